@@ -0,0 +1,46 @@
+// Shared by the forward and deferred paths of 5_Lighting
+
+cbuffer FrameCB : register(b0)
+{
+    float4x4 view;
+    float4x4 viewProj;
+    float4x4 invViewProj;
+    float3 camPosWS;
+    float pd00;
+    float3 lightDir;
+    float pad0;
+    float3 mainLightColor;
+    float pad1;
+};
+
+#include "ClusteredLights.hlsli"
+
+static float s_Shininess = 128.0f;
+
+// Lighting of a surface point: ambient, main directional light and the point and spot lights of its cluster, with their shadows
+// With DRAW_LIGHTS the point and spot lights are the ones of the draw, drawLightRange
+float3 shadeSurface(float3 albedo, float3 N, float3 posWS, float2 pixelPos, uint2 drawLightRange = uint2(0, 0))
+{
+    // Ambient lighting (just to make sure we see something in non lit areas
+    float3 ambient = float3(1.0f, 1.0f, 1.0f) * 0.1f;
+
+    float3 lighting = float3(0.0f, 0.0f, 0.0f);
+    float3 V = normalize(camPosWS - posWS);
+
+    // Dir light
+    float viewDepth = -mul(view, float4(posWS, 1.0f)).z;
+    float NdotL = max(dot(N, -lightDir), 0.0f);
+    if (NdotL > 0.0f)
+    {
+        lighting += NdotL * mainLightColor * getCascadeShadow(posWS, N, viewDepth);
+    }
+
+    // Point and spot lights of the draw or the cluster
+#if defined(DRAW_LIGHTS)
+    lighting += evaluateLightRange(drawLightRange, posWS, N, V, s_Shininess);
+#else
+    lighting += evaluateClusteredLights(pixelPos, viewDepth, posWS, N, V, s_Shininess);
+#endif
+
+    return albedo * (ambient + lighting);
+}
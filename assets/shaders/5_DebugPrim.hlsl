@@ -26,21 +26,7 @@ cbuffer FrameCB : register(b0)
     float3 lightDir;
     float pad0;
 	float3 mainLightColor;
-	
-	// Point
-	float pointLightRadius;
-	float3 pointLightPos;
 	float pad1;
-	float3 pointLightColor;
-
-	// Spot
-	float spotLightInnerCone; // cos of angle
-	float3 spotLightPos;
-	float spotLightOuterCone; // cos of angle
-	float3 spotLightDir;
-	float spotLightInnerRadius;
-	float3 spotLightColor;
-	float spotLightOuterRadius;
 };
 
 cbuffer DrawcallCB : register(b1)
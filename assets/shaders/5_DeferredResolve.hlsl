@@ -0,0 +1,49 @@
+// Full screen lighting of the G-buffer written by 5_GBuffer.hlsl, with the same lights as the forward path
+// Use column major so the matrices are compatible with glm ones
+#pragma pack_matrix(column_major)
+
+#include "5_Common.hlsli"
+
+Texture2D gbufferAlbedo : register(t5);
+Texture2D gbufferNormal : register(t6);
+Texture2D<float> gbufferDepth : register(t7);
+
+struct FS_INPUT
+{
+    float4 pos : SV_POSITION;
+};
+
+// Triangle covering the screen
+FS_INPUT mainVS(uint vertexId : SV_VertexID)
+{
+    FS_INPUT output;
+    float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+    output.pos = float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+    return output;
+}
+
+float4 mainFS(FS_INPUT input) : SV_Target
+{
+    int3 texel = int3(input.pos.xy, 0);
+    float depth = gbufferDepth.Load(texel);
+    if (depth >= 1.0f)
+    {
+        return float4(0.0f, 0.0f, 0.0f, 0.0f); // Background
+    }
+    float3 albedo = gbufferAlbedo.Load(texel).rgb;
+    float4 normal = gbufferNormal.Load(texel);
+    if (normal.a == 0.0f)
+    {
+        return float4(albedo, 1.0f);
+    }
+
+    // World space position from the depth
+    float2 screenSize;
+    gbufferDepth.GetDimensions(screenSize.x, screenSize.y);
+    float2 ndc = float2(input.pos.x / screenSize.x, 1.0f - input.pos.y / screenSize.y) * 2.0f - 1.0f;
+    float4 posWS = mul(invViewProj, float4(ndc, depth, 1.0f));
+    posWS.xyz /= posWS.w;
+
+    float3 N = normalize(normal.xyz * 2.0f - 1.0f);
+    return float4(shadeSurface(albedo, N, posWS.xyz, input.pos.xy), 1.0f);
+}
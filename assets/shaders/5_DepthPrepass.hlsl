@@ -0,0 +1,11 @@
+// Depth only pre-pass of the opaque surfaces of 5_Lighting. Reads the position stream only (GltfScene::VertexBuffer0)
+// Use column major so the matrices are compatible with glm ones
+#pragma pack_matrix(column_major)
+
+#include "5_Common.hlsli"
+#include "5_Surface.hlsli"
+
+float4 prepassVS(float3 pos : POSITION) : SV_POSITION
+{
+    return getClipPosition(pos);
+}
@@ -0,0 +1,26 @@
+// G-buffer pass of the deferred path of 5_Lighting. Lit by 5_DeferredResolve.hlsl
+// Use column major so the matrices are compatible with glm ones
+#pragma pack_matrix(column_major)
+
+#include "5_Common.hlsli"
+#include "5_Surface.hlsli"
+
+struct GBUFFER_OUTPUT
+{
+    float4 albedo : SV_Target0; // RGB: Albedo
+    float4 normal : SV_Target1; // RGB: World space normal * 0.5 + 0.5, A: 1 if lit, 0 if the albedo is output as is
+};
+
+GBUFFER_OUTPUT mainFS(FS_INPUT input, bool isFrontFace : SV_IsFrontFace)
+{
+    Surface surface = getSurface(input, isFrontFace);
+    GBUFFER_OUTPUT output;
+#if defined(DEBUG_NORMALS)
+    output.albedo = float4(surface.N * 0.5 + 0.5, 1.0f);
+    output.normal = float4(0.5f, 0.5f, 1.0f, 0.0f);
+#else // Default
+    output.albedo = float4(surface.albedo, 1.0f);
+    output.normal = float4(normalize(surface.N) * 0.5 + 0.5, 1.0f);
+#endif
+    return output;
+}
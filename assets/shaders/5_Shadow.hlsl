@@ -0,0 +1,25 @@
+// Depth only rendering of the shadow views into their shadow atlas tiles
+// Use column major so the matrices are compatible with glm ones
+#pragma pack_matrix(column_major)
+
+cbuffer ShadowPassCB : register(b0)
+{
+    float4x4 viewProj;
+};
+
+cbuffer DrawcallCB : register(b1)
+{
+    float4x4 model;
+};
+
+float4 mainVS(float3 pos : POSITION) : SV_POSITION
+{
+    return mul(viewProj, mul(model, float4(pos, 1.0f)));
+}
+
+// Triangle covering the viewport at the far plane, clears the tile before rendering it
+float4 clearVS(uint vertexId : SV_VertexID) : SV_POSITION
+{
+    float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+    return float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 1.0f, 1.0f);
+}
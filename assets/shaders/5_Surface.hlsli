@@ -0,0 +1,161 @@
+// Geometry and materials of the GltfScene surfaces, shared by the forward and G-buffer passes of 5_Lighting
+// Needs FrameCB (5_Common.hlsli)
+
+struct VS_INPUT
+{
+    float3 pos : POSITION;
+    float3 normal : NORMAL;
+    float4 tangent : TANGENT;
+    float2 uv : TEXCOORD0;
+#ifdef GPU_DRIVEN
+    uint drawId : DRAWID; // Per instance, the GPU culling writes it as the start instance
+#endif
+};
+
+struct FS_INPUT
+{
+    float4 pos : SV_POSITION;
+    float3 posWS : POSWS;
+    float3 normal : NORMAL;
+//#ifdef NORMAL_MAPPING
+    float4 tangent : TANGENT;
+//#endif
+    float2 uv : TEXCOORD0;
+#ifdef GPU_DRIVEN
+    nointerpolation uint drawId : DRAWID;
+#endif
+};
+
+#ifdef GPU_DRIVEN
+// Draws of the GPU-driven path come from indirect arguments, their data is read from a buffer with the draw id
+struct DrawcallData
+{
+    float4x4 model;
+    uint albedoSlice;
+    uint normalSlice;
+    float alphaCutoff;
+    float normalScale;
+    float4 baseColorFactor;
+    uint2 lightRange;
+    uint2 drawPad;
+};
+StructuredBuffer<DrawcallData> drawcallData : register(t12);
+
+static float4x4 model;
+static uint albedoSlice;
+static uint normalSlice;
+static float alphaCutoff;
+static float normalScale;
+static float4 baseColorFactor;
+
+void loadDrawcallData(uint drawId)
+{
+    DrawcallData data = drawcallData[drawId];
+    model = data.model;
+    albedoSlice = data.albedoSlice;
+    normalSlice = data.normalSlice;
+    alphaCutoff = data.alphaCutoff;
+    normalScale = data.normalScale;
+    baseColorFactor = data.baseColorFactor;
+}
+#else
+cbuffer DrawcallCB : register(b1)
+{
+    float4x4 model;
+    uint albedoSlice; // Only used with TEXTURE_ARRAYS
+    uint normalSlice;
+    float alphaCutoff; // Only used with ALPHA_TEST
+    float normalScale;
+    float4 baseColorFactor;
+    uint2 lightRange; // Only used with DRAW_LIGHTS, offset and count in the light indices
+    uint2 drawPad;
+};
+#endif
+
+// Samplers of the material textures
+SamplerState albedoSampler : register(s0);
+SamplerState normalSampler : register(s1);
+
+#ifdef TEXTURE_ARRAYS
+Texture2DArray tex_albedo : register(t0);
+#define SAMPLE_ALBEDO(uv) tex_albedo.Sample(albedoSampler, float3(uv, albedoSlice))
+#else
+Texture2D tex_albedo : register(t0);
+#define SAMPLE_ALBEDO(uv) tex_albedo.Sample(albedoSampler, uv)
+#endif
+
+#ifdef NORMAL_MAPPING
+#ifdef TEXTURE_ARRAYS
+Texture2DArray tex_normal : register(t1);
+#define SAMPLE_NORMAL(uv) tex_normal.Sample(normalSampler, float3(uv, normalSlice))
+#else
+Texture2D tex_normal : register(t1);
+#define SAMPLE_NORMAL(uv) tex_normal.Sample(normalSampler, uv)
+#endif
+#endif
+
+// Clip space position. The depth pre-pass uses it too, both passes have to produce the same depth for the EQUAL test
+float4 getClipPosition(float3 pos)
+{
+    float4x4 modelViewProj = mul(viewProj, model);
+    precise float4 posCS = mul(modelViewProj, float4(pos, 1.0f));
+    return posCS;
+}
+
+FS_INPUT mainVS(VS_INPUT input)
+{
+    FS_INPUT output;
+#ifdef GPU_DRIVEN
+    loadDrawcallData(input.drawId);
+    output.drawId = input.drawId;
+#endif
+
+    output.normal = normalize(mul((float3x3)model, input.normal));
+    output.pos = getClipPosition(input.pos);
+    output.posWS = mul(model, float4(input.pos, 1.0f)).xyz;
+    output.uv = input.uv;
+#ifdef NORMAL_MAPPING
+    output.tangent = float4(normalize(mul((float3x3)model, input.tangent.xyz)), input.tangent.w);
+#endif
+    return output;
+}
+
+struct Surface
+{
+    float3 albedo;
+    float3 N;
+};
+
+// Material inputs of a pixel. Discards the pixel if it fails the alpha test
+Surface getSurface(FS_INPUT input, bool isFrontFace)
+{
+#ifdef GPU_DRIVEN
+    loadDrawcallData(input.drawId);
+#endif
+    Surface surface;
+    float4 baseColor = SAMPLE_ALBEDO(input.uv) * baseColorFactor;
+#ifdef ALPHA_TEST
+    clip(baseColor.a - alphaCutoff);
+#endif
+    surface.albedo = baseColor.rgb;
+
+    float3 N = input.normal;
+#ifdef DOUBLE_SIDED
+    // Back faces are lit from their side
+    N = isFrontFace ? N : -N;
+    input.tangent.w = isFrontFace ? input.tangent.w : -input.tangent.w;
+#endif
+
+#ifdef NORMAL_MAPPING
+    // Only XY are read, cooked normal maps are BC5 (2 channels)
+    float2 normalXY = SAMPLE_NORMAL(input.uv).rg * 2.0f - 1.0f;
+    float3 normal = normalize(float3(normalXY * normalScale, sqrt(saturate(1.0f - dot(normalXY, normalXY)))));
+    float3x3 TBN = transpose(float3x3(
+        input.tangent.xyz,
+        cross(N, input.tangent.xyz) * input.tangent.w,
+        N));
+    N = mul(TBN, normal);
+#endif
+    surface.N = N;
+    return surface;
+}
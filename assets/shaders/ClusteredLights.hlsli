@@ -0,0 +1,97 @@
+// Clustered point and spot lights, see framework/LightClusters.h
+// Bind the lights to t2, the cluster ranges to t3, the light indices to t4 and the cluster constants to b2
+// With DRAW_LIGHTS t4 holds the per draw lists of framework/DrawLightLists.h instead, the draw gives the range
+
+#include "Shadows.hlsli"
+
+struct LightData
+{
+    float3 pos;
+    float radius;
+    float3 color;
+    uint type; // 0: Point, 1: Spot
+    float3 dir;
+    float cosInnerCone;
+    float cosOuterCone;
+    uint shadowView; // First view in shadowViews, or NO_SHADOW. Points have 6, one per cube face
+    float2 pad;
+};
+
+cbuffer ClusterCB : register(b2)
+{
+    float4 clusterGrid; // Tiles x, tiles y, slices, light count
+    float4 clusterScaleBias; // Pixel to tile scale (x, y), view depth to slice scale and bias
+};
+
+StructuredBuffer<LightData> lights : register(t2);
+StructuredBuffer<uint2> clusterRanges : register(t3); // Offset, count
+StructuredBuffer<uint> clusterLightIndices : register(t4);
+
+// Obtained from Filament (https://google.github.io/filament/Filament.html#lighting/directlighting/punctuallights)
+float getSquareFalloffAttenuation(float3 posToLight, float lightInvRadius) {
+    float distanceSquare = dot(posToLight, posToLight);
+    float factor = distanceSquare * lightInvRadius * lightInvRadius;
+    float smoothFactor = max(1.0 - factor * factor, 0.0);
+    return (smoothFactor * smoothFactor) / max(distanceSquare, 1e-4);
+}
+
+float getSpotAngleAttenuation(float3 l, float3 lightDir, float cosInnerAngle, float cosOuterAngle) 
+{
+    float spotScale = 1.0 / max(cosInnerAngle - cosOuterAngle, 1e-4);
+    float spotOffset = -cosOuterAngle * spotScale;
+
+    float cd = dot(normalize(-lightDir), l);
+    float attenuation = clamp(cd * spotScale + spotOffset, 0.0, 1.0);
+    return attenuation * attenuation;
+}
+
+// Range of clusterLightIndices with the lights that can reach the pixel. viewDepth is positive
+uint2 getClusterRange(float2 pixelPos, float viewDepth)
+{
+    uint3 cluster;
+    cluster.xy = min(uint2(pixelPos * clusterScaleBias.xy), uint2(clusterGrid.xy) - 1);
+    cluster.z = (uint)clamp(log(max(viewDepth, 1e-4)) * clusterScaleBias.z + clusterScaleBias.w, 0.0, clusterGrid.z - 1.0);
+    return clusterRanges[(cluster.z * (uint)clusterGrid.y + cluster.y) * (uint)clusterGrid.x + cluster.x];
+}
+
+// Diffuse and specular (Blinn-Phong) lighting of a point or spot light
+float3 evaluateLight(LightData light, float3 posWS, float3 N, float3 V, float shininess)
+{
+    float3 posToLight = light.pos - posWS;
+    float3 L = normalize(posToLight);
+    float3 H = normalize(L + V);
+    float NdotL = max(0.0f, dot(L, N));
+    float3 specular = light.color * pow(max(0.0f, dot(N, H)), shininess);
+
+    float atten = getSquareFalloffAttenuation(posToLight, 1.0f / light.radius);
+    if (light.type == 1)
+    {
+        atten *= getSpotAngleAttenuation(normalize(light.dir), L, light.cosInnerCone, light.cosOuterCone);
+    }
+    if (light.shadowView != NO_SHADOW && atten > 0.0f)
+    {
+        uint view = light.shadowView;
+        if (light.type == 0)
+        {
+            view += getCubeFace(-posToLight);
+        }
+        atten *= sampleShadowView(view, posWS, N);
+    }
+    return atten * NdotL * (light.color + specular);
+}
+
+// Lights of a range (offset, count) of clusterLightIndices
+float3 evaluateLightRange(uint2 range, float3 posWS, float3 N, float3 V, float shininess)
+{
+    float3 lighting = float3(0.0f, 0.0f, 0.0f);
+    for (uint i = 0; i < range.y; ++i)
+    {
+        lighting += evaluateLight(lights[clusterLightIndices[range.x + i]], posWS, N, V, shininess);
+    }
+    return lighting;
+}
+
+float3 evaluateClusteredLights(float2 pixelPos, float viewDepth, float3 posWS, float3 N, float3 V, float shininess)
+{
+    return evaluateLightRange(getClusterRange(pixelPos, viewDepth), posWS, N, V, shininess);
+}
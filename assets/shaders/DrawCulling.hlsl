@@ -0,0 +1,163 @@
+// GPU-driven draw culling. Frustum and depth hierarchy tests per draw, visible draws are compacted into the indirect arguments
+// of their batch. framework/DrawCulling.cpp is the CPU reference, keep them in sync
+// Use column major so the matrices are compatible with glm ones
+#pragma pack_matrix(column_major)
+
+#define THREAD_GROUP_SIZE 64
+#define NEAR_W 0.01f
+#define ARGS_STRIDE 20 // D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS
+
+// DrawCulling::Phase and the visibility flags
+#define SINGLE_PHASE 0
+#define EARLY_PHASE 1
+#define LATE_PHASE 2
+#define VISIBLE_FLAG 1
+#define DRAWN_EARLY_FLAG 2
+
+struct CullDraw
+{
+    float3 boundsCenter; // World space box
+    uint batch;
+    float3 boundsExtents;
+    float boundsRadius;
+    uint indexCount;
+    uint firstIndex;
+    int baseVertex;
+    uint drawId;
+};
+
+struct CullBatch
+{
+    uint firstArgs;
+    uint drawCount;
+};
+
+cbuffer CullCB : register(b0)
+{
+    float4 frustumPlanes[5];
+    float4x4 hizViewProj;
+    uint hizWidth;
+    uint hizHeight;
+    uint hizLevelCount; // 0 disables the occlusion test
+    uint drawCount;
+    uint batchCount;
+    uint argsCount;
+    uint phase;
+    uint cullPad;
+};
+
+StructuredBuffer<CullDraw> draws : register(t0);
+StructuredBuffer<CullBatch> batches : register(t1);
+Texture2D<float> hiz : register(t2);
+RWByteAddressBuffer indirectArgs : register(u0);
+RWByteAddressBuffer batchCounts : register(u1); // Visible draws per batch
+RWByteAddressBuffer visibility : register(u2); // Flags per draw, kept between frames. Unused by the single phase
+
+bool isDrawVisible(CullDraw draw)
+{
+    [unroll]
+    for (uint i = 0; i < 5; ++i)
+    {
+        if (dot(frustumPlanes[i].xyz, draw.boundsCenter) + frustumPlanes[i].w < -draw.boundsRadius)
+        {
+            return false;
+        }
+    }
+    if (hizLevelCount == 0)
+    {
+        return true;
+    }
+
+    float2 minUV = 1e30f;
+    float2 maxUV = -1e30f;
+    float minDepth = 1e30f;
+    [unroll]
+    for (uint c = 0; c < 8; ++c)
+    {
+        float3 corner = draw.boundsCenter + draw.boundsExtents * float3((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f);
+        float4 clipPos = mul(hizViewProj, float4(corner, 1.0f));
+        if (clipPos.w < NEAR_W)
+        {
+            return true;
+        }
+        float3 ndc = clipPos.xyz / clipPos.w;
+        float2 uv = float2(ndc.x * 0.5f + 0.5f, 0.5f - ndc.y * 0.5f);
+        minUV = min(minUV, uv);
+        maxUV = max(maxUV, uv);
+        minDepth = min(minDepth, ndc.z);
+    }
+    if (maxUV.x < 0.0f || maxUV.y < 0.0f || minUV.x > 1.0f || minUV.y > 1.0f)
+    {
+        return true; // Wasn't on screen, there is no depth to test against
+    }
+
+    // Level where the box covers at most 2x2 texels
+    float2 size = float2(hizWidth, hizHeight);
+    uint2 minTexel = uint2(clamp(minUV * size, 0.0f, size - 1.0f));
+    uint2 maxTexel = uint2(clamp(maxUV * size, 0.0f, size - 1.0f));
+    uint level = 0;
+    while (level + 1 < hizLevelCount && ((maxTexel.x >> level) - (minTexel.x >> level) > 1 || (maxTexel.y >> level) - (minTexel.y >> level) > 1))
+    {
+        level++;
+    }
+    uint2 levelSize = max(uint2(hizWidth, hizHeight) >> level, 1);
+    uint2 first = min(minTexel >> level, levelSize - 1);
+    uint2 last = min(maxTexel >> level, levelSize - 1);
+    float maxDepth = 0.0f;
+    for (uint y = first.y; y <= last.y; ++y)
+    {
+        for (uint x = first.x; x <= last.x; ++x)
+        {
+            maxDepth = max(maxDepth, hiz.Load(int3(x, y, level)));
+        }
+    }
+    return minDepth <= maxDepth;
+}
+
+// Empties the arguments and the batch counters. Dispatched before cullCS
+[numthreads(THREAD_GROUP_SIZE, 1, 1)]
+void clearCS(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x < argsCount)
+    {
+        indirectArgs.Store4(id.x * ARGS_STRIDE, uint4(0, 0, 0, 0));
+        indirectArgs.Store(id.x * ARGS_STRIDE + 16, 0);
+    }
+    if (id.x < batchCount)
+    {
+        batchCounts.Store(id.x * 4, 0);
+    }
+}
+
+[numthreads(THREAD_GROUP_SIZE, 1, 1)]
+void cullCS(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= drawCount)
+    {
+        return;
+    }
+    CullDraw draw = draws[id.x];
+    uint flags = phase != SINGLE_PHASE ? visibility.Load(draw.drawId * 4) : 0;
+    if (phase == EARLY_PHASE && (flags & VISIBLE_FLAG) == 0)
+    {
+        return;
+    }
+    bool isVisible = isDrawVisible(draw);
+    if (phase == EARLY_PHASE)
+    {
+        visibility.Store(draw.drawId * 4, isVisible ? (flags | DRAWN_EARLY_FLAG) : (flags & ~DRAWN_EARLY_FLAG));
+    }
+    else if (phase == LATE_PHASE)
+    {
+        visibility.Store(draw.drawId * 4, isVisible ? VISIBLE_FLAG : 0);
+    }
+    if (!isVisible || (phase == LATE_PHASE && (flags & DRAWN_EARLY_FLAG) != 0))
+    {
+        return;
+    }
+    uint slot;
+    batchCounts.InterlockedAdd(draw.batch * 4, 1, slot);
+    uint offset = (batches[draw.batch].firstArgs + slot) * ARGS_STRIDE;
+    indirectArgs.Store4(offset, uint4(draw.indexCount, 1, draw.firstIndex, asuint(draw.baseVertex)));
+    indirectArgs.Store(offset + 16, draw.drawId);
+}
@@ -0,0 +1,100 @@
+// Automatic exposure in a single dispatch: luminance histogram, average and temporal adaptation. framework/AutoExposure.cpp
+// is the CPU reference, keep them in sync
+
+#define TILE_SIZE 16
+#define BIN_COUNT (TILE_SIZE * TILE_SIZE) // One bin per thread
+
+// Words of the state buffer (AutoExposure::s_*Word), after the bins
+#define GROUP_COUNTER_OFFSET (BIN_COUNT * 4)
+#define AVERAGE_OFFSET (GROUP_COUNTER_OFFSET + 4)
+#define ADAPTED_OFFSET (GROUP_COUNTER_OFFSET + 8)
+#define EXPOSURE_OFFSET (GROUP_COUNTER_OFFSET + 12)
+
+cbuffer ExposureCB : register(b0)
+{
+    uint2 size;
+    uint groupCount;
+    float minLogLuminance;
+    float logLuminanceRange;
+    float adaptationRate;
+    float keyValue;
+    float exposureScale;
+};
+
+Texture2D<float4> sceneColor : register(t0);
+// Other groups' atomics have to be visible to the last group
+globallycoherent RWByteAddressBuffer state : register(u0);
+
+groupshared uint s_bins[BIN_COUNT];
+groupshared bool s_isLastGroup;
+
+uint getBin(float3 color)
+{
+    float luminance = dot(color, float3(0.2126f, 0.7152f, 0.0722f));
+    if (!(luminance > 1e-5f))
+    {
+        return 0;
+    }
+    float logLuminance = saturate((log2(luminance) - minLogLuminance) / logLuminanceRange);
+    return (uint)(logLuminance * (BIN_COUNT - 2) + 1.0f);
+}
+
+[numthreads(TILE_SIZE, TILE_SIZE, 1)]
+void exposureCS(uint3 id : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
+{
+    // Histogram of the tile, added to the one of the frame
+    s_bins[groupIndex] = 0;
+    GroupMemoryBarrierWithGroupSync();
+    if (all(id.xy < size))
+    {
+        InterlockedAdd(s_bins[getBin(sceneColor.Load(int3(id.xy, 0)).rgb)], 1);
+    }
+    GroupMemoryBarrierWithGroupSync();
+    if (s_bins[groupIndex] != 0)
+    {
+        state.InterlockedAdd(groupIndex * 4, s_bins[groupIndex]);
+    }
+    DeviceMemoryBarrierWithGroupSync();
+    if (groupIndex == 0)
+    {
+        uint doneCount;
+        state.InterlockedAdd(GROUP_COUNTER_OFFSET, 1, doneCount);
+        s_isLastGroup = doneCount == groupCount - 1;
+    }
+    GroupMemoryBarrierWithGroupSync();
+    if (!s_isLastGroup)
+    {
+        return;
+    }
+
+    // The last group averages the frame's histogram and clears it for the next frame
+    uint count = state.Load(groupIndex * 4);
+    state.Store(groupIndex * 4, 0);
+    s_bins[groupIndex] = count * groupIndex;
+    GroupMemoryBarrierWithGroupSync();
+    [unroll]
+    for (uint stride = BIN_COUNT / 2; stride > 0; stride >>= 1)
+    {
+        if (groupIndex < stride)
+        {
+            s_bins[groupIndex] += s_bins[groupIndex + stride];
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+    if (groupIndex == 0)
+    {
+        uint countedCount = size.x * size.y - count; // Thread 0 has the count of bin 0
+        float average = exp2(minLogLuminance);
+        if (countedCount > 0)
+        {
+            float averageBin = (float)s_bins[0] / (float)countedCount;
+            average = exp2((averageBin - 1.0f) / (BIN_COUNT - 2) * logLuminanceRange + minLogLuminance);
+        }
+        float adapted = asfloat(state.Load(ADAPTED_OFFSET));
+        adapted = adapted > 0.0f ? adapted + (average - adapted) * adaptationRate : average;
+        state.Store(GROUP_COUNTER_OFFSET, 0);
+        state.Store(AVERAGE_OFFSET, asuint(average));
+        state.Store(ADAPTED_OFFSET, asuint(adapted));
+        state.Store(EXPOSURE_OFFSET, asuint(keyValue / max(adapted, 1e-5f) * exposureScale));
+    }
+}
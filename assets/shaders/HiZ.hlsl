@@ -0,0 +1,47 @@
+// Depth hierarchy for occlusion culling: every texel keeps the farthest depth of the texels it covers. See framework/DrawCulling.h
+// Levels halve the size rounding down, like texture mips, so the last texel of an odd row or column also takes the one left over
+
+cbuffer HiZCB : register(b0)
+{
+    uint2 srcSize;
+    uint2 dstSize;
+};
+
+// copyDepthCS: the depth attachment, downsampleCS: the previous level
+Texture2D<float> srcLevel : register(t0);
+RWTexture2D<float> dstLevel : register(u0);
+
+// Level 0
+[numthreads(8, 8, 1)]
+void copyDepthCS(uint3 id : SV_DispatchThreadID)
+{
+    if (any(id.xy >= dstSize))
+    {
+        return;
+    }
+    dstLevel[id.xy] = srcLevel.Load(int3(id.xy, 0));
+}
+
+[numthreads(8, 8, 1)]
+void downsampleCS(uint3 id : SV_DispatchThreadID)
+{
+    if (any(id.xy >= dstSize))
+    {
+        return;
+    }
+    uint2 first = id.xy * 2;
+    uint2 last = first + 1;
+    last.x += (id.x == dstSize.x - 1 && (srcSize.x & 1)) ? 1 : 0;
+    last.y += (id.y == dstSize.y - 1 && (srcSize.y & 1)) ? 1 : 0;
+    last = min(last, srcSize - 1);
+
+    float maxDepth = 0.0f;
+    for (uint y = first.y; y <= last.y; ++y)
+    {
+        for (uint x = first.x; x <= last.x; ++x)
+        {
+            maxDepth = max(maxDepth, srcLevel.Load(int3(x, y, 0)));
+        }
+    }
+    dstLevel[id.xy] = maxDepth;
+}
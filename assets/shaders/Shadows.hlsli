@@ -0,0 +1,89 @@
+// Shadows rendered in the shadow atlas, see framework/ShadowAtlas.h
+// Bind the shadow views to t10, the atlas to t11, the comparison sampler to s2 and the shadow constants to b4
+
+#define NO_SHADOW 0xFFFFFFFF
+
+struct ShadowView
+{
+    float4x4 viewProj;
+    float4 atlasScaleBias; // NDC to atlas UV
+    float4 atlasBounds; // UV rect of the tile, shrunk by half a texel so filtering doesn't read the neighbour tiles
+    float normalOffset; // World units the position is pushed along the normal, per unit of distance for perspective views
+    uint isPerspective;
+    uint isValid; // The tile hasn't been rendered yet
+    float pad;
+};
+
+cbuffer ShadowCB : register(b4)
+{
+    float4 cascadeSplits; // View depth where each cascade ends
+    uint cascadeCount;
+    float3 shadowPad;
+};
+
+StructuredBuffer<ShadowView> shadowViews : register(t10);
+Texture2D<float> shadowAtlas : register(t11);
+SamplerComparisonState shadowSampler : register(s2);
+
+// Face of a point light cube: +X, -X, +Y, -Y, +Z, -Z
+uint getCubeFace(float3 dir)
+{
+    float3 absDir = abs(dir);
+    if (absDir.x >= absDir.y && absDir.x >= absDir.z)
+    {
+        return dir.x > 0.0f ? 0 : 1;
+    }
+    if (absDir.y >= absDir.z)
+    {
+        return dir.y > 0.0f ? 2 : 3;
+    }
+    return dir.z > 0.0f ? 4 : 5;
+}
+
+// 1: Lit, 0: In shadow. 2x2 bilinear PCF taps, 4x4 texels
+float sampleShadowView(uint viewIdx, float3 posWS, float3 N)
+{
+    ShadowView view = shadowViews[viewIdx];
+    if (view.isValid == 0)
+    {
+        return 1.0f;
+    }
+    float offset = view.normalOffset;
+    if (view.isPerspective != 0)
+    {
+        offset *= mul(view.viewProj, float4(posWS, 1.0f)).w;
+    }
+    float4 posCS = mul(view.viewProj, float4(posWS + N * offset, 1.0f));
+    float3 ndc = posCS.xyz / posCS.w;
+    if (any(abs(ndc.xy) > 1.0f) || ndc.z > 1.0f)
+    {
+        return 1.0f;
+    }
+
+    float2 uv = ndc.xy * view.atlasScaleBias.xy + view.atlasScaleBias.zw;
+    float width, height;
+    shadowAtlas.GetDimensions(width, height);
+    float2 texel = 1.0f / float2(width, height);
+    float shadow = 0.0f;
+    [unroll]
+    for (int i = 0; i < 4; ++i)
+    {
+        float2 tapUV = uv + (float2(i & 1, i >> 1) - 0.5f) * texel * 2.0f;
+        tapUV = clamp(tapUV, view.atlasBounds.xy, view.atlasBounds.zw);
+        shadow += shadowAtlas.SampleCmpLevelZero(shadowSampler, tapUV, ndc.z);
+    }
+    return shadow * 0.25f;
+}
+
+// Directional light shadow of the cascade the position falls in. Cascades are the first shadow views
+float getCascadeShadow(float3 posWS, float3 N, float viewDepth)
+{
+    for (uint i = 0; i < cascadeCount; ++i)
+    {
+        if (viewDepth < cascadeSplits[i])
+        {
+            return sampleShadowView(i, posWS, N);
+        }
+    }
+    return 1.0f;
+}
@@ -0,0 +1,38 @@
+// HDR scene color to the back buffer with the exposure of Exposure.hlsl. See AutoExposure::tonemap
+
+#define EXPOSURE_OFFSET (256 * 4 + 12) // AutoExposure::s_exposureWord
+
+Texture2D<float4> sceneColor : register(t0);
+ByteAddressBuffer exposureState : register(t1);
+
+struct FS_INPUT
+{
+    float4 pos : SV_POSITION;
+};
+
+// Triangle covering the screen
+FS_INPUT mainVS(uint vertexId : SV_VertexID)
+{
+    FS_INPUT output;
+    float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+    output.pos = float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 0.0f, 1.0f);
+    return output;
+}
+
+// Narkowicz's fit of the ACES filmic curve
+float3 tonemapACES(float3 x)
+{
+    return saturate((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f));
+}
+
+float3 linearToSRGB(float3 color)
+{
+    return color <= 0.0031308f ? color * 12.92f : 1.055f * pow(color, 1.0f / 2.4f) - 0.055f;
+}
+
+float4 mainFS(FS_INPUT input) : SV_Target
+{
+    float exposure = asfloat(exposureState.Load(EXPOSURE_OFFSET));
+    float3 color = max(sceneColor.Load(int3(input.pos.xy, 0)).rgb * exposure, 0.0f);
+    return float4(linearToSRGB(tonemapACES(color)), 1.0f);
+}
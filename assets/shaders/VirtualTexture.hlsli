@@ -0,0 +1,47 @@
+// Software virtual texture sampling, see framework/VirtualTexture.h
+// Bind the page table to t8, the physical page cache to t9 and the constants to b3. The sampler should clamp,
+// the page borders cover the filter footprint
+
+cbuffer VirtualTextureCB : register(b3)
+{
+    float4 vt_virtualSize; // Width, height, page size, mip count
+    float4 vt_physicalSize; // Width, height, page stride, page border
+};
+
+Texture2D<uint4> vt_pageTable : register(t8);
+Texture2D vt_physical : register(t9);
+
+// Mip of the virtual texture needed by the pixel
+float vtComputeMip(float2 uv)
+{
+    float2 texels = uv * vt_virtualSize.xy;
+    float2 dx = ddx(texels);
+    float2 dy = ddy(texels);
+    float maxLenSq = max(dot(dx, dx), dot(dy, dy));
+    return clamp(0.5 * log2(maxLenSq), 0.0, vt_virtualSize.w - 1.0);
+}
+
+// Value to write to the feedback target: page id + 1, the target is cleared to 0
+uint vtFeedback(float2 uv)
+{
+    uint mip = (uint)vtComputeMip(uv);
+    uint2 pages = max(uint2(vt_virtualSize.xy) >> mip, 1) + (uint)vt_virtualSize.z - 1;
+    pages /= (uint)vt_virtualSize.z;
+    uint2 page = min(uint2(frac(uv) * pages), pages - 1);
+    return ((mip << 28) | (page.y << 14) | page.x) + 1;
+}
+
+float4 vtSample(SamplerState samplerState, float2 uv)
+{
+    // The derivatives must come from the unwrapped uv, frac jumps at the seams and would pick the coarsest mip there
+    float mip = vtComputeMip(uv);
+    uv = frac(uv);
+
+    // The entry of the page, or of the closest resident ancestor
+    uint4 entry = vt_pageTable.Load(int3(uv * (vt_virtualSize.xy / vt_virtualSize.z) / exp2(floor(mip)), floor(mip)));
+    uint residentMip = entry.z;
+    float pageSizeInMip = vt_virtualSize.z * exp2(residentMip); // Virtual texels covered by a page of that mip
+    float2 inPage = frac(uv * vt_virtualSize.xy / pageSizeInMip) * vt_virtualSize.z;
+    float2 physicalTexel = float2(entry.xy) * vt_physicalSize.z + vt_physicalSize.w + inPage;
+    return vt_physical.SampleLevel(samplerState, physicalTexel / vt_physicalSize.xy, 0);
+}
@@ -4061,6 +4061,9 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const json &o,
           return false;
         }
       } else {
+#ifdef TINYGLTF_NO_EXTERNAL_BUFFER
+        // Keep the uri, the application reads the .bin file on demand.
+#else
         // External .bin file.
         std::string decoded_uri = dlib::urldecode(buffer->uri);
         if (!LoadExternalFile(&buffer->data, err, /* warn */ nullptr,
@@ -4068,6 +4071,7 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const json &o,
                               byteLength, /* checkSize */ true, fs)) {
           return false;
         }
+#endif
       }
     } else {
       // load data from (embedded) binary data
@@ -4090,9 +4094,14 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const json &o,
         return false;
       }
 
+#ifdef TINYGLTF_NO_BINARY_CHUNK_COPY
+      // The application reads the BIN chunk straight from the GLB, buffer->data
+      // is left empty.
+#else
       // Read buffer data
       buffer->data.resize(static_cast<size_t>(byteLength));
       memcpy(&(buffer->data.at(0)), bin_data, static_cast<size_t>(byteLength));
+#endif
     }
 
   } else {
@@ -4106,6 +4115,9 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const json &o,
         return false;
       }
     } else {
+#ifdef TINYGLTF_NO_EXTERNAL_BUFFER
+      // Keep the uri, the application reads the .bin file on demand.
+#else
       // Assume external .bin file.
       std::string decoded_uri = dlib::urldecode(buffer->uri);
       if (!LoadExternalFile(&buffer->data, err, /* warn */ nullptr, decoded_uri,
@@ -4113,6 +4125,7 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const json &o,
                             /* checkSize */ true, fs)) {
         return false;
       }
+#endif
     }
   }
 
@@ -5936,6 +5949,15 @@ bool TinyGLTF::LoadFromString(Model *model, std::string *err, std::string *warn,
         }
         const Buffer &buffer = model->buffers[size_t(bufferView.buffer)];
 
+        if (buffer.data.empty()) {
+          // Buffer payload not owned by tinygltf (see
+          // TINYGLTF_NO_BINARY_CHUNK_COPY and TINYGLTF_NO_EXTERNAL_BUFFER),
+          // leave the image for the application to decode from the bufferView.
+          model->images.emplace_back(std::move(image));
+          ++idx;
+          return true;
+        }
+
         if (*LoadImageData == nullptr) {
           if (err) {
             (*err) += "No LoadImageData callback specified.\n";
@@ -0,0 +1,314 @@
+#include "framework/Types.h"
+#include "framework/AccessorUtils.h"
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <emmintrin.h>
+
+namespace framework
+{
+
+	// Normalized integers as defined by glTF: unsigned c / max, signed max(c / max, -1)
+	template<typename T>
+	static inline f32 toFloat(T value, bool normalized)
+	{
+		if (!normalized)
+		{
+			return static_cast<f32>(value);
+		}
+		static constexpr f32 s_invMax = 1.0f / static_cast<f32>(std::numeric_limits<T>::max());
+		return glm::max(static_cast<f32>(value) * s_invMax, -1.0f);
+	}
+
+	template<>
+	inline f32 toFloat<f32>(f32 value, bool /*normalized*/)
+	{
+		return value;
+	}
+
+	// Generic kernel, handles any stride, component count and element indices
+	template<typename T, bool Normalized>
+	static void convertGeneric(const AccessorUtils::Stream& src, u32 count, f32* dst, u32 dstComponentCount, u32 dstStride, const u32* elementIndices)
+	{
+		const u32 components = glm::min(src.m_componentCount, dstComponentCount);
+		u8* dstBytes = reinterpret_cast<u8*>(dst);
+		for (u32 i = 0; i < count; ++i, dstBytes += dstStride)
+		{
+			const u8* element = src.m_data + src.m_stride * (elementIndices ? elementIndices[i] : i);
+			f32* dstElement = reinterpret_cast<f32*>(dstBytes);
+			for (u32 c = 0; c < components; ++c)
+			{
+				T value;
+				memcpy(&value, element + c * sizeof(T), sizeof(T));
+				dstElement[c] = toFloat<T>(value, Normalized);
+			}
+		}
+	}
+
+	// Up to 4 floats of an element in the low lanes. Never reads or writes past the last component, elements are interleaved
+	template<u32 Components>
+	static inline __m128 loadFloats(const u8* src)
+	{
+		if (Components == 4)
+		{
+			return _mm_loadu_ps(reinterpret_cast<const f32*>(src));
+		}
+		const __m128 xy = _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+		return Components == 3 ? _mm_movelh_ps(xy, _mm_load_ss(reinterpret_cast<const f32*>(src + 8))) : xy;
+	}
+
+	template<u32 Components>
+	static inline void storeFloats(u8* dst, __m128 values)
+	{
+		if (Components == 4)
+		{
+			_mm_storeu_ps(reinterpret_cast<f32*>(dst), values);
+			return;
+		}
+		if (Components == 1)
+		{
+			_mm_store_ss(reinterpret_cast<f32*>(dst), values);
+			return;
+		}
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_castps_si128(values));
+		if (Components == 3)
+		{
+			_mm_store_ss(reinterpret_cast<f32*>(dst + 8), _mm_movehl_ps(values, values));
+		}
+	}
+
+	// Floats with a fixed component count, the common case for positions, normals and uvs. Any stride and element indices
+	template<u32 Components>
+	static void gatherFloats(const u8* src, u32 srcStride, u32 count, u8* dst, u32 dstStride, const u32* elementIndices)
+	{
+		for (u32 i = 0; i < count; ++i, dst += dstStride)
+		{
+			storeFloats<Components>(dst, loadFloats<Components>(src + srcStride * (elementIndices ? elementIndices[i] : i)));
+		}
+	}
+
+	// 8 or 16 bit integers in the low lanes of values, widened to 32 bit
+	template<typename T>
+	static inline __m128i widenTo32(__m128i values)
+	{
+		static constexpr bool s_isSigned = std::numeric_limits<T>::is_signed;
+		const __m128i zero = _mm_setzero_si128();
+		if (sizeof(T) == 1)
+		{
+			// Place each byte in the high half of a 16 bit lane and shift back to extend
+			values = s_isSigned ? _mm_srai_epi16(_mm_unpacklo_epi8(zero, values), 8) : _mm_unpacklo_epi8(values, zero);
+		}
+		return s_isSigned ? _mm_srai_epi32(_mm_unpacklo_epi16(zero, values), 16) : _mm_unpacklo_epi16(values, zero);
+	}
+
+	// 8 or 16 bit integer elements to floats, one element per iteration. Any stride and element indices, so it reads
+	// interleaved sources and writes the interleaved vertex buffers directly
+	template<typename T, bool Normalized, u32 Components>
+	static void convertElementsSIMD(const u8* src, u32 srcStride, u32 count, u8* dst, u32 dstStride, const u32* elementIndices)
+	{
+		static_assert(sizeof(T) <= 2, "Only 8 and 16 bit components");
+		static constexpr bool s_isSigned = std::numeric_limits<T>::is_signed;
+		const __m128 scale = _mm_set1_ps(Normalized ? (1.0f / static_cast<f32>(std::numeric_limits<T>::max())) : 1.0f);
+		const __m128 minusOne = _mm_set1_ps(-1.0f);
+		for (u32 i = 0; i < count; ++i, dst += dstStride)
+		{
+			u64 bits = 0;
+			memcpy(&bits, src + srcStride * (elementIndices ? elementIndices[i] : i), Components * sizeof(T));
+			__m128 values = _mm_mul_ps(_mm_cvtepi32_ps(widenTo32<T>(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&bits)))), scale);
+			if (Normalized && s_isSigned)
+			{
+				values = _mm_max_ps(values, minusOne);
+			}
+			storeFloats<Components>(dst, values);
+		}
+	}
+
+	// Tightly packed integer components to tightly packed floats, 8 components per iteration
+	template<typename T, bool Normalized>
+	static void convertPackedSIMD(const T* src, u32 componentCount, f32* dst)
+	{
+		static_assert(sizeof(T) <= 2, "Only 8 and 16 bit components");
+		static constexpr bool s_isSigned = std::numeric_limits<T>::is_signed;
+		const __m128 scale = _mm_set1_ps(Normalized ? (1.0f / static_cast<f32>(std::numeric_limits<T>::max())) : 1.0f);
+		const __m128 minusOne = _mm_set1_ps(-1.0f);
+		u32 i = 0;
+		for (; i + 8 <= componentCount; i += 8)
+		{
+			// 4 components per half
+			const __m128i loValues = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+			const __m128i hiValues = sizeof(T) == 1 ? _mm_srli_si128(loValues, 4) : _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i + 4));
+			const __m128i lo = widenTo32<T>(loValues);
+			const __m128i hi = widenTo32<T>(hiValues);
+			__m128 flo = _mm_mul_ps(_mm_cvtepi32_ps(lo), scale);
+			__m128 fhi = _mm_mul_ps(_mm_cvtepi32_ps(hi), scale);
+			if (Normalized && s_isSigned)
+			{
+				flo = _mm_max_ps(flo, minusOne);
+				fhi = _mm_max_ps(fhi, minusOne);
+			}
+			_mm_storeu_ps(dst + i, flo);
+			_mm_storeu_ps(dst + i + 4, fhi);
+		}
+		for (; i < componentCount; ++i)
+		{
+			dst[i] = toFloat<T>(src[i], Normalized);
+		}
+	}
+
+	using ConvertFn = void(*)(const AccessorUtils::Stream&, u32, f32*, u32, u32, const u32*);
+	using PackedConvertFn = void(*)(const u8*, u32, f32*);
+	using StridedConvertFn = bool(*)(const u8*, u32, u32, u32, u8*, u32, const u32*);
+
+	template<typename T, bool Normalized>
+	static void convertPacked(const u8* src, u32 componentCount, f32* dst)
+	{
+		convertPackedSIMD<T, Normalized>(reinterpret_cast<const T*>(src), componentCount, dst);
+	}
+
+	// False when there is no kernel for the component count
+	template<typename T, bool Normalized>
+	static bool convertStrided(const u8* src, u32 srcStride, u32 components, u32 count, u8* dst, u32 dstStride, const u32* elementIndices)
+	{
+		switch (components)
+		{
+		case 1: convertElementsSIMD<T, Normalized, 1>(src, srcStride, count, dst, dstStride, elementIndices); return true;
+		case 2: convertElementsSIMD<T, Normalized, 2>(src, srcStride, count, dst, dstStride, elementIndices); return true;
+		case 3: convertElementsSIMD<T, Normalized, 3>(src, srcStride, count, dst, dstStride, elementIndices); return true;
+		case 4: convertElementsSIMD<T, Normalized, 4>(src, srcStride, count, dst, dstStride, elementIndices); return true;
+		default: return false;
+		}
+	}
+
+	struct ComponentInfo
+	{
+		u32 m_size;
+		ConvertFn m_convert[2]; // [normalized]
+		PackedConvertFn m_convertPacked[2]; // [normalized], nullptr when no SIMD path exists
+		StridedConvertFn m_convertStrided[2]; // [normalized], nullptr when no SIMD path exists
+	};
+
+	// Indexed by componentType - AccessorUtils::Byte
+	static const ComponentInfo s_componentInfos[] =
+	{
+		{ 1, { &convertGeneric<s8, false>, &convertGeneric<s8, true> }, { &convertPacked<s8, false>, &convertPacked<s8, true> }, { &convertStrided<s8, false>, &convertStrided<s8, true> } },
+		{ 1, { &convertGeneric<u8, false>, &convertGeneric<u8, true> }, { &convertPacked<u8, false>, &convertPacked<u8, true> }, { &convertStrided<u8, false>, &convertStrided<u8, true> } },
+		{ 2, { &convertGeneric<s16, false>, &convertGeneric<s16, true> }, { &convertPacked<s16, false>, &convertPacked<s16, true> }, { &convertStrided<s16, false>, &convertStrided<s16, true> } },
+		{ 2, { &convertGeneric<u16, false>, &convertGeneric<u16, true> }, { &convertPacked<u16, false>, &convertPacked<u16, true> }, { &convertStrided<u16, false>, &convertStrided<u16, true> } },
+		{ 0, { nullptr, nullptr }, { nullptr, nullptr }, { nullptr, nullptr } }, // Signed int, not allowed by glTF
+		{ 4, { &convertGeneric<u32, false>, &convertGeneric<u32, true> }, { nullptr, nullptr }, { nullptr, nullptr } },
+		{ 4, { &convertGeneric<f32, false>, &convertGeneric<f32, false> }, { nullptr, nullptr }, { nullptr, nullptr } },
+	};
+
+	static const ComponentInfo* getComponentInfo(u32 componentType)
+	{
+		if (componentType < AccessorUtils::Byte || componentType > AccessorUtils::Float)
+		{
+			return nullptr;
+		}
+		const ComponentInfo* info = &s_componentInfos[componentType - AccessorUtils::Byte];
+		return info->m_size ? info : nullptr;
+	}
+
+	bool AccessorUtils::isSupported(u32 componentType)
+	{
+		return getComponentInfo(componentType) != nullptr;
+	}
+
+	u32 AccessorUtils::getComponentSize(u32 componentType)
+	{
+		const ComponentInfo* info = getComponentInfo(componentType);
+		return info ? info->m_size : 0;
+	}
+
+	bool AccessorUtils::convertToFloat(const Stream& src, u32 count, f32* dst, u32 dstComponentCount, u32 dstStride, const u32* elementIndices)
+	{
+		const ComponentInfo* info = getComponentInfo(src.m_componentType);
+		if (!info)
+		{
+			printf("Accessor component type %u not supported\n", src.m_componentType);
+			return false;
+		}
+		if (count == 0)
+		{
+			return true;
+		}
+
+		const u32 components = glm::min(src.m_componentCount, dstComponentCount);
+		const bool isSequential = elementIndices == nullptr;
+		const bool isSrcPacked = src.m_stride == info->m_size * src.m_componentCount;
+		const bool isDstPacked = dstStride == components * sizeof(f32) && components == src.m_componentCount;
+		if (src.m_componentType == Float)
+		{
+			if (isSequential && isSrcPacked && isDstPacked)
+			{
+				memcpy(dst, src.m_data, count * dstStride);
+				return true;
+			}
+			u8* dstBytes = reinterpret_cast<u8*>(dst);
+			switch (components)
+			{
+			case 2: gatherFloats<2>(src.m_data, src.m_stride, count, dstBytes, dstStride, elementIndices); return true;
+			case 3: gatherFloats<3>(src.m_data, src.m_stride, count, dstBytes, dstStride, elementIndices); return true;
+			case 4: gatherFloats<4>(src.m_data, src.m_stride, count, dstBytes, dstStride, elementIndices); return true;
+			default: break;
+			}
+		}
+		else if (isSequential && isSrcPacked && isDstPacked && info->m_convertPacked[src.m_normalized])
+		{
+			info->m_convertPacked[src.m_normalized](src.m_data, count * components, dst);
+			return true;
+		}
+		else if (info->m_convertStrided[src.m_normalized] &&
+			info->m_convertStrided[src.m_normalized](src.m_data, src.m_stride, components, count, reinterpret_cast<u8*>(dst), dstStride, elementIndices))
+		{
+			// Interleaved destinations like the vertex buffers, and remapped elements
+			return true;
+		}
+
+		info->m_convert[src.m_normalized](src, count, dst, dstComponentCount, dstStride, elementIndices);
+		return true;
+	}
+
+	bool AccessorUtils::convertToUint(const Stream& src, u32 count, u32* dst)
+	{
+		const u32 componentSize = getComponentSize(src.m_componentType);
+		if (src.m_componentType != UnsignedByte && src.m_componentType != UnsignedShort && src.m_componentType != UnsignedInt)
+		{
+			printf("Accessor component type %u can't be read as unsigned integers\n", src.m_componentType);
+			return false;
+		}
+
+		const u8* element = src.m_data;
+		if (componentSize == 4)
+		{
+			if (src.m_stride == 4)
+			{
+				memcpy(dst, element, count * sizeof(u32));
+				return true;
+			}
+			for (u32 i = 0; i < count; ++i, element += src.m_stride)
+			{
+				memcpy(&dst[i], element, sizeof(u32));
+			}
+		}
+		else if (componentSize == 2)
+		{
+			for (u32 i = 0; i < count; ++i, element += src.m_stride)
+			{
+				u16 value;
+				memcpy(&value, element, sizeof(u16));
+				dst[i] = static_cast<u32>(value);
+			}
+		}
+		else
+		{
+			for (u32 i = 0; i < count; ++i, element += src.m_stride)
+			{
+				dst[i] = static_cast<u32>(element[0]);
+			}
+		}
+		return true;
+	}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// Conversion of glTF accessor data (any component type, normalized or not, any stride) to the formats used by the renderer.
+	// Kernels are picked from a table by component type and normalization. Floats and 8 or 16 bit integers have SIMD paths
+	// for any stride, so interleaved vertex buffers are written directly. Packed data goes through memcpy or wider SIMD paths.
+	class AccessorUtils
+	{
+	public:
+
+		// Values match the glTF spec
+		enum ComponentType : u32
+		{
+			Byte = 5120,
+			UnsignedByte = 5121,
+			Short = 5122,
+			UnsignedShort = 5123,
+			UnsignedInt = 5125,
+			Float = 5126,
+		};
+
+		// Strided elements of componentCount components each
+		struct Stream
+		{
+			const u8* m_data = nullptr;
+			u32 m_stride = 0; // In bytes
+			u32 m_componentType = Float;
+			u32 m_componentCount = 0;
+			bool m_normalized = false;
+		};
+
+		static bool isSupported(u32 componentType);
+
+		// Size in bytes of a component, 0 if not supported
+		static u32 getComponentSize(u32 componentType);
+
+		// Write count elements as floats to dst, dstStride bytes apart. Only the first dstComponentCount components are written,
+		// components missing in the source are left untouched. If elementIndices is given, element i is read from src[elementIndices[i]]
+		static bool convertToFloat(const Stream& src, u32 count, f32* dst, u32 dstComponentCount, u32 dstStride, const u32* elementIndices = nullptr);
+
+		// Write count scalar unsigned integers (indices) widened to u32
+		static bool convertToUint(const Stream& src, u32 count, u32* dst);
+	};
+}
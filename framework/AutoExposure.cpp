@@ -0,0 +1,141 @@
+#include "framework/Types.h"
+#include "framework/AutoExposure.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace framework
+{
+
+	static f32 wordToFloat(u32 word)
+	{
+		f32 value;
+		memcpy(&value, &word, sizeof(f32));
+		return value;
+	}
+
+	static u32 floatToWord(f32 value)
+	{
+		u32 word;
+		memcpy(&word, &value, sizeof(u32));
+		return word;
+	}
+
+	AutoExposure::Constants AutoExposure::makeConstants(const Config& config, u32 width, u32 height, f32 deltaTime, f32 exposureCompensation)
+	{
+		Constants constants;
+		constants.m_width = width;
+		constants.m_height = height;
+		constants.m_groupCount = getGroupCountX(width) * getGroupCountY(height);
+		constants.m_minLogLuminance = config.m_minLogLuminance;
+		constants.m_logLuminanceRange = glm::max(config.m_maxLogLuminance - config.m_minLogLuminance, 1e-3f);
+		constants.m_adaptationRate = 1.0f - expf(-glm::max(deltaTime, 0.0f) * config.m_adaptationSpeed);
+		constants.m_keyValue = config.m_keyValue;
+		constants.m_exposureScale = exp2f(exposureCompensation);
+		return constants;
+	}
+
+	f32 AutoExposure::getLuminance(const v3& color)
+	{
+		return glm::dot(color, v3(0.2126f, 0.7152f, 0.0722f));
+	}
+
+	u32 AutoExposure::getBin(const Constants& constants, f32 luminance)
+	{
+		// Bins 1 to s_binCount - 1 split the log2 range, brighter pixels go to the last one
+		if (!(luminance > 1e-5f))
+		{
+			return 0;
+		}
+		const f32 logLuminance = glm::clamp((log2f(luminance) - constants.m_minLogLuminance) / constants.m_logLuminanceRange, 0.0f, 1.0f);
+		return static_cast<u32>(logLuminance * static_cast<f32>(s_binCount - 2) + 1.0f);
+	}
+
+	void AutoExposure::addToHistogram(const Constants& constants, const v4* pixels, u32* bins)
+	{
+		const u32 pixelCount = constants.m_width * constants.m_height;
+		for (u32 i = 0; i < pixelCount; ++i)
+		{
+			bins[getBin(constants, getLuminance(v3(pixels[i])))]++;
+		}
+	}
+
+	f32 AutoExposure::getAverageLuminance(const Constants& constants, const u32* bins)
+	{
+		// Same integer sums as the shader, they fit in 32 bits up to 4K
+		u32 weightedSum = 0;
+		u32 pixelCount = 0;
+		for (u32 i = 0; i < s_binCount; ++i)
+		{
+			weightedSum += bins[i] * i;
+			pixelCount += bins[i];
+		}
+		const u32 countedCount = pixelCount - bins[0];
+		if (countedCount == 0)
+		{
+			return exp2f(constants.m_minLogLuminance);
+		}
+		const f32 averageBin = static_cast<f32>(weightedSum) / static_cast<f32>(countedCount);
+		const f32 logLuminance = (averageBin - 1.0f) / static_cast<f32>(s_binCount - 2) * constants.m_logLuminanceRange + constants.m_minLogLuminance;
+		return exp2f(logLuminance);
+	}
+
+	f32 AutoExposure::adapt(const Constants& constants, f32 prevAdapted, f32 average)
+	{
+		if (!(prevAdapted > 0.0f))
+		{
+			return average;
+		}
+		return prevAdapted + (average - prevAdapted) * constants.m_adaptationRate;
+	}
+
+	f32 AutoExposure::getExposure(const Constants& constants, f32 adapted)
+	{
+		return constants.m_keyValue / glm::max(adapted, 1e-5f) * constants.m_exposureScale;
+	}
+
+	void AutoExposure::update(const Constants& constants, const v4* pixels, u32* state)
+	{
+		addToHistogram(constants, pixels, state);
+		const f32 average = getAverageLuminance(constants, state);
+		const f32 adapted = adapt(constants, wordToFloat(state[s_adaptedWord]), average);
+		state[s_averageWord] = floatToWord(average);
+		state[s_adaptedWord] = floatToWord(adapted);
+		state[s_exposureWord] = floatToWord(getExposure(constants, adapted));
+		memset(state, 0, s_binCount * sizeof(u32));
+		state[s_groupCounterWord] = 0;
+	}
+
+	f32 AutoExposure::compareStates(const u32* stateA, const u32* stateB)
+	{
+		for (u32 i = 0; i <= s_groupCounterWord; ++i)
+		{
+			if (stateA[i] != 0 || stateB[i] != 0)
+			{
+				return 1.0f;
+			}
+		}
+		f32 maxError = 0.0f;
+		for (u32 word : {s_averageWord, s_adaptedWord, s_exposureWord})
+		{
+			const f32 a = wordToFloat(stateA[word]);
+			const f32 b = wordToFloat(stateB[word]);
+			maxError = glm::max(maxError, fabsf(a - b) / glm::max(glm::max(fabsf(a), fabsf(b)), 1e-6f));
+		}
+		return maxError;
+	}
+
+	v3 AutoExposure::tonemap(const v3& color, f32 exposure)
+	{
+		const v3 x = glm::max(color * exposure, v3(0.0f));
+		const v3 mapped = glm::clamp((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f), v3(0.0f), v3(1.0f));
+		// sRGB encoding
+		v3 encoded;
+		for (u32 i = 0; i < 3; ++i)
+		{
+			encoded[i] = mapped[i] <= 0.0031308f ? mapped[i] * 12.92f : 1.055f * powf(mapped[i], 1.0f / 2.4f) - 0.055f;
+		}
+		return encoded;
+	}
+
+}
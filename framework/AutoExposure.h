@@ -0,0 +1,79 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// Automatic exposure and tonemapping of an HDR image. Layouts shared with assets/shaders/Exposure.hlsl and Tonemap.hlsl,
+	// and a CPU reference of what they do, to validate the GPU results and to test the exposure math without a GPU.
+	// The exposure is a single compute dispatch instead of a chain of downsample passes: every group bins the log2 luminance
+	// of a tile in shared memory and adds it to the histogram of the state buffer. The last group to finish averages the
+	// histogram, adapts the luminance towards the average over time and clears the histogram for the next frame.
+	class AutoExposure
+	{
+	public:
+
+		static constexpr u32 s_tileSize = 16; // Pixels per side of a group
+		static constexpr u32 s_binCount = s_tileSize * s_tileSize; // One bin per thread of a group. Bin 0 has the pixels too dark to count
+
+		// Layout of the state buffer, in 4 byte words. It is kept between frames
+		static constexpr u32 s_groupCounterWord = s_binCount; // Groups done this frame
+		static constexpr u32 s_averageWord = s_binCount + 1; // Average luminance of the last frame
+		static constexpr u32 s_adaptedWord = s_binCount + 2; // Adapted luminance, 0 before the first frame
+		static constexpr u32 s_exposureWord = s_binCount + 3; // Read by the tonemap
+		static constexpr u32 s_stateWordCount = s_binCount + 4;
+
+		struct Config
+		{
+			f32 m_minLogLuminance = -10.0f; // log2, the histogram range
+			f32 m_maxLogLuminance = 4.0f;
+			f32 m_adaptationSpeed = 1.5f; // Per second, higher adapts faster
+			f32 m_keyValue = 0.18f; // Middle grey, the adapted luminance is exposed to it
+		};
+
+		// Layout of ExposureCB
+		struct Constants
+		{
+			u32 m_width = 0;
+			u32 m_height = 0;
+			u32 m_groupCount = 0;
+			f32 m_minLogLuminance = 0.0f;
+			f32 m_logLuminanceRange = 1.0f;
+			f32 m_adaptationRate = 1.0f; // Fraction of the way to the average this frame
+			f32 m_keyValue = 0.18f;
+			f32 m_exposureScale = 1.0f; // Compensation on top of the automatic exposure
+		};
+
+		// exposureCompensation in EV (stops)
+		static Constants makeConstants(const Config& config, u32 width, u32 height, f32 deltaTime, f32 exposureCompensation);
+
+		static u32 getGroupCountX(u32 width) { return (width + s_tileSize - 1) / s_tileSize; }
+		static u32 getGroupCountY(u32 height) { return (height + s_tileSize - 1) / s_tileSize; }
+
+		static f32 getLuminance(const v3& color);
+
+		static u32 getBin(const Constants& constants, f32 luminance);
+
+		// Adds the pixels (width * height of the constants, RGB) to bins
+		static void addToHistogram(const Constants& constants, const v4* pixels, u32* bins);
+
+		// Luminance of the average bin, bin 0 excluded. Images without a bright enough pixel get the darkest luminance
+		static f32 getAverageLuminance(const Constants& constants, const u32* bins);
+
+		// prevAdapted 0 (first frame) takes the average as is
+		static f32 adapt(const Constants& constants, f32 prevAdapted, f32 average);
+
+		static f32 getExposure(const Constants& constants, f32 adapted);
+
+		// What the exposure dispatch does to the state (s_stateWordCount words)
+		static void update(const Constants& constants, const v4* pixels, u32* state);
+
+		// Largest relative difference of the average, adapted luminance and exposure of two states. 1 when a histogram or
+		// its counter wasn't cleared
+		static f32 compareStates(const u32* stateA, const u32* stateB);
+
+		// ACES filmic curve (Narkowicz fit) of the exposed color, encoded for an sRGB display
+		static v3 tonemap(const v3& color, f32 exposure);
+	};
+}
@@ -8,6 +8,9 @@ namespace framework
 		, m_projection(1.0f)
 		, m_viewProjection(1.0f)
 		, m_invViewProjection(1.0f)
+		, m_prevView(1.0f)
+		, m_prevViewProjection(1.0f)
+		, m_prevInvViewProjection(1.0f)
 	{
 	}
 
@@ -20,6 +23,8 @@ namespace framework
 	void Camera::setPerspective(f32 fovDeg, f32 aspect, f32 nearPlane, f32 farPlane)
 	{
 		m_projection = glm::perspective(glm::radians(fovDeg), aspect, nearPlane, farPlane);
+		m_nearPlane = nearPlane;
+		m_farPlane = farPlane;
 		updateMatrices();
 	}
 
@@ -29,6 +34,13 @@ namespace framework
 		m_invViewProjection = glm::inverse(m_viewProjection);
 	}
 
+	void Camera::storePrevMatrices()
+	{
+		m_prevView = m_view;
+		m_prevViewProjection = m_viewProjection;
+		m_prevInvViewProjection = m_invViewProjection;
+	}
+
 	FirstPersonCamera::FirstPersonCamera() {}
 
 	void FirstPersonCamera::init(const v3& defaultPos, const v3& initialTarget, f32 moveSpeed, f32 rotSpeed)
@@ -47,6 +59,7 @@ namespace framework
 
 	void FirstPersonCamera::update(f32 elapsedTime)
 	{
+		storePrevMatrices();
 		v2 mouseDelta = Window::getMouseDelta();
 		f32 mouseWheel = Window::getMouseWheel();
 		bool isRightMouseDown = Window::isMouseDown(MouseButton::Right);
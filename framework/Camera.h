@@ -17,6 +17,9 @@ namespace framework
 
 		void updateMatrices();
 
+		// Keeps the current matrices as the previous frame ones, call it once per frame before they change
+		void storePrevMatrices();
+
 		m4 getView() const { return m_view; }
 
 		m4 getProjection() const { return m_projection; }
@@ -25,12 +28,28 @@ namespace framework
 
 		m4 getInvViewProj() const { return m_invViewProjection; }
 
+		// Of the last frame, to reproject its data (e.g. its depth) into the current one
+		m4 getPrevView() const { return m_prevView; }
+
+		m4 getPrevViewProj() const { return m_prevViewProjection; }
+
+		m4 getPrevInvViewProj() const { return m_prevInvViewProjection; }
+
+		f32 getNearPlane() const { return m_nearPlane; }
+
+		f32 getFarPlane() const { return m_farPlane; }
+
 	protected:
 
 		m4 m_view;
 		m4 m_projection;
 		m4 m_viewProjection;
 		m4 m_invViewProjection;
+		m4 m_prevView;
+		m4 m_prevViewProjection;
+		m4 m_prevInvViewProjection;
+		f32 m_nearPlane = 0.1f;
+		f32 m_farPlane = 1000.0f;
 	};
 
 	class FirstPersonCamera : public Camera
@@ -0,0 +1,241 @@
+#include "framework/Types.h"
+#include "framework/DrawCulling.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace framework
+{
+
+	DrawCulling::Constants DrawCulling::makeConstants(const m4& viewProj, const m4& hizViewProj, u32 hizWidth, u32 hizHeight, u32 drawCount, const Batch* batches, u32 batchCount, 
+		Phase phase)
+	{
+		// Same planes as Frustum: left, right, bottom, top and far. Kept here so the reference has no other dependencies
+		Constants constants;
+		const m4 rows = glm::transpose(viewProj);
+		constants.m_frustumPlanes[0] = rows[3] + rows[0];
+		constants.m_frustumPlanes[1] = rows[3] - rows[0];
+		constants.m_frustumPlanes[2] = rows[3] + rows[1];
+		constants.m_frustumPlanes[3] = rows[3] - rows[1];
+		constants.m_frustumPlanes[4] = rows[3] - rows[2];
+		for (v4& plane : constants.m_frustumPlanes)
+		{
+			plane /= glm::length(v3(plane));
+		}
+		constants.m_hizViewProj = hizViewProj;
+		constants.m_hizWidth = hizWidth;
+		constants.m_hizHeight = hizHeight;
+		constants.m_hizLevelCount = (hizWidth > 0 && hizHeight > 0) ? getLevelCount(hizWidth, hizHeight) : 0;
+		constants.m_drawCount = drawCount;
+		constants.m_batchCount = batchCount;
+		constants.m_argsCount = 0;
+		for (u32 i = 0; i < batchCount; ++i)
+		{
+			constants.m_argsCount = glm::max(constants.m_argsCount, batches[i].m_firstArgs + batches[i].m_drawCount);
+		}
+		constants.m_phase = phase;
+		constants.pad = 0;
+		return constants;
+	}
+
+	u32 DrawCulling::getLevelCount(u32 width, u32 height)
+	{
+		const u32 size = glm::max(width, height);
+		u32 count = 1;
+		while ((size >> count) > 0)
+		{
+			count++;
+		}
+		return count;
+	}
+
+	void DrawCulling::buildHiZ(const f32* depth, u32 width, u32 height, HiZ& outHiZ)
+	{
+		const u32 levelCount = getLevelCount(width, height);
+		outHiZ.m_levels.resize(levelCount);
+		outHiZ.m_widths.resize(levelCount);
+		outHiZ.m_heights.resize(levelCount);
+		outHiZ.m_levels[0].assign(depth, depth + width * height);
+		outHiZ.m_widths[0] = width;
+		outHiZ.m_heights[0] = height;
+		for (u32 level = 1; level < levelCount; ++level)
+		{
+			const Vector<f32>& src = outHiZ.m_levels[level - 1];
+			const u32 srcWidth = outHiZ.m_widths[level - 1];
+			const u32 srcHeight = outHiZ.m_heights[level - 1];
+			const u32 dstWidth = glm::max(width >> level, 1u);
+			const u32 dstHeight = glm::max(height >> level, 1u);
+			Vector<f32>& dst = outHiZ.m_levels[level];
+			dst.resize(dstWidth * dstHeight);
+			outHiZ.m_widths[level] = dstWidth;
+			outHiZ.m_heights[level] = dstHeight;
+			// Same as downsampleCS
+			for (u32 y = 0; y < dstHeight; ++y)
+			{
+				const u32 lastY = glm::min((y == dstHeight - 1 && (srcHeight & 1)) ? y * 2 + 2 : y * 2 + 1, srcHeight - 1);
+				for (u32 x = 0; x < dstWidth; ++x)
+				{
+					const u32 lastX = glm::min((x == dstWidth - 1 && (srcWidth & 1)) ? x * 2 + 2 : x * 2 + 1, srcWidth - 1);
+					f32 maxDepth = 0.0f;
+					for (u32 srcY = y * 2; srcY <= lastY; ++srcY)
+					{
+						for (u32 srcX = x * 2; srcX <= lastX; ++srcX)
+						{
+							maxDepth = glm::max(maxDepth, src[srcY * srcWidth + srcX]);
+						}
+					}
+					dst[y * dstWidth + x] = maxDepth;
+				}
+			}
+		}
+	}
+
+	bool DrawCulling::isVisible(const Constants& constants, const Draw& draw, const HiZ* hiz)
+	{
+		// Same as isDrawVisible in DrawCulling.hlsl
+		for (u32 i = 0; i < s_planeCount; ++i)
+		{
+			const v4& plane = constants.m_frustumPlanes[i];
+			if (glm::dot(v3(plane), draw.m_boundsCenter) + plane.w < -draw.m_boundsRadius)
+			{
+				return false;
+			}
+		}
+		if (constants.m_hizLevelCount == 0 || !hiz)
+		{
+			return true;
+		}
+
+		v2 minUV(FLT_MAX);
+		v2 maxUV(-FLT_MAX);
+		f32 minDepth = FLT_MAX;
+		for (u32 i = 0; i < 8; ++i)
+		{
+			const v3 corner = draw.m_boundsCenter + draw.m_boundsExtents * v3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+			const v4 clipPos = constants.m_hizViewProj * v4(corner, 1.0f);
+			if (clipPos.w < s_nearW)
+			{
+				return true;
+			}
+			const v3 ndc = v3(clipPos) / clipPos.w;
+			const v2 uv(ndc.x * 0.5f + 0.5f, 0.5f - ndc.y * 0.5f);
+			minUV = glm::min(minUV, uv);
+			maxUV = glm::max(maxUV, uv);
+			minDepth = glm::min(minDepth, ndc.z);
+		}
+		if (maxUV.x < 0.0f || maxUV.y < 0.0f || minUV.x > 1.0f || minUV.y > 1.0f)
+		{
+			return true; // Wasn't on screen, there is no depth to test against
+		}
+
+		// Level where the box covers at most 2x2 texels
+		const v2 size(static_cast<f32>(constants.m_hizWidth), static_cast<f32>(constants.m_hizHeight));
+		const glm::uvec2 minTexel = glm::uvec2(glm::clamp(minUV * size, v2(0.0f), size - 1.0f));
+		const glm::uvec2 maxTexel = glm::uvec2(glm::clamp(maxUV * size, v2(0.0f), size - 1.0f));
+		u32 level = 0;
+		while (level + 1 < constants.m_hizLevelCount && ((maxTexel.x >> level) - (minTexel.x >> level) > 1 || (maxTexel.y >> level) - (minTexel.y >> level) > 1))
+		{
+			level++;
+		}
+		const u32 levelWidth = hiz->m_widths[level];
+		const u32 levelHeight = hiz->m_heights[level];
+		const Vector<f32>& depth = hiz->m_levels[level];
+		f32 maxDepth = 0.0f;
+		for (u32 y = glm::min(minTexel.y >> level, levelHeight - 1); y <= glm::min(maxTexel.y >> level, levelHeight - 1); ++y)
+		{
+			for (u32 x = glm::min(minTexel.x >> level, levelWidth - 1); x <= glm::min(maxTexel.x >> level, levelWidth - 1); ++x)
+			{
+				maxDepth = glm::max(maxDepth, depth[y * levelWidth + x]);
+			}
+		}
+		return minDepth <= maxDepth;
+	}
+
+	void DrawCulling::cull(const Constants& constants, const Draw* draws, const Batch* batches, const HiZ* hiz, u32* visibility, 
+		Vector<IndirectArgs>& outArgs, Vector<u32>& outBatchCounts)
+	{
+		outArgs.assign(constants.m_argsCount, IndirectArgs());
+		outBatchCounts.assign(constants.m_batchCount, 0);
+		for (u32 i = 0; i < constants.m_drawCount; ++i)
+		{
+			// Same as cullCS
+			const Draw& draw = draws[i];
+			const u32 flags = (constants.m_phase != SinglePhase && visibility) ? visibility[draw.m_drawId] : 0;
+			if (constants.m_phase == EarlyPhase && (flags & s_visibleFlag) == 0)
+			{
+				continue;
+			}
+			const bool isDrawVisible = isVisible(constants, draw, hiz);
+			if (constants.m_phase == EarlyPhase && visibility)
+			{
+				visibility[draw.m_drawId] = isDrawVisible ? (flags | s_drawnEarlyFlag) : (flags & ~s_drawnEarlyFlag);
+			}
+			else if (constants.m_phase == LatePhase && visibility)
+			{
+				visibility[draw.m_drawId] = isDrawVisible ? s_visibleFlag : 0;
+			}
+			if (!isDrawVisible || (constants.m_phase == LatePhase && (flags & s_drawnEarlyFlag) != 0))
+			{
+				continue;
+			}
+			IndirectArgs& args = outArgs[batches[draw.m_batch].m_firstArgs + outBatchCounts[draw.m_batch]++];
+			args.m_indexCountPerInstance = draw.m_indexCount;
+			args.m_instanceCount = 1;
+			args.m_startIndexLocation = draw.m_firstIndex;
+			args.m_baseVertexLocation = draw.m_baseVertex;
+			args.m_startInstanceLocation = draw.m_drawId;
+		}
+	}
+
+	u32 DrawCulling::compareResults(const Batch* batches, u32 batchCount, const IndirectArgs* argsA, const u32* countsA, const IndirectArgs* argsB, const u32* countsB)
+	{
+		u32 mismatchCount = 0;
+		Vector<u32> idsA;
+		Vector<u32> idsB;
+		auto gatherIds = [&mismatchCount](const Batch& batch, const IndirectArgs* args, u32 count, Vector<u32>& outIds)
+		{
+			outIds.clear();
+			for (u32 i = 0; i < batch.m_drawCount; ++i)
+			{
+				const IndirectArgs& slot = args[batch.m_firstArgs + i];
+				if (i < count)
+				{
+					outIds.push_back(slot.m_startInstanceLocation);
+				}
+				else if (slot.m_instanceCount != 0)
+				{
+					mismatchCount++;
+				}
+			}
+			std::sort(outIds.begin(), outIds.end());
+		};
+		for (u32 b = 0; b < batchCount; ++b)
+		{
+			gatherIds(batches[b], argsA, glm::min(countsA[b], batches[b].m_drawCount), idsA);
+			gatherIds(batches[b], argsB, glm::min(countsB[b], batches[b].m_drawCount), idsB);
+			// Size of the symmetric difference of the sorted lists
+			size_t idxA = 0;
+			size_t idxB = 0;
+			while (idxA < idsA.size() || idxB < idsB.size())
+			{
+				if (idxB == idsB.size() || (idxA < idsA.size() && idsA[idxA] < idsB[idxB]))
+				{
+					mismatchCount++;
+					idxA++;
+				}
+				else if (idxA == idsA.size() || idsB[idxB] < idsA[idxA])
+				{
+					mismatchCount++;
+					idxB++;
+				}
+				else
+				{
+					idxA++;
+					idxB++;
+				}
+			}
+		}
+		return mismatchCount;
+	}
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// GPU-driven draw culling. Layouts shared with assets/shaders/DrawCulling.hlsl and HiZ.hlsl, and a CPU reference of what
+	// their compute shaders do, to validate the GPU results and to test the culling without a GPU.
+	// Draws are grouped in batches that share their render state. A draw is kept when its bounds are in the frustum and not
+	// behind the depth hierarchy, and is compacted to the front of the indirect arguments of its batch. The rest of the
+	// arguments of the batch draw no instances. The GPU doesn't keep the order of the draws inside a batch, compareResults
+	// ignores it.
+	// With two phase culling the depth hierarchy of the last frame is reprojected: the early phase draws what was visible
+	// last frame and isn't behind that depth, the late phase tests every draw against the depth of the early phase, draws
+	// what the early one missed and flags what is visible for the next frame. No occluders are rasterized for it.
+	class DrawCulling
+	{
+	public:
+
+		static constexpr u32 s_threadGroupSize = 64;
+		static constexpr u32 s_planeCount = 5;
+		static constexpr f32 s_nearW = 0.01f; // Boxes with a corner closer than this in clip space w aren't occlusion tested
+
+		enum Phase : u32
+		{
+			SinglePhase = 0, // Every draw is tested, there are no visibility flags
+			EarlyPhase,
+			LatePhase
+		};
+
+		// Per draw visibility flags, kept between frames
+		static constexpr u32 s_visibleFlag = 1 << 0; // Visible at the end of the last frame
+		static constexpr u32 s_drawnEarlyFlag = 1 << 1; // Drawn by the early phase of this frame
+
+		// Layout of CullDraw
+		struct Draw
+		{
+			v3 m_boundsCenter = v3(0.0f); // World space box
+			u32 m_batch = 0;
+			v3 m_boundsExtents = v3(0.0f);
+			f32 m_boundsRadius = 0.0f; // World space sphere around the box center
+			u32 m_indexCount = 0;
+			u32 m_firstIndex = 0;
+			s32 m_baseVertex = 0;
+			u32 m_drawId = 0; // Written to StartInstanceLocation, selects the data of the draw
+		};
+
+		struct Batch
+		{
+			u32 m_firstArgs = 0; // Its draws are compacted in [m_firstArgs, m_firstArgs + m_drawCount)
+			u32 m_drawCount = 0;
+		};
+
+		// Layout of D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS
+		struct IndirectArgs
+		{
+			u32 m_indexCountPerInstance = 0;
+			u32 m_instanceCount = 0;
+			u32 m_startIndexLocation = 0;
+			s32 m_baseVertexLocation = 0;
+			u32 m_startInstanceLocation = 0;
+		};
+
+		// Layout of CullCB
+		struct Constants
+		{
+			v4 m_frustumPlanes[s_planeCount]; // See Frustum
+			m4 m_hizViewProj = m4(1.0f); // View projection the depth in the hierarchy was rendered with, usually last frame's
+			u32 m_hizWidth = 0;
+			u32 m_hizHeight = 0;
+			u32 m_hizLevelCount = 0; // 0 disables the occlusion test
+			u32 m_drawCount = 0;
+			u32 m_batchCount = 0;
+			u32 m_argsCount = 0;
+			u32 m_phase = SinglePhase;
+			u32 pad = 0;
+		};
+
+		// Farthest depth (largest, depth buffer convention) per texel. Levels halve the size rounding down, like texture mips,
+		// and the last texel of a row or column also covers the odd texel left over from the level above
+		struct HiZ
+		{
+			Vector<Vector<f32>> m_levels;
+			Vector<u32> m_widths;
+			Vector<u32> m_heights;
+		};
+
+		// hizWidth 0 disables the occlusion test. The early phase tests against last frame's depth, with last frame's viewProj
+		static Constants makeConstants(const m4& viewProj, const m4& hizViewProj, u32 hizWidth, u32 hizHeight, u32 drawCount, const Batch* batches, u32 batchCount, 
+			Phase phase = SinglePhase);
+
+		// Full mip chain, down to 1x1
+		static u32 getLevelCount(u32 width, u32 height);
+
+		static void buildHiZ(const f32* depth, u32 width, u32 height, HiZ& outHiZ);
+
+		static bool isVisible(const Constants& constants, const Draw& draw, const HiZ* hiz);
+
+		// outArgs gets constants.m_argsCount entries and outBatchCounts the visible draws per batch. visibility has the flags
+		// of every draw, read and updated by the early and late phases
+		static void cull(const Constants& constants, const Draw* draws, const Batch* batches, const HiZ* hiz, u32* visibility, 
+			Vector<IndirectArgs>& outArgs, Vector<u32>& outBatchCounts);
+
+		// Draws visible in one result and not in the other, plus arguments past the visible ones that draw something
+		static u32 compareResults(const Batch* batches, u32 batchCount, const IndirectArgs* argsA, const u32* countsA, const IndirectArgs* argsB, const u32* countsB);
+	};
+}
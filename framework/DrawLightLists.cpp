@@ -0,0 +1,172 @@
+#include "framework/Types.h"
+#include "framework/DrawLightLists.h"
+
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <emmintrin.h>
+
+namespace framework
+{
+
+	void DrawLightLists::init(const Config& config)
+	{
+		m_config = config;
+		m_config.m_maxLightsPerDraw = glm::max(m_config.m_maxLightsPerDraw, 1u);
+		m_ranges.clear();
+		m_lightIndices.clear();
+		m_droppedCount = 0;
+	}
+
+	u32 DrawLightLists::assignDraws(const DrawBounds* draws, const u8* isDrawVisible, u32 firstDraw, u32 lastDraw)
+	{
+		u32 droppedCount = 0;
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		for (u32 drawIdx = firstDraw; drawIdx < lastDraw; ++drawIdx)
+		{
+			m_drawCounts[drawIdx] = 0;
+			if (isDrawVisible && !isDrawVisible[drawIdx])
+			{
+				continue;
+			}
+			const DrawBounds& bounds = draws[drawIdx];
+			const __m128 centerX = _mm_set1_ps(bounds.m_center.x);
+			const __m128 centerY = _mm_set1_ps(bounds.m_center.y);
+			const __m128 centerZ = _mm_set1_ps(bounds.m_center.z);
+			const __m128 extentX = _mm_set1_ps(bounds.m_extents.x);
+			const __m128 extentY = _mm_set1_ps(bounds.m_extents.y);
+			const __m128 extentZ = _mm_set1_ps(bounds.m_extents.z);
+			const __m128 boxRadius = _mm_set1_ps(glm::length(bounds.m_extents));
+			const __m128 negBoxRadius = _mm_set1_ps(-glm::length(bounds.m_extents));
+			u32* drawLights = &m_drawLights[drawIdx * m_config.m_maxLightsPerDraw];
+			u32& count = m_drawCounts[drawIdx];
+			for (u32 i = 0; i < m_paddedLightCount; i += 4)
+			{
+				// Sphere vs AABB: squared distance from the sphere center to the box
+				const __m128 dx = _mm_max_ps(_mm_sub_ps(_mm_and_ps(_mm_sub_ps(_mm_loadu_ps(&m_sphereX[i]), centerX), absMask), extentX), zero);
+				const __m128 dy = _mm_max_ps(_mm_sub_ps(_mm_and_ps(_mm_sub_ps(_mm_loadu_ps(&m_sphereY[i]), centerY), absMask), extentY), zero);
+				const __m128 dz = _mm_max_ps(_mm_sub_ps(_mm_and_ps(_mm_sub_ps(_mm_loadu_ps(&m_sphereZ[i]), centerZ), absMask), extentZ), zero);
+				const __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				__m128 isTouching = _mm_cmple_ps(distSq, _mm_loadu_ps(&m_sphereRadiusSq[i]));
+				if (_mm_movemask_ps(isTouching) == 0)
+				{
+					continue;
+				}
+
+				// Cone vs sphere around the box: distance to the cone side, then in front of its range or behind its apex
+				const __m128 vx = _mm_sub_ps(centerX, _mm_loadu_ps(&m_apexX[i]));
+				const __m128 vy = _mm_sub_ps(centerY, _mm_loadu_ps(&m_apexY[i]));
+				const __m128 vz = _mm_sub_ps(centerZ, _mm_loadu_ps(&m_apexZ[i]));
+				const __m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+				const __m128 axisDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(&m_axisX[i])), _mm_mul_ps(vy, _mm_loadu_ps(&m_axisY[i]))),
+					_mm_mul_ps(vz, _mm_loadu_ps(&m_axisZ[i])));
+				const __m128 sideDist = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&m_cosAngle[i]), _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(lenSq, _mm_mul_ps(axisDist, axisDist)), zero))),
+					_mm_mul_ps(axisDist, _mm_loadu_ps(&m_sinAngle[i])));
+				isTouching = _mm_and_ps(isTouching, _mm_cmple_ps(sideDist, boxRadius));
+				isTouching = _mm_and_ps(isTouching, _mm_cmple_ps(axisDist, _mm_add_ps(boxRadius, _mm_loadu_ps(&m_coneRange[i]))));
+				isTouching = _mm_and_ps(isTouching, _mm_cmpge_ps(axisDist, negBoxRadius));
+
+				u32 mask = static_cast<u32>(_mm_movemask_ps(isTouching));
+				while (mask)
+				{
+					const u32 lane = static_cast<u32>(glm::findLSB(mask));
+					mask &= mask - 1;
+					if (count < m_config.m_maxLightsPerDraw)
+					{
+						drawLights[count++] = i + lane;
+					}
+					else
+					{
+						droppedCount++;
+					}
+				}
+			}
+		}
+		return droppedCount;
+	}
+
+	void DrawLightLists::build(const DrawBounds* draws, const u8* isDrawVisible, u32 drawCount, const ClusterLight* lights, u32 lightCount)
+	{
+		m_paddedLightCount = (lightCount + 3) & ~3u;
+		for (Vector<f32>* values : {&m_sphereX, &m_sphereY, &m_sphereZ, &m_apexX, &m_apexY, &m_apexZ, &m_axisX, &m_axisY, &m_axisZ, &m_coneRange, &m_sinAngle})
+		{
+			values->assign(m_paddedLightCount, 0.0f);
+		}
+		m_sphereRadiusSq.assign(m_paddedLightCount, -1.0f); // Padding touches nothing
+		m_cosAngle.assign(m_paddedLightCount, -1.0f);
+		for (u32 i = 0; i < lightCount; ++i)
+		{
+			const ClusterLight& light = lights[i];
+			v3 center;
+			f32 radius;
+			LightClusters::getLightSphere(light, center, radius);
+			m_sphereX[i] = center.x;
+			m_sphereY[i] = center.y;
+			m_sphereZ[i] = center.z;
+			m_sphereRadiusSq[i] = radius > 0.0f ? radius * radius : -1.0f;
+			m_apexX[i] = light.m_pos.x;
+			m_apexY[i] = light.m_pos.y;
+			m_apexZ[i] = light.m_pos.z;
+			m_coneRange[i] = light.m_radius;
+			// Cones wider than a half space are tested as spheres, like points (zero axis and a 180 degrees angle)
+			if (light.m_type == ClusterLight::Spot && light.m_cosOuterCone > 0.0f)
+			{
+				const v3 axis = glm::normalize(light.m_dir);
+				const f32 cosAngle = glm::min(light.m_cosOuterCone, 1.0f);
+				m_axisX[i] = axis.x;
+				m_axisY[i] = axis.y;
+				m_axisZ[i] = axis.z;
+				m_cosAngle[i] = cosAngle;
+				m_sinAngle[i] = sqrtf(1.0f - cosAngle * cosAngle);
+			}
+		}
+
+		// Threads own whole ranges of draws, so they never write the same list
+		m_drawLights.resize(static_cast<size_t>(drawCount) * m_config.m_maxLightsPerDraw);
+		m_drawCounts.resize(drawCount);
+		const u32 threadCount = glm::min(glm::max(std::thread::hardware_concurrency(), 1u), glm::max(drawCount / s_minDrawsPerThread, 1u));
+		if (threadCount <= 1)
+		{
+			m_droppedCount = assignDraws(draws, isDrawVisible, 0, drawCount);
+		}
+		else
+		{
+			Vector<std::thread> threads;
+			Vector<u32> droppedCounts(threadCount, 0);
+			threads.reserve(threadCount);
+			const u32 drawsPerThread = (drawCount + threadCount - 1) / threadCount;
+			for (u32 t = 0; t < threadCount; ++t)
+			{
+				const u32 firstDraw = glm::min(t * drawsPerThread, drawCount);
+				const u32 lastDraw = glm::min(firstDraw + drawsPerThread, drawCount);
+				threads.emplace_back([this, t, draws, isDrawVisible, firstDraw, lastDraw, &droppedCounts]()
+				{
+					droppedCounts[t] = assignDraws(draws, isDrawVisible, firstDraw, lastDraw);
+				});
+			}
+			m_droppedCount = 0;
+			for (u32 t = 0; t < threadCount; ++t)
+			{
+				threads[t].join();
+				m_droppedCount += droppedCounts[t];
+			}
+		}
+
+		// Compact the per draw lists
+		m_ranges.resize(drawCount);
+		u32 offset = 0;
+		for (u32 i = 0; i < drawCount; ++i)
+		{
+			m_ranges[i].m_offset = offset;
+			m_ranges[i].m_count = m_drawCounts[i];
+			offset += m_drawCounts[i];
+		}
+		m_lightIndices.resize(offset);
+		for (u32 i = 0; i < drawCount; ++i)
+		{
+			memcpy(m_lightIndices.data() + m_ranges[i].m_offset, &m_drawLights[static_cast<size_t>(i) * m_config.m_maxLightsPerDraw], m_ranges[i].m_count * sizeof(u32));
+		}
+	}
+
+}
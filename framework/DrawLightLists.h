@@ -0,0 +1,71 @@
+#pragma once
+
+#include "framework/Types.h"
+#include "framework/LightClusters.h"
+
+namespace framework
+{
+
+	// Assigns the point and spot lights to draws: a draw gets the lights whose volume touches its world space AABB, as a
+	// range of a compact light index list. An alternative to LightClusters for forward shading, the lights of a pixel come
+	// from its draw instead of its cluster.
+	// Every draw is tested against 4 lights at a time with SSE: the bounding sphere of the light against the box, then the
+	// cone of spots against the sphere around the box. Draws are split across threads. Doesn't touch the GPU.
+	class DrawLightLists
+	{
+	public:
+
+		struct Config
+		{
+			u32 m_maxLightsPerDraw = 64; // Extra lights are dropped
+		};
+
+		// Same layout as LightClusters::Range
+		struct Range
+		{
+			u32 m_offset;
+			u32 m_count;
+		};
+
+		// World space AABB
+		struct DrawBounds
+		{
+			v3 m_center;
+			v3 m_extents;
+		};
+
+		void init(const Config& config);
+
+		// Draws with isDrawVisible 0 get no lights, isDrawVisible can be null
+		void build(const DrawBounds* draws, const u8* isDrawVisible, u32 drawCount, const ClusterLight* lights, u32 lightCount);
+
+		const Vector<Range>& getRanges() const { return m_ranges; }
+		const Vector<u32>& getLightIndices() const { return m_lightIndices; }
+
+		// Lights that didn't fit in m_maxLightsPerDraw in the last build
+		u32 getDroppedCount() const { return m_droppedCount; }
+
+	private:
+
+		static constexpr u32 s_minDrawsPerThread = 256;
+
+		// Returns the lights dropped from full draws
+		u32 assignDraws(const DrawBounds* draws, const u8* isDrawVisible, u32 firstDraw, u32 lastDraw);
+
+		Config m_config;
+
+		// Lights SoA, padded to a multiple of 4 with lights that touch nothing. Points get a cone that culls nothing
+		u32 m_paddedLightCount = 0;
+		Vector<f32> m_sphereX, m_sphereY, m_sphereZ, m_sphereRadiusSq;
+		Vector<f32> m_apexX, m_apexY, m_apexZ;
+		Vector<f32> m_axisX, m_axisY, m_axisZ;
+		Vector<f32> m_coneRange, m_cosAngle, m_sinAngle;
+
+		Vector<u32> m_drawLights; // m_maxLightsPerDraw entries per draw
+		Vector<u32> m_drawCounts;
+		u32 m_droppedCount = 0;
+
+		Vector<Range> m_ranges;
+		Vector<u32> m_lightIndices;
+	};
+}
@@ -56,6 +56,61 @@ namespace framework
 		}
 	}
 
+	HANDLE FileUtils::openFileForWrite(const char* fileAbsPath)
+	{
+		HANDLE file = CreateFileA(
+			fileAbsPath,
+			GENERIC_WRITE,
+			0, NULL,
+			CREATE_ALWAYS,
+			FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			printf("Attempt to create file '%s' failed with error: %d", fileAbsPath, GetLastError());
+		}
+		return file;
+	}
+
+	u32 FileUtils::writeBytes(const HANDLE file, u32 toWrite, const void* buffer)
+	{
+		DWORD outWritten(0);
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			if (!WriteFile(file,
+				buffer,
+				toWrite,
+				&outWritten,
+				NULL))
+			{
+				printf("Attempt to write file data failed with error: %d", GetLastError());
+			}
+		}
+		return outWritten;
+	}
+
+	bool FileUtils::getFileInfo(const char* fileAbsPath, u64& outSize, u64& outWriteTime)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!GetFileAttributesExA(fileAbsPath, GetFileExInfoStandard, &data))
+		{
+			return false;
+		}
+		outSize = (static_cast<u64>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+		outWriteTime = (static_cast<u64>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+		return true;
+	}
+
+	bool FileUtils::createDirectory(const char* dirAbsPath)
+	{
+		if (CreateDirectoryA(dirAbsPath, NULL) || GetLastError() == ERROR_ALREADY_EXISTS)
+		{
+			return true;
+		}
+		printf("Attempt to create directory '%s' failed with error: %d", dirAbsPath, GetLastError());
+		return false;
+	}
+
 	// ----------------------------------------------------------------------
 
 	UniquePtr<char[]> FileUtils::loadFileContent(const char* fileRelPath, u32& outFileSize)
@@ -91,4 +146,62 @@ namespace framework
 		return result;
 	}
 
+	// ----------------------------------------------------------------------
+
+	bool MappedFile::open(const char* fileAbsPath)
+	{
+		close();
+		m_file = CreateFileA(
+			fileAbsPath,
+			GENERIC_READ,
+			FILE_SHARE_READ, NULL,
+			OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, NULL);
+		if (m_file == INVALID_HANDLE_VALUE)
+		{
+			printf("Attempt to open file '%s' failed with error: %d", fileAbsPath, GetLastError());
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		GetFileSizeEx(m_file, &size);
+		m_size = static_cast<u64>(size.QuadPart);
+		if (m_size == 0)
+		{
+			printf("Can't map empty file '%s'", fileAbsPath);
+			close();
+			return false;
+		}
+
+		m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_mapping)
+		{
+			m_data = static_cast<const u8*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+		}
+		if (!m_data)
+		{
+			printf("Attempt to map file '%s' failed with error: %d", fileAbsPath, GetLastError());
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+		{
+			UnmapViewOfFile(m_data);
+			m_data = nullptr;
+		}
+		if (m_mapping)
+		{
+			CloseHandle(m_mapping);
+			m_mapping = nullptr;
+		}
+		FileUtils::closeFile(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+		m_size = 0;
+	}
+
 }
\ No newline at end of file
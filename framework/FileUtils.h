@@ -16,5 +16,39 @@ namespace framework
 		static u32 getFileSize(const HANDLE file);
 		static u32 readBytes(const HANDLE file, u32 toRead, void* outBuffer);
 		static void closeFile(const HANDLE file);
+
+		static HANDLE openFileForWrite(const char* fileAbsPath);
+		static u32 writeBytes(const HANDLE file, u32 toWrite, const void* buffer);
+
+		// Size and last write time of a file, used to detect changes in source assets
+		static bool getFileInfo(const char* fileAbsPath, u64& outSize, u64& outWriteTime);
+
+		// Creates the directory if it doesn't exist. Parent must exist
+		static bool createDirectory(const char* dirAbsPath);
+	};
+
+	// Read only view of a whole file mapped in memory. Pages are loaded by the OS when accessed
+	class MappedFile
+	{
+	public:
+
+		MappedFile() {}
+		~MappedFile() { close(); }
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const char* fileAbsPath);
+		void close();
+
+		bool isOpen() const { return m_data != nullptr; }
+		const u8* getData() const { return m_data; }
+		u64 getSize() const { return m_size; }
+
+	private:
+
+		HANDLE m_file = INVALID_HANDLE_VALUE;
+		HANDLE m_mapping = nullptr;
+		const u8* m_data = nullptr;
+		u64 m_size = 0;
 	};
 }
\ No newline at end of file
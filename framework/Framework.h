@@ -4,11 +4,13 @@
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "d3dcompiler.lib")
+#pragma comment(lib, "windowscodecs.lib")
 
 // Include some platform libraries
 #include <windows.h>
 #include <d3d11.h>
 #include <d3dcompiler.h>
+#include <wincodec.h>
 
 // External utilities
 #include "external/imgui/imgui.h"
@@ -23,6 +25,28 @@
 #include "framework/Paths.h"
 #include "framework/CommandLine.h"
 #include "framework/FileUtils.h"
+#include "framework/GeometryUtils.h"
+#include "framework/LightClusters.h"
+#include "framework/DrawLightLists.h"
+#include "framework/ShadowAtlas.h"
+#include "framework/ShadowCascades.h"
+#include "framework/OcclusionCuller.h"
+#include "framework/DrawCulling.h"
+#include "framework/RenderGraph.h"
+#include "framework/AutoExposure.h"
+#include "framework/AccessorUtils.h"
+#include "framework/TextureUtils.h"
+#include "framework/ImageDecoder.h"
+#include "framework/TextureCompression.h"
+#include "framework/TextureFile.h"
+#include "framework/GltfBufferReader.h"
+#include "framework/RingAllocator.h"
+#include "framework/TextureStreamer.h"
+#include "framework/TextureCache.h"
+#include "framework/TextureArrayPacker.h"
+#include "framework/VirtualPageTable.h"
 #include "framework/Window.h"
 #include "framework/RenderUtils.h"
+#include "framework/TextureCooker.h"
+#include "framework/VirtualTexture.h"
 #include "framework/Camera.h"
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "framework/Framework.h"
+#include "framework/GeometryUtils.h"
+
+namespace framework
+{
+
+	void IndexUtils::computeRange(const u32* indices, u32 indexCount, u32& outMin, u32& outMax)
+	{
+		u32 minIdx = 0xFFFFFFFF;
+		u32 maxIdx = 0;
+		for (u32 i = 0; i < indexCount; ++i)
+		{
+			minIdx = glm::min(minIdx, indices[i]);
+			maxIdx = glm::max(maxIdx, indices[i]);
+		}
+		outMin = indexCount ? minIdx : 0;
+		outMax = maxIdx;
+	}
+
+	void IndexUtils::narrowToShort(const u32* src, u32 indexCount, u32 baseVertex, u16* dst)
+	{
+		for (u32 i = 0; i < indexCount; ++i)
+		{
+			VERIFY((src[i] - baseVertex) < s_maxShortVertexCount, "Index out of the 16 bit range");
+			dst[i] = static_cast<u16>(src[i] - baseVertex);
+		}
+	}
+
+	void IndexUtils::splitToShortChunks(const u32* indices, u32 indexCount, u32 vertexCount,
+		Vector<Chunk>& outChunks, Vector<u16>& outIndices, Vector<u32>& outVertexRemap)
+	{
+		static constexpr u32 s_invalidIdx = 0xFFFFFFFF;
+		VERIFY((indexCount % 3) == 0, "Expected a triangle list");
+
+		// Source vertex -> local index in the current chunk
+		Vector<u32> localIdx(vertexCount, s_invalidIdx);
+
+		outIndices.reserve(outIndices.size() + indexCount);
+		Chunk chunk;
+		chunk.m_firstIndex = static_cast<u32>(outIndices.size());
+		chunk.m_firstVertex = static_cast<u32>(outVertexRemap.size());
+
+		for (u32 tri = 0; tri < indexCount; tri += 3)
+		{
+			u32 newVertices = 0;
+			for (u32 corner = 0; corner < 3; ++corner)
+			{
+				newVertices += (localIdx[indices[tri + corner]] == s_invalidIdx) ? 1 : 0;
+			}
+
+			// Close the chunk if this triangle doesn't fit
+			if (chunk.m_vertexCount + newVertices > s_maxShortVertexCount)
+			{
+				for (u32 i = chunk.m_firstVertex; i < chunk.m_firstVertex + chunk.m_vertexCount; ++i)
+				{
+					localIdx[outVertexRemap[i]] = s_invalidIdx;
+				}
+				outChunks.push_back(chunk);
+				chunk = Chunk();
+				chunk.m_firstIndex = static_cast<u32>(outIndices.size());
+				chunk.m_firstVertex = static_cast<u32>(outVertexRemap.size());
+			}
+
+			for (u32 corner = 0; corner < 3; ++corner)
+			{
+				const u32 srcIdx = indices[tri + corner];
+				VERIFY(srcIdx < vertexCount, "Index out of range");
+				if (localIdx[srcIdx] == s_invalidIdx)
+				{
+					localIdx[srcIdx] = chunk.m_vertexCount++;
+					outVertexRemap.push_back(srcIdx);
+				}
+				outIndices.push_back(static_cast<u16>(localIdx[srcIdx]));
+				chunk.m_indexCount++;
+			}
+		}
+
+		if (chunk.m_indexCount)
+		{
+			outChunks.push_back(chunk);
+		}
+	}
+
+	// ----------------------------------------------------------------------
+
+	Frustum Frustum::fromViewProj(const m4& viewProj)
+	{
+		// Rows of the matrix (glm is column major)
+		const m4 rows = glm::transpose(viewProj);
+		Frustum frustum;
+		frustum.m_planes[0] = rows[3] + rows[0];
+		frustum.m_planes[1] = rows[3] - rows[0];
+		frustum.m_planes[2] = rows[3] + rows[1];
+		frustum.m_planes[3] = rows[3] - rows[1];
+		frustum.m_planes[4] = rows[3] - rows[2];
+		for (v4& plane : frustum.m_planes)
+		{
+			plane /= glm::length(v3(plane));
+		}
+		return frustum;
+	}
+
+	bool Frustum::isSphereVisible(const v3& center, f32 radius) const
+	{
+		for (const v4& plane : m_planes)
+		{
+			if (glm::dot(v3(plane), center) + plane.w < -radius)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// ----------------------------------------------------------------------
+
+	VertexWelder::VertexWelder(u32 floatsPerVertex, f32 epsilon)
+		: m_floatsPerVertex(floatsPerVertex)
+		, m_epsilon(glm::max(epsilon, 0.0f))
+	{
+	}
+
+	void VertexWelder::reserve(u32 vertexCount)
+	{
+		m_vertices.reserve(vertexCount * m_floatsPerVertex);
+		m_next.reserve(vertexCount);
+		m_buckets.reserve(vertexCount);
+	}
+
+	u32 VertexWelder::findInBucket(u64 hash, const f32* attribs, u32 minAcceptedIdx) const
+	{
+		auto bucket = m_buckets.find(hash);
+		if (bucket == m_buckets.end())
+		{
+			return s_invalidIdx;
+		}
+		// Buckets are sorted from newest to oldest, stop when going out of the accepted range
+		for (u32 idx = bucket->second; idx != s_invalidIdx && idx >= minAcceptedIdx; idx = m_next[idx])
+		{
+			if (isEqual(attribs, getVertex(idx)))
+			{
+				return idx;
+			}
+		}
+		return s_invalidIdx;
+	}
+
+	u32 VertexWelder::weld(const f32* attribs, u32 minAcceptedIdx)
+	{
+		u64 hash;
+		u32 match = s_invalidIdx;
+		if (m_epsilon == 0.0f)
+		{
+			hash = Hash::compute(attribs, m_floatsPerVertex * sizeof(f32));
+			match = findInBucket(hash, attribs, minAcceptedIdx);
+		}
+		else
+		{
+			// Cells are 2 epsilons wide, so a vertex within epsilon is in this cell or in the neighbour on the closest side
+			// along each axis: 2^k cells to probe. The newest match wins, like in a single bucket
+			const u32 axisCount = getCellAxisCount();
+			const f32 invCellSize = 0.5f / m_epsilon;
+			s32 cell[s_maxCellAxes];
+			s32 neighbourStep[s_maxCellAxes];
+			for (u32 i = 0; i < axisCount; ++i)
+			{
+				const f32 coord = attribs[i] * invCellSize;
+				cell[i] = static_cast<s32>(glm::floor(coord));
+				neighbourStep[i] = (coord - static_cast<f32>(cell[i])) < 0.5f ? -1 : 1;
+			}
+			hash = Hash::compute(cell, axisCount * sizeof(s32));
+			for (u32 probe = 0; probe < (1u << axisCount); ++probe)
+			{
+				s32 probeCell[s_maxCellAxes];
+				for (u32 i = 0; i < axisCount; ++i)
+				{
+					probeCell[i] = cell[i] + ((probe >> i) & 1 ? neighbourStep[i] : 0);
+				}
+				const u32 idx = findInBucket(Hash::compute(probeCell, axisCount * sizeof(s32)), attribs, minAcceptedIdx);
+				if (idx != s_invalidIdx && (match == s_invalidIdx || idx > match))
+				{
+					match = idx;
+				}
+			}
+		}
+		if (match != s_invalidIdx)
+		{
+			return match;
+		}
+
+		const u32 newIdx = getVertexCount();
+		auto bucket = m_buckets.find(hash);
+		m_vertices.insert(m_vertices.end(), attribs, attribs + m_floatsPerVertex);
+		m_next.push_back(bucket != m_buckets.end() ? bucket->second : s_invalidIdx);
+		m_buckets[hash] = newIdx;
+		return newIdx;
+	}
+
+	bool VertexWelder::isEqual(const f32* a, const f32* b) const
+	{
+		if (m_epsilon == 0.0f)
+		{
+			return memcmp(a, b, m_floatsPerVertex * sizeof(f32)) == 0;
+		}
+		for (u32 i = 0; i < m_floatsPerVertex; ++i)
+		{
+			if (glm::abs(a[i] - b[i]) > m_epsilon)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	class IndexUtils
+	{
+	public:
+
+		// Max number of distinct vertices a 16 bit index buffer can address
+		static constexpr u32 s_maxShortVertexCount = 0x10000;
+
+		// Range of vertices referenced by a chunk of a split primitive
+		struct Chunk
+		{
+			u32 m_firstIndex = 0; // Offset into the output index list
+			u32 m_indexCount = 0;
+			u32 m_firstVertex = 0; // Offset into the output vertex remap list
+			u32 m_vertexCount = 0;
+		};
+
+		static void computeRange(const u32* indices, u32 indexCount, u32& outMin, u32& outMax);
+
+		// True if the indices in [minIdx, maxIdx] can be stored as u16 once rebased to minIdx
+		static bool canNarrow(u32 minIdx, u32 maxIdx) { return (maxIdx - minIdx) < s_maxShortVertexCount; }
+
+		// dst[i] = src[i] - baseVertex
+		static void narrowToShort(const u32* src, u32 indexCount, u32 baseVertex, u16* dst);
+
+		// Split a triangle list into chunks that reference at most s_maxShortVertexCount vertices each.
+		// Each chunk gets its own local u16 indices and a remap list (local vertex -> source vertex).
+		static void splitToShortChunks(const u32* indices, u32 indexCount, u32 vertexCount,
+			Vector<Chunk>& outChunks, Vector<u16>& outIndices, Vector<u32>& outVertexRemap);
+	};
+
+	// Planes of a view frustum, pointing inwards. Built from a view projection matrix
+	struct Frustum
+	{
+		static constexpr u32 s_planeCount = 5; // Left, right, bottom, top, far. The near plane is left out, spheres behind the camera fail the side planes
+
+		static Frustum fromViewProj(const m4& viewProj);
+
+		bool isSphereVisible(const v3& center, f32 radius) const;
+
+		v4 m_planes[s_planeCount];
+	};
+
+	// Deduplicates vertices made of N floats. Vertices are bucketed by a hash of their attributes and compared attribute by
+	// attribute. With an epsilon, the bucket is a cell of a grid over the first 3 floats (the position) and the neighbour cells
+	// a match could be in are probed too, so vertices closer than epsilon on every attribute are welded across cell borders
+	class VertexWelder
+	{
+	public:
+
+		VertexWelder(u32 floatsPerVertex, f32 epsilon = 0.0f);
+
+		void reserve(u32 vertexCount);
+
+		// Returns the index of an equal vertex that is >= minAcceptedIdx. Adds the vertex if none is found
+		u32 weld(const f32* attribs, u32 minAcceptedIdx = 0);
+
+		u32 getVertexCount() const { return static_cast<u32>(m_next.size()); }
+
+		const f32* getVertex(u32 idx) const { return m_vertices.data() + idx * m_floatsPerVertex; }
+
+	private:
+
+		static constexpr u32 s_invalidIdx = 0xFFFFFFFF;
+
+		static constexpr u32 s_maxCellAxes = 3;
+
+		u32 getCellAxisCount() const { return m_floatsPerVertex < s_maxCellAxes ? m_floatsPerVertex : s_maxCellAxes; }
+
+		// Newest equal vertex >= minAcceptedIdx in the bucket, s_invalidIdx if none
+		u32 findInBucket(u64 hash, const f32* attribs, u32 minAcceptedIdx) const;
+
+		bool isEqual(const f32* a, const f32* b) const;
+
+		u32 m_floatsPerVertex;
+		f32 m_epsilon;
+		Vector<f32> m_vertices;
+		Vector<u32> m_next; // Next vertex in the same hash bucket
+		UMap<u64, u32> m_buckets; // Hash -> Last vertex added with that hash
+	};
+}
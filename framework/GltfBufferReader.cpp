@@ -0,0 +1,82 @@
+#include "framework/Framework.h"
+#include "framework/GltfBufferReader.h"
+
+namespace framework
+{
+
+	void GltfBufferReader::addMemoryBuffer(const u8* data, u64 size)
+	{
+		Source source;
+		source.m_data = data;
+		source.m_size = data ? size : 0;
+		m_sources.push_back(source);
+	}
+
+	bool GltfBufferReader::addFileBuffer(const char* fileAbsPath)
+	{
+		Source source;
+		source.m_file = FileUtils::openFileForRead(fileAbsPath);
+		if (source.m_file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		// FileUtils::getFileSize is 32 bit, binary buffers can be larger
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(source.m_file, &fileSize))
+		{
+			printf("Failed to get the size of %s\n", fileAbsPath);
+			FileUtils::closeFile(source.m_file);
+			return false;
+		}
+		source.m_size = static_cast<u64>(fileSize.QuadPart);
+		m_sources.push_back(source);
+		return true;
+	}
+
+	const u8* GltfBufferReader::acquire(u32 bufferIdx, u64 offset, u64 size)
+	{
+		VERIFY(bufferIdx < m_sources.size(), "Buffer not registered in the reader");
+		const Source& source = m_sources[bufferIdx];
+		if (offset + size > source.m_size)
+		{
+			printf("Read out of the bounds of buffer %u\n", bufferIdx);
+			return nullptr;
+		}
+		if (source.m_data)
+		{
+			return source.m_data + offset;
+		}
+
+		// Only the requested range of the file is brought to memory
+		if (size > UINT32_MAX)
+		{
+			printf("Read of %llu bytes from buffer %u is too large\n", size, bufferIdx);
+			return nullptr;
+		}
+		if (size > m_window.size())
+		{
+			m_window.resize(static_cast<size_t>(size));
+			m_peakWindowSize = glm::max(m_peakWindowSize, size);
+		}
+		LARGE_INTEGER filePos;
+		filePos.QuadPart = static_cast<LONGLONG>(offset);
+		if (!SetFilePointerEx(source.m_file, filePos, NULL, FILE_BEGIN) ||
+			FileUtils::readBytes(source.m_file, static_cast<u32>(size), m_window.data()) != size)
+		{
+			printf("Failed to read %llu bytes from buffer %u\n", size, bufferIdx);
+			return nullptr;
+		}
+		return m_window.data();
+	}
+
+	void GltfBufferReader::clear()
+	{
+		for (const Source& source : m_sources)
+		{
+			FileUtils::closeFile(source.m_file);
+		}
+		m_sources.clear();
+		Vector<u8>().swap(m_window);
+	}
+
+}
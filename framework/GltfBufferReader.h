@@ -0,0 +1,46 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// Gives access to ranges of the glTF buffers without keeping whole buffers in memory.
+	// Buffers can live in memory (GLB BIN chunk of a mapped file, data URIs decoded by tinygltf)
+	// or in external .bin files, which are read on demand into a scratch window reused between reads.
+	class GltfBufferReader
+	{
+	public:
+
+		GltfBufferReader() {}
+		~GltfBufferReader() { clear(); }
+		GltfBufferReader(const GltfBufferReader&) = delete;
+		GltfBufferReader& operator=(const GltfBufferReader&) = delete;
+
+		// Buffers must be added in the same order they are declared in the glTF
+		void addMemoryBuffer(const u8* data, u64 size);
+		bool addFileBuffer(const char* fileAbsPath);
+
+		// Returns a pointer to the bytes [offset, offset + size) of the buffer or nullptr on failure.
+		// The pointer is only valid until the next call to acquire or clear
+		const u8* acquire(u32 bufferIdx, u64 offset, u64 size);
+
+		// Close files and release the scratch window
+		void clear();
+
+		u64 getPeakWindowSize() const { return m_peakWindowSize; }
+
+	private:
+
+		struct Source
+		{
+			const u8* m_data = nullptr; // Only for buffers in memory
+			HANDLE m_file = INVALID_HANDLE_VALUE;
+			u64 m_size = 0;
+		};
+
+		Vector<Source> m_sources;
+		Vector<u8> m_window;
+		u64 m_peakWindowSize = 0;
+	};
+}
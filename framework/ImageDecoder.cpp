@@ -0,0 +1,365 @@
+#include "framework/Framework.h"
+#include "framework/ImageDecoder.h"
+
+namespace framework
+{
+
+	void ImageDecoder::getDecodedSize(const Info& info, u32 downscaleLog2, u32& outWidth, u32& outHeight)
+	{
+		outWidth = glm::max(info.m_width >> downscaleLog2, 1u);
+		outHeight = glm::max(info.m_height >> downscaleLog2, 1u);
+	}
+
+	// ----------------------------------------------------------------------
+
+	bool StbImageDecoder::canDecode(const u8* data, u64 size) const
+	{
+		s32 x, y, n;
+		return stbi_info_from_memory(data, static_cast<s32>(size), &x, &y, &n) != 0;
+	}
+
+	bool StbImageDecoder::readInfo(const u8* data, u64 size, Info& outInfo)
+	{
+		s32 x, y, n;
+		if (!stbi_info_from_memory(data, static_cast<s32>(size), &x, &y, &n))
+		{
+			return false;
+		}
+		outInfo.m_width = x;
+		outInfo.m_height = y;
+		return true;
+	}
+
+	bool StbImageDecoder::decode(const u8* data, u64 size, const Target& target)
+	{
+		s32 x, y, n;
+		u8* texels = stbi_load_from_memory(data, static_cast<s32>(size), &x, &y, &n, s_bytesPerTexel);
+		if (!texels)
+		{
+			return false;
+		}
+
+		Info info;
+		info.m_width = x;
+		info.m_height = y;
+		u32 width, height;
+		getDecodedSize(info, target.m_downscaleLog2, width, height);
+		const u32 srcPitch = x * s_bytesPerTexel;
+		if (target.m_downscaleLog2 == 0)
+		{
+			for (u32 row = 0; row < height; ++row)
+			{
+				memcpy(target.m_data + row * target.m_rowPitch, texels + row * srcPitch, srcPitch);
+			}
+		}
+		else
+		{
+			// Box filter the footprint of each texel, clamped to the image
+			const u32 footprint = 1 << target.m_downscaleLog2;
+			for (u32 row = 0; row < height; ++row)
+			{
+				const u32 srcRowBegin = row << target.m_downscaleLog2;
+				const u32 srcRowEnd = glm::min(srcRowBegin + footprint, static_cast<u32>(y));
+				u8* dst = target.m_data + row * target.m_rowPitch;
+				for (u32 col = 0; col < width; ++col)
+				{
+					const u32 srcColBegin = col << target.m_downscaleLog2;
+					const u32 srcColEnd = glm::min(srcColBegin + footprint, static_cast<u32>(x));
+					u32 sum[s_bytesPerTexel] = {};
+					for (u32 srcRow = srcRowBegin; srcRow < srcRowEnd; ++srcRow)
+					{
+						const u8* src = texels + srcRow * srcPitch + srcColBegin * s_bytesPerTexel;
+						for (u32 i = 0; i < (srcColEnd - srcColBegin) * s_bytesPerTexel; ++i)
+						{
+							sum[i % s_bytesPerTexel] += src[i];
+						}
+					}
+					const u32 count = (srcRowEnd - srcRowBegin) * (srcColEnd - srcColBegin);
+					for (u32 c = 0; c < s_bytesPerTexel; ++c)
+					{
+						dst[col * s_bytesPerTexel + c] = static_cast<u8>((sum[c] + count / 2) / count);
+					}
+				}
+			}
+		}
+		stbi_image_free(texels);
+		return true;
+	}
+
+	// ----------------------------------------------------------------------
+
+	WicImageDecoder::WicImageDecoder()
+	{
+		// S_FALSE means COM was already initialized on this thread and still needs a CoUninitialize.
+		// RPC_E_CHANGED_MODE means it was initialized with another threading model, which WIC works with too
+		const HRESULT res = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+		m_isComInitialized = (res == S_OK || res == S_FALSE);
+		if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&m_factory))))
+		{
+			printf("Failed to create the WIC factory, WIC decoding is disabled\n");
+			m_factory = nullptr;
+		}
+	}
+
+	WicImageDecoder::~WicImageDecoder()
+	{
+		if (m_factory)
+		{
+			m_factory->Release();
+			m_factory = nullptr;
+		}
+		if (m_isComInitialized)
+		{
+			CoUninitialize();
+			m_isComInitialized = false;
+		}
+	}
+
+	bool WicImageDecoder::canDecode(const u8* data, u64 size) const
+	{
+		static const u8 s_jpegMagic[] = { 0xFF, 0xD8, 0xFF };
+		static const u8 s_pngMagic[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		if (!m_factory)
+		{
+			return false;
+		}
+		return (size >= sizeof(s_jpegMagic) && memcmp(data, s_jpegMagic, sizeof(s_jpegMagic)) == 0) ||
+			(size >= sizeof(s_pngMagic) && memcmp(data, s_pngMagic, sizeof(s_pngMagic)) == 0);
+	}
+
+	bool WicImageDecoder::openFrame(const u8* data, u64 size, IWICStream** outStream, IWICBitmapDecoder** outDecoder, IWICBitmapFrameDecode** outFrame)
+	{
+		*outStream = nullptr;
+		*outDecoder = nullptr;
+		*outFrame = nullptr;
+		if (!m_factory || size > 0xFFFFFFFF)
+		{
+			return false;
+		}
+		// The stream reads the memory in place
+		return SUCCEEDED(m_factory->CreateStream(outStream)) &&
+			SUCCEEDED((*outStream)->InitializeFromMemory(const_cast<BYTE*>(data), static_cast<DWORD>(size))) &&
+			SUCCEEDED(m_factory->CreateDecoderFromStream(*outStream, nullptr, WICDecodeMetadataCacheOnDemand, outDecoder)) &&
+			SUCCEEDED((*outDecoder)->GetFrame(0, outFrame));
+	}
+
+	template <typename T>
+	static void safeRelease(T*& ptr)
+	{
+		if (ptr)
+		{
+			ptr->Release();
+			ptr = nullptr;
+		}
+	}
+
+	bool WicImageDecoder::readInfo(const u8* data, u64 size, Info& outInfo)
+	{
+		IWICStream* stream;
+		IWICBitmapDecoder* decoder;
+		IWICBitmapFrameDecode* frame;
+		UINT width = 0;
+		UINT height = 0;
+		const bool success = openFrame(data, size, &stream, &decoder, &frame) && SUCCEEDED(frame->GetSize(&width, &height));
+		safeRelease(frame);
+		safeRelease(decoder);
+		safeRelease(stream);
+		outInfo.m_width = width;
+		outInfo.m_height = height;
+		return success;
+	}
+
+	bool WicImageDecoder::decode(const u8* data, u64 size, const Target& target)
+	{
+		IWICStream* stream;
+		IWICBitmapDecoder* decoder;
+		IWICBitmapFrameDecode* frame;
+		IWICBitmapSourceTransform* transform = nullptr;
+		IWICBitmapScaler* scaler = nullptr;
+		IWICFormatConverter* converter = nullptr;
+		bool success = false;
+
+		Info info;
+		if (openFrame(data, size, &stream, &decoder, &frame) && SUCCEEDED(frame->GetSize(&info.m_width, &info.m_height)))
+		{
+			u32 width, height;
+			getDecodedSize(info, target.m_downscaleLog2, width, height);
+			const UINT bufferSize = target.m_rowPitch * height;
+
+			// Scaling in the codec (JPEG DCT scaling) decodes a fraction of the data. Only usable when it outputs RGBA at the exact size
+			if (target.m_downscaleLog2 > 0 && SUCCEEDED(frame->QueryInterface(IID_PPV_ARGS(&transform))))
+			{
+				UINT closestWidth = width;
+				UINT closestHeight = height;
+				WICPixelFormatGUID format = GUID_WICPixelFormat32bppRGBA;
+				BOOL canTransform = FALSE;
+				if (SUCCEEDED(transform->GetClosestSize(&closestWidth, &closestHeight)) && closestWidth == width && closestHeight == height &&
+					SUCCEEDED(transform->GetClosestPixelFormat(&format)) && IsEqualGUID(format, GUID_WICPixelFormat32bppRGBA) &&
+					SUCCEEDED(transform->DoesSupportTransform(WICBitmapTransformRotate0, &canTransform)) && canTransform)
+				{
+					success = SUCCEEDED(transform->CopyPixels(nullptr, width, height, &format, WICBitmapTransformRotate0, target.m_rowPitch, bufferSize, target.m_data));
+				}
+			}
+
+			if (!success)
+			{
+				IWICBitmapSource* source = frame;
+				if (target.m_downscaleLog2 > 0)
+				{
+					if (FAILED(m_factory->CreateBitmapScaler(&scaler)) || FAILED(scaler->Initialize(frame, width, height, WICBitmapInterpolationModeFant)))
+					{
+						source = nullptr;
+					}
+					else
+					{
+						source = scaler;
+					}
+				}
+				success = source &&
+					SUCCEEDED(m_factory->CreateFormatConverter(&converter)) &&
+					SUCCEEDED(converter->Initialize(source, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom)) &&
+					SUCCEEDED(converter->CopyPixels(nullptr, target.m_rowPitch, bufferSize, target.m_data));
+			}
+		}
+
+		safeRelease(converter);
+		safeRelease(scaler);
+		safeRelease(transform);
+		safeRelease(frame);
+		safeRelease(decoder);
+		safeRelease(stream);
+		return success;
+	}
+
+	// ----------------------------------------------------------------------
+
+	Vector<UniquePtr<ImageDecoder>> ImageDecoders::ms_decoders;
+	bool ImageDecoders::ms_hasDefaultDecoders = false;
+
+	void ImageDecoders::registerDefaultDecoders()
+	{
+		if (ms_hasDefaultDecoders)
+		{
+			return;
+		}
+		ms_hasDefaultDecoders = true;
+		// stb_image goes last, it's the fallback for everything else
+		ms_decoders.push_back(std::make_unique<StbImageDecoder>());
+		UniquePtr<WicImageDecoder> wic = std::make_unique<WicImageDecoder>();
+		if (wic->isValid())
+		{
+			ms_decoders.insert(ms_decoders.begin(), std::move(wic));
+		}
+	}
+
+	void ImageDecoders::registerDecoder(UniquePtr<ImageDecoder>&& decoder)
+	{
+		registerDefaultDecoders();
+		ms_decoders.insert(ms_decoders.begin(), std::move(decoder));
+	}
+
+	ImageDecoder* ImageDecoders::findDecoder(const u8* data, u64 size)
+	{
+		registerDefaultDecoders();
+		for (UniquePtr<ImageDecoder>& decoder : ms_decoders)
+		{
+			if (decoder->canDecode(data, size))
+			{
+				return decoder.get();
+			}
+		}
+		return nullptr;
+	}
+
+	bool ImageDecoders::decode(const u8* data, u64 size, u32 downscaleLog2, Vector<u8>& outTexels, u32& outWidth, u32& outHeight)
+	{
+		registerDefaultDecoders();
+		for (UniquePtr<ImageDecoder>& decoder : ms_decoders)
+		{
+			ImageDecoder::Info info;
+			if (!decoder->canDecode(data, size) || !decoder->readInfo(data, size, info))
+			{
+				continue;
+			}
+			ImageDecoder::getDecodedSize(info, downscaleLog2, outWidth, outHeight);
+			outTexels.resize(static_cast<size_t>(outWidth) * outHeight * ImageDecoder::s_bytesPerTexel);
+
+			ImageDecoder::Target target;
+			target.m_data = outTexels.data();
+			target.m_rowPitch = outWidth * ImageDecoder::s_bytesPerTexel;
+			target.m_downscaleLog2 = downscaleLog2;
+			if (decoder->decode(data, size, target))
+			{
+				return true;
+			}
+			printf("%s failed to decode an image, trying the next decoder\n", decoder->getName());
+		}
+		return false;
+	}
+
+	void ImageDecoders::benchmark(const char* dirAbsPath)
+	{
+		registerDefaultDecoders();
+
+		// Load every JPEG and PNG in memory, only decoding is timed
+		Vector<UniquePtr<MappedFile>> files;
+		static const char* s_patterns[] = { "*.jpg", "*.jpeg", "*.png" };
+		for (const char* pattern : s_patterns)
+		{
+			const String dir = String(dirAbsPath) + "/";
+			WIN32_FIND_DATAA findData;
+			HANDLE find = FindFirstFileA((dir + pattern).c_str(), &findData);
+			if (find == INVALID_HANDLE_VALUE)
+			{
+				continue;
+			}
+			do
+			{
+				UniquePtr<MappedFile> file = std::make_unique<MappedFile>();
+				if (file->open((dir + findData.cFileName).c_str()))
+				{
+					files.push_back(std::move(file));
+				}
+			} while (FindNextFileA(find, &findData));
+			FindClose(find);
+		}
+		printf("Image decoder benchmark: %u images in %s\n", static_cast<u32>(files.size()), dirAbsPath);
+
+		Vector<u8> texels;
+		for (UniquePtr<ImageDecoder>& decoder : ms_decoders)
+		{
+			for (u32 downscaleLog2 = 0; downscaleLog2 <= 2; downscaleLog2 += 2)
+			{
+				u32 decodedCount = 0;
+				u64 texelCount = 0;
+				f64 elapsedMs = 0.0;
+				for (const UniquePtr<MappedFile>& file : files)
+				{
+					ImageDecoder::Info info;
+					if (!decoder->canDecode(file->getData(), file->getSize()) || !decoder->readInfo(file->getData(), file->getSize(), info))
+					{
+						continue;
+					}
+					u32 width, height;
+					ImageDecoder::getDecodedSize(info, downscaleLog2, width, height);
+					texels.resize(static_cast<size_t>(width) * height * ImageDecoder::s_bytesPerTexel);
+					ImageDecoder::Target target;
+					target.m_data = texels.data();
+					target.m_rowPitch = width * ImageDecoder::s_bytesPerTexel;
+					target.m_downscaleLog2 = downscaleLog2;
+
+					const f64 start = Time::getTimeStampMs();
+					if (decoder->decode(file->getData(), file->getSize(), target))
+					{
+						elapsedMs += Time::getTimeStampMs() - start;
+						texelCount += static_cast<u64>(info.m_width) * info.m_height;
+						decodedCount++;
+					}
+				}
+				printf("  %-10s downscale 1/%u: %u images, %.1f ms, %.1f source MTexels/s\n", decoder->getName(), 1 << downscaleLog2,
+					decodedCount, elapsedMs, elapsedMs > 0.0 ? (texelCount / 1.0e6) / (elapsedMs / 1000.0) : 0.0);
+			}
+		}
+	}
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// Decodes images (JPEG, PNG, ...) to 8 bit RGBA. New backends can be plugged in with ImageDecoders::registerDecoder
+	class ImageDecoder
+	{
+	public:
+
+		static constexpr u32 s_bytesPerTexel = 4;
+
+		struct Info
+		{
+			u32 m_width = 0;
+			u32 m_height = 0;
+		};
+
+		// Where the texels go. Rows start every m_rowPitch bytes, so the decoder can write straight into the final memory.
+		// The image is downscaled by 2^m_downscaleLog2 while decoding, see getDecodedSize
+		struct Target
+		{
+			u8* m_data = nullptr;
+			u32 m_rowPitch = 0;
+			u32 m_downscaleLog2 = 0;
+		};
+
+		virtual ~ImageDecoder() {}
+
+		virtual const char* getName() const = 0;
+
+		// True if the data looks like a format the decoder supports
+		virtual bool canDecode(const u8* data, u64 size) const = 0;
+
+		virtual bool readInfo(const u8* data, u64 size, Info& outInfo) = 0;
+
+		virtual bool decode(const u8* data, u64 size, const Target& target) = 0;
+
+		static void getDecodedSize(const Info& info, u32 downscaleLog2, u32& outWidth, u32& outHeight);
+	};
+
+	// Any format supported by stb_image. Decodes to a temporary buffer and copies (or box filters when downscaling) into the target
+	class StbImageDecoder : public ImageDecoder
+	{
+	public:
+
+		const char* getName() const override { return "stb_image"; }
+		bool canDecode(const u8* data, u64 size) const override;
+		bool readInfo(const u8* data, u64 size, Info& outInfo) override;
+		bool decode(const u8* data, u64 size, const Target& target) override;
+	};
+
+	// JPEG and PNG through the Windows Imaging Component, which has vectorized codecs. Decodes straight into the target.
+	// JPEGs are downscaled in the DCT domain when the codec supports it, other images with a Fant scaler
+	class WicImageDecoder : public ImageDecoder
+	{
+	public:
+
+		WicImageDecoder();
+		~WicImageDecoder();
+		WicImageDecoder(const WicImageDecoder&) = delete;
+		WicImageDecoder& operator=(const WicImageDecoder&) = delete;
+
+		bool isValid() const { return m_factory != nullptr; }
+
+		const char* getName() const override { return "WIC"; }
+		bool canDecode(const u8* data, u64 size) const override;
+		bool readInfo(const u8* data, u64 size, Info& outInfo) override;
+		bool decode(const u8* data, u64 size, const Target& target) override;
+
+	private:
+
+		bool openFrame(const u8* data, u64 size, IWICStream** outStream, IWICBitmapDecoder** outDecoder, IWICBitmapFrameDecode** outFrame);
+
+		IWICImagingFactory* m_factory = nullptr;
+		bool m_isComInitialized = false; // Balanced with CoUninitialize on destruction
+	};
+
+	class ImageDecoders
+	{
+	public:
+
+		// Registered decoders are tried before the ones already registered. WIC and stb_image are registered on first use
+		static void registerDecoder(UniquePtr<ImageDecoder>&& decoder);
+
+		// First decoder that can decode the data. Null if none
+		static ImageDecoder* findDecoder(const u8* data, u64 size);
+
+		// Decode to tightly packed RGBA. Falls back to the next decoder if one fails
+		static bool decode(const u8* data, u64 size, u32 downscaleLog2, Vector<u8>& outTexels, u32& outWidth, u32& outHeight);
+
+		// Decode every JPEG and PNG in the directory with each decoder and print the timings
+		static void benchmark(const char* dirAbsPath);
+
+	private:
+
+		static void registerDefaultDecoders();
+
+		static Vector<UniquePtr<ImageDecoder>> ms_decoders;
+		static bool ms_hasDefaultDecoders;
+	};
+}
@@ -0,0 +1,282 @@
+#include "framework/Types.h"
+#include "framework/LightClusters.h"
+
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <emmintrin.h>
+
+namespace framework
+{
+
+	static constexpr f32 s_emptyBound = 1e30f; // Padding clusters get an inverted AABB, no sphere touches it
+
+	void LightClusters::init(const Config& config)
+	{
+		m_config = config;
+		m_config.m_tilesX = glm::max(m_config.m_tilesX, 1u);
+		m_config.m_tilesY = glm::max(m_config.m_tilesY, 1u);
+		m_config.m_slices = glm::max(m_config.m_slices, 1u);
+		m_config.m_maxLightsPerCluster = glm::max(m_config.m_maxLightsPerCluster, 1u);
+
+		m_rowStride = (m_config.m_tilesX + 3) & ~3u;
+		const u32 paddedCount = m_rowStride * m_config.m_tilesY * m_config.m_slices;
+		m_minX.assign(paddedCount, s_emptyBound);
+		m_minY.assign(paddedCount, s_emptyBound);
+		m_minZ.assign(paddedCount, s_emptyBound);
+		m_maxX.assign(paddedCount, -s_emptyBound);
+		m_maxY.assign(paddedCount, -s_emptyBound);
+		m_maxZ.assign(paddedCount, -s_emptyBound);
+		m_boundsProjection = m4(0.0f);
+
+		m_clusterLights.resize(getClusterCount() * m_config.m_maxLightsPerCluster);
+		m_clusterCounts.resize(getClusterCount());
+		m_ranges.resize(getClusterCount());
+		m_lightIndices.clear();
+		m_constants.m_grid = v4(static_cast<f32>(m_config.m_tilesX), static_cast<f32>(m_config.m_tilesY), static_cast<f32>(m_config.m_slices), 0.0f);
+		m_constants.m_scaleBias = v4(0.0f);
+	}
+
+	u32 LightClusters::getSlice(f32 depth) const
+	{
+		const f32 slice = logf(depth) * m_constants.m_scaleBias.z + m_constants.m_scaleBias.w;
+		return static_cast<u32>(glm::clamp(slice, 0.0f, static_cast<f32>(m_config.m_slices - 1)));
+	}
+
+	void LightClusters::computeClusterBounds(const m4& projection, f32 nearPlane, f32 farPlane)
+	{
+		// x_view = ndc_x * depth / P00, same for y. Tile row 0 is the top of the screen
+		const f32 invScaleX = 1.0f / projection[0][0];
+		const f32 invScaleY = 1.0f / projection[1][1];
+		const f32 depthRatio = farPlane / nearPlane;
+		for (u32 slice = 0; slice < m_config.m_slices; ++slice)
+		{
+			const f32 sliceNear = nearPlane * powf(depthRatio, static_cast<f32>(slice) / m_config.m_slices);
+			const f32 sliceFar = nearPlane * powf(depthRatio, static_cast<f32>(slice + 1) / m_config.m_slices);
+			for (u32 y = 0; y < m_config.m_tilesY; ++y)
+			{
+				const f32 ndcTop = 1.0f - 2.0f * y / m_config.m_tilesY;
+				const f32 ndcBottom = 1.0f - 2.0f * (y + 1) / m_config.m_tilesY;
+				for (u32 x = 0; x < m_config.m_tilesX; ++x)
+				{
+					const f32 ndcLeft = -1.0f + 2.0f * x / m_config.m_tilesX;
+					const f32 ndcRight = -1.0f + 2.0f * (x + 1) / m_config.m_tilesX;
+					const u32 idx = (slice * m_config.m_tilesY + y) * m_rowStride + x;
+					m_minX[idx] = glm::min(ndcLeft * sliceNear, ndcLeft * sliceFar) * invScaleX;
+					m_maxX[idx] = glm::max(ndcRight * sliceNear, ndcRight * sliceFar) * invScaleX;
+					m_minY[idx] = glm::min(ndcBottom * sliceNear, ndcBottom * sliceFar) * invScaleY;
+					m_maxY[idx] = glm::max(ndcTop * sliceNear, ndcTop * sliceFar) * invScaleY;
+					m_minZ[idx] = -sliceFar;
+					m_maxZ[idx] = -sliceNear;
+				}
+			}
+		}
+		m_boundsProjection = projection;
+		m_boundsNear = nearPlane;
+		m_boundsFar = farPlane;
+	}
+
+	void LightClusters::getLightSphere(const ClusterLight& light, v3& outCenter, f32& outRadius)
+	{
+		outCenter = light.m_pos;
+		outRadius = light.m_radius;
+		if (light.m_type == ClusterLight::Spot)
+		{
+			const f32 cosAngle = glm::clamp(light.m_cosOuterCone, 0.0f, 1.0f);
+			const v3 dir = glm::normalize(light.m_dir);
+			if (cosAngle > 0.70710678f)
+			{
+				const f32 coneRadius = light.m_radius / (2.0f * cosAngle);
+				if (coneRadius < outRadius)
+				{
+					outCenter = light.m_pos + dir * coneRadius;
+					outRadius = coneRadius;
+				}
+			}
+			else
+			{
+				outCenter = light.m_pos + dir * (light.m_radius * cosAngle);
+				outRadius = light.m_radius * sqrtf(1.0f - cosAngle * cosAngle);
+			}
+		}
+	}
+
+	bool LightClusters::computeLightBounds(const m4& view, const m4& projection, f32 nearPlane, f32 farPlane, const ClusterLight& light, LightBounds& outBounds) const
+	{
+		v3 center;
+		f32 radius;
+		getLightSphere(light, center, radius);
+
+		const v3 centerVS = v3(view * v4(center, 1.0f));
+		const f32 depth = -centerVS.z;
+		if (radius <= 0.0f || depth + radius < nearPlane || depth - radius > farPlane)
+		{
+			return false;
+		}
+		outBounds.m_center = centerVS;
+		outBounds.m_radius = radius;
+		outBounds.m_minSlice = getSlice(glm::max(depth - radius, nearPlane));
+		outBounds.m_maxSlice = getSlice(glm::min(depth + radius, farPlane));
+
+		// Screen bounds of the view space AABB of the sphere. Spheres crossing the near plane cover the whole screen
+		outBounds.m_minX = 0;
+		outBounds.m_maxX = m_config.m_tilesX - 1;
+		outBounds.m_minY = 0;
+		outBounds.m_maxY = m_config.m_tilesY - 1;
+		if (depth - radius > nearPlane)
+		{
+			const f32 nearDepth = depth - radius;
+			const f32 farDepth = depth + radius;
+			const f32 x0 = centerVS.x - radius;
+			const f32 x1 = centerVS.x + radius;
+			const f32 y0 = centerVS.y - radius;
+			const f32 y1 = centerVS.y + radius;
+			const f32 ndcMinX = glm::min(x0 / nearDepth, x0 / farDepth) * projection[0][0];
+			const f32 ndcMaxX = glm::max(x1 / nearDepth, x1 / farDepth) * projection[0][0];
+			const f32 ndcMinY = glm::min(y0 / nearDepth, y0 / farDepth) * projection[1][1];
+			const f32 ndcMaxY = glm::max(y1 / nearDepth, y1 / farDepth) * projection[1][1];
+			if (ndcMaxX < -1.0f || ndcMinX > 1.0f || ndcMaxY < -1.0f || ndcMinY > 1.0f)
+			{
+				return false;
+			}
+			auto toTile = [](f32 coord, u32 tileCount)
+			{
+				return static_cast<u32>(glm::clamp(coord * tileCount, 0.0f, static_cast<f32>(tileCount - 1)));
+			};
+			outBounds.m_minX = toTile(ndcMinX * 0.5f + 0.5f, m_config.m_tilesX);
+			outBounds.m_maxX = toTile(ndcMaxX * 0.5f + 0.5f, m_config.m_tilesX);
+			outBounds.m_minY = toTile(0.5f - ndcMaxY * 0.5f, m_config.m_tilesY);
+			outBounds.m_maxY = toTile(0.5f - ndcMinY * 0.5f, m_config.m_tilesY);
+		}
+		return true;
+	}
+
+	u32 LightClusters::binSlices(u32 firstSlice, u32 lastSlice)
+	{
+		u32 droppedCount = 0;
+		for (u32 slice = firstSlice; slice < lastSlice; ++slice)
+		{
+			for (u32 i = 0; i < static_cast<u32>(m_lightBounds.size()); ++i)
+			{
+				const LightBounds& bounds = m_lightBounds[i];
+				if (slice < bounds.m_minSlice || slice > bounds.m_maxSlice)
+				{
+					continue;
+				}
+				const __m128 centerX = _mm_set1_ps(bounds.m_center.x);
+				const __m128 centerY = _mm_set1_ps(bounds.m_center.y);
+				const __m128 centerZ = _mm_set1_ps(bounds.m_center.z);
+				const __m128 radiusSq = _mm_set1_ps(bounds.m_radius * bounds.m_radius);
+				const __m128 zero = _mm_setzero_ps();
+				const u32 lightIdx = m_lightBoundsIdx[i];
+				for (u32 y = bounds.m_minY; y <= bounds.m_maxY; ++y)
+				{
+					const u32 rowIdx = (slice * m_config.m_tilesY + y) * m_rowStride;
+					// Sphere vs AABB for 4 clusters of the row at once: squared distance from the center to the box
+					for (u32 x = bounds.m_minX & ~3u; x <= bounds.m_maxX; x += 4)
+					{
+						const u32 idx = rowIdx + x;
+						const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minX[idx]), centerX), _mm_sub_ps(centerX, _mm_loadu_ps(&m_maxX[idx]))), zero);
+						const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minY[idx]), centerY), _mm_sub_ps(centerY, _mm_loadu_ps(&m_maxY[idx]))), zero);
+						const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&m_minZ[idx]), centerZ), _mm_sub_ps(centerZ, _mm_loadu_ps(&m_maxZ[idx]))), zero);
+						const __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+						u32 mask = static_cast<u32>(_mm_movemask_ps(_mm_cmple_ps(distSq, radiusSq)));
+						while (mask)
+						{
+							const u32 lane = static_cast<u32>(glm::findLSB(mask));
+							mask &= mask - 1;
+							const u32 tileX = x + lane;
+							if (tileX < bounds.m_minX || tileX > bounds.m_maxX)
+							{
+								continue;
+							}
+							const u32 clusterIdx = getClusterIdx(tileX, y, slice);
+							u32& count = m_clusterCounts[clusterIdx];
+							if (count < m_config.m_maxLightsPerCluster)
+							{
+								m_clusterLights[clusterIdx * m_config.m_maxLightsPerCluster + count++] = lightIdx;
+							}
+							else
+							{
+								droppedCount++;
+							}
+						}
+					}
+				}
+			}
+		}
+		return droppedCount;
+	}
+
+	void LightClusters::build(const m4& view, const m4& projection, f32 nearPlane, f32 farPlane, u32 viewportWidth, u32 viewportHeight,
+		const ClusterLight* lights, u32 lightCount)
+	{
+		const f32 depthScale = m_config.m_slices / logf(farPlane / nearPlane);
+		m_constants.m_scaleBias = v4(static_cast<f32>(m_config.m_tilesX) / glm::max(viewportWidth, 1u), static_cast<f32>(m_config.m_tilesY) / glm::max(viewportHeight, 1u),
+			depthScale, -depthScale * logf(nearPlane));
+		if (projection != m_boundsProjection || nearPlane != m_boundsNear || farPlane != m_boundsFar)
+		{
+			computeClusterBounds(projection, nearPlane, farPlane);
+		}
+
+		m_lightBounds.clear();
+		m_lightBoundsIdx.clear();
+		for (u32 i = 0; i < lightCount; ++i)
+		{
+			LightBounds bounds;
+			if (computeLightBounds(view, projection, nearPlane, farPlane, lights[i], bounds))
+			{
+				m_lightBounds.push_back(bounds);
+				m_lightBoundsIdx.push_back(i);
+			}
+		}
+
+		// Threads own whole slices, so they never write the same cluster
+		std::fill(m_clusterCounts.begin(), m_clusterCounts.end(), 0);
+		const u32 visibleCount = static_cast<u32>(m_lightBounds.size());
+		const u32 maxThreadCount = m_config.m_maxThreadCount ? m_config.m_maxThreadCount : glm::max(std::thread::hardware_concurrency(), 1u);
+		const u32 threadCount = glm::min(glm::min(maxThreadCount, glm::max(visibleCount / s_minLightsPerThread, 1u)), m_config.m_slices);
+		if (threadCount <= 1)
+		{
+			m_droppedCount = binSlices(0, m_config.m_slices);
+		}
+		else
+		{
+			Vector<std::thread> threads;
+			Vector<u32> droppedCounts(threadCount, 0);
+			threads.reserve(threadCount);
+			const u32 slicesPerThread = (m_config.m_slices + threadCount - 1) / threadCount;
+			for (u32 t = 0; t < threadCount; ++t)
+			{
+				const u32 firstSlice = t * slicesPerThread;
+				const u32 lastSlice = glm::min(firstSlice + slicesPerThread, m_config.m_slices);
+				threads.emplace_back([this, t, firstSlice, lastSlice, &droppedCounts]()
+				{
+					droppedCounts[t] = binSlices(firstSlice, lastSlice);
+				});
+			}
+			m_droppedCount = 0;
+			for (u32 t = 0; t < threadCount; ++t)
+			{
+				threads[t].join();
+				m_droppedCount += droppedCounts[t];
+			}
+		}
+
+		// Compact the per cluster lists
+		u32 offset = 0;
+		for (u32 i = 0; i < getClusterCount(); ++i)
+		{
+			m_ranges[i].m_offset = offset;
+			m_ranges[i].m_count = m_clusterCounts[i];
+			offset += m_clusterCounts[i];
+		}
+		m_lightIndices.resize(offset);
+		for (u32 i = 0; i < getClusterCount(); ++i)
+		{
+			memcpy(m_lightIndices.data() + m_ranges[i].m_offset, &m_clusterLights[i * m_config.m_maxLightsPerCluster], m_ranges[i].m_count * sizeof(u32));
+		}
+		m_constants.m_grid.w = static_cast<f32>(lightCount);
+	}
+
+}
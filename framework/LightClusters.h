@@ -0,0 +1,121 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// Punctual light, laid out as LightData in assets/shaders/ClusteredLights.hlsli
+	struct ClusterLight
+	{
+		enum Type : u32
+		{
+			Point = 0,
+			Spot,
+		};
+
+		v3 m_pos = v3(0.0f);
+		f32 m_radius = 1.0f;
+		v3 m_color = v3(1.0f);
+		u32 m_type = Point;
+		v3 m_dir = v3(0.0f, -1.0f, 0.0f); // Spot only
+		f32 m_cosInnerCone = 1.0f; // Spot only
+		f32 m_cosOuterCone = 0.0f; // Spot only
+		u32 m_shadowView = s_noShadow; // First shadow view (see assets/shaders/Shadows.hlsli). Points have 6, one per cube face
+		f32 pad[2];
+
+		static constexpr u32 s_noShadow = 0xFFFFFFFF;
+	};
+
+	// Assigns lights to the clusters (froxels) of the view frustum: screen tiles split in depth slices that grow
+	// exponentially with the distance. The shader finds the cluster of a pixel and only evaluates its lights.
+	// Binning runs on the CPU, split by depth slices across threads, testing 4 clusters at a time with SSE. Doesn't touch
+	// the GPU, so it can run headless.
+	class LightClusters
+	{
+	public:
+
+		struct Config
+		{
+			u32 m_tilesX = 16;
+			u32 m_tilesY = 9;
+			u32 m_slices = 24;
+			u32 m_maxLightsPerCluster = 128; // Extra lights are dropped
+			u32 m_maxThreadCount = 0; // Threads binning the lights, 0 for one per hardware thread. Fewer are used with few lights
+		};
+
+		// Per cluster range in the light index list
+		struct Range
+		{
+			u32 m_offset;
+			u32 m_count;
+		};
+
+		// Layout of the cluster constants in ClusteredLights.hlsli
+		struct ShaderConstants
+		{
+			v4 m_grid; // Tiles x, tiles y, slices, light count
+			v4 m_scaleBias; // Pixel to tile scale (x, y), view depth to slice scale and bias: slice = log(depth) * z + w
+		};
+
+		void init(const Config& config);
+
+		// Bins the lights for a camera. Projection as built by Camera (perspective, looking down -Z in view space)
+		void build(const m4& view, const m4& projection, f32 nearPlane, f32 farPlane, u32 viewportWidth, u32 viewportHeight,
+			const ClusterLight* lights, u32 lightCount);
+
+		const Config& getConfig() const { return m_config; }
+		u32 getClusterCount() const { return m_config.m_tilesX * m_config.m_tilesY * m_config.m_slices; }
+		u32 getClusterIdx(u32 x, u32 y, u32 slice) const { return (slice * m_config.m_tilesY + y) * m_config.m_tilesX + x; }
+
+		const Vector<Range>& getRanges() const { return m_ranges; }
+		const Vector<u32>& getLightIndices() const { return m_lightIndices; }
+		const ShaderConstants& getShaderConstants() const { return m_constants; }
+
+		// Lights that didn't fit in m_maxLightsPerCluster in the last build
+		u32 getDroppedCount() const { return m_droppedCount; }
+
+		// World space sphere around the volume of a light. Spots are bounded by the sphere around their cone
+		static void getLightSphere(const ClusterLight& light, v3& outCenter, f32& outRadius);
+
+	private:
+
+		static constexpr u32 s_minLightsPerThread = 64;
+
+		// View space bounding sphere and cluster range of a light
+		struct LightBounds
+		{
+			v3 m_center;
+			f32 m_radius;
+			u32 m_minX, m_maxX;
+			u32 m_minY, m_maxY;
+			u32 m_minSlice, m_maxSlice;
+		};
+
+		void computeClusterBounds(const m4& projection, f32 nearPlane, f32 farPlane);
+		bool computeLightBounds(const m4& view, const m4& projection, f32 nearPlane, f32 farPlane, const ClusterLight& light, LightBounds& outBounds) const;
+		// Returns the lights dropped from full clusters
+		u32 binSlices(u32 firstSlice, u32 lastSlice);
+		u32 getSlice(f32 depth) const;
+
+		Config m_config;
+
+		// View space AABBs of the clusters, SoA and padded to 4 clusters per row for SSE
+		u32 m_rowStride = 0;
+		Vector<f32> m_minX, m_minY, m_minZ;
+		Vector<f32> m_maxX, m_maxY, m_maxZ;
+		m4 m_boundsProjection = m4(0.0f); // Projection the AABBs were computed for
+		f32 m_boundsNear = 0.0f;
+		f32 m_boundsFar = 0.0f;
+
+		Vector<LightBounds> m_lightBounds;
+		Vector<u32> m_lightBoundsIdx; // Light of each entry in m_lightBounds
+		Vector<u32> m_clusterLights; // m_maxLightsPerCluster entries per cluster
+		Vector<u32> m_clusterCounts;
+		u32 m_droppedCount = 0;
+
+		Vector<Range> m_ranges;
+		Vector<u32> m_lightIndices;
+		ShaderConstants m_constants;
+	};
+}
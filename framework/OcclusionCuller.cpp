@@ -0,0 +1,406 @@
+#include "framework/Types.h"
+#include "framework/OcclusionCuller.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <emmintrin.h>
+
+namespace framework
+{
+
+	static constexpr u32 s_minTrianglesPerThread = 1024;
+	static constexpr f32 s_depthTolerance = 1e-3f; // Relative. Keeps a surface from hiding the box around itself
+
+	bool OcclusionCuller::init(const Config& config)
+	{
+		if (config.m_width == 0 || config.m_height == 0 || config.m_width > 4096 || config.m_height > 4096)
+		{
+			printf("Invalid occlusion culling resolution %ux%u\n", config.m_width, config.m_height);
+			return false;
+		}
+		m_tilesX = (config.m_width + s_tileWidth - 1) / s_tileWidth;
+		m_tilesY = (config.m_height + s_tileHeight - 1) / s_tileHeight;
+		m_width = m_tilesX * s_tileWidth;
+		m_height = m_tilesY * s_tileHeight;
+		m_maxThreadCount = config.m_maxThreadCount ? config.m_maxThreadCount : glm::max(std::thread::hardware_concurrency(), 1u);
+
+		m_levels.clear();
+		m_levelWidths.clear();
+		m_levelHeights.clear();
+		u32 width = m_width;
+		u32 height = m_height;
+		while (true)
+		{
+			m_levels.emplace_back(width * height, 0.0f);
+			m_levelWidths.push_back(width);
+			m_levelHeights.push_back(height);
+			if (width == 1 && height == 1)
+			{
+				break;
+			}
+			width = (width + 1) / 2;
+			height = (height + 1) / 2;
+		}
+		return true;
+	}
+
+	void OcclusionCuller::beginFrame(const m4& viewProj)
+	{
+		m_viewProj = viewProj;
+		m_occluders.clear();
+		m_occluderFirstTriangle.clear();
+		m_occluderFirstTriangle.push_back(0);
+		m_stats = Stats();
+	}
+
+	void OcclusionCuller::addOccluder(const v3* positions, const void* indices, u32 indexCount, bool isIndexShort, const m4& model)
+	{
+		if (indexCount < 3)
+		{
+			return;
+		}
+		Occluder occluder;
+		occluder.m_positions = positions;
+		occluder.m_indices = indices;
+		occluder.m_indexCount = indexCount;
+		occluder.m_isIndexShort = isIndexShort;
+		occluder.m_modelViewProj = m_viewProj * model;
+		m_occluders.push_back(occluder);
+		m_occluderFirstTriangle.push_back(m_occluderFirstTriangle.back() + indexCount / 3);
+	}
+
+	void OcclusionCuller::addTriangle(const v4* clipPos, ThreadBins& bins, u32& outTriangleCount) const
+	{
+		v3 screen[3]; // Pixel coordinates and 1/w
+		for (u32 i = 0; i < 3; ++i)
+		{
+			const f32 invW = 1.0f / clipPos[i].w;
+			screen[i] = v3((clipPos[i].x * invW * 0.5f + 0.5f) * m_width, (0.5f - clipPos[i].y * invW * 0.5f) * m_height, invW);
+		}
+		f32 area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+		if (fabsf(area) < 1e-6f)
+		{
+			return;
+		}
+		// Both windings are occluders, double sided materials are common
+		if (area < 0.0f)
+		{
+			std::swap(screen[1], screen[2]);
+			area = -area;
+		}
+
+		// Pixels whose center is inside the bounds
+		const v2 minPos = glm::min(glm::min(v2(screen[0]), v2(screen[1])), v2(screen[2]));
+		const v2 maxPos = glm::max(glm::max(v2(screen[0]), v2(screen[1])), v2(screen[2]));
+		const f32 minX = ceilf(glm::clamp(minPos.x - 0.5f, 0.0f, static_cast<f32>(m_width)));
+		const f32 minY = ceilf(glm::clamp(minPos.y - 0.5f, 0.0f, static_cast<f32>(m_height)));
+		const f32 maxX = floorf(glm::clamp(maxPos.x - 0.5f, -1.0f, static_cast<f32>(m_width - 1)));
+		const f32 maxY = floorf(glm::clamp(maxPos.y - 0.5f, -1.0f, static_cast<f32>(m_height - 1)));
+		if (minX > maxX || minY > maxY)
+		{
+			return;
+		}
+
+		Triangle tri;
+		tri.m_origin = v2(screen[0]);
+		for (u32 i = 0; i < 3; ++i)
+		{
+			const v3& from = screen[i];
+			const v3& to = screen[(i + 1) % 3];
+			tri.m_edgeA[i] = from.y - to.y;
+			tri.m_edgeB[i] = to.x - from.x;
+			tri.m_edgeC[i] = tri.m_edgeA[i] * (tri.m_origin.x - from.x) + tri.m_edgeB[i] * (tri.m_origin.y - from.y);
+		}
+		const v3 d1 = screen[1] - screen[0];
+		const v3 d2 = screen[2] - screen[0];
+		tri.m_depthPlane = v3((d1.z * d2.y - d2.z * d1.y) / area, (d2.z * d1.x - d1.z * d2.x) / area, screen[0].z);
+		tri.m_minX = static_cast<u16>(minX);
+		tri.m_minY = static_cast<u16>(minY);
+		tri.m_maxX = static_cast<u16>(maxX);
+		tri.m_maxY = static_cast<u16>(maxY);
+
+		const u32 triIdx = static_cast<u32>(bins.m_triangles.size());
+		bins.m_triangles.push_back(tri);
+		for (u32 tileY = tri.m_minY / s_tileHeight; tileY <= tri.m_maxY / s_tileHeight; ++tileY)
+		{
+			for (u32 tileX = tri.m_minX / s_tileWidth; tileX <= tri.m_maxX / s_tileWidth; ++tileX)
+			{
+				bins.m_tiles[tileY * m_tilesX + tileX].push_back(triIdx);
+			}
+		}
+		outTriangleCount++;
+	}
+
+	void OcclusionCuller::setupTriangles(u32 firstTriangle, u32 lastTriangle, ThreadBins& bins, u32& outTriangleCount) const
+	{
+		outTriangleCount = 0;
+		u32 occluderIdx = static_cast<u32>(std::upper_bound(m_occluderFirstTriangle.begin(), m_occluderFirstTriangle.end(), firstTriangle) - m_occluderFirstTriangle.begin()) - 1;
+		for (u32 triangle = firstTriangle; triangle < lastTriangle; ++triangle)
+		{
+			while (triangle >= m_occluderFirstTriangle[occluderIdx + 1])
+			{
+				occluderIdx++;
+			}
+			const Occluder& occluder = m_occluders[occluderIdx];
+			const u32 firstIndex = (triangle - m_occluderFirstTriangle[occluderIdx]) * 3;
+			v4 clipPos[3];
+			u32 behindMask = 0;
+			for (u32 i = 0; i < 3; ++i)
+			{
+				const u32 vertexIdx = occluder.m_isIndexShort ? static_cast<const u16*>(occluder.m_indices)[firstIndex + i] : static_cast<const u32*>(occluder.m_indices)[firstIndex + i];
+				clipPos[i] = occluder.m_modelViewProj * v4(occluder.m_positions[vertexIdx], 1.0f);
+				behindMask |= (clipPos[i].w < s_nearW) ? (1u << i) : 0u;
+			}
+			if (behindMask == 0)
+			{
+				addTriangle(clipPos, bins, outTriangleCount);
+				continue;
+			}
+			if (behindMask == 7)
+			{
+				continue;
+			}
+
+			// Clip against the near w, the part in front is a triangle or a quad
+			v4 clipped[4];
+			u32 clippedCount = 0;
+			for (u32 i = 0; i < 3; ++i)
+			{
+				const v4& from = clipPos[i];
+				const v4& to = clipPos[(i + 1) % 3];
+				const bool isFromInside = from.w >= s_nearW;
+				const bool isToInside = to.w >= s_nearW;
+				if (isFromInside)
+				{
+					clipped[clippedCount++] = from;
+				}
+				if (isFromInside != isToInside)
+				{
+					// Always from the inside vertex, so a shared edge gives the same point in both triangles and they don't crack
+					const v4& inside = isFromInside ? from : to;
+					const v4& outside = isFromInside ? to : from;
+					clipped[clippedCount++] = glm::mix(inside, outside, (s_nearW - inside.w) / (outside.w - inside.w));
+				}
+			}
+			addTriangle(clipped, bins, outTriangleCount);
+			if (clippedCount == 4)
+			{
+				const v4 secondTriangle[3] = {clipped[0], clipped[2], clipped[3]};
+				addTriangle(secondTriangle, bins, outTriangleCount);
+			}
+		}
+	}
+
+	void OcclusionCuller::rasterizeTile(u32 tileIdx)
+	{
+		const u32 tileMinX = (tileIdx % m_tilesX) * s_tileWidth;
+		const u32 tileMinY = (tileIdx / m_tilesX) * s_tileHeight;
+		f32* depth = m_levels[0].data();
+		const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 zero = _mm_setzero_ps();
+		for (const ThreadBins& bins : m_threadBins)
+		{
+			for (u32 triIdx : bins.m_tiles[tileIdx])
+			{
+				const Triangle& tri = bins.m_triangles[triIdx];
+				const u32 minX = glm::max<u32>(tri.m_minX, tileMinX) & ~3u;
+				const u32 maxX = glm::min<u32>(tri.m_maxX, tileMinX + s_tileWidth - 1);
+				const u32 minY = glm::max<u32>(tri.m_minY, tileMinY);
+				const u32 maxY = glm::min<u32>(tri.m_maxY, tileMinY + s_tileHeight - 1);
+				const __m128 edgeA0 = _mm_set1_ps(tri.m_edgeA[0]);
+				const __m128 edgeA1 = _mm_set1_ps(tri.m_edgeA[1]);
+				const __m128 edgeA2 = _mm_set1_ps(tri.m_edgeA[2]);
+				const __m128 depthDx = _mm_set1_ps(tri.m_depthPlane.x);
+				for (u32 y = minY; y <= maxY; ++y)
+				{
+					const f32 pixelY = y + 0.5f - tri.m_origin.y;
+					const __m128 rowEdge0 = _mm_set1_ps(tri.m_edgeB[0] * pixelY + tri.m_edgeC[0]);
+					const __m128 rowEdge1 = _mm_set1_ps(tri.m_edgeB[1] * pixelY + tri.m_edgeC[1]);
+					const __m128 rowEdge2 = _mm_set1_ps(tri.m_edgeB[2] * pixelY + tri.m_edgeC[2]);
+					const __m128 rowDepth = _mm_set1_ps(tri.m_depthPlane.y * pixelY + tri.m_depthPlane.z);
+					f32* row = depth + y * m_width;
+					for (u32 x = minX; x <= maxX; x += 4)
+					{
+						const __m128 pixelX = _mm_add_ps(_mm_set1_ps(static_cast<f32>(x) - tri.m_origin.x), laneOffsets);
+						const __m128 edge0 = _mm_add_ps(_mm_mul_ps(edgeA0, pixelX), rowEdge0);
+						const __m128 edge1 = _mm_add_ps(_mm_mul_ps(edgeA1, pixelX), rowEdge1);
+						const __m128 edge2 = _mm_add_ps(_mm_mul_ps(edgeA2, pixelX), rowEdge2);
+						const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+						if (_mm_movemask_ps(inside) == 0)
+						{
+							continue;
+						}
+						// Keep the closest occluder, the largest 1/w
+						const __m128 triDepth = _mm_add_ps(_mm_mul_ps(depthDx, pixelX), rowDepth);
+						const __m128 oldDepth = _mm_loadu_ps(row + x);
+						const __m128 newDepth = _mm_or_ps(_mm_and_ps(inside, _mm_max_ps(oldDepth, triDepth)), _mm_andnot_ps(inside, oldDepth));
+						_mm_storeu_ps(row + x, newDepth);
+					}
+				}
+			}
+		}
+	}
+
+	void OcclusionCuller::buildHierarchy()
+	{
+		// Every texel keeps the farthest depth (smallest 1/w) of the texels it covers
+		for (u32 level = 1; level < static_cast<u32>(m_levels.size()); ++level)
+		{
+			const Vector<f32>& src = m_levels[level - 1];
+			Vector<f32>& dst = m_levels[level];
+			const u32 srcWidth = m_levelWidths[level - 1];
+			const u32 srcHeight = m_levelHeights[level - 1];
+			for (u32 y = 0; y < m_levelHeights[level]; ++y)
+			{
+				const u32 y0 = y * 2;
+				const u32 y1 = glm::min(y0 + 1, srcHeight - 1);
+				for (u32 x = 0; x < m_levelWidths[level]; ++x)
+				{
+					const u32 x0 = x * 2;
+					const u32 x1 = glm::min(x0 + 1, srcWidth - 1);
+					dst[y * m_levelWidths[level] + x] = glm::min(glm::min(src[y0 * srcWidth + x0], src[y0 * srcWidth + x1]),
+						glm::min(src[y1 * srcWidth + x0], src[y1 * srcWidth + x1]));
+				}
+			}
+		}
+	}
+
+	void OcclusionCuller::rasterize()
+	{
+		if (m_levels.empty())
+		{
+			return;
+		}
+		const u32 triangleCount = m_occluderFirstTriangle.back();
+		const u32 tileCount = m_tilesX * m_tilesY;
+		const u32 threadCount = glm::min(m_maxThreadCount, glm::max(triangleCount / s_minTrianglesPerThread, 1u));
+		m_threadBins.resize(threadCount);
+		for (ThreadBins& bins : m_threadBins)
+		{
+			bins.m_triangles.clear();
+			bins.m_tiles.resize(tileCount);
+			for (Vector<u32>& tile : bins.m_tiles)
+			{
+				tile.clear();
+			}
+		}
+		std::fill(m_levels[0].begin(), m_levels[0].end(), 0.0f);
+
+		Vector<u32> setupCounts(threadCount, 0);
+		if (threadCount <= 1)
+		{
+			setupTriangles(0, triangleCount, m_threadBins[0], setupCounts[0]);
+			for (u32 tileIdx = 0; tileIdx < tileCount; ++tileIdx)
+			{
+				rasterizeTile(tileIdx);
+			}
+		}
+		else
+		{
+			// Setup and binning, split by triangles. Each thread bins into its own lists
+			Vector<std::thread> threads;
+			threads.reserve(threadCount);
+			const u32 trianglesPerThread = (triangleCount + threadCount - 1) / threadCount;
+			for (u32 t = 0; t < threadCount; ++t)
+			{
+				const u32 firstTriangle = glm::min(t * trianglesPerThread, triangleCount);
+				const u32 lastTriangle = glm::min(firstTriangle + trianglesPerThread, triangleCount);
+				threads.emplace_back([this, t, firstTriangle, lastTriangle, &setupCounts]()
+				{
+					setupTriangles(firstTriangle, lastTriangle, m_threadBins[t], setupCounts[t]);
+				});
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+
+			// Rasterization, threads take whole tiles so they never write the same pixel
+			threads.clear();
+			std::atomic<u32> nextTile(0);
+			for (u32 t = 0; t < threadCount; ++t)
+			{
+				threads.emplace_back([this, tileCount, &nextTile]()
+				{
+					for (u32 tileIdx = nextTile++; tileIdx < tileCount; tileIdx = nextTile++)
+					{
+						rasterizeTile(tileIdx);
+					}
+				});
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		}
+		for (u32 count : setupCounts)
+		{
+			m_stats.m_occluderTriangles += count;
+		}
+
+		buildHierarchy();
+	}
+
+	bool OcclusionCuller::isVisible(const v3& boundsCenter, const v3& boundsExtents, const m4& model)
+	{
+		if (m_levels.empty())
+		{
+			return true;
+		}
+		m_stats.m_testedCount++;
+		const m4 modelViewProj = m_viewProj * model;
+		v2 minPos(FLT_MAX);
+		v2 maxPos(-FLT_MAX);
+		f32 maxDepth = 0.0f;
+		for (u32 i = 0; i < 8; ++i)
+		{
+			const v3 corner = boundsCenter + boundsExtents * v3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+			const v4 clipPos = modelViewProj * v4(corner, 1.0f);
+			if (clipPos.w < s_nearW)
+			{
+				return true;
+			}
+			const f32 invW = 1.0f / clipPos.w;
+			const v2 pos((clipPos.x * invW * 0.5f + 0.5f) * m_width, (0.5f - clipPos.y * invW * 0.5f) * m_height);
+			minPos = glm::min(minPos, pos);
+			maxPos = glm::max(maxPos, pos);
+			maxDepth = glm::max(maxDepth, invW);
+		}
+		if (maxPos.x < 0.0f || maxPos.y < 0.0f || minPos.x >= m_width || minPos.y >= m_height)
+		{
+			return true; // Off screen, left to frustum culling
+		}
+
+		// Pick the level where the rectangle covers at most 4x4 texels
+		const u32 minX = static_cast<u32>(glm::max(minPos.x, 0.0f));
+		const u32 minY = static_cast<u32>(glm::max(minPos.y, 0.0f));
+		const u32 maxX = static_cast<u32>(glm::min(maxPos.x, static_cast<f32>(m_width - 1)));
+		const u32 maxY = static_cast<u32>(glm::min(maxPos.y, static_cast<f32>(m_height - 1)));
+		u32 level = 0;
+		while (level + 1 < static_cast<u32>(m_levels.size()) && ((maxX >> level) - (minX >> level) > 3 || (maxY >> level) - (minY >> level) > 3))
+		{
+			level++;
+		}
+
+		const Vector<f32>& hierarchy = m_levels[level];
+		const u32 levelWidth = m_levelWidths[level];
+		const f32 testDepth = maxDepth * (1.0f + s_depthTolerance);
+		for (u32 y = minY >> level; y <= (maxY >> level); ++y)
+		{
+			for (u32 x = minX >> level; x <= (maxX >> level); ++x)
+			{
+				if (hierarchy[y * levelWidth + x] <= testDepth)
+				{
+					return true;
+				}
+			}
+		}
+		m_stats.m_culledCount++;
+		return false;
+	}
+
+}
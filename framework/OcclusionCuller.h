@@ -0,0 +1,112 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// Software occlusion culling. A few large occluders are rasterized on the CPU into a small depth buffer, then a
+	// hierarchical depth (farthest depth of each 2x2 block, level by level) lets a bounding box be tested against a handful
+	// of texels before its draw is submitted.
+	// Depth is stored as 1/w (linear in screen space, 0 is empty), so it doesn't depend on the depth range of the projection.
+	// Triangles are set up and binned to screen tiles in parallel, then threads rasterize whole tiles, 4 pixels per SSE step.
+	// Every frame:
+	//  - beginFrame with the camera view projection
+	//  - addOccluder for the selected occluders
+	//  - rasterize
+	//  - isVisible per object
+	class OcclusionCuller
+	{
+	public:
+
+		static constexpr u32 s_tileWidth = 32;
+		static constexpr u32 s_tileHeight = 16;
+
+		struct Config
+		{
+			u32 m_width = 320; // Rounded up to whole tiles
+			u32 m_height = 176;
+			u32 m_maxThreadCount = 0; // 0 for one per hardware thread. Fewer are used with few triangles
+		};
+
+		struct Stats
+		{
+			u32 m_occluderTriangles = 0; // Rasterized, after clipping
+			u32 m_testedCount = 0;
+			u32 m_culledCount = 0;
+			f32 getCulledPercentage() const { return m_testedCount ? (100.0f * m_culledCount) / m_testedCount : 0.0f; }
+		};
+
+		bool init(const Config& config);
+
+		void beginFrame(const m4& viewProj);
+
+		// Triangle list. The data must stay alive until rasterize returns. Indices are relative to positions
+		void addOccluder(const v3* positions, const void* indices, u32 indexCount, bool isIndexShort, const m4& model);
+
+		void rasterize();
+
+		// Bounding box in model space. False when the box is behind the occluders. Boxes crossing the near plane are visible
+		bool isVisible(const v3& boundsCenter, const v3& boundsExtents, const m4& model);
+
+		const Stats& getStats() const { return m_stats; }
+		u32 getWidth() const { return m_width; }
+		u32 getHeight() const { return m_height; }
+		// Rasterized 1/w, row by row
+		const Vector<f32>& getDepth() const { return m_levels[0]; }
+		// Depth hierarchy, level 0 is the depth buffer
+		u32 getLevelCount() const { return static_cast<u32>(m_levels.size()); }
+		const Vector<f32>& getLevel(u32 level) const { return m_levels[level]; }
+		u32 getLevelWidth(u32 level) const { return m_levelWidths[level]; }
+		u32 getLevelHeight(u32 level) const { return m_levelHeights[level]; }
+
+	private:
+
+		struct Occluder
+		{
+			const v3* m_positions = nullptr;
+			const void* m_indices = nullptr;
+			u32 m_indexCount = 0;
+			bool m_isIndexShort = false;
+			m4 m_modelViewProj = m4(1.0f);
+		};
+
+		// Edge functions and depth plane in pixel coordinates, relative to the first vertex so they stay accurate far off screen
+		struct Triangle
+		{
+			v2 m_origin = v2(0.0f);
+			f32 m_edgeA[3];
+			f32 m_edgeB[3];
+			f32 m_edgeC[3]; // At the origin
+			v3 m_depthPlane = v3(0.0f); // 1/w = x * dx + y * dy + z
+			u16 m_minX, m_minY, m_maxX, m_maxY; // Covered pixels
+		};
+
+		struct ThreadBins
+		{
+			Vector<Triangle> m_triangles;
+			Vector<Vector<u32>> m_tiles; // Triangles per tile
+		};
+
+		void setupTriangles(u32 firstTriangle, u32 lastTriangle, ThreadBins& bins, u32& outTriangleCount) const;
+		void addTriangle(const v4* clipPos, ThreadBins& bins, u32& outTriangleCount) const;
+		void rasterizeTile(u32 tileIdx);
+		void buildHierarchy();
+
+		static constexpr f32 s_nearW = 0.01f; // Clip space w where occluders are clipped and boxes stop being tested
+
+		u32 m_width = 0;
+		u32 m_height = 0;
+		u32 m_maxThreadCount = 0;
+		u32 m_tilesX = 0;
+		u32 m_tilesY = 0;
+		m4 m_viewProj = m4(1.0f);
+		Vector<Occluder> m_occluders;
+		Vector<u32> m_occluderFirstTriangle; // Prefix sum of the triangle counts, to split the work by triangles
+		Vector<ThreadBins> m_threadBins;
+		Vector<Vector<f32>> m_levels; // Level 0 is the depth buffer, every level halves the size
+		Vector<u32> m_levelWidths;
+		Vector<u32> m_levelHeights;
+		Stats m_stats;
+	};
+}
@@ -54,5 +54,44 @@ namespace framework
 		return getAssetPath(String(relPath));
 	}
 
+	static s32 getHexValue(char c)
+	{
+		if (c >= '0' && c <= '9')
+		{
+			return c - '0';
+		}
+		if (c >= 'a' && c <= 'f')
+		{
+			return c - 'a' + 10;
+		}
+		if (c >= 'A' && c <= 'F')
+		{
+			return c - 'A' + 10;
+		}
+		return -1;
+	}
+
+	String Paths::decodeUri(const String& uri)
+	{
+		String decoded;
+		decoded.reserve(uri.size());
+		for (size_t i = 0; i < uri.size(); ++i)
+		{
+			// Malformed escapes are kept as they are
+			const s32 high = (uri[i] == '%' && i + 2 < uri.size()) ? getHexValue(uri[i + 1]) : -1;
+			const s32 low = high >= 0 ? getHexValue(uri[i + 2]) : -1;
+			if (low >= 0)
+			{
+				decoded += static_cast<char>(high * 16 + low);
+				i += 2;
+			}
+			else
+			{
+				decoded += uri[i];
+			}
+		}
+		return decoded;
+	}
+
 }
 ////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
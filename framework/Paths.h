@@ -15,6 +15,9 @@ namespace framework
 		static String getAssetPath(const String& relPath);
 		static String getAssetPath(const char* relPath);
 
+		// Percent-decodes a relative URI, e.g. glTF buffer uris ("My%20Model.bin" is "My Model.bin")
+		static String decodeUri(const String& uri);
+
 		static String getWorkingDir()
 		{
 			return ms_workingDir;
@@ -0,0 +1,277 @@
+#include "framework/Types.h"
+#include "framework/RenderGraph.h"
+
+#include <cstdio>
+
+namespace framework
+{
+
+	void RenderGraph::reset()
+	{
+		m_textures.clear();
+		m_versions.clear();
+		m_passes.clear();
+		m_passOrder.clear();
+		m_physicalDescs.clear();
+		m_report = Report();
+	}
+
+	RenderGraph::ResourceHandle RenderGraph::addTexture(const char* name, const TextureDesc& desc, bool isImported)
+	{
+		Texture texture;
+		texture.m_name = name;
+		texture.m_desc = desc;
+		texture.m_isImported = isImported;
+		texture.m_latestVersion = static_cast<ResourceHandle>(m_versions.size());
+		Version version;
+		version.m_texture = static_cast<u32>(m_textures.size());
+		m_textures.push_back(texture);
+		m_versions.push_back(version);
+		return texture.m_latestVersion;
+	}
+
+	RenderGraph::ResourceHandle RenderGraph::createTexture(const char* name, const TextureDesc& desc)
+	{
+		return addTexture(name, desc, false);
+	}
+
+	RenderGraph::ResourceHandle RenderGraph::importTexture(const char* name, const TextureDesc& desc)
+	{
+		return addTexture(name, desc, true);
+	}
+
+	u32 RenderGraph::addPass(const char* name, Execute execute)
+	{
+		Pass pass;
+		pass.m_name = name;
+		pass.m_execute = std::move(execute);
+		m_passes.push_back(std::move(pass));
+		return static_cast<u32>(m_passes.size()) - 1;
+	}
+
+	void RenderGraph::read(u32 pass, ResourceHandle handle)
+	{
+		m_passes[pass].m_reads.push_back(handle);
+	}
+
+	RenderGraph::ResourceHandle RenderGraph::write(u32 pass, ResourceHandle handle)
+	{
+		Texture& texture = m_textures[m_versions[handle].m_texture];
+		if (texture.m_latestVersion != handle)
+		{
+			printf("Pass %s writes an old version of %s\n", m_passes[pass].m_name.c_str(), texture.m_name.c_str());
+			return s_invalidHandle;
+		}
+		Version version;
+		version.m_texture = m_versions[handle].m_texture;
+		version.m_producer = pass;
+		texture.m_latestVersion = static_cast<ResourceHandle>(m_versions.size());
+		m_versions[handle].m_nextVersion = texture.m_latestVersion;
+		m_versions.push_back(version);
+		m_passes[pass].m_writes.push_back(handle);
+		return texture.m_latestVersion;
+	}
+
+	bool RenderGraph::compile()
+	{
+		const u32 passCount = static_cast<u32>(m_passes.size());
+		m_passOrder.clear();
+		m_physicalDescs.clear();
+		m_report = Report();
+
+		// Keep the passes that write imported textures and the ones they depend on
+		Vector<u32> stack;
+		for (u32 i = 0; i < passCount; ++i)
+		{
+			Pass& pass = m_passes[i];
+			pass.m_isCulled = true;
+			for (ResourceHandle handle : pass.m_writes)
+			{
+				if (m_textures[m_versions[handle].m_texture].m_isImported && pass.m_isCulled)
+				{
+					pass.m_isCulled = false;
+					stack.push_back(i);
+				}
+			}
+		}
+		while (!stack.empty())
+		{
+			const Pass& pass = m_passes[stack.back()];
+			stack.pop_back();
+			for (const Vector<ResourceHandle>* handles : {&pass.m_reads, &pass.m_writes})
+			{
+				for (ResourceHandle handle : *handles)
+				{
+					const u32 producer = m_versions[handle].m_producer;
+					if (producer != s_invalidIndex && m_passes[producer].m_isCulled)
+					{
+						m_passes[producer].m_isCulled = false;
+						stack.push_back(producer);
+					}
+				}
+			}
+		}
+
+		// A version comes after its producer, and the next version after the passes reading this one
+		Vector<Vector<u32>> successors(passCount);
+		Vector<u32> dependencyCounts(passCount, 0);
+		u32 keptCount = 0;
+		auto addDependency = [&](u32 from, u32 to)
+		{
+			if (from != s_invalidIndex && to != s_invalidIndex && from != to && !m_passes[from].m_isCulled)
+			{
+				successors[from].push_back(to);
+				dependencyCounts[to]++;
+			}
+		};
+		for (u32 i = 0; i < passCount; ++i)
+		{
+			const Pass& pass = m_passes[i];
+			if (pass.m_isCulled)
+			{
+				continue;
+			}
+			keptCount++;
+			for (ResourceHandle handle : pass.m_reads)
+			{
+				addDependency(m_versions[handle].m_producer, i);
+				const ResourceHandle nextVersion = m_versions[handle].m_nextVersion;
+				if (nextVersion != s_invalidHandle)
+				{
+					const u32 nextWriter = m_versions[nextVersion].m_producer;
+					if (!m_passes[nextWriter].m_isCulled)
+					{
+						addDependency(i, nextWriter);
+					}
+				}
+			}
+			for (ResourceHandle handle : pass.m_writes)
+			{
+				addDependency(m_versions[handle].m_producer, i);
+			}
+		}
+
+		// Topological order, the first declared pass of the ready ones goes first
+		Vector<u8> isScheduled(passCount, 0);
+		while (m_passOrder.size() < keptCount)
+		{
+			u32 next = s_invalidIndex;
+			for (u32 i = 0; i < passCount && next == s_invalidIndex; ++i)
+			{
+				if (!m_passes[i].m_isCulled && !isScheduled[i] && dependencyCounts[i] == 0)
+				{
+					next = i;
+				}
+			}
+			if (next == s_invalidIndex)
+			{
+				printf("Render graph has a dependency cycle\n");
+				m_passOrder.clear();
+				return false;
+			}
+			isScheduled[next] = 1;
+			m_passOrder.push_back(next);
+			for (u32 successor : successors[next])
+			{
+				dependencyCounts[successor]--;
+			}
+		}
+
+		// Lifetimes, as positions in the order
+		for (Texture& texture : m_textures)
+		{
+			texture.m_physical = s_invalidIndex;
+			texture.m_firstUse = s_invalidIndex;
+			texture.m_lastUse = 0;
+		}
+		for (u32 position = 0; position < static_cast<u32>(m_passOrder.size()); ++position)
+		{
+			const Pass& pass = m_passes[m_passOrder[position]];
+			for (const Vector<ResourceHandle>* handles : {&pass.m_reads, &pass.m_writes})
+			{
+				for (ResourceHandle handle : *handles)
+				{
+					Texture& texture = m_textures[m_versions[handle].m_texture];
+					texture.m_firstUse = glm::min(texture.m_firstUse, position);
+					texture.m_lastUse = glm::max(texture.m_lastUse, position);
+				}
+			}
+		}
+
+		// Transient textures by first use take the first physical texture like them that is free by then
+		Vector<u32> transients;
+		for (u32 i = 0; i < static_cast<u32>(m_textures.size()); ++i)
+		{
+			if (!m_textures[i].m_isImported && m_textures[i].m_firstUse != s_invalidIndex)
+			{
+				transients.push_back(i);
+			}
+		}
+		std::stable_sort(transients.begin(), transients.end(), [this](u32 a, u32 b)
+		{
+			return m_textures[a].m_firstUse < m_textures[b].m_firstUse;
+		});
+		Vector<u32> physicalLastUses;
+		for (u32 textureIdx : transients)
+		{
+			Texture& texture = m_textures[textureIdx];
+			for (u32 i = 0; i < static_cast<u32>(m_physicalDescs.size()) && texture.m_physical == s_invalidIndex; ++i)
+			{
+				if (m_physicalDescs[i] == texture.m_desc && physicalLastUses[i] < texture.m_firstUse)
+				{
+					texture.m_physical = i;
+				}
+			}
+			if (texture.m_physical == s_invalidIndex)
+			{
+				texture.m_physical = static_cast<u32>(m_physicalDescs.size());
+				m_physicalDescs.push_back(texture.m_desc);
+				physicalLastUses.push_back(0);
+				m_report.m_physicalBytes += texture.m_desc.getSize();
+			}
+			physicalLastUses[texture.m_physical] = texture.m_lastUse;
+			m_report.m_transientBytes += texture.m_desc.getSize();
+		}
+
+		m_report.m_passCount = passCount;
+		m_report.m_culledPassCount = passCount - keptCount;
+		m_report.m_transientCount = static_cast<u32>(transients.size());
+		m_report.m_physicalCount = static_cast<u32>(m_physicalDescs.size());
+		return true;
+	}
+
+	void RenderGraph::execute() const
+	{
+		for (u32 passIdx : m_passOrder)
+		{
+			if (m_passes[passIdx].m_execute)
+			{
+				m_passes[passIdx].m_execute();
+			}
+		}
+	}
+
+	u32 RenderGraph::getPhysicalIndex(ResourceHandle handle) const
+	{
+		return m_textures[m_versions[handle].m_texture].m_physical;
+	}
+
+	void RenderGraph::printReport() const
+	{
+		printf("Render graph: %u passes (%u culled), %u transient textures in %u physical ones, %.2f MB instead of %.2f MB\n",
+			m_report.m_passCount, m_report.m_culledPassCount, m_report.m_transientCount, m_report.m_physicalCount,
+			static_cast<f64>(m_report.m_physicalBytes) / (1024.0 * 1024.0), static_cast<f64>(m_report.m_transientBytes) / (1024.0 * 1024.0));
+		for (u32 passIdx : m_passOrder)
+		{
+			printf("  %s\n", m_passes[passIdx].m_name.c_str());
+		}
+		for (const Texture& texture : m_textures)
+		{
+			if (texture.m_physical != s_invalidIndex)
+			{
+				printf("  %s -> physical %u, passes [%u, %u]\n", texture.m_name.c_str(), texture.m_physical, texture.m_firstUse, texture.m_lastUse);
+			}
+		}
+	}
+
+}
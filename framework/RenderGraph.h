@@ -0,0 +1,133 @@
+#pragma once
+
+#include "framework/Types.h"
+
+#include <functional>
+
+namespace framework
+{
+
+	// Frame described as passes that declare the textures they read and write. compile() culls the passes nothing that
+	// leaves the frame depends on, orders the rest by their dependencies (declaration order otherwise) and assigns the
+	// transient textures to physical ones. D3D11 can't place resources in shared memory, so transient textures with the
+	// same description whose lifetimes don't overlap share one physical texture instead. No D3D here, RenderGraphTargets
+	// creates the physical textures.
+	// Writing a texture makes a new version of it: passes read versions, so the order follows the data. Writes modify the
+	// version they are given (e.g. depth test against a pre-pass), and only its latest version can be written.
+	class RenderGraph
+	{
+	public:
+
+		using ResourceHandle = u32; // A version of a texture
+		using Execute = std::function<void()>;
+
+		static constexpr ResourceHandle s_invalidHandle = 0xFFFFFFFF;
+		static constexpr u32 s_invalidIndex = 0xFFFFFFFF;
+
+		enum TextureKind : u32
+		{
+			ColorTarget = 0,
+			DepthTarget
+		};
+
+		struct TextureDesc
+		{
+			u32 m_width = 0;
+			u32 m_height = 0;
+			u32 m_format = 0; // DXGI_FORMAT, kept as u32 so the graph has no D3D dependency
+			u32 m_texelSize = 4; // Bytes, for the memory report
+			TextureKind m_kind = ColorTarget;
+
+			bool operator==(const TextureDesc& other) const
+			{
+				return m_width == other.m_width && m_height == other.m_height && m_format == other.m_format && m_kind == other.m_kind;
+			}
+			u64 getSize() const { return static_cast<u64>(m_width) * m_height * m_texelSize; }
+		};
+
+		struct Report
+		{
+			u32 m_passCount = 0;
+			u32 m_culledPassCount = 0;
+			u32 m_transientCount = 0; // Used by the passes that run
+			u32 m_physicalCount = 0;
+			u64 m_transientBytes = 0; // One texture per transient one
+			u64 m_physicalBytes = 0;
+
+			u64 getSavedBytes() const { return m_transientBytes - m_physicalBytes; }
+		};
+
+		// Forgets passes and textures, to describe the next frame
+		void reset();
+
+		ResourceHandle createTexture(const char* name, const TextureDesc& desc);
+
+		// Lives outside the graph (e.g. the back buffer). It isn't aliased and the passes writing it are never culled
+		ResourceHandle importTexture(const char* name, const TextureDesc& desc);
+
+		u32 addPass(const char* name, Execute execute);
+
+		void read(u32 pass, ResourceHandle handle);
+
+		// Returns the new version, s_invalidHandle when handle isn't the latest one
+		ResourceHandle write(u32 pass, ResourceHandle handle);
+
+		// False with a dependency cycle
+		bool compile();
+
+		// Passes that weren't culled, in order
+		void execute() const;
+
+		// After compile
+		const Vector<u32>& getPassOrder() const { return m_passOrder; }
+		bool isPassCulled(u32 pass) const { return m_passes[pass].m_isCulled; }
+		const char* getPassName(u32 pass) const { return m_passes[pass].m_name.c_str(); }
+		u32 getPassCount() const { return static_cast<u32>(m_passes.size()); }
+		// s_invalidIndex for imported textures and textures no pass that runs uses
+		u32 getPhysicalIndex(ResourceHandle handle) const;
+		u32 getPhysicalCount() const { return static_cast<u32>(m_physicalDescs.size()); }
+		const TextureDesc& getPhysicalDesc(u32 physicalIdx) const { return m_physicalDescs[physicalIdx]; }
+		const TextureDesc& getDesc(ResourceHandle handle) const { return m_textures[m_versions[handle].m_texture].m_desc; }
+		const Report& getReport() const { return m_report; }
+
+		void printReport() const;
+
+	private:
+
+		struct Texture
+		{
+			String m_name;
+			TextureDesc m_desc;
+			bool m_isImported = false;
+			ResourceHandle m_latestVersion = s_invalidHandle;
+			u32 m_physical = s_invalidIndex;
+			u32 m_firstUse = s_invalidIndex; // Position in m_passOrder
+			u32 m_lastUse = 0;
+		};
+
+		struct Version
+		{
+			u32 m_texture = 0;
+			u32 m_producer = s_invalidIndex; // Pass that wrote it, none for the first version
+			ResourceHandle m_nextVersion = s_invalidHandle;
+		};
+
+		struct Pass
+		{
+			String m_name;
+			Execute m_execute;
+			Vector<ResourceHandle> m_reads;
+			Vector<ResourceHandle> m_writes; // Versions it modifies, not the ones it makes
+			bool m_isCulled = false;
+		};
+
+		ResourceHandle addTexture(const char* name, const TextureDesc& desc, bool isImported);
+
+		Vector<Texture> m_textures;
+		Vector<Version> m_versions;
+		Vector<Pass> m_passes;
+		Vector<u32> m_passOrder;
+		Vector<TextureDesc> m_physicalDescs;
+		Report m_report;
+	};
+}
@@ -5,7 +5,9 @@
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #define TINYGLTF_NO_INCLUDE_STB_IMAGE
-//#define TINYGLTF_NO_EXTERNAL_IMAGE 
+#define TINYGLTF_NO_BINARY_CHUNK_COPY // GLB binary chunks are read from the mapped file (see GltfScene::registerBuffers)
+#define TINYGLTF_NO_EXTERNAL_BUFFER // External .bin files are streamed by GltfBufferReader
+#define TINYGLTF_NO_EXTERNAL_IMAGE // Images are decoded on demand, only when there is no cooked version (see GltfScene::loadImage)
 #include "external/tinygltf/tiny_gltf.h"
 #pragma warning(default:4996)
 
@@ -449,16 +451,21 @@ namespace framework
 	{
 		String absPath = Paths::getAssetPath(srcRelPath);
 		UniquePtr<char[]> hlslSrc = FileUtils::loadFileContent(absPath.c_str());
-		size_t srcSize = strlen(hlslSrc.get());
 		if (!hlslSrc)
 		{
 			return false;
 		}
+		// Includes are resolved relative to the shader file
+		return createGraphicsPipeline(device, hlslSrc.get(), strlen(hlslSrc.get()), entryVS, entryFS, vertexAttributes, vertexAttribCount, absPath.c_str());
+	}
+
+	bool ShaderPipeline::createGraphicsPipeline(ID3D11Device* device, const char* src, const size_t srcSize, const char* entryVS, const char* entryFS, D3D11_INPUT_ELEMENT_DESC* vertexAttributes, u32 vertexAttribCount, const char* srcAbsPath)
+	{
 		ID3DBlob* errorMSG = nullptr;
 		// Load vertex shader
 		{
 			ID3DBlob* vertexShaderBlob;
-			HRESULT res = D3DCompile(hlslSrc.get(), srcSize, NULL, NULL, NULL, entryVS, "vs_5_0", 0, 0, &vertexShaderBlob, &errorMSG);
+			HRESULT res = D3DCompile(src, srcSize, srcAbsPath, NULL, srcAbsPath ? D3D_COMPILE_STANDARD_FILE_INCLUDE : NULL, entryVS, "vs_5_0", 0, 0, &vertexShaderBlob, &errorMSG);
 			if (FAILED(res))
 			{
 				OutputDebugStringA((char*)errorMSG->GetBufferPointer());
@@ -470,17 +477,21 @@ namespace framework
 				vertexShaderBlob->Release();
 				return false;
 			}
-			res = device->CreateInputLayout(vertexAttributes, vertexAttribCount, vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), &m_layout);
-			if (FAILED(res))
+			if (vertexAttribCount > 0)
 			{
-				return false;
+				res = device->CreateInputLayout(vertexAttributes, vertexAttribCount, vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), &m_layout);
+				if (FAILED(res))
+				{
+					return false;
+				}
 			}
 		}
 
-		// Load Fragment/Pixel shader
+		// Load Fragment/Pixel shader. Depth only pipelines have none
+		if (entryFS)
 		{
 			ID3DBlob* pixelShaderBlob;
-			HRESULT res = D3DCompile(hlslSrc.get(), srcSize, NULL, NULL, NULL, "mainFS", "ps_5_0", 0, 0, &pixelShaderBlob, &errorMSG);
+			HRESULT res = D3DCompile(src, srcSize, srcAbsPath, NULL, srcAbsPath ? D3D_COMPILE_STANDARD_FILE_INCLUDE : NULL, entryFS, "ps_5_0", 0, 0, &pixelShaderBlob, &errorMSG);
 			if (FAILED(res))
 			{
 				OutputDebugStringA((char*)errorMSG->GetBufferPointer());
@@ -497,66 +508,106 @@ namespace framework
 		return true;
 	}
 
-	bool ShaderPipeline::createGraphicsPipeline(ID3D11Device* device, const char* src, const size_t srcSize, const char* entryVS, const char* entryFS, D3D11_INPUT_ELEMENT_DESC* vertexAttributes, u32 vertexAttribCount)
+	void ShaderPipeline::bind(ID3D11DeviceContext* ctx)
+	{
+		ctx->IASetInputLayout(m_layout);
+		ctx->VSSetShader(m_vertexShader, nullptr, 0);
+		ctx->PSSetShader(m_fragmentShader, nullptr, 0);
+	}
+
+	// -----------------------------------------------------------------------------------------
+
+	ComputePipeline::~ComputePipeline()
+	{
+		if (m_computeShader)
+		{
+			m_computeShader->Release();
+		}
+	}
+
+	bool ComputePipeline::loadComputePipeline(ID3D11Device* device, const char* srcRelPath, const char* entryCS)
+	{
+		String absPath = Paths::getAssetPath(srcRelPath);
+		UniquePtr<char[]> hlslSrc = FileUtils::loadFileContent(absPath.c_str());
+		if (!hlslSrc)
+		{
+			return false;
+		}
+		return createComputePipeline(device, hlslSrc.get(), strlen(hlslSrc.get()), entryCS, absPath.c_str());
+	}
+
+	bool ComputePipeline::createComputePipeline(ID3D11Device* device, const char* src, const size_t srcSize, const char* entryCS, const char* srcAbsPath)
 	{
 		ID3DBlob* errorMSG = nullptr;
-		// Load vertex shader
+		ID3DBlob* computeShaderBlob;
+		HRESULT res = D3DCompile(src, srcSize, srcAbsPath, NULL, srcAbsPath ? D3D_COMPILE_STANDARD_FILE_INCLUDE : NULL, entryCS, "cs_5_0", 0, 0, &computeShaderBlob, &errorMSG);
+		if (FAILED(res))
 		{
-			ID3DBlob* vertexShaderBlob;
-			HRESULT res = D3DCompile(src, srcSize, NULL, NULL, NULL, entryVS, "vs_5_0", 0, 0, &vertexShaderBlob, &errorMSG);
-			if (FAILED(res))
-			{
-				OutputDebugStringA((char*)errorMSG->GetBufferPointer());
-				errorMSG->Release();
-				return false;
-			}
-			if (device->CreateVertexShader(vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), NULL, &m_vertexShader) != S_OK)
-			{
-				vertexShaderBlob->Release();
-				return false;
-			}
-			res = device->CreateInputLayout(vertexAttributes, vertexAttribCount, vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(), &m_layout);
-			if (FAILED(res))
-			{
-				return false;
-			}
+			OutputDebugStringA((char*)errorMSG->GetBufferPointer());
+			errorMSG->Release();
+			return false;
 		}
+		res = device->CreateComputeShader(computeShaderBlob->GetBufferPointer(), computeShaderBlob->GetBufferSize(), NULL, &m_computeShader);
+		computeShaderBlob->Release();
+		return res == S_OK;
+	}
+
+	void ComputePipeline::bind(ID3D11DeviceContext* ctx)
+	{
+		ctx->CSSetShader(m_computeShader, nullptr, 0);
+	}
+
+	// -----------------------------------------------------------------------------------------
 
-		// Load Fragment/Pixel shader
+	bool RenderGraphTargets::update(ID3D11Device* device, const RenderGraph& graph)
+	{
+		const u32 physicalCount = graph.getPhysicalCount();
+		m_descs.resize(physicalCount);
+		m_renderTargets.resize(physicalCount);
+		m_depthAttachments.resize(physicalCount);
+		for (u32 i = 0; i < physicalCount; ++i)
 		{
-			ID3DBlob* pixelShaderBlob;
-			HRESULT res = D3DCompile(src, srcSize, NULL, NULL, NULL, "mainFS", "ps_5_0", 0, 0, &pixelShaderBlob, &errorMSG);
-			if (FAILED(res))
+			const RenderGraph::TextureDesc& desc = graph.getPhysicalDesc(i);
+			if ((m_renderTargets[i] || m_depthAttachments[i]) && m_descs[i] == desc)
 			{
-				OutputDebugStringA((char*)errorMSG->GetBufferPointer());
-				errorMSG->Release();
-				return false;
+				continue;
 			}
-			if (device->CreatePixelShader(pixelShaderBlob->GetBufferPointer(), pixelShaderBlob->GetBufferSize(), NULL, &m_fragmentShader) != S_OK)
+			m_descs[i] = desc;
+			m_renderTargets[i].reset();
+			m_depthAttachments[i].reset();
+			const DXGI_FORMAT format = static_cast<DXGI_FORMAT>(desc.m_format);
+			if (desc.m_kind == RenderGraph::DepthTarget)
 			{
-				pixelShaderBlob->Release();
-				return false;
+				m_depthAttachments[i] = std::make_unique<DepthAttachment>();
+				if (!RenderResources::createDepthAttachment(device, desc.m_width, desc.m_height, format, *m_depthAttachments[i], true))
+				{
+					m_depthAttachments[i].reset();
+					return false;
+				}
+			}
+			else
+			{
+				m_renderTargets[i] = std::make_unique<RenderTarget>();
+				if (!RenderResources::createRenderTarget(device, desc.m_width, desc.m_height, format, *m_renderTargets[i]))
+				{
+					m_renderTargets[i].reset();
+					return false;
+				}
 			}
-			pixelShaderBlob->Release();
 		}
 		return true;
 	}
 
-	void ShaderPipeline::bind(ID3D11DeviceContext* ctx)
+	RenderTarget* RenderGraphTargets::getRenderTarget(const RenderGraph& graph, RenderGraph::ResourceHandle handle) const
 	{
-		if (m_layout)
-		{
-			ctx->IASetInputLayout(m_layout);
-		}
+		const u32 physicalIdx = graph.getPhysicalIndex(handle);
+		return physicalIdx < m_renderTargets.size() ? m_renderTargets[physicalIdx].get() : nullptr;
+	}
 
-		if (m_vertexShader)
-		{
-			ctx->VSSetShader(m_vertexShader, nullptr, 0);
-		}
-		if (m_fragmentShader)
-		{
-			ctx->PSSetShader(m_fragmentShader, nullptr, 0);
-		}
+	DepthAttachment* RenderGraphTargets::getDepthAttachment(const RenderGraph& graph, RenderGraph::ResourceHandle handle) const
+	{
+		const u32 physicalIdx = graph.getPhysicalIndex(handle);
+		return physicalIdx < m_depthAttachments.size() ? m_depthAttachments[physicalIdx].get() : nullptr;
 	}
 
 	// -----------------------------------------------------------------------------------------
@@ -574,25 +625,57 @@ namespace framework
 		return true;
 	}
 
-	bool RenderResources::loadTexture2D(ID3D11Device* device, ID3D11DeviceContext* ctx, const char* fileRelPath, DXGI_FORMAT format, Texture2D& outTexture)
+	bool RenderResources::loadTexture2D(ID3D11Device* device, ID3D11DeviceContext* ctx, const char* fileRelPath, DXGI_FORMAT format, Texture2D& outTexture, MipGenerator::Filter mipFilter, u32 downscaleLog2)
 	{
 		String absPath(Paths::getAssetPath(fileRelPath));
-		s32 x, y, n;
-		static constexpr u32 s_bytesPerTexel = 4;
-		unsigned char* data = stbi_load(absPath.c_str(), &x, &y, &n, s_bytesPerTexel);
+		MappedFile file;
+		if (!file.open(absPath.c_str()))
+		{
+			printf("Failed to load resource %s", fileRelPath);
+			return false;
+		}
+
+		// Pre-cooked containers are created straight from the mapped file
+		if (TextureFile::isContainer(file.getData(), file.getSize()))
+		{
+			TextureLevels levels;
+			if (!TextureFile::parse(file.getData(), file.getSize(), levels))
+			{
+				printf("Failed to load resource %s", fileRelPath);
+				return false;
+			}
+			if (isFormatSRGB(format))
+			{
+				levels.m_format = TextureFile::toSRGB(levels.m_format);
+			}
+			const u32 skippedLevels = glm::min(downscaleLog2, static_cast<u32>(levels.m_levels.size()) - 1);
+			levels.m_levels.erase(levels.m_levels.begin(), levels.m_levels.begin() + skippedLevels);
+			return createTexture2D(device, levels, outTexture);
+		}
 
-		if (!data)
+		Vector<u8> texels;
+		u32 width, height;
+		if (!ImageDecoders::decode(file.getData(), file.getSize(), downscaleLog2, texels, width, height))
 		{
 			printf("Failed to load resource %s", fileRelPath);
 			return false;
 		}
+		return createTexture2D(device, ctx, width, height, ImageDecoder::s_bytesPerTexel, format, texels.data(), outTexture, mipFilter);
+	}
 
-		u32 desiredMipMaps = static_cast<u32>(log2f(static_cast<f32>(glm::min(x, y))));;
+	bool RenderResources::createTexture2D(ID3D11Device* device, ID3D11DeviceContext* ctx, u32 w, u32 h, u32 texelSize, DXGI_FORMAT format, const void* data, Texture2D& outTexture, MipGenerator::Filter mipFilter)
+	{
+		if (texelSize == MipChain::s_bytesPerTexel)
+		{
+			MipChain mipChain;
+			MipGenerator::generate(static_cast<const u8*>(data), w, h, isFormatSRGB(format), mipFilter, mipChain);
+			return createTexture2D(device, mipChain, format, outTexture);
+		}
 
 		D3D11_TEXTURE2D_DESC desc;
 		ZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
-		desc.Width = x;
-		desc.Height = y;
+		desc.Width = w;
+		desc.Height = h;
 		desc.MipLevels = 0;
 		desc.ArraySize = 1;
 		desc.Format = format;
@@ -603,19 +686,13 @@ namespace framework
 		desc.Usage = D3D11_USAGE_DEFAULT;
 		desc.CPUAccessFlags = 0;
 
-		D3D11_SUBRESOURCE_DATA initialData;
-		initialData.pSysMem = data;
-		initialData.SysMemPitch = s_bytesPerTexel * x;
-		initialData.SysMemSlicePitch = 0;
-
 		HRESULT res = device->CreateTexture2D(&desc, nullptr, &outTexture.m_texture);
 		if (FAILED(res))
 		{
-			printf("Failed to createstaging texture resource");
-			stbi_image_free(data);
+			printf("Failed to create texture resource");
 			return false;
 		}
-		ctx->UpdateSubresource(outTexture.m_texture, 0, nullptr, data, s_bytesPerTexel * x, 0);
+		ctx->UpdateSubresource(outTexture.m_texture, 0, nullptr, data, texelSize * w, 0);
 
 		D3D11_SHADER_RESOURCE_VIEW_DESC descSRV;
 		ZeroMemory(&descSRV, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
@@ -627,53 +704,82 @@ namespace framework
 		res = device->CreateShaderResourceView(outTexture.m_texture, &descSRV, &outTexture.m_SRV);
 		if (FAILED(res))
 		{
-			printf("Failed to create SRV for staging texture");
-			stbi_image_free(data);
+			printf("Failed to create SRV for texture");
 			return false;
 		}
 		ctx->GenerateMips(outTexture.m_SRV);
-		stbi_image_free(data);
 		return true;
 	}
 
-	bool RenderResources::createTexture2D(ID3D11Device* device, ID3D11DeviceContext* ctx, u32 w, u32 h, u32 texelSize, DXGI_FORMAT format, const void* data, Texture2D& outTexture)
+	bool RenderResources::createTexture2D(ID3D11Device* device, const MipChain& mipChain, DXGI_FORMAT format, Texture2D& outTexture)
 	{
-		u32 desiredMipMaps = static_cast<u32>(log2f(static_cast<f32>(glm::min(w, h))));;
+		TextureLevels levels;
+		levels.m_format = format;
+		levels.m_levels.resize(mipChain.getLevelCount());
+		for (u32 i = 0; i < mipChain.getLevelCount(); ++i)
+		{
+			TextureLevels::Level& level = levels.m_levels[i];
+			level.m_data = mipChain.getLevelData(i);
+			level.m_width = mipChain.m_levels[i].m_width;
+			level.m_height = mipChain.m_levels[i].m_height;
+			level.m_rowPitch = mipChain.getLevelPitch(i);
+			level.m_size = level.m_rowPitch * level.m_height;
+		}
+		return createTexture2D(device, levels, outTexture);
+	}
 
+	bool RenderResources::createTexture2D(ID3D11Device* device, const TextureLevels& levels, Texture2D& outTexture)
+	{
+		const u32 mipCount = static_cast<u32>(levels.m_levels.size());
 		D3D11_TEXTURE2D_DESC desc;
 		ZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
-		desc.Width = w;
-		desc.Height = h;
-		desc.MipLevels = 0;
+		desc.Width = levels.m_levels[0].m_width;
+		desc.Height = levels.m_levels[0].m_height;
+		desc.MipLevels = mipCount;
 		desc.ArraySize = 1;
-		desc.Format = format;
+		desc.Format = levels.m_format;
 		desc.SampleDesc.Count = 1;
-		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
-		desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
-		// Allow staging texture to be visible
-		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.MiscFlags = 0;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
 		desc.CPUAccessFlags = 0;
 
-		D3D11_SUBRESOURCE_DATA initialData;
-		initialData.pSysMem = data;
-		initialData.SysMemPitch = texelSize * w * h;
-		initialData.SysMemSlicePitch = 0;
+		Vector<D3D11_SUBRESOURCE_DATA> initialData(mipCount);
+		for (u32 i = 0; i < mipCount; ++i)
+		{
+			initialData[i].pSysMem = levels.m_levels[i].m_data;
+			initialData[i].SysMemPitch = levels.m_levels[i].m_rowPitch;
+			initialData[i].SysMemSlicePitch = 0;
+		}
 
-		HRESULT res = device->CreateTexture2D(&desc, nullptr, &outTexture.m_texture);
-		ctx->UpdateSubresource(outTexture.m_texture, 0, nullptr, data, texelSize * w, 0);
+		HRESULT res = device->CreateTexture2D(&desc, initialData.data(), &outTexture.m_texture);
+		if (FAILED(res))
+		{
+			printf("Failed to create texture resource");
+			return false;
+		}
 
 		D3D11_SHADER_RESOURCE_VIEW_DESC descSRV;
 		ZeroMemory(&descSRV, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
-		descSRV.Format = format;
+		descSRV.Format = levels.m_format;
 		descSRV.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
 		descSRV.Texture2D.MipLevels = -1;
 		descSRV.Texture2D.MostDetailedMip = 0;
 
 		res = device->CreateShaderResourceView(outTexture.m_texture, &descSRV, &outTexture.m_SRV);
-		ctx->GenerateMips(outTexture.m_SRV);
+		if (FAILED(res))
+		{
+			printf("Failed to create SRV for texture");
+			return false;
+		}
 		return true;
 	}
 
+	bool RenderResources::isFormatSRGB(DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB || format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+	}
+
 	ID3D11SamplerState* RenderResources::createSamplerState(ID3D11Device* device, D3D11_FILTER filter, D3D11_TEXTURE_ADDRESS_MODE addressMode)
 	{
 		ID3D11SamplerState* sampler = nullptr;
@@ -692,18 +798,105 @@ namespace framework
 		return sampler;
 	}
 
-	bool RenderResources::createDepthAttachment(ID3D11Device* device, u32 width, u32 height, DXGI_FORMAT format, DepthAttachment& outDepthAttachment)
+	bool RenderResources::updateStructuredBuffer(ID3D11Device* device, ID3D11DeviceContext* ctx, const void* data, u32 elementSize, u32 elementCount, StructuredBuffer& buffer)
+	{
+		// Empty buffers still get one element, so there is always a view to bind
+		const u32 requiredCount = glm::max(elementCount, 1u);
+		if (!buffer.m_buffer || buffer.m_elementSize != elementSize || buffer.m_capacity < requiredCount)
+		{
+			if (buffer.m_SRV)
+			{
+				buffer.m_SRV->Release();
+				buffer.m_SRV = nullptr;
+			}
+			if (buffer.m_buffer)
+			{
+				buffer.m_buffer->Release();
+				buffer.m_buffer = nullptr;
+			}
+			u32 capacity = glm::max(buffer.m_capacity, 64u);
+			while (capacity < requiredCount)
+			{
+				capacity *= 2;
+			}
+
+			D3D11_BUFFER_DESC desc;
+			ZeroMemory(&desc, sizeof(D3D11_BUFFER_DESC));
+			desc.ByteWidth = capacity * elementSize;
+			desc.Usage = D3D11_USAGE_DYNAMIC;
+			desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+			desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+			desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+			desc.StructureByteStride = elementSize;
+			if (FAILED(device->CreateBuffer(&desc, nullptr, &buffer.m_buffer)))
+			{
+				printf("Failed to create structured buffer\n");
+				return false;
+			}
+
+			D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+			ZeroMemory(&srvDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+			srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+			srvDesc.Buffer.FirstElement = 0;
+			srvDesc.Buffer.NumElements = capacity;
+			if (FAILED(device->CreateShaderResourceView(buffer.m_buffer, &srvDesc, &buffer.m_SRV)))
+			{
+				printf("Failed to create structured buffer view\n");
+				return false;
+			}
+			buffer.m_elementSize = elementSize;
+			buffer.m_capacity = capacity;
+		}
+
+		if (elementCount == 0)
+		{
+			return true;
+		}
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(ctx->Map(buffer.m_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		{
+			printf("Failed to map structured buffer\n");
+			return false;
+		}
+		memcpy(mapped.pData, data, static_cast<size_t>(elementCount) * elementSize);
+		ctx->Unmap(buffer.m_buffer, 0);
+		return true;
+	}
+
+	bool RenderResources::createDepthAttachment(ID3D11Device* device, u32 width, u32 height, DXGI_FORMAT format, DepthAttachment& outDepthAttachment, bool isShaderReadable)
 	{
+		// Shader readable attachments are created typeless, so the depth can be viewed as a color format
+		DXGI_FORMAT textureFormat = format;
+		DXGI_FORMAT viewFormat = DXGI_FORMAT_UNKNOWN;
+		if (isShaderReadable)
+		{
+			switch (format)
+			{
+			case DXGI_FORMAT_D24_UNORM_S8_UINT:
+				textureFormat = DXGI_FORMAT_R24G8_TYPELESS;
+				viewFormat = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+				break;
+			case DXGI_FORMAT_D32_FLOAT:
+				textureFormat = DXGI_FORMAT_R32_TYPELESS;
+				viewFormat = DXGI_FORMAT_R32_FLOAT;
+				break;
+			default:
+				printf("Depth format can't be read by shaders");
+				return false;
+			}
+		}
+
 		D3D11_TEXTURE2D_DESC descDepth;
 		descDepth.Width = width;
 		descDepth.Height = height;
 		descDepth.MipLevels = 1;
 		descDepth.ArraySize = 1;
-		descDepth.Format = format;
+		descDepth.Format = textureFormat;
 		descDepth.SampleDesc.Count = 1;
 		descDepth.SampleDesc.Quality = 0;
 		descDepth.Usage = D3D11_USAGE_DEFAULT;
-		descDepth.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+		descDepth.BindFlags = D3D11_BIND_DEPTH_STENCIL | (isShaderReadable ? D3D11_BIND_SHADER_RESOURCE : 0);
 		descDepth.CPUAccessFlags = 0;
 		descDepth.MiscFlags = 0;
 		HRESULT res = device->CreateTexture2D(&descDepth, NULL, &outDepthAttachment.m_depthStencilTexture);
@@ -728,16 +921,52 @@ namespace framework
 			printf("Failed to create Depth Stencil view.");
 			return false;
 		}
+
+		if (isShaderReadable)
+		{
+			D3D11_SHADER_RESOURCE_VIEW_DESC descSRV;
+			ZeroMemory(&descSRV, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+			descSRV.Format = viewFormat;
+			descSRV.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+			descSRV.Texture2D.MipLevels = 1;
+			if (FAILED(device->CreateShaderResourceView(outDepthAttachment.m_depthStencilTexture, &descSRV, &outDepthAttachment.m_SRV)))
+			{
+				printf("Failed to create Depth Stencil shader view.");
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool RenderResources::createRenderTarget(ID3D11Device* device, u32 width, u32 height, DXGI_FORMAT format, RenderTarget& outRenderTarget)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		ZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Format = format;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+		if (FAILED(device->CreateTexture2D(&desc, nullptr, &outRenderTarget.m_texture)) ||
+			FAILED(device->CreateRenderTargetView(outRenderTarget.m_texture, nullptr, &outRenderTarget.m_RTV)) ||
+			FAILED(device->CreateShaderResourceView(outRenderTarget.m_texture, nullptr, &outRenderTarget.m_SRV)))
+		{
+			printf("Failed to create render target.");
+			return false;
+		}
 		return true;
 	}
 
-	ID3D11DepthStencilState* RenderResources::createDepthStencilState(ID3D11Device* device, D3D11_COMPARISON_FUNC func)
+	ID3D11DepthStencilState* RenderResources::createDepthStencilState(ID3D11Device* device, D3D11_COMPARISON_FUNC func, bool isWriteEnabled)
 	{
 		D3D11_DEPTH_STENCIL_DESC dsDesc;
 
 		// Depth test parameters
 		dsDesc.DepthEnable = true;
-		dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+		dsDesc.DepthWriteMask = isWriteEnabled ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
 		dsDesc.DepthFunc = func;
 
 		// Stencil test parameters
@@ -753,6 +982,165 @@ namespace framework
 		return pDSState;
 	}
 
+	bool RenderResources::createRawBuffer(ID3D11Device* device, u32 size, bool isIndirectArgs, RawBuffer& outBuffer)
+	{
+		// Raw views address 4 byte words
+		size = (size + 3) & ~3u;
+		D3D11_BUFFER_DESC desc;
+		ZeroMemory(&desc, sizeof(D3D11_BUFFER_DESC));
+		desc.ByteWidth = size;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS | (isIndirectArgs ? D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS : 0);
+		if (FAILED(device->CreateBuffer(&desc, nullptr, &outBuffer.m_buffer)))
+		{
+			printf("Failed to create raw buffer\n");
+			return false;
+		}
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+		ZeroMemory(&srvDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+		srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+		srvDesc.BufferEx.NumElements = size / 4;
+		srvDesc.BufferEx.Flags = D3D11_BUFFEREX_SRV_FLAG_RAW;
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+		ZeroMemory(&uavDesc, sizeof(D3D11_UNORDERED_ACCESS_VIEW_DESC));
+		uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+		uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+		uavDesc.Buffer.NumElements = size / 4;
+		uavDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+		if (FAILED(device->CreateShaderResourceView(outBuffer.m_buffer, &srvDesc, &outBuffer.m_SRV)) || 
+			FAILED(device->CreateUnorderedAccessView(outBuffer.m_buffer, &uavDesc, &outBuffer.m_UAV)))
+		{
+			printf("Failed to create raw buffer views\n");
+			return false;
+		}
+		outBuffer.m_size = size;
+		return true;
+	}
+
+	bool RenderResources::createRWTexture2D(ID3D11Device* device, u32 width, u32 height, u32 mipCount, DXGI_FORMAT format, RWTexture2D& outTexture)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		ZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+		desc.Width = width;
+		desc.Height = height;
+		desc.MipLevels = mipCount;
+		desc.ArraySize = 1;
+		desc.Format = format;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+		if (FAILED(device->CreateTexture2D(&desc, nullptr, &outTexture.m_texture)))
+		{
+			printf("Failed to create RW texture\n");
+			return false;
+		}
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+		ZeroMemory(&srvDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+		srvDesc.Format = format;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = mipCount;
+		if (FAILED(device->CreateShaderResourceView(outTexture.m_texture, &srvDesc, &outTexture.m_SRV)))
+		{
+			printf("Failed to create RW texture view\n");
+			return false;
+		}
+		outTexture.m_mipSRVs.resize(mipCount, nullptr);
+		outTexture.m_mipUAVs.resize(mipCount, nullptr);
+		for (u32 mip = 0; mip < mipCount; ++mip)
+		{
+			srvDesc.Texture2D.MostDetailedMip = mip;
+			srvDesc.Texture2D.MipLevels = 1;
+			D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+			ZeroMemory(&uavDesc, sizeof(D3D11_UNORDERED_ACCESS_VIEW_DESC));
+			uavDesc.Format = format;
+			uavDesc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D;
+			uavDesc.Texture2D.MipSlice = mip;
+			if (FAILED(device->CreateShaderResourceView(outTexture.m_texture, &srvDesc, &outTexture.m_mipSRVs[mip])) || 
+				FAILED(device->CreateUnorderedAccessView(outTexture.m_texture, &uavDesc, &outTexture.m_mipUAVs[mip])))
+			{
+				printf("Failed to create RW texture mip views\n");
+				return false;
+			}
+		}
+		outTexture.m_width = width;
+		outTexture.m_height = height;
+		return true;
+	}
+
+	ID3D11Buffer* RenderResources::createReadbackBuffer(ID3D11Device* device, u32 size)
+	{
+		D3D11_BUFFER_DESC desc;
+		ZeroMemory(&desc, sizeof(D3D11_BUFFER_DESC));
+		desc.ByteWidth = size;
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		ID3D11Buffer* staging = nullptr;
+		if (FAILED(device->CreateBuffer(&desc, nullptr, &staging)))
+		{
+			printf("Failed to create readback buffer\n");
+		}
+		return staging;
+	}
+
+	bool RenderResources::readbackBuffer(ID3D11Device* device, ID3D11DeviceContext* ctx, ID3D11Buffer* buffer, u32 size, void* outData)
+	{
+		ID3D11Buffer* staging = createReadbackBuffer(device, size);
+		if (!staging)
+		{
+			return false;
+		}
+		D3D11_BOX box = {0, 0, 0, size, 1, 1};
+		ctx->CopySubresourceRegion(staging, 0, 0, 0, 0, buffer, 0, &box);
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		const bool isMapped = SUCCEEDED(ctx->Map(staging, 0, D3D11_MAP_READ, 0, &mapped));
+		if (isMapped)
+		{
+			memcpy(outData, mapped.pData, size);
+			ctx->Unmap(staging, 0);
+		}
+		staging->Release();
+		return isMapped;
+	}
+
+	bool RenderResources::readbackTexture2D(ID3D11Device* device, ID3D11DeviceContext* ctx, ID3D11Texture2D* texture, u32 mip, u32 texelSize, Vector<u8>& outData)
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		texture->GetDesc(&desc);
+		desc.Width = glm::max(desc.Width >> mip, 1u);
+		desc.Height = glm::max(desc.Height >> mip, 1u);
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.BindFlags = 0;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		desc.MiscFlags = 0;
+		ID3D11Texture2D* staging = nullptr;
+		if (FAILED(device->CreateTexture2D(&desc, nullptr, &staging)))
+		{
+			printf("Failed to create readback texture\n");
+			return false;
+		}
+		ctx->CopySubresourceRegion(staging, 0, 0, 0, 0, texture, mip, nullptr);
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		const bool isMapped = SUCCEEDED(ctx->Map(staging, 0, D3D11_MAP_READ, 0, &mapped));
+		if (isMapped)
+		{
+			const u32 rowSize = desc.Width * texelSize;
+			outData.resize(rowSize * desc.Height);
+			for (u32 y = 0; y < desc.Height; ++y)
+			{
+				memcpy(outData.data() + y * rowSize, static_cast<const u8*>(mapped.pData) + y * mapped.RowPitch, rowSize);
+			}
+			ctx->Unmap(staging, 0);
+		}
+		staging->Release();
+		return isMapped;
+	}
+
 	ID3D11Buffer* RenderResources::createVertexBuffer(ID3D11Device* device, u32 bufferSize, void* initialData)
 	{
 		D3D11_BUFFER_DESC bufferDesc;
@@ -1035,6 +1423,46 @@ namespace framework
 		return false;
 	}
 
+	static constexpr u32 s_glbMagic = 0x46546C67; // "glTF"
+	static constexpr u32 s_glbChunkBIN = 0x004E4942; // "BIN"
+	static constexpr u32 s_glbHeaderSize = 12;
+	static constexpr u32 s_glbChunkHeaderSize = 8;
+
+	static bool isGLB(const u8* data, u32 size)
+	{
+		u32 magic = 0;
+		if (size >= s_glbHeaderSize + s_glbChunkHeaderSize)
+		{
+			memcpy(&magic, data, sizeof(u32));
+		}
+		return magic == s_glbMagic;
+	}
+
+	// GLB layout: Header (magic, version, length) | JSON chunk (length, type, data) | BIN chunk (length, type, data) (optional)
+	static const u8* findGLBBinChunk(const u8* data, u32 size, u32& outBinSize)
+	{
+		u32 header[3];
+		u32 jsonChunkLength;
+		memcpy(header, data, sizeof(header));
+		memcpy(&jsonChunkLength, data + s_glbHeaderSize, sizeof(u32));
+		const u64 binChunkOffset = u64(s_glbHeaderSize) + s_glbChunkHeaderSize + jsonChunkLength;
+		const u64 length = glm::min(header[2], size);
+		outBinSize = 0;
+		if (binChunkOffset + s_glbChunkHeaderSize > length)
+		{
+			return nullptr;
+		}
+
+		u32 binChunkHeader[2];
+		memcpy(binChunkHeader, data + binChunkOffset, sizeof(binChunkHeader));
+		if (binChunkHeader[1] != s_glbChunkBIN || binChunkOffset + s_glbChunkHeaderSize + binChunkHeader[0] > length)
+		{
+			return nullptr;
+		}
+		outBinSize = binChunkHeader[0];
+		return data + binChunkOffset + s_glbChunkHeaderSize;
+	}
+
 	static bool writeWholeFile(std::string * error, const std::string & filePath, 
 		const std::vector<unsigned char> & data, void * userData)
 	{
@@ -1044,8 +1472,25 @@ namespace framework
 
 
 
-	bool GltfScene::loadGLTF(ID3D11Device* device, ID3D11DeviceContext* ctx,const char* fileRelPath)
+	GltfScene::~GltfScene()
 	{
+		for (ID3D11SamplerState* sampler : m_samplers)
+		{
+			sampler->Release();
+		}
+		if (m_vertexBuffer)
+		{
+			m_vertexBuffer->Release();
+		}
+		if (m_indexBuffer)
+		{
+			m_indexBuffer->Release();
+		}
+	}
+
+	bool GltfScene::loadGLTF(ID3D11Device* device, ID3D11DeviceContext* ctx,const char* fileRelPath, u32 loadFlags)
+	{
+		m_loadFlags = loadFlags;
 		String path(fileRelPath);
 		std::replace( path.begin(), path.end(), '\\', '/');
 		size_t pivot = path.find_last_of('/');
@@ -1055,14 +1500,13 @@ namespace framework
 			prefixPath = path.substr(0, pivot);
 		}
 
-		u32 fileSize = 0;
 		m_basePath = prefixPath;
 		String absPath = framework::Paths::getAssetPath(fileRelPath);
-		UniquePtr<char[]> gltfFileData = framework::FileUtils::loadFileContent(absPath.c_str(), fileSize);
-		if (fileSize == 0) 
+		MappedFile gltfFile;
+		if (!gltfFile.open(absPath.c_str())) 
 		{
 			printf("GLTF file could not be opened.");
-			return 1;
+			return false;
 		}
 
 		UniquePtr<tinygltf::Model> model = std::make_unique<tinygltf::Model>();
@@ -1074,7 +1518,23 @@ namespace framework
 		callbacks.WriteWholeFile = &writeWholeFile;
 		callbacks.FileExists = &doesFileExist;
 		loader.SetFsCallbacks(callbacks);
-		if (!loader.LoadASCIIFromString(model.get(), &error, &warnings, gltfFileData.get(), fileSize, prefixPath)) 
+
+		const u8* fileData = gltfFile.getData();
+		const u32 fileSize = static_cast<u32>(gltfFile.getSize());
+		const u8* glbBinChunk = nullptr;
+		u32 glbBinChunkSize = 0;
+		bool loaded = false;
+		if (isGLB(fileData, fileSize))
+		{
+			// The JSON chunk is parsed in place and the BIN chunk is read from the mapped file (see TINYGLTF_NO_BINARY_CHUNK_COPY)
+			glbBinChunk = findGLBBinChunk(fileData, fileSize, glbBinChunkSize);
+			loaded = loader.LoadBinaryFromMemory(model.get(), &error, &warnings, fileData, fileSize, prefixPath);
+		}
+		else
+		{
+			loaded = loader.LoadASCIIFromString(model.get(), &error, &warnings, reinterpret_cast<const char*>(fileData), fileSize, prefixPath);
+		}
+		if (!loaded) 
 		{
 			printf("ERRORs: %s\n", error.c_str());
 			return false;
@@ -1084,26 +1544,263 @@ namespace framework
 			printf("WARNINGs: %s\n", warnings.c_str());
 		}
 
-		if (model->scenes.size() > 0) 
+		bool success = model->scenes.size() > 0 && registerBuffers(model.get(), glbBinChunk, glbBinChunkSize);
+		if (success) 
 		{
 			const tinygltf::Scene& scene = model->scenes[0];
 			for (s32 idx : scene.nodes) 
 			{
 				setupNodeHierarchy(model.get(), idx);
 			}
-			if (!setupMaterials(device, ctx, model.get())) 
+			const u32 cacheHitsBefore = m_textureCache->getHitCount();
+			success = setupMaterials(device, ctx, model.get());
+			if (!success) 
 			{
 				printf("Failed to initialize material data");
-				return false;
 			}
-			if (!setupGeometry(device, model.get())) 
+			else
+			{
+				printf("Material textures: %u shared through the texture cache\n", m_textureCache->getHitCount() - cacheHitsBefore);
+				if ((m_loadFlags & PackTextures) != 0 && (m_loadFlags & StreamTextures) == 0)
+				{
+					success = packMaterialTextures(device, ctx);
+				}
+				computeMaterialSortIds();
+				// Texels are already in GPU memory, release them before streaming the geometry
+				for (tinygltf::Image& img : model->images)
+				{
+					std::vector<unsigned char>().swap(img.image);
+				}
+				success = success && setupGeometry(device, model.get());
+				if (!success) 
+				{
+					printf("Failed to initialize geometry resources");
+				}
+			}
+		}
+
+		printf("Geometry streaming: peak read window %u KB\n", static_cast<u32>(m_bufferReader.getPeakWindowSize() / 1024));
+		m_bufferReader.clear();
+		return success;
+	}
+
+	bool GltfScene::registerBuffers(tinygltf::Model* gltf, const u8* glbBinChunk, u32 glbBinChunkSize)
+	{
+		m_bufferReader.clear();
+		for (const tinygltf::Buffer& buffer : gltf->buffers)
+		{
+			if (!buffer.data.empty())
+			{
+				// Data URI, already decoded by tinygltf
+				m_bufferReader.addMemoryBuffer(buffer.data.data(), buffer.data.size());
+			}
+			else if (buffer.uri.empty())
+			{
+				if (!glbBinChunk)
+				{
+					printf("GLB without binary chunk\n");
+					return false;
+				}
+				m_bufferReader.addMemoryBuffer(glbBinChunk, glbBinChunkSize);
+			}
+			else if (!m_bufferReader.addFileBuffer(Paths::getAssetPath(resolveTexturePath(Paths::decodeUri(buffer.uri))).c_str()))
 			{
-				printf("Failed to initialize geometry resources");
+				printf("Failed to open buffer %s\n", buffer.uri.c_str());
 				return false;
 			}
+		}
+		return true;
+	}
+
+	// Streams the elements [firstElement, firstElement + elementCount) of the accessor.
+	// The data is only valid until the next read from the buffer reader
+	bool GltfScene::acquireAccessorData(tinygltf::Model* gltf, const tinygltf::Accessor& accessor, u32 firstElement, u32 elementCount, AccessorUtils::Stream& outStream)
+	{
+		const tinygltf::BufferView& view = gltf->bufferViews[accessor.bufferView];
+		const u32 componentSize = AccessorUtils::getComponentSize(static_cast<u32>(accessor.componentType));
+		if (componentSize == 0)
+		{
+			printf("Accessor %s uses an unsupported component type\n", accessor.name.c_str());
+			return false;
+		}
+		outStream.m_componentType = static_cast<u32>(accessor.componentType);
+		outStream.m_componentCount = static_cast<u32>(tinygltf::GetNumComponentsInType(accessor.type));
+		outStream.m_normalized = accessor.normalized;
+		const u32 elementSize = componentSize * outStream.m_componentCount;
+		outStream.m_stride = view.byteStride ? static_cast<u32>(view.byteStride) : elementSize;
+		outStream.m_data = nullptr;
+		if (elementCount == 0)
+		{
 			return true;
 		}
-		return false;
+		const u64 offset = u64(view.byteOffset) + accessor.byteOffset + u64(outStream.m_stride) * firstElement;
+		const u64 size = u64(outStream.m_stride) * (elementCount - 1) + elementSize;
+		outStream.m_data = m_bufferReader.acquire(static_cast<u32>(view.buffer), offset, size);
+		return outStream.m_data != nullptr;
+	}
+
+	bool GltfScene::loadImage(tinygltf::Model* gltf, tinygltf::Image& img)
+	{
+		if (!img.image.empty())
+		{
+			return true;
+		}
+
+		// Images in buffers and external files are not decoded by tinygltf (see TINYGLTF_NO_BINARY_CHUNK_COPY and TINYGLTF_NO_EXTERNAL_IMAGE).
+		// They are decoded straight into the image texels. Images that get cooked are decoded at full size
+		const u32 downscaleLog2 = (m_loadFlags & CookTextures) != 0 ? 0 : m_textureDownscaleLog2;
+		u32 width = 0;
+		u32 height = 0;
+		bool isDecoded = false;
+		if (img.bufferView >= 0)
+		{
+			const tinygltf::BufferView& view = gltf->bufferViews[img.bufferView];
+			const u8* encoded = m_bufferReader.acquire(static_cast<u32>(view.buffer), view.byteOffset, view.byteLength);
+			isDecoded = encoded && ImageDecoders::decode(encoded, view.byteLength, downscaleLog2, img.image, width, height);
+		}
+		else if (!img.uri.empty())
+		{
+			MappedFile file;
+			isDecoded = file.open(Paths::getAssetPath(resolveTexturePath(img.uri)).c_str()) && 
+				ImageDecoders::decode(file.getData(), file.getSize(), downscaleLog2, img.image, width, height);
+		}
+		if (!isDecoded)
+		{
+			printf("Failed to decode image %s\n", img.uri.empty() ? img.name.c_str() : img.uri.c_str());
+			img.image.clear();
+			return false;
+		}
+		img.width = width;
+		img.height = height;
+		img.component = ImageDecoder::s_bytesPerTexel;
+		img.bits = 8;
+		img.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+		return true;
+	}
+
+	// Identifies the contents of an image without decoding it
+	u64 GltfScene::computeImageHash(tinygltf::Model* gltf, const tinygltf::Image& img)
+	{
+		if (img.bufferView >= 0)
+		{
+			const tinygltf::BufferView& view = gltf->bufferViews[img.bufferView];
+			const u8* encoded = m_bufferReader.acquire(static_cast<u32>(view.buffer), view.byteOffset, view.byteLength);
+			return encoded ? TextureCache::computeDataHash(encoded, view.byteLength) : 0;
+		}
+		if (!img.uri.empty() && !tinygltf::IsDataURI(img.uri))
+		{
+			return m_textureCache->computeFileHash(Paths::getAssetPath(resolveTexturePath(img.uri)));
+		}
+		// Data URI, already decoded by tinygltf
+		return img.image.empty() ? 0 : TextureCache::computeDataHash(img.image.data(), img.image.size());
+	}
+
+	bool GltfScene::createMaterialTexture(ID3D11Device* device, ID3D11DeviceContext* ctx, tinygltf::Model* gltf, s32 textureIdx, bool isNormalMap, SharedPtr<Texture2D>& outTexture, u32& outStreamHandle)
+	{
+		tinygltf::Image& img = gltf->images[gltf->textures[textureIdx].source];
+		const u64 imageHash = computeImageHash(gltf, img);
+
+		// Everything that changes the texture created from the image. Streamed textures are only shared within the scene
+		const bool isStreamed = (m_loadFlags & CookTextures) != 0 && (m_loadFlags & StreamTextures) != 0;
+		const u64 variant[5] = { 
+			isNormalMap ? 1ull : 0ull, 
+			m_loadFlags & (CookTextures | StreamTextures), 
+			static_cast<u64>(m_textureQuality),
+			isStreamed ? reinterpret_cast<u64>(&m_textureStreamer) : 0ull,
+			(m_loadFlags & CookTextures) != 0 ? 0ull : static_cast<u64>(m_textureDownscaleLog2) };
+		const u64 cacheKey = TextureCache::makeKey(imageHash, Hash::compute(variant, sizeof(variant)));
+		if (imageHash != 0)
+		{
+			outTexture = m_textureCache->find(cacheKey, &outStreamHandle);
+			if (outTexture)
+			{
+				return true;
+			}
+		}
+
+		outTexture = std::make_shared<Texture2D>();
+		outStreamHandle = TextureStreamer::s_invalidHandle;
+		if (!createTexture(device, ctx, gltf, img, imageHash, isNormalMap, *outTexture, outStreamHandle))
+		{
+			outTexture = nullptr;
+			return false;
+		}
+		if (imageHash != 0)
+		{
+			m_textureCache->add(cacheKey, outTexture, outStreamHandle);
+		}
+		return true;
+	}
+
+	bool GltfScene::createTexture(ID3D11Device* device, ID3D11DeviceContext* ctx, tinygltf::Model* gltf, tinygltf::Image& img, u64 imageHash, 
+		bool isNormalMap, Texture2D& outTexture, u32& outStreamHandle)
+	{
+		outTexture.m_name = resolveTexturePath(img.uri);
+		if ((m_loadFlags & CookTextures) != 0)
+		{
+			const TextureCooker::Usage usage = isNormalMap ? TextureCooker::Usage::NormalMap : TextureCooker::Usage::Color;
+			const String cookedPath = TextureCooker::getCookedPath(imageHash, usage, m_textureQuality);
+			bool isCooked = imageHash != 0 && FileUtils::doesFileExist(cookedPath.c_str());
+			if (!isCooked && imageHash != 0 && loadImage(gltf, img))
+			{
+				isCooked = TextureCooker::cook(img.image.data(), img.width, img.height, usage, m_textureQuality, cookedPath);
+			}
+			if (isCooked && (m_loadFlags & StreamTextures) != 0)
+			{
+				outStreamHandle = m_textureStreamer.addTexture(device, cookedPath.c_str(), outTexture);
+				if (outStreamHandle != TextureStreamer::s_invalidHandle)
+				{
+					return true;
+				}
+			}
+			if (isCooked && TextureCooker::loadCooked(device, cookedPath, outTexture))
+			{
+				return true;
+			}
+			// Fall back to the uncompressed texture
+		}
+
+		if (!loadImage(gltf, img))
+		{
+			return false;
+		}
+		const u32 texelSize = img.component;
+		const DXGI_FORMAT format = isNormalMap ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+		return framework::RenderResources::createTexture2D(device, ctx, img.width, img.height, texelSize, format, img.image.data(), outTexture, 
+			isNormalMap ? MipGenerator::Filter::Box : MipGenerator::Filter::Kaiser);
+	}
+
+	void GltfScene::updateTextureStreaming(ID3D11Device* device, ID3D11DeviceContext* ctx, const m4& view, const m4& projection, u32 viewportHeight)
+	{
+		if ((m_loadFlags & StreamTextures) == 0)
+		{
+			return;
+		}
+
+		const Frustum frustum = Frustum::fromViewProj(projection * view);
+		const v3 camPos = v3(glm::inverse(view)[3]);
+		// World size covered by a pixel at distance 1
+		const f32 pixelSizeAtUnitDistance = 2.0f / (projection[1][1] * static_cast<f32>(glm::max(viewportHeight, 1u)));
+		for (const Node& node : m_nodes)
+		{
+			const f32 scale = glm::max(glm::length(v3(node.m_model[0])), glm::max(glm::length(v3(node.m_model[1])), glm::length(v3(node.m_model[2]))));
+			for (const Meshlet& meshlet : m_meshes[node.m_mesh].m_meshlets)
+			{
+				const v3 center = v3(node.m_model * v4(meshlet.m_boundsCenter, 1.0f));
+				const f32 radius = meshlet.m_boundsRadius * scale;
+				if (!frustum.isSphereVisible(center, radius))
+				{
+					continue;
+				}
+				// The closest point of the meshlet needs the most detail
+				const f32 distance = glm::max(glm::length(center - camPos) - radius, 0.01f);
+				const f32 uvPerPixel = (meshlet.m_uvDensity / scale) * distance * pixelSizeAtUnitDistance;
+				const SurfaceMaterial& material = m_materials[meshlet.m_material];
+				m_textureStreamer.requestMip(material.m_albedoStream, uvPerPixel);
+				m_textureStreamer.requestMip(material.m_normalStream, uvPerPixel);
+			}
+		}
+		m_textureStreamer.update(device, ctx);
 	}
 
 	void GltfScene::setupNodeHierarchy(tinygltf::Model* gltf, s32 nodeIdx, const m4& parentModel)
@@ -1145,59 +1842,145 @@ namespace framework
 		}
 	}
 
-	template<typename AttribT>
-	static inline void readAttribData(tinygltf::Model* gltf, AttribT* dst, u32 expectedStride, u32 vertexIdx, const tinygltf::Accessor& accesor)
+	// Reserve space at the end of the index data. Returns the offset in bytes
+	static u32 allocIndexBytes(Vector<u8>& indexData, u32 bytes)
 	{
-		const tinygltf::BufferView& view = gltf->bufferViews[accesor.bufferView];
-		u32 stride = static_cast<u32>(glm::max(expectedStride, static_cast<u32>(view.byteStride)));
-		unsigned char* src = gltf->buffers[view.buffer].data.data() + accesor.byteOffset + view.byteOffset;
-		src += stride * vertexIdx;
-		*dst = *(reinterpret_cast<AttribT*>(src));
+		const u32 offset = static_cast<u32>(indexData.size());
+		indexData.resize(offset + ((bytes + 3) & ~3u)); // Guarantee alignment of 4 bytes (alignof(int))
+		return offset;
 	}
 
-	bool GltfScene::setupGeometry(ID3D11Device* device, tinygltf::Model* gltf) 
+	bool GltfScene::setupGeometry(ID3D11Device* device, tinygltf::Model* gltf)
 	{
 		// Do two iterations:
-		// 0: Resolve required sizes and offsets
-		// 1: Copy data to buffers
+		// 0: Resolve index data (narrowed to 16 bits when possible), required sizes and offsets
+		// 1: Copy vertex data to buffers
+
+		// Vertices of the primitive used by each meshlet
+		struct MeshletSource
+		{
+			u32 m_primIdx = 0;
+			u32 m_firstVertex = 0; // Index rebase applied to the meshlet
+			Vector<u32> m_vertexRemap; // Only for split primitives: Meshlet vertex -> Primitive vertex
+		};
+		Vector<Vector<MeshletSource>> meshletSources(gltf->meshes.size());
 
 		m_meshes.resize(gltf->meshes.size());
 		u32 vertexCount(0);
-		u32 indexBufferSize(0);
+		Vector<u8> indexBufferData;
+		Vector<u32> primIndices;
+		Vector<IndexUtils::Chunk> chunks;
+		Vector<u16> chunkIndices;
+		Vector<u32> chunkRemap;
+		u32 sourceIndexBytes(0);
+		u32 shortMeshletCount(0);
+		u32 splitPrimCount(0);
 		for (u32 meshIdx = 0; meshIdx < static_cast<u32>(gltf->meshes.size()); meshIdx++)
 		{
 			const tinygltf::Mesh& gltfMesh = gltf->meshes[meshIdx];
 			const std::vector<tinygltf::Primitive>& prims = gltfMesh.primitives;
 			Mesh& mesh = m_meshes[meshIdx];
-			mesh.m_meshlets.resize(prims.size());
-			for (u32 meshletIdx = 0; meshletIdx < static_cast<u32>(prims.size()); ++meshletIdx) 
+			Vector<MeshletSource>& sources = meshletSources[meshIdx];
+			mesh.m_meshlets.clear();
+			mesh.m_meshlets.reserve(prims.size());
+			for (u32 primIdx = 0; primIdx < static_cast<u32>(prims.size()); ++primIdx)
 			{
-				const tinygltf::Primitive& prim = prims[meshletIdx];
+				const tinygltf::Primitive& prim = prims[primIdx];
 				VERIFY(prim.mode == TINYGLTF_MODE_TRIANGLES, "Make sure the primitive is a triangle list");
 
-				Meshlet& meshlet = mesh.m_meshlets[meshletIdx];
-				meshlet.m_indexBytesOffset = indexBufferSize;// Offset in bytes (will be used when binding index buffer)
-				meshlet.m_vertexOffset = vertexCount;
-				meshlet.m_material = prim.material;
-				// Find index count
-				const tinygltf::Accessor& indexAccesor = gltf->accessors[prim.indices];
-				meshlet.m_indexCount = static_cast<u32>(indexAccesor.count);
-				// Use 16bit indices when the component type is either byte (we will convert this to u16) or unsigned short
-				meshlet.m_isIndexShort = (indexAccesor.componentType == TINYGLTF_COMPONENT_TYPE_SHORT) ||
-					(indexAccesor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) ||
-					(indexAccesor.componentType == TINYGLTF_COMPONENT_TYPE_BYTE) ||
-					(indexAccesor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE);
-				indexBufferSize += (meshlet.m_isIndexShort ? 2 : 4) * meshlet.m_indexCount;
-				indexBufferSize += (indexBufferSize % 4) != 0 ? 2 : 0; // Guarantee alignment of 4 bytes (alignof(int))
-
 				// Find out the number of vertices
 				const auto posIt = prim.attributes.find(s_PosAttribName);
-				if (posIt != prim.attributes.end()) // Guaranteed every mesh will have at least this attribute
+				VERIFY(posIt != prim.attributes.end(), "Primitive without positions"); // Guaranteed every mesh will have at least this attribute
+				const tinygltf::Accessor& posAccesor = gltf->accessors[posIt->second];
+				VERIFY(posAccesor.type == TINYGLTF_TYPE_VEC3, "Positions must be VEC3");
+				const u32 primVertexCount = static_cast<u32>(posAccesor.count);
+
+				// Decode indices (non indexed primitives get a trivial index list)
+				if (prim.indices >= 0)
+				{
+					const tinygltf::Accessor& indexAccesor = gltf->accessors[prim.indices];
+					const u32 primIndexCount = static_cast<u32>(indexAccesor.count);
+					AccessorUtils::Stream stream;
+					primIndices.resize(primIndexCount);
+					if (!acquireAccessorData(gltf, indexAccesor, 0, primIndexCount, stream) ||
+						!AccessorUtils::convertToUint(stream, primIndexCount, primIndices.data()))
+					{
+						return false;
+					}
+					sourceIndexBytes += static_cast<u32>(tinygltf::GetComponentSizeInBytes(indexAccesor.componentType) * indexAccesor.count);
+				}
+				else
+				{
+					primIndices.resize(primVertexCount);
+					for (u32 i = 0; i < primVertexCount; ++i)
+					{
+						primIndices[i] = i;
+					}
+				}
+				const u32 indexCount = static_cast<u32>(primIndices.size());
+
+				// Rebase the indices to the lowest referenced vertex and use 16 bits whenever the range allows it
+				u32 minIdx, maxIdx;
+				IndexUtils::computeRange(primIndices.data(), indexCount, minIdx, maxIdx);
+				const bool canNarrow = IndexUtils::canNarrow(minIdx, maxIdx);
+				if (canNarrow || (m_loadFlags & SplitLargePrimitives) == 0)
+				{
+					Meshlet meshlet;
+					meshlet.m_material = prim.material;
+					meshlet.m_vertexOffset = vertexCount;
+					meshlet.m_vertexCount = indexCount ? (maxIdx - minIdx + 1) : 0;
+					meshlet.m_indexCount = indexCount;
+					meshlet.m_isIndexShort = canNarrow;
+					meshlet.m_indexBytesOffset = allocIndexBytes(indexBufferData, (canNarrow ? 2 : 4) * indexCount);
+					void* dst = indexBufferData.data() + meshlet.m_indexBytesOffset;
+					if (canNarrow)
+					{
+						IndexUtils::narrowToShort(primIndices.data(), indexCount, minIdx, reinterpret_cast<u16*>(dst));
+						shortMeshletCount++;
+					}
+					else
+					{
+						u32* dstIndices = reinterpret_cast<u32*>(dst);
+						for (u32 i = 0; i < indexCount; ++i)
+						{
+							dstIndices[i] = primIndices[i] - minIdx;
+						}
+					}
+					vertexCount += meshlet.m_vertexCount;
+					mesh.m_meshlets.push_back(meshlet);
+
+					MeshletSource source;
+					source.m_primIdx = primIdx;
+					source.m_firstVertex = minIdx;
+					sources.push_back(std::move(source));
+				}
+				else
 				{
-					const tinygltf::Accessor& posAccesor = gltf->accessors[posIt->second];
-					VERIFY(posAccesor.type == TINYGLTF_TYPE_VEC3 && posAccesor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT, "Format for pos not supported");
-					meshlet.m_vertexCount = static_cast<u32>(posAccesor.count);
-					vertexCount += static_cast<u32>(posAccesor.count);
+					// Split the primitive in chunks addressable with 16 bit indices. Each one becomes a meshlet
+					chunks.clear();
+					chunkIndices.clear();
+					chunkRemap.clear();
+					IndexUtils::splitToShortChunks(primIndices.data(), indexCount, primVertexCount, chunks, chunkIndices, chunkRemap);
+					for (const IndexUtils::Chunk& chunk : chunks)
+					{
+						Meshlet meshlet;
+						meshlet.m_material = prim.material;
+						meshlet.m_vertexOffset = vertexCount;
+						meshlet.m_vertexCount = chunk.m_vertexCount;
+						meshlet.m_indexCount = chunk.m_indexCount;
+						meshlet.m_isIndexShort = true;
+						meshlet.m_indexBytesOffset = allocIndexBytes(indexBufferData, 2 * chunk.m_indexCount);
+						memcpy(indexBufferData.data() + meshlet.m_indexBytesOffset, chunkIndices.data() + chunk.m_firstIndex, 2 * chunk.m_indexCount);
+						vertexCount += meshlet.m_vertexCount;
+						mesh.m_meshlets.push_back(meshlet);
+						shortMeshletCount++;
+
+						MeshletSource source;
+						source.m_primIdx = primIdx;
+						source.m_vertexRemap.assign(chunkRemap.begin() + chunk.m_firstVertex, chunkRemap.begin() + chunk.m_firstVertex + chunk.m_vertexCount);
+						sources.push_back(std::move(source));
+					}
+					splitPrimCount++;
 				}
 			}
 		}
@@ -1208,130 +1991,69 @@ namespace framework
 		static u32 s_vertexSize = static_cast<u32>(sizeof(VertexBuffer0) + sizeof(VertexBuffer1));
 		u32 vertexDataReqSpace = s_vertexSize * vertexCount;
 		UniquePtr<char[]> vertexBufferData = UniquePtr<char[]>(new char[vertexDataReqSpace]);
-		UniquePtr<char[]> indexBufferData = UniquePtr<char[]>(new char[indexBufferSize]);
 		VertexBuffer0* buff0Data = reinterpret_cast<VertexBuffer0*>(vertexBufferData.get());
 		VertexBuffer1* buff1Data = reinterpret_cast<VertexBuffer1*>(buff0Data + vertexCount);
-		char* indexBuffData = reinterpret_cast<char*>(indexBufferData.get());
+		char* indexBuffData = reinterpret_cast<char*>(indexBufferData.data());
 
 		for (u32 meshIdx = 0; meshIdx < static_cast<u32>(gltf->meshes.size()); meshIdx++)
 		{
 			const tinygltf::Mesh& gltfMesh = gltf->meshes[meshIdx];
 			const std::vector<tinygltf::Primitive>& prims = gltfMesh.primitives;
 			Mesh& mesh = m_meshes[meshIdx];
-			mesh.m_meshlets.resize(prims.size());
-			for (u32 meshletIdx = 0; meshletIdx < static_cast<u32>(prims.size()); ++meshletIdx) 
+			for (u32 meshletIdx = 0; meshletIdx < static_cast<u32>(mesh.m_meshlets.size()); ++meshletIdx)
 			{
-				const tinygltf::Primitive& prim = prims[meshletIdx];
+				const MeshletSource& source = meshletSources[meshIdx][meshletIdx];
+				const tinygltf::Primitive& prim = prims[source.m_primIdx];
 				Meshlet& meshlet = mesh.m_meshlets[meshletIdx];
+				const bool isRemapped = !source.m_vertexRemap.empty();
 
-				// Copy index data
+				// Only the range of primitive vertices used by the meshlet is streamed
+				u32 firstSrcVertex = source.m_firstVertex;
+				u32 srcVertexCount = meshlet.m_vertexCount;
+				if (isRemapped)
 				{
-					const tinygltf::Accessor& indexAccesor = gltf->accessors[prim.indices];
-					const tinygltf::BufferView& view = gltf->bufferViews[indexAccesor.bufferView];
-					bool isInteger = (indexAccesor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) || (indexAccesor.componentType == TINYGLTF_COMPONENT_TYPE_INT);
-					bool isShort = (indexAccesor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) || (indexAccesor.componentType == TINYGLTF_COMPONENT_TYPE_SHORT);
-					bool isByte = (indexAccesor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) || (indexAccesor.componentType == TINYGLTF_COMPONENT_TYPE_BYTE);
-					unsigned char* src = gltf->buffers[view.buffer].data.data() + indexAccesor.byteOffset + view.byteOffset;
-					char* dst = indexBuffData + meshlet.m_indexBytesOffset;
-					if (isInteger || isShort)
-					{
-						u32 stride = static_cast<u32>(view.byteStride);
-						if (stride)
-						{
-							u32 bytesToCopy = isInteger ? 4 : 2;
-							for (u32 i = 0; i < indexAccesor.count; ++i)
-							{
-								memcpy(dst, src, bytesToCopy);
-								src += stride;
-								dst += bytesToCopy;
-							}
-						}
-						else
-						{
-							u32 bytesToCopy = (isInteger ? 4 : 2) * static_cast<u32>(indexAccesor.count);
-							memcpy(dst, src, bytesToCopy);
-						}
-					}
-					else if (isByte)
-					{
-						// Special conversion needed
-						u32 stride = static_cast<u32>(view.byteStride);
-						stride = glm::max(stride, 1u);
-						for (u32 i = 0; i < indexAccesor.count; ++i)
-						{
-							u16 element = static_cast<char>(src[0]);
-							memcpy(dst, &element, 2);
-							src += stride;
-						}
-					}
+					u32 maxSrcVertex;
+					IndexUtils::computeRange(source.m_vertexRemap.data(), meshlet.m_vertexCount, firstSrcVertex, maxSrcVertex);
+					srcVertexCount = maxSrcVertex - firstSrcVertex + 1;
 				}
-
-				// Fill the data for Vertex Buffer 0
+				// Vertex of the streamed range used by each meshlet vertex
+				Vector<u32> elementIndices;
+				if (isRemapped)
 				{
-					VertexBuffer0* meshletBuff0 = buff0Data + meshlet.m_vertexOffset;
-					const auto posIt = prim.attributes.find(s_PosAttribName);
-					if (posIt != prim.attributes.end())
+					elementIndices.resize(meshlet.m_vertexCount);
+					for (u32 i = 0; i < meshlet.m_vertexCount; ++i)
 					{
-						const tinygltf::Accessor& posAccesor = gltf->accessors[posIt->second];
-						const tinygltf::BufferView& view = gltf->bufferViews[posAccesor.bufferView];
-
-						unsigned char* src = gltf->buffers[view.buffer].data.data() + posAccesor.byteOffset + view.byteOffset;
-						u32 bytesToCopy = static_cast<u32>(sizeof(v3));
-						if (view.byteStride) 
-						{
-							for (u32 i=0; i<posAccesor.count; ++i) 
-							{
-								meshletBuff0[i].m_pos = *(reinterpret_cast<v3*>(src));
-								src += view.byteStride;
-							}
-						}
-						else 
-						{						
-							memcpy(&meshletBuff0[0].m_pos[0], src, bytesToCopy * meshlet.m_vertexCount);
-						}
+						elementIndices[i] = source.m_vertexRemap[i] - firstSrcVertex;
 					}
 				}
 
-				// Fill the data for Vertex Buffer 1
+				// Stream one attribute of the meshlet into the vertex buffers, converting it to floats.
+				// Missing attributes keep the default values
+				auto readAttribute = [&](const String& attribName, u32 componentCount, f32* dst, u32 dstStride) -> bool
 				{
-					VertexBuffer1* meshletBuff1 = buff1Data + meshlet.m_vertexOffset;
-					const auto normalIt = prim.attributes.find(s_NormalAttribName);
-					const auto uvIt = prim.attributes.find(s_UvAttribName);
-					const auto tangentIt = prim.attributes.find(s_TangentAttribName);
-					for (u32 i=0; i<meshlet.m_vertexCount; ++i) 
+					const auto attribIt = prim.attributes.find(attribName);
+					if (attribIt == prim.attributes.end())
 					{
-						// Fill normals
-						meshletBuff1[i].m_normal = v3(0.0f, 0.0f, 1.0f);
-						if (normalIt != prim.attributes.end()) 
-						{
-							const tinygltf::Accessor& accesor = gltf->accessors[normalIt->second];
-							VERIFY(accesor.type == TINYGLTF_TYPE_VEC3 && accesor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT, "Format for normal not supported");
-							readAttribData<v3>(gltf, &meshletBuff1[i].m_normal, static_cast<u32>(sizeof(v3)), i, accesor);
-						}
-
-						// Fill Uvs
-						meshletBuff1[i].m_uv = v3(0.0f);
-						if (uvIt != prim.attributes.end()) 
-						{
-							const tinygltf::Accessor& accesor = gltf->accessors[uvIt->second];
-							VERIFY(accesor.type == TINYGLTF_TYPE_VEC2 && accesor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT, "Format for uv not supported");
-							readAttribData<v2>(gltf, &meshletBuff1[i].m_uv, static_cast<u32>(sizeof(v2)), i, accesor);
-						}
-
-						// Fill tangents
-						meshletBuff1[i].m_tangent = v4(0.0f);
-						//if (tangentIt != prim.attributes.end()) 
-						//{
-						//	const tinygltf::Accessor& accesor = gltf->accessors[tangentIt->second];
-						//	VERIFY((accesor.type == TINYGLTF_TYPE_VEC4) && accesor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT, "Format for tangent not supported");
-						//	u32 dataStride = static_cast<u32>(sizeof(v4));
-						//	readAttribData<v4>(gltf, &meshletBuff1[i].m_tangent, dataStride, i, accesor);
-						//}
-						//else if(m_materials[meshlet.m_material].m_normal.m_SRV)
-						//{
-						//	printf("The material used has a normal map but the geometry lacks tangents.\n");
-						//}
+						return true;
 					}
+					AccessorUtils::Stream stream;
+					return acquireAccessorData(gltf, gltf->accessors[attribIt->second], firstSrcVertex, srcVertexCount, stream) &&
+						AccessorUtils::convertToFloat(stream, meshlet.m_vertexCount, dst, componentCount, dstStride, isRemapped ? elementIndices.data() : nullptr);
+				};
+
+				VertexBuffer0* meshletBuff0 = buff0Data + meshlet.m_vertexOffset;
+				VertexBuffer1* meshletBuff1 = buff1Data + meshlet.m_vertexOffset;
+				for (u32 i=0; i<meshlet.m_vertexCount; ++i)
+				{
+					meshletBuff1[i].m_normal = v3(0.0f, 0.0f, 1.0f);
+					meshletBuff1[i].m_uv = v2(0.0f);
+					meshletBuff1[i].m_tangent = v4(0.0f); // Tangents are computed below
+				}
+				if (!readAttribute(s_PosAttribName, 3, &meshletBuff0[0].m_pos[0], sizeof(VertexBuffer0)) ||
+					!readAttribute(s_NormalAttribName, 3, &meshletBuff1[0].m_normal[0], sizeof(VertexBuffer1)) ||
+					!readAttribute(s_UvAttribName, 2, &meshletBuff1[0].m_uv[0], sizeof(VertexBuffer1)))
+				{
+					return false;
 				}
 
 				// Compute tangents
@@ -1346,6 +2068,8 @@ namespace framework
 					u32 indexCount = meshlet.m_indexCount;
 					VertexBuffer0* meshletBuff0 = buff0Data + meshlet.m_vertexOffset;
 					VertexBuffer1* meshletBuff1 = buff1Data + meshlet.m_vertexOffset;
+					f32 uvArea = 0.0f;
+					f32 area = 0.0f;
 					for (u32 i = 0; i < indexCount; i += 3) 
 					{
 						u32 idx0 = meshlet.m_isIndexShort ? static_cast<u32>(indexAsShort[i]) : indexAsUint[i];
@@ -1363,6 +2087,8 @@ namespace framework
 						v2 uvEdge10 = v11.m_uv - v01.m_uv;
 						v2 uvEdge20 = v21.m_uv - v01.m_uv;
 						f32 determinant = (uvEdge10.y * uvEdge20.x) - (uvEdge10.x * uvEdge20.y);
+						uvArea += glm::abs(determinant);
+						area += glm::length(glm::cross(edge10, edge20));
 						determinant = (glm::abs(determinant) < s_MinFloat) ? 0.0001f : (1.0f / determinant);
 
 						v3 tangent = (edge20 * uvEdge10.y - edge10 * uvEdge20.y) * determinant;
@@ -1388,38 +2114,256 @@ namespace framework
 						const f32 w = (glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f) ? 1.0f : -1.0f;
 						vert.m_tangent = v4(tangent, w);
 					}
+					meshlet.m_uvDensity = (area > s_MinFloat) ? glm::sqrt(uvArea / area) : 0.0f;
+				}
+
+				// Bounding sphere
+				{
+					v3 minPos = meshletBuff0[0].m_pos;
+					v3 maxPos = minPos;
+					for (u32 i = 1; i < meshlet.m_vertexCount; ++i)
+					{
+						minPos = glm::min(minPos, meshletBuff0[i].m_pos);
+						maxPos = glm::max(maxPos, meshletBuff0[i].m_pos);
+					}
+					meshlet.m_boundsCenter = (minPos + maxPos) * 0.5f;
+					meshlet.m_boundsExtents = (maxPos - minPos) * 0.5f;
+					meshlet.m_boundsRadius = 0.0f;
+					for (u32 i = 0; i < meshlet.m_vertexCount; ++i)
+					{
+						meshlet.m_boundsRadius = glm::max(meshlet.m_boundsRadius, glm::length(meshletBuff0[i].m_pos - meshlet.m_boundsCenter));
+					}
 				}
 
 			} // End iterate meshlets
 		} // End iterate meshes
 
+		if ((m_loadFlags & WeldVertices) != 0)
+		{
+			const u32 weldedVertexCount = weldVertices(vertexCount, indexBufferData, vertexBufferData);
+			printf("Vertex welding: %u -> %u vertices (%u KB -> %u KB)\n", vertexCount, weldedVertexCount,
+				(s_vertexSize * vertexCount) / 1024, (s_vertexSize * weldedVertexCount) / 1024);
+			vertexCount = weldedVertexCount;
+			vertexDataReqSpace = s_vertexSize * vertexCount;
+			m_vertexBuff1OffsetBytes = vertexCount * static_cast<u32>(sizeof(VertexBuffer0));
+		}
+
 		m_vertexBuffer = framework::RenderResources::createVertexBuffer(device, vertexDataReqSpace, vertexBufferData.get());
-		m_indexBuffer = framework::RenderResources::createIndexBuffer(device, indexBufferSize, indexBufferData.get());
+		m_indexBuffer = framework::RenderResources::createIndexBuffer(device, static_cast<u32>(indexBufferData.size()), indexBufferData.data());
+		if ((m_loadFlags & KeepCpuGeometry) != 0)
+		{
+			const VertexBuffer0* positions = reinterpret_cast<const VertexBuffer0*>(vertexBufferData.get());
+			m_cpuPositions.resize(vertexCount);
+			for (u32 i = 0; i < vertexCount; ++i)
+			{
+				m_cpuPositions[i] = positions[i].m_pos;
+			}
+			m_cpuIndexData = indexBufferData;
+		}
+
+		u32 meshletCount = 0;
+		for (const Mesh& mesh : m_meshes)
+		{
+			meshletCount += static_cast<u32>(mesh.m_meshlets.size());
+		}
+		printf("Index data: %u KB (source %u KB). %u/%u meshlets use 16 bit indices. %u primitives split.\n",
+			static_cast<u32>(indexBufferData.size() / 1024), sourceIndexBytes / 1024, shortMeshletCount, meshletCount, splitPrimCount);
 
 		return (m_vertexBuffer && m_indexBuffer);
 	}
 
+	u32 GltfScene::weldVertices(u32 vertexCount, Vector<u8>& indexData, UniquePtr<char[]>& inOutVertexData)
+	{
+		static constexpr u32 s_floatsPerVertex = static_cast<u32>((sizeof(VertexBuffer0) + sizeof(VertexBuffer1)) / sizeof(f32));
+		const VertexBuffer0* buff0 = reinterpret_cast<const VertexBuffer0*>(inOutVertexData.get());
+		const VertexBuffer1* buff1 = reinterpret_cast<const VertexBuffer1*>(buff0 + vertexCount);
+
+		VertexWelder welder(s_floatsPerVertex, m_weldEpsilon);
+		welder.reserve(vertexCount);
+		Vector<u32> remap;
+		f32 attribs[s_floatsPerVertex];
+		for (Mesh& mesh : m_meshes)
+		{
+			for (Meshlet& meshlet : mesh.m_meshlets)
+			{
+				if (meshlet.m_vertexCount == 0)
+				{
+					continue;
+				}
+
+				// 16 bit meshlets only accept matches that keep all their vertices addressable,
+				// the highest index they can end up using is the last vertex that could be appended.
+				const u32 maxVertexEnd = welder.getVertexCount() + meshlet.m_vertexCount;
+				const u32 minAcceptedIdx = (meshlet.m_isIndexShort && maxVertexEnd > IndexUtils::s_maxShortVertexCount) ?
+					(maxVertexEnd - IndexUtils::s_maxShortVertexCount) : 0;
+
+				remap.resize(meshlet.m_vertexCount);
+				u32 minIdx = 0xFFFFFFFF;
+				u32 maxIdx = 0;
+				for (u32 i = 0; i < meshlet.m_vertexCount; ++i)
+				{
+					memcpy(attribs, &buff0[meshlet.m_vertexOffset + i], sizeof(VertexBuffer0));
+					memcpy(attribs + (sizeof(VertexBuffer0) / sizeof(f32)), &buff1[meshlet.m_vertexOffset + i], sizeof(VertexBuffer1));
+					remap[i] = welder.weld(attribs, minAcceptedIdx);
+					minIdx = glm::min(minIdx, remap[i]);
+					maxIdx = glm::max(maxIdx, remap[i]);
+				}
+
+				// Rewrite the indices relative to the new base vertex
+				void* indices = indexData.data() + meshlet.m_indexBytesOffset;
+				for (u32 i = 0; i < meshlet.m_indexCount; ++i)
+				{
+					if (meshlet.m_isIndexShort)
+					{
+						u16& idx = reinterpret_cast<u16*>(indices)[i];
+						idx = static_cast<u16>(remap[idx] - minIdx);
+					}
+					else
+					{
+						u32& idx = reinterpret_cast<u32*>(indices)[i];
+						idx = remap[idx] - minIdx;
+					}
+				}
+				meshlet.m_vertexOffset = minIdx;
+				meshlet.m_vertexCount = maxIdx - minIdx + 1;
+			}
+		}
+
+		// Rebuild the vertex data from the welded vertices
+		const u32 weldedVertexCount = welder.getVertexCount();
+		UniquePtr<char[]> weldedData = UniquePtr<char[]>(new char[(sizeof(VertexBuffer0) + sizeof(VertexBuffer1)) * weldedVertexCount]);
+		VertexBuffer0* weldedBuff0 = reinterpret_cast<VertexBuffer0*>(weldedData.get());
+		VertexBuffer1* weldedBuff1 = reinterpret_cast<VertexBuffer1*>(weldedBuff0 + weldedVertexCount);
+		for (u32 i = 0; i < weldedVertexCount; ++i)
+		{
+			const f32* vertex = welder.getVertex(i);
+			memcpy(&weldedBuff0[i], vertex, sizeof(VertexBuffer0));
+			memcpy(&weldedBuff1[i], vertex + (sizeof(VertexBuffer0) / sizeof(f32)), sizeof(VertexBuffer1));
+		}
+		inOutVertexData = std::move(weldedData);
+		return weldedVertexCount;
+	}
+
+	static D3D11_TEXTURE_ADDRESS_MODE getAddressMode(s32 gltfWrap)
+	{
+		switch (gltfWrap)
+		{
+		case TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE:
+			return D3D11_TEXTURE_ADDRESS_CLAMP;
+		case TINYGLTF_TEXTURE_WRAP_MIRRORED_REPEAT:
+			return D3D11_TEXTURE_ADDRESS_MIRROR;
+		default:
+			return D3D11_TEXTURE_ADDRESS_WRAP;
+		}
+	}
+
+	static D3D11_SAMPLER_DESC getSamplerDesc(const tinygltf::Sampler* gltfSampler)
+	{
+		// Undefined filters default to trilinear, the textures always have mips
+		const s32 minFilter = gltfSampler ? gltfSampler->minFilter : -1;
+		const s32 magFilter = gltfSampler ? gltfSampler->magFilter : -1;
+		const bool isMinPoint = minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST || minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST || 
+			minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_LINEAR;
+		const bool isMipPoint = minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST || minFilter == TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST;
+		const bool hasMips = minFilter != TINYGLTF_TEXTURE_FILTER_NEAREST && minFilter != TINYGLTF_TEXTURE_FILTER_LINEAR;
+
+		D3D11_SAMPLER_DESC desc;
+		ZeroMemory(&desc, sizeof(D3D11_SAMPLER_DESC));
+		desc.Filter = D3D11_ENCODE_BASIC_FILTER(
+			isMinPoint ? D3D11_FILTER_TYPE_POINT : D3D11_FILTER_TYPE_LINEAR,
+			(magFilter == TINYGLTF_TEXTURE_FILTER_NEAREST) ? D3D11_FILTER_TYPE_POINT : D3D11_FILTER_TYPE_LINEAR,
+			isMipPoint ? D3D11_FILTER_TYPE_POINT : D3D11_FILTER_TYPE_LINEAR,
+			D3D11_FILTER_REDUCTION_TYPE_STANDARD);
+		desc.AddressU = getAddressMode(gltfSampler ? gltfSampler->wrapS : TINYGLTF_TEXTURE_WRAP_REPEAT);
+		desc.AddressV = getAddressMode(gltfSampler ? gltfSampler->wrapT : TINYGLTF_TEXTURE_WRAP_REPEAT);
+		desc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+		desc.MaxAnisotropy = 1;
+		desc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+		desc.MinLOD = 0.0f;
+		desc.MaxLOD = hasMips ? D3D11_FLOAT32_MAX : 0.0f;
+		return desc;
+	}
+
+	bool GltfScene::setupSamplers(ID3D11Device* device, tinygltf::Model* gltf)
+	{
+		// Many glTF samplers are identical, keep one state per description
+		UMap<u64, u32> samplerLookup;
+		auto addSampler = [&](const tinygltf::Sampler* gltfSampler, u32& outIdx)
+		{
+			const D3D11_SAMPLER_DESC desc = getSamplerDesc(gltfSampler);
+			const u64 key = Hash::compute(&desc, sizeof(D3D11_SAMPLER_DESC));
+			auto it = samplerLookup.find(key);
+			if (it != samplerLookup.end())
+			{
+				outIdx = it->second;
+				return true;
+			}
+			ID3D11SamplerState* sampler = nullptr;
+			if (FAILED(device->CreateSamplerState(&desc, &sampler)))
+			{
+				return false;
+			}
+			outIdx = static_cast<u32>(m_samplers.size());
+			m_samplers.push_back(sampler);
+			samplerLookup[key] = outIdx;
+			return true;
+		};
+
+		u32 defaultIdx;
+		if (!addSampler(nullptr, defaultIdx))
+		{
+			printf("Failed to create the default sampler\n");
+			return false;
+		}
+		m_gltfSamplerMap.resize(gltf->samplers.size());
+		for (u32 i = 0; i < static_cast<u32>(gltf->samplers.size()); ++i)
+		{
+			if (!addSampler(&gltf->samplers[i], m_gltfSamplerMap[i]))
+			{
+				printf("Failed to create sampler %u\n", i);
+				return false;
+			}
+		}
+		return true;
+	}
+
 	bool GltfScene::setupMaterials(ID3D11Device* device, ID3D11DeviceContext* ctx, tinygltf::Model* gltf) 
 	{
+		if (!setupSamplers(device, gltf))
+		{
+			return false;
+		}
+
+		// Textures shared through the cache get the same id
+		UMap<const Texture2D*, u32> textureIds;
+		auto getTextureId = [&textureIds](const SharedPtr<Texture2D>& texture)
+		{
+			return textureIds.emplace(texture.get(), static_cast<u32>(textureIds.size())).first->second;
+		};
+		auto getSamplerIdx = [this, gltf](s32 textureIdx)
+		{
+			const s32 samplerIdx = gltf->textures[textureIdx].sampler;
+			return (samplerIdx >= 0 && samplerIdx < static_cast<s32>(m_gltfSamplerMap.size())) ? m_gltfSamplerMap[samplerIdx] : 0;
+		};
+
 		m_materials.resize(gltf->materials.size());
 		for (u32 i = 0; i < static_cast<u32>(gltf->materials.size()); ++i) 
 		{
 			const tinygltf::Material& gltfMat = gltf->materials[i];
 			SurfaceMaterial& material = m_materials[i];
+			MaterialRecord& record = material.m_record;
 			// Albedo
 			{
 				s32 albedoIdx = gltfMat.pbrMetallicRoughness.baseColorTexture.index;
 				if (albedoIdx >= 0) 
 				{
-					const tinygltf::Image& albedoImg = gltf->images[gltf->textures[albedoIdx].source];
-					material.m_albedo.m_name = resolveTexturePath(albedoImg.uri);
-					u32 texelSize = albedoImg.component;
-					DXGI_FORMAT format = albedoImg.component == 4 ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
-					if(!framework::RenderResources::createTexture2D(device, ctx, albedoImg.width, albedoImg.height, texelSize, format, albedoImg.image.data(), material.m_albedo))
+					if (!createMaterialTexture(device, ctx, gltf, albedoIdx, false, material.m_albedo, material.m_albedoStream))
 					{
 						printf("Failed to create albedo\n");
 						return false;
 					}
+					record.m_albedoTexture = getTextureId(material.m_albedo);
+					record.m_albedoSampler = getSamplerIdx(albedoIdx);
 				}
 			}
 
@@ -1428,18 +2372,115 @@ namespace framework
 				s32 normalIdx = gltfMat.normalTexture.index;
 				if (normalIdx >= 0) 
 				{
-					const tinygltf::Image& img = gltf->images[gltf->textures[normalIdx].source];
-					material.m_normal.m_name = resolveTexturePath(img.uri);
-					u32 texelSize = img.component;
-					DXGI_FORMAT format = img.component == 4 ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_B8G8R8X8_UNORM;
-					if(!framework::RenderResources::createTexture2D(device, ctx, img.width, img.height, texelSize, format, img.image.data(), material.m_normal))
+					if (!createMaterialTexture(device, ctx, gltf, normalIdx, true, material.m_normal, material.m_normalStream))
 					{
 						printf("Failed to create normal map\n");
 						return false;
 					}
-					material.m_hash |= (1<<GltfScene::NormalMap);
+					record.m_normalTexture = getTextureId(material.m_normal);
+					record.m_normalSampler = getSamplerIdx(normalIdx);
+					record.m_normalScale = static_cast<f32>(gltfMat.normalTexture.scale);
+					record.m_hash |= (1<<GltfScene::NormalMap);
 				}
 			}
+
+			// Factors
+			const std::vector<double>& baseColor = gltfMat.pbrMetallicRoughness.baseColorFactor;
+			for (u32 c = 0; c < 4 && c < static_cast<u32>(baseColor.size()); ++c)
+			{
+				record.m_baseColorFactor[c] = static_cast<f32>(baseColor[c]);
+			}
+			for (u32 c = 0; c < 3 && c < static_cast<u32>(gltfMat.emissiveFactor.size()); ++c)
+			{
+				record.m_emissiveFactor[c] = static_cast<f32>(gltfMat.emissiveFactor[c]);
+			}
+			record.m_metallicFactor = static_cast<f32>(gltfMat.pbrMetallicRoughness.metallicFactor);
+			record.m_roughnessFactor = static_cast<f32>(gltfMat.pbrMetallicRoughness.roughnessFactor);
+			if (gltfMat.alphaMode == "MASK")
+			{
+				record.m_alphaCutoff = static_cast<f32>(gltfMat.alphaCutoff);
+				record.m_hash |= (1<<GltfScene::AlphaTest);
+			}
+			if (gltfMat.doubleSided)
+			{
+				record.m_hash |= (1<<GltfScene::DoubleSided);
+			}
+			material.m_hash = record.m_hash;
+		}
+		return true;
+	}
+
+	void GltfScene::computeMaterialSortIds()
+	{
+		static constexpr u32 s_keyCount = 7;
+		struct SortEntry
+		{
+			u32 m_keys[s_keyCount];
+			u32 m_material;
+		};
+		Vector<SortEntry> entries(m_materials.size());
+		for (u32 i = 0; i < static_cast<u32>(m_materials.size()); ++i)
+		{
+			const SurfaceMaterial& material = m_materials[i];
+			const MaterialRecord& record = material.m_record;
+			// Shader variant, then the texture arrays when packed (materials in the same arrays can be batched), then textures and samplers
+			SortEntry& entry = entries[i];
+			entry.m_keys[0] = record.m_hash;
+			entry.m_keys[1] = material.m_albedoSlot.m_array;
+			entry.m_keys[2] = material.m_normalSlot.m_array;
+			entry.m_keys[3] = record.m_albedoTexture;
+			entry.m_keys[4] = record.m_normalTexture;
+			entry.m_keys[5] = record.m_albedoSampler | (record.m_normalSampler << 16);
+			entry.m_keys[6] = static_cast<u32>(Hash::compute(&record, sizeof(MaterialRecord)));
+			entry.m_material = i;
+		}
+		std::sort(entries.begin(), entries.end(), [](const SortEntry& a, const SortEntry& b)
+		{
+			if (std::equal(a.m_keys, a.m_keys + s_keyCount, b.m_keys))
+			{
+				return a.m_material < b.m_material;
+			}
+			return std::lexicographical_compare(a.m_keys, a.m_keys + s_keyCount, b.m_keys, b.m_keys + s_keyCount);
+		});
+
+		// Identical records share the id
+		u32 sortId = 0;
+		for (u32 i = 0; i < static_cast<u32>(entries.size()); ++i)
+		{
+			if (i > 0 && memcmp(&m_materials[entries[i].m_material].m_record, &m_materials[entries[i - 1].m_material].m_record, sizeof(MaterialRecord)) != 0)
+			{
+				sortId++;
+			}
+			m_materials[entries[i].m_material].m_sortId = sortId;
+		}
+	}
+
+	bool GltfScene::packMaterialTextures(ID3D11Device* device, ID3D11DeviceContext* ctx)
+	{
+		m_texturePacker.clear();
+		for (SurfaceMaterial& material : m_materials)
+		{
+			if (material.m_albedo)
+			{
+				material.m_albedoSlot = m_texturePacker.add(*material.m_albedo);
+			}
+			if (material.m_normal)
+			{
+				material.m_normalSlot = m_texturePacker.add(*material.m_normal);
+			}
+		}
+		if (!m_texturePacker.build(device, ctx))
+		{
+			printf("Failed to pack material textures\n");
+			return false;
+		}
+		printf("Material textures: packed in %u texture arrays\n", m_texturePacker.getArrayCount());
+
+		// The arrays hold a copy, drop the references to the individual textures
+		for (SurfaceMaterial& material : m_materials)
+		{
+			material.m_albedo = nullptr;
+			material.m_normal = nullptr;
 		}
 		return true;
 	}
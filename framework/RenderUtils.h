@@ -73,11 +73,14 @@ namespace framework
 			const char* entryFS,
 			D3D11_INPUT_ELEMENT_DESC* vertexAttributes, u32 vertexAttribCount);
 
+		// Includes are resolved relative to srcAbsPath when given. Pipelines without vertex attributes (vertices generated from
+		// SV_VertexID) get no input layout, and without entryFS no pixel shader (depth only)
 		bool createGraphicsPipeline(ID3D11Device* device,
 			const char* src, const size_t srcSize,
 			const char* entryVS,
 			const char* entryFS,
-			D3D11_INPUT_ELEMENT_DESC* vertexAttributes, u32 vertexAttribCount);
+			D3D11_INPUT_ELEMENT_DESC* vertexAttributes, u32 vertexAttribCount,
+			const char* srcAbsPath = nullptr);
 
 		void bind(ID3D11DeviceContext* ctx);
 
@@ -88,6 +91,24 @@ namespace framework
 		ID3D11PixelShader* m_fragmentShader = nullptr;
 	};
 
+	class ComputePipeline
+	{
+	public:
+
+		~ComputePipeline();
+
+		bool loadComputePipeline(ID3D11Device* device, const char* srcRelPath, const char* entryCS);
+
+		// Includes are resolved relative to srcAbsPath when given
+		bool createComputePipeline(ID3D11Device* device, const char* src, const size_t srcSize, const char* entryCS, const char* srcAbsPath = nullptr);
+
+		void bind(ID3D11DeviceContext* ctx);
+
+	private:
+
+		ID3D11ComputeShader* m_computeShader = nullptr;
+	};
+
 	struct Texture2D
 	{
 		~Texture2D()
@@ -113,6 +134,10 @@ namespace framework
 	{
 		~DepthAttachment()
 		{
+			if (m_SRV)
+			{
+				m_SRV->Release();
+			}
 			if (m_depthStencilView)
 			{
 				m_depthStencilView->Release();
@@ -125,6 +150,139 @@ namespace framework
 
 		ID3D11DepthStencilView* m_depthStencilView = nullptr;
 		ID3D11Texture2D* m_depthStencilTexture = nullptr;
+		ID3D11ShaderResourceView* m_SRV = nullptr; // Only for shader readable attachments
+	};
+
+	struct RenderTarget
+	{
+		~RenderTarget()
+		{
+			if (m_SRV)
+			{
+				m_SRV->Release();
+			}
+			if (m_RTV)
+			{
+				m_RTV->Release();
+			}
+			if (m_texture)
+			{
+				m_texture->Release();
+			}
+		}
+
+		ID3D11Texture2D* m_texture = nullptr;
+		ID3D11RenderTargetView* m_RTV = nullptr;
+		ID3D11ShaderResourceView* m_SRV = nullptr;
+	};
+
+	// Dynamic structured buffer read by shaders. Grows when updated with more elements than it fits
+	struct StructuredBuffer
+	{
+		~StructuredBuffer()
+		{
+			if (m_SRV)
+			{
+				m_SRV->Release();
+				m_SRV = nullptr;
+			}
+			if (m_buffer)
+			{
+				m_buffer->Release();
+				m_buffer = nullptr;
+			}
+		}
+
+		ID3D11Buffer* m_buffer = nullptr;
+		ID3D11ShaderResourceView* m_SRV = nullptr;
+		u32 m_elementSize = 0;
+		u32 m_capacity = 0; // In elements
+	};
+
+	// Byte address buffer written by compute shaders, e.g. indirect draw arguments or counters
+	struct RawBuffer
+	{
+		~RawBuffer()
+		{
+			if (m_UAV)
+			{
+				m_UAV->Release();
+				m_UAV = nullptr;
+			}
+			if (m_SRV)
+			{
+				m_SRV->Release();
+				m_SRV = nullptr;
+			}
+			if (m_buffer)
+			{
+				m_buffer->Release();
+				m_buffer = nullptr;
+			}
+		}
+
+		ID3D11Buffer* m_buffer = nullptr;
+		ID3D11ShaderResourceView* m_SRV = nullptr;
+		ID3D11UnorderedAccessView* m_UAV = nullptr;
+		u32 m_size = 0; // In bytes
+	};
+
+	// Texture written by compute shaders, with views of every mip to build mip chains level by level
+	struct RWTexture2D
+	{
+		~RWTexture2D()
+		{
+			for (ID3D11UnorderedAccessView* view : m_mipUAVs)
+			{
+				if (view)
+				{
+					view->Release();
+				}
+			}
+			for (ID3D11ShaderResourceView* view : m_mipSRVs)
+			{
+				if (view)
+				{
+					view->Release();
+				}
+			}
+			if (m_SRV)
+			{
+				m_SRV->Release();
+				m_SRV = nullptr;
+			}
+			if (m_texture)
+			{
+				m_texture->Release();
+				m_texture = nullptr;
+			}
+		}
+
+		ID3D11Texture2D* m_texture = nullptr;
+		ID3D11ShaderResourceView* m_SRV = nullptr; // All the mips
+		Vector<ID3D11ShaderResourceView*> m_mipSRVs;
+		Vector<ID3D11UnorderedAccessView*> m_mipUAVs;
+		u32 m_width = 0;
+		u32 m_height = 0;
+	};
+
+	// Physical textures of the transient ones of a compiled RenderGraph, depth targets are shader readable. They are kept
+	// while the graph compiles to the same physical textures, so a graph described every frame doesn't recreate them
+	class RenderGraphTargets
+	{
+	public:
+
+		bool update(ID3D11Device* device, const RenderGraph& graph);
+
+		// nullptr for imported textures, unused ones or the other kind
+		RenderTarget* getRenderTarget(const RenderGraph& graph, RenderGraph::ResourceHandle handle) const;
+		DepthAttachment* getDepthAttachment(const RenderGraph& graph, RenderGraph::ResourceHandle handle) const;
+
+	private:
+
+		Vector<RenderGraph::TextureDesc> m_descs;
+		Vector<UniquePtr<RenderTarget>> m_renderTargets; // Per physical texture, null for depth targets
+		Vector<UniquePtr<DepthAttachment>> m_depthAttachments; // Per physical texture, null for color targets
 	};
 
 	class RenderResources
@@ -140,13 +298,37 @@ namespace framework
 		static bool updateMappableCBData(ID3D11DeviceContext* ctx, ID3D11Buffer* cBuffer, const void* data, u32 size);
 
 		// Texture resources
-		static bool loadTexture2D(ID3D11Device* device, ID3D11DeviceContext* ctx, const char* fileRelPath, DXGI_FORMAT format, Texture2D& outTexture);
-		static bool createTexture2D(ID3D11Device* device, ID3D11DeviceContext* ctx, u32 w, u32 h, u32 texelSize, DXGI_FORMAT format, const void* data, Texture2D& outTexture);
+		// DDS and KTX2 files are created from the mapped file with the mips they contain. Other images go through ImageDecoders (WIC first, then stb_image).
+		// RGBA8 textures get their mips generated on the CPU and are created immutable, other formats use GenerateMips.
+		// downscaleLog2 drops the most detailed mips: images are downscaled while decoding, containers skip their first levels
+		static bool loadTexture2D(ID3D11Device* device, ID3D11DeviceContext* ctx, const char* fileRelPath, DXGI_FORMAT format, Texture2D& outTexture, 
+			MipGenerator::Filter mipFilter = MipGenerator::Filter::Box, u32 downscaleLog2 = 0);
+		static bool createTexture2D(ID3D11Device* device, ID3D11DeviceContext* ctx, u32 w, u32 h, u32 texelSize, DXGI_FORMAT format, const void* data, Texture2D& outTexture, 
+			MipGenerator::Filter mipFilter = MipGenerator::Filter::Box);
+		static bool createTexture2D(ID3D11Device* device, const MipChain& mipChain, DXGI_FORMAT format, Texture2D& outTexture);
+		static bool createTexture2D(ID3D11Device* device, const TextureLevels& levels, Texture2D& outTexture);
+		static bool isFormatSRGB(DXGI_FORMAT format);
 		static ID3D11SamplerState* createSamplerState(ID3D11Device* device, D3D11_FILTER filter, D3D11_TEXTURE_ADDRESS_MODE addressMode);
 
-		// Depth attachments
-		static bool createDepthAttachment(ID3D11Device* device, u32 width, u32 height, DXGI_FORMAT format, DepthAttachment& outDepthAttachment);
-		static ID3D11DepthStencilState* createDepthStencilState(ID3D11Device* device, D3D11_COMPARISON_FUNC func);
+		// Depth attachments. Shader readable ones get a view of the depth (D24_UNORM_S8_UINT and D32_FLOAT only)
+		static bool createDepthAttachment(ID3D11Device* device, u32 width, u32 height, DXGI_FORMAT format, DepthAttachment& outDepthAttachment, bool isShaderReadable = false);
+
+		// Color render targets, readable by shaders
+		static bool createRenderTarget(ID3D11Device* device, u32 width, u32 height, DXGI_FORMAT format, RenderTarget& outRenderTarget);
+		static ID3D11DepthStencilState* createDepthStencilState(ID3D11Device* device, D3D11_COMPARISON_FUNC func, bool isWriteEnabled = true);
+
+		// Structured buffers
+		static bool updateStructuredBuffer(ID3D11Device* device, ID3D11DeviceContext* ctx, const void* data, u32 elementSize, u32 elementCount, StructuredBuffer& buffer);
+
+		// Compute resources. Indirect argument buffers can be passed to DrawIndexedInstancedIndirect
+		static bool createRawBuffer(ID3D11Device* device, u32 size, bool isIndirectArgs, RawBuffer& outBuffer);
+		static bool createRWTexture2D(ID3D11Device* device, u32 width, u32 height, u32 mipCount, DXGI_FORMAT format, RWTexture2D& outTexture);
+
+		// Staging buffer to copy GPU data to and map it for reading
+		static ID3D11Buffer* createReadbackBuffer(ID3D11Device* device, u32 size);
+		// Copies GPU data back to memory, waiting for the GPU. For debugging and validation. Textures are returned row by row without padding
+		static bool readbackBuffer(ID3D11Device* device, ID3D11DeviceContext* ctx, ID3D11Buffer* buffer, u32 size, void* outData);
+		static bool readbackTexture2D(ID3D11Device* device, ID3D11DeviceContext* ctx, ID3D11Texture2D* texture, u32 mip, u32 texelSize, Vector<u8>& outData);
 
 		// Vertex index buffer helpers
 		static ID3D11Buffer* createVertexBuffer(ID3D11Device* device, u32 bufferSize, void* initialData);
@@ -192,11 +374,35 @@ namespace framework
 			v2 m_uv;
 		};
 
+		static constexpr u32 s_invalidTexture = 0xFFFFFFFF;
+
+		// Plain data of a material, hashed to find materials that render the same
+		struct MaterialRecord 
+		{
+			u32 m_hash = 0; // MaterialHashFlags, selects the shader variant
+			u32 m_albedoTexture = s_invalidTexture; // Texture ids, equal for materials sharing a texture
+			u32 m_normalTexture = s_invalidTexture;
+			u32 m_albedoSampler = 0; // Index in getSamplers()
+			u32 m_normalSampler = 0;
+			f32 m_metallicFactor = 1.0f;
+			f32 m_roughnessFactor = 1.0f;
+			f32 m_normalScale = 1.0f;
+			v4 m_baseColorFactor = v4(1.0f);
+			v3 m_emissiveFactor = v3(0.0f);
+			f32 m_alphaCutoff = 0.5f; // Only with AlphaTest
+		};
+
 		struct SurfaceMaterial 
 		{
-			framework::Texture2D m_albedo;
-			framework::Texture2D m_normal;
-			u32 m_hash;
+			SharedPtr<framework::Texture2D> m_albedo; // Shared with other materials using the same image (see TextureCache)
+			SharedPtr<framework::Texture2D> m_normal;
+			MaterialRecord m_record;
+			u32 m_sortId = 0; // Equal for materials with the same record. Ordered by shader variant, textures and samplers
+			u32 m_hash = 0; // Same as m_record.m_hash
+			u32 m_albedoStream = TextureStreamer::s_invalidHandle; // Only when streaming textures
+			u32 m_normalStream = TextureStreamer::s_invalidHandle;
+			TextureArrayPacker::Slot m_albedoSlot; // Only when packing textures, m_albedo and m_normal are released then
+			TextureArrayPacker::Slot m_normalSlot;
 		};
 
 		struct Node 
@@ -213,6 +419,10 @@ namespace framework
 			u32 m_indexCount;
 			u32 m_material;
 			bool m_isIndexShort = false;
+			v3 m_boundsCenter = v3(0.0f); // Bounding sphere in mesh space, centered on the bounding box
+			f32 m_boundsRadius = 0.0f;
+			v3 m_boundsExtents = v3(0.0f); // Half size of the bounding box in mesh space
+			f32 m_uvDensity = 0.0f; // UV units per mesh space unit, used to pick the texture mips to stream
 		};
 
 		struct Mesh 
@@ -223,34 +433,103 @@ namespace framework
 		enum MaterialHashFlags 
 		{
 			NormalMap = 0,
+			AlphaTest, // glTF MASK alpha mode
+			DoubleSided, // Back faces are not culled and use the flipped normal
 			COUNT
 		};
 
-		bool loadGLTF(ID3D11Device* device, ID3D11DeviceContext* ctx,const char* fileRelPath);
+		enum LoadFlags : u32
+		{
+			SplitLargePrimitives = 1<<0, // Split primitives with too many vertices for 16 bit indices into several meshlets
+			WeldVertices = 1<<1, // Deduplicate vertices inside and across primitives
+			CookTextures = 1<<2, // Block compress textures and cache them (see TextureCooker)
+			StreamTextures = 1<<3, // Stream the mips of cooked textures based on visibility (see TextureStreamer). Requires CookTextures
+			PackTextures = 1<<4, // Pack the material textures into texture arrays (see TextureArrayPacker). Ignored when streaming textures
+			KeepCpuGeometry = 1<<5, // Keep a copy of the positions and indices in memory, e.g. to rasterize occluders on the CPU
+		};
+
+		GltfScene() {}
+		~GltfScene();
+		GltfScene(const GltfScene&) = delete;
+		GltfScene& operator=(const GltfScene&) = delete;
+
+		bool loadGLTF(ID3D11Device* device, ID3D11DeviceContext* ctx,const char* fileRelPath, u32 loadFlags = 0);
+
+		// Max distance between attributes of vertices that get welded (0 means exact match). Set before loading
+		void setWeldEpsilon(f32 epsilon) { m_weldEpsilon = epsilon; }
+
+		// Quality used to cook textures when loading with CookTextures. Set before loading
+		void setTextureQuality(BlockCompressor::Quality quality) { m_textureQuality = quality; }
+
+		// Decode the textures at 1/2^downscaleLog2 of their size, for quick loads with low detail textures.
+		// Ignored with CookTextures, cooked textures keep every mip. Set before loading
+		void setTextureDownscale(u32 downscaleLog2) { m_textureDownscaleLog2 = downscaleLog2; }
+
+		// Set before loading with StreamTextures
+		void setTextureStreamingConfig(const TextureStreamer::Config& config) { m_textureStreamer.setConfig(config); }
+
+		// Request the texture mips needed by the meshlets in view and stream them. Call once per frame
+		void updateTextureStreaming(ID3D11Device* device, ID3D11DeviceContext* ctx, const m4& view, const m4& projection, u32 viewportHeight);
+		const TextureStreamer& getTextureStreamer() const { return m_textureStreamer; }
+
+		// Set before loading to share textures with other scenes
+		void setTextureCache(const SharedPtr<TextureCache>& cache) { m_textureCache = cache; }
+		const SharedPtr<TextureCache>& getTextureCache() const { return m_textureCache; }
 
 		ID3D11Buffer* getPackedVertexBuffer() const { return m_vertexBuffer; }
 		ID3D11Buffer* getPackedIndexBuffer() const { return m_indexBuffer; }
+		// Only with KeepCpuGeometry. Same layout as the GPU buffers: index the positions with the meshlet vertex offset
+		const Vector<v3>& getCpuPositions() const { return m_cpuPositions; }
+		const Vector<u8>& getCpuIndexData() const { return m_cpuIndexData; }
 		const Vector<Mesh>& getMeshes() const { return m_meshes; }
-		const Vector<SurfaceMaterial> getMaterials() const { return m_materials; }
+		const Vector<SurfaceMaterial>& getMaterials() const { return m_materials; }
 		const Vector<Node>& getNodes() const { return m_nodes; }
+		// Sampler states of the glTF samplers, deduplicated. The first one is the default (linear, wrap)
+		const Vector<ID3D11SamplerState*>& getSamplers() const { return m_samplers; }
+		const TextureArrayPacker& getTextureArrays() const { return m_texturePacker; }
 
 		u32 getVertexBuff0OffsetBytes(const Meshlet& meshlet) const { return meshlet.m_vertexOffset * static_cast<u32>(sizeof(VertexBuffer0)); }
 		u32 getVertexBuff1OffsetBytes(const Meshlet& meshlet) const { return m_vertexBuff1OffsetBytes + meshlet.m_vertexOffset * static_cast<u32>(sizeof(VertexBuffer1)); }
+		// Offset of VertexBuff1 for the whole buffer. Use with the meshlet vertex offset as base vertex
+		u32 getVertexBuff1BaseOffsetBytes() const { return m_vertexBuff1OffsetBytes; }
 
 	private:
 
 		void setupNodeHierarchy(tinygltf::Model* gltf, s32 nodeIdx, const m4& parentModel = m4(1.0f));
 		bool setupGeometry(ID3D11Device* device, tinygltf::Model* gltf);
 		bool setupMaterials(ID3D11Device* device, ID3D11DeviceContext* ctx, tinygltf::Model* gltf);
+		u32 weldVertices(u32 vertexCount, Vector<u8>& indexData, UniquePtr<char[]>& inOutVertexData);
+		bool registerBuffers(tinygltf::Model* gltf, const u8* glbBinChunk, u32 glbBinChunkSize);
+		bool acquireAccessorData(tinygltf::Model* gltf, const tinygltf::Accessor& accessor, u32 firstElement, u32 elementCount, AccessorUtils::Stream& outStream);
+		bool loadImage(tinygltf::Model* gltf, tinygltf::Image& img);
+		u64 computeImageHash(tinygltf::Model* gltf, const tinygltf::Image& img);
+		bool setupSamplers(ID3D11Device* device, tinygltf::Model* gltf);
+		void computeMaterialSortIds();
+		bool packMaterialTextures(ID3D11Device* device, ID3D11DeviceContext* ctx);
+		bool createMaterialTexture(ID3D11Device* device, ID3D11DeviceContext* ctx, tinygltf::Model* gltf, s32 textureIdx, bool isNormalMap, SharedPtr<Texture2D>& outTexture, u32& outStreamHandle);
+		bool createTexture(ID3D11Device* device, ID3D11DeviceContext* ctx, tinygltf::Model* gltf, tinygltf::Image& img, u64 imageHash, 
+			bool isNormalMap, Texture2D& outTexture, u32& outStreamHandle);
 		String resolveTexturePath(const String& relPath) const;
 
 
 		ID3D11Buffer* m_vertexBuffer = nullptr;
 		ID3D11Buffer* m_indexBuffer = nullptr;
+		Vector<v3> m_cpuPositions;
+		Vector<u8> m_cpuIndexData;
 		u32 m_vertexBuff1OffsetBytes; // Delta to apply to calculate offset in bytes for VertexBuff1 for each meshlet
 		Vector<Mesh> m_meshes;
 		Vector<SurfaceMaterial> m_materials;
+		Vector<ID3D11SamplerState*> m_samplers;
+		Vector<u32> m_gltfSamplerMap; // glTF sampler -> m_samplers
 		Vector<Node> m_nodes;
 		String m_basePath;
+		u32 m_loadFlags = 0;
+		f32 m_weldEpsilon = 0.0f;
+		BlockCompressor::Quality m_textureQuality = BlockCompressor::Quality::High;
+		u32 m_textureDownscaleLog2 = 0;
+		TextureStreamer m_textureStreamer;
+		SharedPtr<TextureCache> m_textureCache = std::make_shared<TextureCache>();
+		TextureArrayPacker m_texturePacker;
+		GltfBufferReader m_bufferReader; // Only valid while loading
 	};
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include "framework/Types.h"
+#include "framework/Debug.h"
+#include "framework/RingAllocator.h"
+
+namespace framework
+{
+
+	void RingAllocator::reset(u64 capacity)
+	{
+		m_capacity = capacity;
+		m_head = 0;
+		m_tail = 0;
+	}
+
+	bool RingAllocator::allocate(u64 size, u64 alignment, u64& outPosition)
+	{
+		if (size == 0 || size > m_capacity)
+		{
+			return false;
+		}
+		u64 position = (m_head + alignment - 1) & ~(alignment - 1);
+		if (getOffset(position) + size > m_capacity)
+		{
+			// Skip to the start of the ring
+			position = (position / m_capacity + 1) * m_capacity;
+		}
+		if (position + size - m_tail > m_capacity)
+		{
+			return false;
+		}
+		m_head = position + size;
+		outPosition = position;
+		return true;
+	}
+
+	void RingAllocator::release(u64 position)
+	{
+		VERIFY(position >= m_tail && position <= m_head, "Releasing outside the allocated range");
+		m_tail = position;
+	}
+
+}
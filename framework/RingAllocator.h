@@ -0,0 +1,35 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// Allocates ranges of a ring in FIFO order. Positions grow forever, the offset in the ring is position % capacity.
+	// Allocations never wrap around the end of the ring, the remaining space is skipped instead. Not thread safe
+	class RingAllocator
+	{
+	public:
+
+		explicit RingAllocator(u64 capacity = 0) : m_capacity(capacity) {}
+
+		void reset(u64 capacity);
+
+		// False if there is not enough free space. alignment must be a power of 2
+		bool allocate(u64 size, u64 alignment, u64& outPosition);
+
+		// Free everything allocated before position
+		void release(u64 position);
+
+		u64 getOffset(u64 position) const { return position % m_capacity; }
+		u64 getHead() const { return m_head; }
+		u64 getUsedBytes() const { return m_head - m_tail; }
+		u64 getCapacity() const { return m_capacity; }
+
+	private:
+
+		u64 m_capacity;
+		u64 m_head = 0;
+		u64 m_tail = 0;
+	};
+}
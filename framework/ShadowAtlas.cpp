@@ -0,0 +1,313 @@
+#include "framework/Types.h"
+#include "framework/ShadowAtlas.h"
+
+#include <cstdio>
+
+namespace framework
+{
+
+	static bool isPowerOf2(u32 value)
+	{
+		return value && (value & (value - 1)) == 0;
+	}
+
+	static u32 getLog2(u32 value)
+	{
+		u32 log = 0;
+		while (value > 1)
+		{
+			value >>= 1;
+			log++;
+		}
+		return log;
+	}
+
+	bool ShadowAtlasAllocator::init(u32 atlasSize, u32 minTileSize)
+	{
+		if (!isPowerOf2(atlasSize) || !isPowerOf2(minTileSize) || minTileSize > atlasSize || getLog2(atlasSize / minTileSize) > 12)
+		{
+			printf("Invalid shadow atlas size\n");
+			return false;
+		}
+		m_atlasSize = atlasSize;
+		m_levelCount = getLog2(atlasSize / minTileSize) + 1;
+		m_nodes.assign(getLevelOffset(m_levelCount), Absent);
+		m_freeNodes.clear();
+		m_freeNodes.resize(m_levelCount);
+		addFree(0, 0);
+		return true;
+	}
+
+	void ShadowAtlasAllocator::getNodeCoords(u32 node, u32& outLevel, u32& outX, u32& outY) const
+	{
+		u32 level = 0;
+		while (node >= getLevelOffset(level + 1))
+		{
+			level++;
+		}
+		const u32 localIdx = node - getLevelOffset(level);
+		outLevel = level;
+		outX = localIdx & ((1u << level) - 1);
+		outY = localIdx >> level;
+	}
+
+	void ShadowAtlasAllocator::addFree(u32 level, u32 node)
+	{
+		m_nodes[node] = Free;
+		m_freeNodes[level].push_back(node);
+	}
+
+	void ShadowAtlasAllocator::removeFree(u32 level, u32 node)
+	{
+		Vector<u32>& freeNodes = m_freeNodes[level];
+		auto it = std::find(freeNodes.begin(), freeNodes.end(), node);
+		if (it != freeNodes.end())
+		{
+			*it = freeNodes.back();
+			freeNodes.pop_back();
+		}
+	}
+
+	bool ShadowAtlasAllocator::allocate(u32 size, Tile& outTile)
+	{
+		if (m_levelCount == 0)
+		{
+			return false;
+		}
+		size = glm::clamp(size, getMinTileSize(), m_atlasSize);
+		const u32 level = getLog2(m_atlasSize / size); // Deepest level with tiles of at least size texels
+
+		// Smallest free node that fits, split down to the wanted level
+		s32 freeLevel = static_cast<s32>(level);
+		while (freeLevel >= 0 && m_freeNodes[freeLevel].empty())
+		{
+			freeLevel--;
+		}
+		if (freeLevel < 0)
+		{
+			return false;
+		}
+		u32 node = m_freeNodes[freeLevel].back();
+		m_freeNodes[freeLevel].pop_back();
+		u32 nodeLevel, x, y;
+		getNodeCoords(node, nodeLevel, x, y);
+		for (; nodeLevel < level; ++nodeLevel)
+		{
+			m_nodes[node] = Split;
+			x *= 2;
+			y *= 2;
+			addFree(nodeLevel + 1, getNodeIdx(nodeLevel + 1, x + 1, y));
+			addFree(nodeLevel + 1, getNodeIdx(nodeLevel + 1, x, y + 1));
+			addFree(nodeLevel + 1, getNodeIdx(nodeLevel + 1, x + 1, y + 1));
+			node = getNodeIdx(nodeLevel + 1, x, y);
+		}
+		m_nodes[node] = Used;
+
+		outTile.m_size = m_atlasSize >> level;
+		outTile.m_x = x * outTile.m_size;
+		outTile.m_y = y * outTile.m_size;
+		outTile.m_node = node;
+		return true;
+	}
+
+	void ShadowAtlasAllocator::release(const Tile& tile)
+	{
+		if (tile.m_node >= m_nodes.size() || m_nodes[tile.m_node] != Used)
+		{
+			return;
+		}
+		u32 node = tile.m_node;
+		u32 level, x, y;
+		getNodeCoords(node, level, x, y);
+		addFree(level, node);
+
+		// Merge free siblings into their parent
+		while (level > 0)
+		{
+			const u32 firstX = x & ~1u;
+			const u32 firstY = y & ~1u;
+			const u32 siblings[] = {getNodeIdx(level, firstX, firstY), getNodeIdx(level, firstX + 1, firstY), getNodeIdx(level, firstX, firstY + 1), getNodeIdx(level, firstX + 1, firstY + 1)};
+			for (u32 sibling : siblings)
+			{
+				if (m_nodes[sibling] != Free)
+				{
+					return;
+				}
+			}
+			for (u32 sibling : siblings)
+			{
+				removeFree(level, sibling);
+				m_nodes[sibling] = Absent;
+			}
+			level--;
+			x /= 2;
+			y /= 2;
+			addFree(level, getNodeIdx(level, x, y));
+		}
+	}
+
+	u64 ShadowAtlasAllocator::getFreeArea() const
+	{
+		u64 area = 0;
+		for (u32 level = 0; level < m_levelCount; ++level)
+		{
+			const u64 size = m_atlasSize >> level;
+			area += m_freeNodes[level].size() * size * size;
+		}
+		return area;
+	}
+
+	// ----------------------------------------------------------------------
+
+	bool ShadowAtlas::init(const Config& config)
+	{
+		m_config = config;
+		m_entries.clear();
+		m_results.clear();
+		m_renderList.clear();
+		m_frame = 0;
+		return m_allocator.init(config.m_size, config.m_minTileSize);
+	}
+
+	bool ShadowAtlas::allocate(u32 size, ShadowAtlasAllocator::Tile& outTile)
+	{
+		for (; size >= m_allocator.getMinTileSize(); size /= 2)
+		{
+			while (!m_allocator.allocate(size, outTile))
+			{
+				// Views are assigned by importance, so the ones not assigned yet are less important. Evict the one that has gone
+				// longest without being requested, then the least important one
+				auto victim = m_entries.end();
+				for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+				{
+					const Entry& entry = it->second;
+					if (entry.m_assignedFrame == m_frame)
+					{
+						continue;
+					}
+					if (victim == m_entries.end())
+					{
+						victim = it;
+						continue;
+					}
+					const Entry& victimEntry = victim->second;
+					const bool isRequested = entry.m_lastRequestedFrame == m_frame;
+					const bool isVictimRequested = victimEntry.m_lastRequestedFrame == m_frame;
+					if (isRequested != isVictimRequested)
+					{
+						victim = isRequested ? victim : it;
+					}
+					else if (isRequested ? (entry.m_importance < victimEntry.m_importance) : (entry.m_lastRequestedFrame < victimEntry.m_lastRequestedFrame))
+					{
+						victim = it;
+					}
+				}
+				if (victim == m_entries.end())
+				{
+					break;
+				}
+				m_allocator.release(victim->second.m_tile);
+				m_entries.erase(victim);
+			}
+			if (outTile.m_node != ShadowAtlasAllocator::s_invalidNode)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void ShadowAtlas::update(const Request* requests, u32 count)
+	{
+		m_frame++;
+		m_results.assign(count, Result());
+		m_renderList.clear();
+
+		m_order.resize(count);
+		for (u32 i = 0; i < count; ++i)
+		{
+			m_order[i] = i;
+		}
+		std::stable_sort(m_order.begin(), m_order.end(), [requests](u32 a, u32 b)
+		{
+			return requests[a].m_importance > requests[b].m_importance;
+		});
+
+		// Mark the cached views that are still wanted, and give back the tiles of views that want another size
+		for (u32 i = 0; i < count; ++i)
+		{
+			auto it = m_entries.find(requests[i].m_key);
+			if (it == m_entries.end())
+			{
+				continue;
+			}
+			it->second.m_lastRequestedFrame = m_frame;
+			it->second.m_importance = requests[i].m_importance;
+			if (it->second.m_requestedSize != requests[i].m_size)
+			{
+				m_allocator.release(it->second.m_tile);
+				m_entries.erase(it);
+			}
+		}
+
+		for (u32 requestIdx : m_order)
+		{
+			const Request& request = requests[requestIdx];
+			auto it = m_entries.find(request.m_key);
+			if (it == m_entries.end())
+			{
+				Entry entry;
+				entry.m_lastRequestedFrame = m_frame;
+				entry.m_assignedFrame = m_frame;
+				entry.m_importance = request.m_importance;
+				entry.m_requestedSize = request.m_size;
+				if (request.m_size == 0 || !allocate(request.m_size, entry.m_tile))
+				{
+					continue; // No space left, even at the smallest size
+				}
+				it = m_entries.emplace(request.m_key, entry).first;
+			}
+
+			Entry& entry = it->second;
+			entry.m_assignedFrame = m_frame;
+			entry.m_boundsCenter = request.m_boundsCenter;
+			entry.m_boundsRadius = request.m_boundsRadius;
+			if (entry.m_viewHash != request.m_viewHash)
+			{
+				entry.m_viewHash = request.m_viewHash;
+				entry.m_hasContent = false;
+			}
+			if (!entry.m_hasContent && m_renderList.size() < m_config.m_maxRendersPerFrame)
+			{
+				m_renderList.push_back(requestIdx);
+				entry.m_hasContent = true;
+			}
+
+			Result& result = m_results[requestIdx];
+			result.m_tile = entry.m_tile;
+			result.m_hasTile = true;
+			result.m_isValid = entry.m_hasContent;
+		}
+	}
+
+	void ShadowAtlas::invalidate(const v3& center, f32 radius)
+	{
+		for (auto& entry : m_entries)
+		{
+			const f32 maxDistance = radius + entry.second.m_boundsRadius;
+			if (glm::length2(entry.second.m_boundsCenter - center) < maxDistance * maxDistance)
+			{
+				entry.second.m_hasContent = false;
+			}
+		}
+	}
+
+	void ShadowAtlas::invalidateAll()
+	{
+		for (auto& entry : m_entries)
+		{
+			entry.second.m_hasContent = false;
+		}
+	}
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// Hands out square power of 2 tiles of a shadow atlas. Quadtree stored level by level: a node is free, used, split in
+	// 4 children of half its size or absent (covered by a free or used ancestor). Released siblings are merged back.
+	class ShadowAtlasAllocator
+	{
+	public:
+
+		static constexpr u32 s_invalidNode = 0xFFFFFFFF;
+
+		struct Tile
+		{
+			u32 m_x = 0; // In texels
+			u32 m_y = 0;
+			u32 m_size = 0;
+			u32 m_node = s_invalidNode;
+		};
+
+		// Sizes are powers of 2
+		bool init(u32 atlasSize, u32 minTileSize);
+
+		// The size is rounded up to a power of 2 and clamped to [minTileSize, atlasSize]
+		bool allocate(u32 size, Tile& outTile);
+
+		void release(const Tile& tile);
+
+		u32 getAtlasSize() const { return m_atlasSize; }
+		u32 getMinTileSize() const { return m_atlasSize >> (m_levelCount - 1); }
+		// Texels not in a used tile
+		u64 getFreeArea() const;
+
+	private:
+
+		enum NodeState : u8
+		{
+			Absent = 0,
+			Free,
+			Used,
+			Split,
+		};
+
+		static u32 getLevelOffset(u32 level) { return ((1u << (2 * level)) - 1) / 3; }
+		u32 getNodeIdx(u32 level, u32 x, u32 y) const { return getLevelOffset(level) + y * (1u << level) + x; }
+		void getNodeCoords(u32 node, u32& outLevel, u32& outX, u32& outY) const;
+
+		void addFree(u32 level, u32 node);
+		void removeFree(u32 level, u32 node);
+
+		u32 m_atlasSize = 0;
+		u32 m_levelCount = 0;
+		Vector<u8> m_nodes;
+		Vector<Vector<u32>> m_freeNodes; // Per level
+	};
+
+	// Keeps the shadow views of the frame in atlas tiles across frames, so a tile is only rendered again when what it
+	// shows changes: the view moved (a different view hash) or a caster moved inside its bounds (invalidate).
+	// Every frame:
+	//  - Call update with a request per shadow view. The most important views get their size first, evicting cached views
+	//    that aren't requested and then less important ones. The rest get smaller tiles or none when the atlas is full
+	//  - Render the views in getRenderList into their tiles
+	//  - Sample the views whose result is valid
+	class ShadowAtlas
+	{
+	public:
+
+		struct Config
+		{
+			u32 m_size = 4096;
+			u32 m_minTileSize = 128;
+			u32 m_maxRendersPerFrame = 8; // Views beyond it wait for the next frames, and have no valid tile meanwhile
+		};
+
+		struct Request
+		{
+			u64 m_key = 0; // Stable id of the view, e.g. light and cube face or cascade
+			u64 m_viewHash = 0; // Hash of everything the content depends on, usually the view projection
+			f32 m_importance = 0.0f; // Higher first
+			u32 m_size = 0; // Wanted tile size
+			v3 m_boundsCenter = v3(0.0f); // World space volume seen by the view, to invalidate it when casters move
+			f32 m_boundsRadius = 0.0f;
+		};
+
+		struct Result
+		{
+			ShadowAtlasAllocator::Tile m_tile;
+			bool m_hasTile = false;
+			bool m_isValid = false; // The tile holds this view, rendered this frame or cached
+		};
+
+		bool init(const Config& config);
+
+		void update(const Request* requests, u32 count);
+
+		// Per request of the last update
+		const Vector<Result>& getResults() const { return m_results; }
+		// Requests to render this frame, most important first
+		const Vector<u32>& getRenderList() const { return m_renderList; }
+
+		// Tiles seeing the sphere are rendered again. For casters that move
+		void invalidate(const v3& center, f32 radius);
+		void invalidateAll();
+
+		const ShadowAtlasAllocator& getAllocator() const { return m_allocator; }
+		u32 getCachedCount() const { return static_cast<u32>(m_entries.size()); }
+
+	private:
+
+		struct Entry
+		{
+			ShadowAtlasAllocator::Tile m_tile;
+			u64 m_viewHash = 0;
+			u64 m_lastRequestedFrame = 0;
+			u64 m_assignedFrame = 0; // Got its tile in this update
+			f32 m_importance = 0.0f;
+			u32 m_requestedSize = 0; // The tile can be smaller when the atlas was full
+			v3 m_boundsCenter = v3(0.0f);
+			f32 m_boundsRadius = 0.0f;
+			bool m_hasContent = false;
+		};
+
+		// Evicts views that aren't requested or are less important when the atlas is full, then tries smaller sizes
+		bool allocate(u32 size, ShadowAtlasAllocator::Tile& outTile);
+
+		Config m_config;
+		ShadowAtlasAllocator m_allocator;
+		UMap<u64, Entry> m_entries;
+		u64 m_frame = 0;
+
+		Vector<Result> m_results;
+		Vector<u32> m_renderList;
+		Vector<u32> m_order;
+	};
+}
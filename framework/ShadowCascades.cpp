@@ -0,0 +1,63 @@
+#include "framework/Types.h"
+#include "framework/ShadowCascades.h"
+
+#include <cmath>
+
+namespace framework
+{
+
+	void ShadowCascades::build(const Config& config, const m4& view, const m4& projection, f32 nearPlane, f32 farPlane, const v3& lightDir, u32 resolution)
+	{
+		m_cascadeCount = glm::clamp(config.m_cascadeCount, 1u, s_maxCascades);
+		const f32 shadowFar = glm::max(glm::min(farPlane, config.m_maxDistance), nearPlane * 2.0f);
+		const m4 invView = glm::inverse(view);
+
+		// Squared distance from the view axis to the frustum corners, per unit of depth
+		const f32 tanX = 1.0f / projection[0][0];
+		const f32 tanY = 1.0f / projection[1][1];
+		const f32 cornerSlope2 = tanX * tanX + tanY * tanY;
+
+		// The light view only rotates, the cascades translate in its space
+		const v3 dir = glm::normalize(lightDir);
+		const v3 up = (glm::abs(dir.y) > 0.99f) ? v3(1.0f, 0.0f, 0.0f) : v3(0.0f, 1.0f, 0.0f);
+		const m4 lightView = glm::lookAt(v3(0.0f), dir, up);
+
+		f32 splitNear = nearPlane;
+		for (u32 i = 0; i < m_cascadeCount; ++i)
+		{
+			const f32 t = static_cast<f32>(i + 1) / m_cascadeCount;
+			const f32 logSplit = nearPlane * powf(shadowFar / nearPlane, t);
+			const f32 uniformSplit = nearPlane + (shadowFar - nearPlane) * t;
+			const f32 splitFar = glm::mix(uniformSplit, logSplit, config.m_splitLambda);
+
+			// Smallest sphere around the frustum slice: on the view axis, as far from the near corners as from the far ones
+			f32 centerDepth = 0.5f * (splitNear + splitFar) * (1.0f + cornerSlope2);
+			f32 radius;
+			if (centerDepth > splitFar)
+			{
+				centerDepth = splitFar;
+				radius = splitFar * sqrtf(cornerSlope2);
+			}
+			else
+			{
+				radius = sqrtf((splitFar - centerDepth) * (splitFar - centerDepth) + splitFar * splitFar * cornerSlope2);
+			}
+
+			Cascade& cascade = m_cascades[i];
+			cascade.m_splitFar = splitFar;
+			cascade.m_radius = radius;
+			cascade.m_center = v3(invView * v4(0.0f, 0.0f, -centerDepth, 1.0f));
+			cascade.m_texelSize = 2.0f * radius / resolution;
+
+			// Snap to texels in light space. Depth too, so the projection only changes when the camera moves a texel
+			v3 centerLS = v3(lightView * v4(cascade.m_center, 1.0f));
+			centerLS = glm::floor(centerLS / cascade.m_texelSize) * cascade.m_texelSize;
+			const m4 lightProj = glm::orthoRH_ZO(centerLS.x - radius, centerLS.x + radius, centerLS.y - radius, centerLS.y + radius,
+				-centerLS.z - radius - config.m_casterDistance, -centerLS.z + radius);
+			cascade.m_viewProj = lightProj * lightView;
+
+			splitNear = splitFar;
+		}
+	}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// Cascaded shadow maps for a directional light. The view frustum is split in depth ranges (blend of logarithmic and uniform
+	// splits) and each range gets an orthographic projection around its bounding sphere. The sphere size only depends on the
+	// range, and the projection is snapped to whole shadow map texels, so shadows don't shimmer when the camera turns or moves,
+	// and the projection (and the cached atlas tile) stays the same while the camera doesn't move.
+	class ShadowCascades
+	{
+	public:
+
+		static constexpr u32 s_maxCascades = 4;
+
+		struct Config
+		{
+			u32 m_cascadeCount = 4;
+			f32 m_maxDistance = 80.0f; // Shadows end here, or at the far plane if closer
+			f32 m_splitLambda = 0.75f; // 0: Uniform splits, 1: Logarithmic splits
+			f32 m_casterDistance = 100.0f; // How far towards the light casters outside the sphere are kept
+		};
+
+		struct Cascade
+		{
+			m4 m_viewProj = m4(1.0f); // Depth in [0, 1]
+			f32 m_splitFar = 0.0f; // View depth where the cascade ends
+			f32 m_texelSize = 0.0f; // World units per shadow map texel
+			v3 m_center = v3(0.0f); // Bounding sphere of the depth range
+			f32 m_radius = 0.0f;
+		};
+
+		// Projection as built by Camera (perspective, looking down -Z in view space). lightDir points from the light to the scene
+		void build(const Config& config, const m4& view, const m4& projection, f32 nearPlane, f32 farPlane, const v3& lightDir, u32 resolution);
+
+		u32 getCascadeCount() const { return m_cascadeCount; }
+		const Cascade& getCascade(u32 idx) const { return m_cascades[idx]; }
+
+	private:
+
+		Cascade m_cascades[s_maxCascades];
+		u32 m_cascadeCount = 0;
+	};
+}
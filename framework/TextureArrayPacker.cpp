@@ -0,0 +1,130 @@
+#include "framework/Framework.h"
+#include "framework/TextureArrayPacker.h"
+
+namespace framework
+{
+
+	TextureArrayPacker::TextureArray::~TextureArray()
+	{
+		if (m_SRV)
+		{
+			m_SRV->Release();
+			m_SRV = nullptr;
+		}
+		if (m_texture)
+		{
+			m_texture->Release();
+			m_texture = nullptr;
+		}
+	}
+
+	TextureArrayPacker::Slot TextureArrayPacker::add(const Texture2D& texture)
+	{
+		if (!texture.m_texture)
+		{
+			return Slot();
+		}
+		auto it = m_slots.find(texture.m_texture);
+		if (it != m_slots.end())
+		{
+			return it->second;
+		}
+
+		D3D11_TEXTURE2D_DESC desc;
+		texture.m_texture->GetDesc(&desc);
+
+		// Last array with the same layout that still has room. Built arrays are closed
+		Slot slot;
+		for (u32 i = 0; i < static_cast<u32>(m_arrays.size()); ++i)
+		{
+			const TextureArray& texArray = *m_arrays[i];
+			if (!texArray.m_texture && texArray.m_width == desc.Width && texArray.m_height == desc.Height && texArray.m_mipCount == desc.MipLevels &&
+				texArray.m_format == desc.Format && texArray.m_sources.size() < D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION)
+			{
+				slot.m_array = i;
+			}
+		}
+		if (slot.m_array == s_invalidArray)
+		{
+			UniquePtr<TextureArray> texArray = std::make_unique<TextureArray>();
+			texArray->m_width = desc.Width;
+			texArray->m_height = desc.Height;
+			texArray->m_mipCount = desc.MipLevels;
+			texArray->m_format = desc.Format;
+			slot.m_array = static_cast<u32>(m_arrays.size());
+			m_arrays.push_back(std::move(texArray));
+		}
+
+		TextureArray& texArray = *m_arrays[slot.m_array];
+		slot.m_slice = static_cast<u32>(texArray.m_sources.size());
+		texArray.m_sources.push_back(texture.m_texture);
+		m_slots[texture.m_texture] = slot;
+		return slot;
+	}
+
+	bool TextureArrayPacker::build(ID3D11Device* device, ID3D11DeviceContext* ctx)
+	{
+		for (UniquePtr<TextureArray>& texArray : m_arrays)
+		{
+			if (texArray->m_texture)
+			{
+				continue;
+			}
+
+			D3D11_TEXTURE2D_DESC desc;
+			ZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+			desc.Width = texArray->m_width;
+			desc.Height = texArray->m_height;
+			desc.MipLevels = texArray->m_mipCount;
+			desc.ArraySize = static_cast<u32>(texArray->m_sources.size());
+			texArray->m_sliceCount = desc.ArraySize;
+			desc.Format = texArray->m_format;
+			desc.SampleDesc.Count = 1;
+			desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+			desc.Usage = D3D11_USAGE_DEFAULT;
+			if (FAILED(device->CreateTexture2D(&desc, nullptr, &texArray->m_texture)))
+			{
+				printf("Failed to create texture array\n");
+				return false;
+			}
+
+			for (u32 slice = 0; slice < desc.ArraySize; ++slice)
+			{
+				for (u32 mip = 0; mip < desc.MipLevels; ++mip)
+				{
+					ctx->CopySubresourceRegion(texArray->m_texture, D3D11CalcSubresource(mip, slice, desc.MipLevels), 0, 0, 0,
+						texArray->m_sources[slice], mip, nullptr);
+				}
+			}
+
+			D3D11_SHADER_RESOURCE_VIEW_DESC descSRV;
+			ZeroMemory(&descSRV, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+			descSRV.Format = desc.Format;
+			descSRV.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+			descSRV.Texture2DArray.MostDetailedMip = 0;
+			descSRV.Texture2DArray.MipLevels = -1;
+			descSRV.Texture2DArray.FirstArraySlice = 0;
+			descSRV.Texture2DArray.ArraySize = desc.ArraySize;
+			if (FAILED(device->CreateShaderResourceView(texArray->m_texture, &descSRV, &texArray->m_SRV)))
+			{
+				printf("Failed to create SRV for texture array\n");
+				return false;
+			}
+		}
+
+		// The sources can be released now
+		for (UniquePtr<TextureArray>& texArray : m_arrays)
+		{
+			texArray->m_sources.clear();
+		}
+		m_slots.clear();
+		return true;
+	}
+
+	void TextureArrayPacker::clear()
+	{
+		m_arrays.clear();
+		m_slots.clear();
+	}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+	struct Texture2D;
+
+	// Packs textures with the same size, format and mip count into Texture2DArrays, so draws that only differ by
+	// texture can share the bound resources and select their slice with a constant instead.
+	// The texels are copied on the GPU, so block compressed textures are packed as they are.
+	class TextureArrayPacker
+	{
+	public:
+
+		static constexpr u32 s_invalidArray = 0xFFFFFFFF;
+
+		struct Slot
+		{
+			u32 m_array = s_invalidArray;
+			u32 m_slice = 0;
+		};
+
+		struct TextureArray
+		{
+			~TextureArray();
+
+			ID3D11Texture2D* m_texture = nullptr;
+			ID3D11ShaderResourceView* m_SRV = nullptr;
+			u32 m_width = 0;
+			u32 m_height = 0;
+			u32 m_mipCount = 0;
+			u32 m_sliceCount = 0;
+			DXGI_FORMAT m_format = DXGI_FORMAT_UNKNOWN;
+			Vector<ID3D11Texture2D*> m_sources; // Textures copied into each slice, only valid until build
+		};
+
+		TextureArrayPacker() {}
+		TextureArrayPacker(const TextureArrayPacker&) = delete;
+		TextureArrayPacker& operator=(const TextureArrayPacker&) = delete;
+
+		// Returns the slot the texture gets once built. Adding the same texture again returns the same slot.
+		// The texture must stay alive until build
+		Slot add(const Texture2D& texture);
+
+		// Create the arrays and copy the textures into them
+		bool build(ID3D11Device* device, ID3D11DeviceContext* ctx);
+
+		void clear();
+
+		const TextureArray& getArray(u32 idx) const { return *m_arrays[idx]; }
+		u32 getArrayCount() const { return static_cast<u32>(m_arrays.size()); }
+
+	private:
+
+		Vector<UniquePtr<TextureArray>> m_arrays;
+		UMap<ID3D11Texture2D*, Slot> m_slots; // Source texture -> Slot
+	};
+}
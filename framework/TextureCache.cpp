@@ -0,0 +1,79 @@
+#include "framework/Framework.h"
+#include "framework/TextureCache.h"
+
+namespace framework
+{
+
+	u64 TextureCache::computeFileHash(const String& absPath)
+	{
+		u64 fileKey[3] = { Hash::compute(absPath), 0, 0 };
+		if (!FileUtils::getFileInfo(absPath.c_str(), fileKey[1], fileKey[2]))
+		{
+			return 0;
+		}
+		const u64 fileKeyHash = Hash::compute(fileKey, sizeof(fileKey));
+		auto it = m_fileHashes.find(fileKeyHash);
+		if (it != m_fileHashes.end())
+		{
+			return it->second;
+		}
+
+		MappedFile file;
+		if (!file.open(absPath.c_str()))
+		{
+			return 0;
+		}
+		const u64 contentHash = computeDataHash(file.getData(), file.getSize());
+		m_fileHashes[fileKeyHash] = contentHash;
+		return contentHash;
+	}
+
+	u64 TextureCache::computeDataHash(const void* data, u64 size)
+	{
+		// Mix the size in, so empty or truncated data doesn't collide as easily
+		return Hash::compute(data, size, size);
+	}
+
+	u64 TextureCache::makeKey(u64 contentHash, u64 variant)
+	{
+		const u64 key[2] = { contentHash, variant };
+		return Hash::compute(key, sizeof(key));
+	}
+
+	SharedPtr<Texture2D> TextureCache::find(u64 key, u32* outUserData)
+	{
+		auto it = m_textures.find(key);
+		if (it == m_textures.end())
+		{
+			return nullptr;
+		}
+		SharedPtr<Texture2D> texture = it->second.m_texture.lock();
+		if (!texture)
+		{
+			m_textures.erase(it);
+			return nullptr;
+		}
+		if (outUserData)
+		{
+			*outUserData = it->second.m_userData;
+		}
+		m_hitCount++;
+		return texture;
+	}
+
+	void TextureCache::add(u64 key, const SharedPtr<Texture2D>& texture, u32 userData)
+	{
+		Entry& entry = m_textures[key];
+		entry.m_texture = texture;
+		entry.m_userData = userData;
+	}
+
+	void TextureCache::purge()
+	{
+		for (auto it = m_textures.begin(); it != m_textures.end();)
+		{
+			it = it->second.m_texture.expired() ? m_textures.erase(it) : std::next(it);
+		}
+	}
+
+}
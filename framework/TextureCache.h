@@ -0,0 +1,52 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+	struct Texture2D;
+
+	// Shares textures created from the same source data. Textures are keyed by a hash of their content (plus whatever
+	// the caller mixes in, like the usage) so identical images referenced from different materials, paths or scenes
+	// are only created once. The cache doesn't own the textures, they are released when the last user drops them.
+	// Share one cache between scenes to dedup across them.
+	class TextureCache
+	{
+	public:
+
+		TextureCache() {}
+		TextureCache(const TextureCache&) = delete;
+		TextureCache& operator=(const TextureCache&) = delete;
+
+		// Hash of the file contents. Memoized by path, size and write time, so unchanged files are only read once
+		u64 computeFileHash(const String& absPath);
+
+		static u64 computeDataHash(const void* data, u64 size);
+
+		// Key of a texture created from the content with the given hash. variant tells apart textures made from the same content
+		static u64 makeKey(u64 contentHash, u64 variant);
+
+		// Null if there is no live texture for the key. outUserData returns what was stored along with it
+		SharedPtr<Texture2D> find(u64 key, u32* outUserData = nullptr);
+
+		void add(u64 key, const SharedPtr<Texture2D>& texture, u32 userData = 0);
+
+		// Drop the entries of textures that were released
+		void purge();
+
+		u32 getHitCount() const { return m_hitCount; }
+		u32 getEntryCount() const { return static_cast<u32>(m_textures.size()); }
+
+	private:
+
+		struct Entry
+		{
+			std::weak_ptr<Texture2D> m_texture;
+			u32 m_userData = 0;
+		};
+
+		UMap<u64, Entry> m_textures; // Key -> Texture
+		UMap<u64, u64> m_fileHashes; // Hash of path, size and write time -> Hash of the contents
+		u32 m_hitCount = 0;
+	};
+}
@@ -0,0 +1,550 @@
+#include "framework/Types.h"
+#include "framework/TextureCompression.h"
+
+#include <cstring>
+#include <cfloat>
+#include <thread>
+
+namespace framework
+{
+
+	static constexpr u32 s_texelsPerBlock = 16;
+	static constexpr u32 s_refineIterations = 2;
+	static constexpr u32 s_minBlocksPerThread = 256;
+
+	// Interpolation weights (out of 64) of BC7 4 bit indices
+	static const u32 s_bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// BC1 palette order: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1. Weight of c1 for each index
+	static const f32 s_bc1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	struct BitWriter
+	{
+		BitWriter(u8* data, u32 sizeBytes) : m_data(data) { memset(data, 0, sizeBytes); }
+
+		void write(u32 value, u32 bits)
+		{
+			for (u32 i = 0; i < bits; ++i, ++m_pos)
+			{
+				if ((value >> i) & 1)
+				{
+					m_data[m_pos >> 3] |= static_cast<u8>(1 << (m_pos & 7));
+				}
+			}
+		}
+
+		u8* m_data;
+		u32 m_pos = 0;
+	};
+
+	static void loadTexels(const u8* texels, v4* outTexels)
+	{
+		for (u32 i = 0; i < s_texelsPerBlock; ++i)
+		{
+			outTexels[i] = v4(texels[4 * i], texels[4 * i + 1], texels[4 * i + 2], texels[4 * i + 3]);
+		}
+	}
+
+	// Endpoints in [0, 255] of the segment that best fits the texels. Only the channels in mask are considered
+	static void findEndpoints(const v4* texels, const v4& mask, BlockCompressor::Quality quality, v4& outE0, v4& outE1)
+	{
+		v4 minColor(255.0f);
+		v4 maxColor(0.0f);
+		v4 mean(0.0f);
+		for (u32 i = 0; i < s_texelsPerBlock; ++i)
+		{
+			minColor = glm::min(minColor, texels[i] * mask);
+			maxColor = glm::max(maxColor, texels[i] * mask);
+			mean += texels[i] * mask;
+		}
+		mean /= static_cast<f32>(s_texelsPerBlock);
+
+		if (quality == BlockCompressor::Quality::Fast)
+		{
+			// Inset the box slightly, extremes are usually outliers
+			const v4 inset = (maxColor - minColor) / 16.0f;
+			outE0 = maxColor - inset;
+			outE1 = minColor + inset;
+			return;
+		}
+
+		// Principal axis of the covariance matrix through power iteration
+		f32 cov[4][4] = {};
+		for (u32 i = 0; i < s_texelsPerBlock; ++i)
+		{
+			const v4 d = texels[i] * mask - mean;
+			for (u32 r = 0; r < 4; ++r)
+			{
+				for (u32 c = 0; c < 4; ++c)
+				{
+					cov[r][c] += d[r] * d[c];
+				}
+			}
+		}
+		v4 axis = maxColor - minColor;
+		for (u32 iter = 0; iter < 8; ++iter)
+		{
+			v4 next(0.0f);
+			for (u32 r = 0; r < 4; ++r)
+			{
+				for (u32 c = 0; c < 4; ++c)
+				{
+					next[r] += cov[r][c] * axis[c];
+				}
+			}
+			const f32 len = glm::length(next);
+			if (len < 1.0e-6f)
+			{
+				break;
+			}
+			axis = next / len;
+		}
+		const f32 axisLen2 = glm::length2(axis);
+		if (axisLen2 < 1.0e-6f)
+		{
+			outE0 = outE1 = mean;
+			return;
+		}
+
+		f32 minT = FLT_MAX;
+		f32 maxT = -FLT_MAX;
+		for (u32 i = 0; i < s_texelsPerBlock; ++i)
+		{
+			const f32 t = glm::dot(texels[i] * mask - mean, axis) / axisLen2;
+			minT = glm::min(minT, t);
+			maxT = glm::max(maxT, t);
+		}
+		outE0 = glm::clamp(mean + axis * maxT, v4(0.0f), v4(255.0f));
+		outE1 = glm::clamp(mean + axis * minT, v4(0.0f), v4(255.0f));
+	}
+
+	// Endpoints that minimize the error for the given interpolation weights (weight of e1 per texel).
+	// Returns false if the system is degenerate (all texels use the same weight)
+	static bool solveEndpoints(const v4* texels, const f32* weights, v4& outE0, v4& outE1)
+	{
+		f32 a = 0.0f, b = 0.0f, c = 0.0f;
+		v4 d0(0.0f), d1(0.0f);
+		for (u32 i = 0; i < s_texelsPerBlock; ++i)
+		{
+			const f32 w = weights[i];
+			a += (1.0f - w) * (1.0f - w);
+			b += (1.0f - w) * w;
+			c += w * w;
+			d0 += texels[i] * (1.0f - w);
+			d1 += texels[i] * w;
+		}
+		const f32 det = a * c - b * b;
+		if (glm::abs(det) < 1.0e-6f)
+		{
+			return false;
+		}
+		outE0 = glm::clamp((d0 * c - d1 * b) / det, v4(0.0f), v4(255.0f));
+		outE1 = glm::clamp((d1 * a - d0 * b) / det, v4(0.0f), v4(255.0f));
+		return true;
+	}
+
+	// ----------------------------------------------------------------------
+	// BC1
+
+	static u16 packRGB565(const v4& color)
+	{
+		const u32 r = static_cast<u32>(glm::clamp(color.r * (31.0f / 255.0f) + 0.5f, 0.0f, 31.0f));
+		const u32 g = static_cast<u32>(glm::clamp(color.g * (63.0f / 255.0f) + 0.5f, 0.0f, 63.0f));
+		const u32 b = static_cast<u32>(glm::clamp(color.b * (31.0f / 255.0f) + 0.5f, 0.0f, 31.0f));
+		return static_cast<u16>((r << 11) | (g << 5) | b);
+	}
+
+	static v4 unpackRGB565(u16 color)
+	{
+		const u32 r = (color >> 11) & 31;
+		const u32 g = (color >> 5) & 63;
+		const u32 b = color & 31;
+		return v4((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 0.0f);
+	}
+
+	// Quantize endpoints and pick indices. Returns the squared error
+	static f32 encodeBC1Color(const v4* texels, const v4& e0, const v4& e1, u16& outC0, u16& outC1, u32* outIndices)
+	{
+		outC0 = packRGB565(e0);
+		outC1 = packRGB565(e1);
+		if (outC0 < outC1)
+		{
+			std::swap(outC0, outC1);
+		}
+		if (outC0 == outC1)
+		{
+			// Only in 3 color mode when equal, index 0 maps to c0 anyway
+			const v4 color = unpackRGB565(outC0);
+			f32 error = 0.0f;
+			for (u32 i = 0; i < s_texelsPerBlock; ++i)
+			{
+				outIndices[i] = 0;
+				error += glm::length2(v3(texels[i]) - v3(color));
+			}
+			return error;
+		}
+
+		v4 palette[4];
+		palette[0] = unpackRGB565(outC0);
+		palette[1] = unpackRGB565(outC1);
+		palette[2] = (palette[0] * 2.0f + palette[1]) / 3.0f;
+		palette[3] = (palette[0] + palette[1] * 2.0f) / 3.0f;
+		f32 error = 0.0f;
+		for (u32 i = 0; i < s_texelsPerBlock; ++i)
+		{
+			f32 bestDist = FLT_MAX;
+			for (u32 p = 0; p < 4; ++p)
+			{
+				const f32 dist = glm::length2(v3(texels[i]) - v3(palette[p]));
+				if (dist < bestDist)
+				{
+					bestDist = dist;
+					outIndices[i] = p;
+				}
+			}
+			error += bestDist;
+		}
+		return error;
+	}
+
+	static void writeBC1Block(u16 c0, u16 c1, const u32* indices, u8* outBlock)
+	{
+		u32 packedIndices = 0;
+		for (u32 i = 0; i < s_texelsPerBlock; ++i)
+		{
+			packedIndices |= indices[i] << (2 * i);
+		}
+		memcpy(outBlock, &c0, 2);
+		memcpy(outBlock + 2, &c1, 2);
+		memcpy(outBlock + 4, &packedIndices, 4);
+	}
+
+	static void compressColorBC1(const v4* texels, BlockCompressor::Quality quality, u8* outBlock)
+	{
+		const v4 rgbMask(1.0f, 1.0f, 1.0f, 0.0f);
+		v4 e0, e1;
+		findEndpoints(texels, rgbMask, quality, e0, e1);
+
+		u16 c0, c1;
+		u32 indices[s_texelsPerBlock];
+		f32 error = encodeBC1Color(texels, e0, e1, c0, c1, indices);
+		if (quality == BlockCompressor::Quality::High)
+		{
+			for (u32 iter = 0; iter < s_refineIterations && error > 0.0f; ++iter)
+			{
+				f32 weights[s_texelsPerBlock];
+				for (u32 i = 0; i < s_texelsPerBlock; ++i)
+				{
+					weights[i] = s_bc1Weights[indices[i]];
+				}
+				// Weights are relative to the quantized (possibly swapped) endpoints
+				if (!solveEndpoints(texels, weights, e0, e1))
+				{
+					break;
+				}
+				u16 newC0, newC1;
+				u32 newIndices[s_texelsPerBlock];
+				const f32 newError = encodeBC1Color(texels, e0 * rgbMask, e1 * rgbMask, newC0, newC1, newIndices);
+				if (newError >= error)
+				{
+					break;
+				}
+				error = newError;
+				c0 = newC0;
+				c1 = newC1;
+				memcpy(indices, newIndices, sizeof(indices));
+			}
+		}
+		writeBC1Block(c0, c1, indices, outBlock);
+	}
+
+	// ----------------------------------------------------------------------
+	// BC4, single channel. Used for BC3 alpha and both channels of BC5
+
+	static void compressChannelBC4(const u8* texels, u32 channel, u8* outBlock)
+	{
+		u32 maxValue = 0;
+		u32 minValue = 255;
+		for (u32 i = 0; i < s_texelsPerBlock; ++i)
+		{
+			maxValue = glm::max(maxValue, static_cast<u32>(texels[4 * i + channel]));
+			minValue = glm::min(minValue, static_cast<u32>(texels[4 * i + channel]));
+		}
+
+		BitWriter writer(outBlock, 8);
+		writer.write(maxValue, 8);
+		writer.write(minValue, 8);
+		for (u32 i = 0; i < s_texelsPerBlock; ++i)
+		{
+			u32 index = 0;
+			if (maxValue != minValue)
+			{
+				// Position along the 8 value ramp, 0 is max and 7 is min. Ramp index 0 -> 0, 7 -> 1, i -> i + 1
+				const u32 value = texels[4 * i + channel];
+				const u32 step = ((maxValue - value) * 14 + (maxValue - minValue)) / (2 * (maxValue - minValue));
+				index = (step == 0) ? 0 : ((step == 7) ? 1 : (step + 1));
+			}
+			writer.write(index, 3);
+		}
+	}
+
+	// ----------------------------------------------------------------------
+	// BC7 mode 6: one subset, RGBA endpoints of 7 bits + 1 unique p-bit, 4 bit indices
+
+	// Quantize an endpoint to 7 bits per channel plus the p-bit that reproduces it best
+	static void quantizeBC7Endpoint(const v4& endpoint, u32* outQuantized, u32& outPBit)
+	{
+		f32 bestError = FLT_MAX;
+		for (u32 pBit = 0; pBit < 2; ++pBit)
+		{
+			u32 quantized[4];
+			f32 error = 0.0f;
+			for (u32 c = 0; c < 4; ++c)
+			{
+				quantized[c] = static_cast<u32>(glm::clamp((endpoint[c] - pBit) * 0.5f + 0.5f, 0.0f, 127.0f));
+				const f32 delta = static_cast<f32>((quantized[c] << 1) | pBit) - endpoint[c];
+				error += delta * delta;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				outPBit = pBit;
+				memcpy(outQuantized, quantized, sizeof(quantized));
+			}
+		}
+	}
+
+	struct BC7Mode6
+	{
+		u32 m_endpoints[2][4];
+		u32 m_pBits[2];
+		u32 m_indices[s_texelsPerBlock];
+	};
+
+	static f32 encodeBC7Mode6(const v4* texels, const v4& e0, const v4& e1, BC7Mode6& outBlock)
+	{
+		quantizeBC7Endpoint(e0, outBlock.m_endpoints[0], outBlock.m_pBits[0]);
+		quantizeBC7Endpoint(e1, outBlock.m_endpoints[1], outBlock.m_pBits[1]);
+		v4 unquantized[2];
+		for (u32 e = 0; e < 2; ++e)
+		{
+			for (u32 c = 0; c < 4; ++c)
+			{
+				unquantized[e][c] = static_cast<f32>((outBlock.m_endpoints[e][c] << 1) | outBlock.m_pBits[e]);
+			}
+		}
+		v4 palette[16];
+		for (u32 p = 0; p < 16; ++p)
+		{
+			const v4 interpolated = (unquantized[0] * static_cast<f32>(64 - s_bc7Weights4[p]) + unquantized[1] * static_cast<f32>(s_bc7Weights4[p]) + 32.0f) / 64.0f;
+			palette[p] = glm::floor(interpolated);
+		}
+
+		f32 error = 0.0f;
+		for (u32 i = 0; i < s_texelsPerBlock; ++i)
+		{
+			f32 bestDist = FLT_MAX;
+			for (u32 p = 0; p < 16; ++p)
+			{
+				const f32 dist = glm::length2(texels[i] - palette[p]);
+				if (dist < bestDist)
+				{
+					bestDist = dist;
+					outBlock.m_indices[i] = p;
+				}
+			}
+			error += bestDist;
+		}
+		return error;
+	}
+
+	static void writeBC7Mode6(BC7Mode6& block, u8* outBlock)
+	{
+		// The most significant bit of the first index is implicit 0, swap the endpoints if needed
+		if (block.m_indices[0] & 8)
+		{
+			for (u32 c = 0; c < 4; ++c)
+			{
+				std::swap(block.m_endpoints[0][c], block.m_endpoints[1][c]);
+			}
+			std::swap(block.m_pBits[0], block.m_pBits[1]);
+			for (u32 i = 0; i < s_texelsPerBlock; ++i)
+			{
+				block.m_indices[i] = 15 - block.m_indices[i];
+			}
+		}
+
+		BitWriter writer(outBlock, 16);
+		writer.write(1 << 6, 7); // Mode 6
+		for (u32 c = 0; c < 4; ++c)
+		{
+			writer.write(block.m_endpoints[0][c], 7);
+			writer.write(block.m_endpoints[1][c], 7);
+		}
+		writer.write(block.m_pBits[0], 1);
+		writer.write(block.m_pBits[1], 1);
+		writer.write(block.m_indices[0], 3);
+		for (u32 i = 1; i < s_texelsPerBlock; ++i)
+		{
+			writer.write(block.m_indices[i], 4);
+		}
+	}
+
+	// ----------------------------------------------------------------------
+
+	u32 BlockCompressor::getBlockSize(Format format)
+	{
+		return (format == Format::BC1) ? 8 : 16;
+	}
+
+	u32 BlockCompressor::getRowPitch(Format format, u32 width)
+	{
+		return glm::max((width + s_blockDim - 1) / s_blockDim, 1u) * getBlockSize(format);
+	}
+
+	u32 BlockCompressor::getLevelSize(Format format, u32 width, u32 height)
+	{
+		return getRowPitch(format, width) * glm::max((height + s_blockDim - 1) / s_blockDim, 1u);
+	}
+
+	bool BlockCompressor::hasAlpha(const u8* rgba, u32 texelCount)
+	{
+		for (u32 i = 0; i < texelCount; ++i)
+		{
+			if (rgba[4 * i + 3] != 255)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void BlockCompressor::compressBlockBC1(const u8* texels, Quality quality, u8* outBlock)
+	{
+		v4 colors[s_texelsPerBlock];
+		loadTexels(texels, colors);
+		compressColorBC1(colors, quality, outBlock);
+	}
+
+	void BlockCompressor::compressBlockBC3(const u8* texels, Quality quality, u8* outBlock)
+	{
+		compressChannelBC4(texels, 3, outBlock);
+		compressBlockBC1(texels, quality, outBlock + 8);
+	}
+
+	// BC4 channels are encoded the same way at every quality
+	void BlockCompressor::compressBlockBC5(const u8* texels, Quality, u8* outBlock)
+	{
+		compressChannelBC4(texels, 0, outBlock);
+		compressChannelBC4(texels, 1, outBlock + 8);
+	}
+
+	void BlockCompressor::compressBlockBC7(const u8* texels, Quality quality, u8* outBlock)
+	{
+		v4 colors[s_texelsPerBlock];
+		loadTexels(texels, colors);
+		v4 e0, e1;
+		findEndpoints(colors, v4(1.0f), quality, e0, e1);
+
+		BC7Mode6 block;
+		f32 error = encodeBC7Mode6(colors, e0, e1, block);
+		if (quality == Quality::High)
+		{
+			for (u32 iter = 0; iter < s_refineIterations && error > 0.0f; ++iter)
+			{
+				f32 weights[s_texelsPerBlock];
+				for (u32 i = 0; i < s_texelsPerBlock; ++i)
+				{
+					weights[i] = static_cast<f32>(s_bc7Weights4[block.m_indices[i]]) / 64.0f;
+				}
+				if (!solveEndpoints(colors, weights, e0, e1))
+				{
+					break;
+				}
+				BC7Mode6 refined;
+				const f32 newError = encodeBC7Mode6(colors, e0, e1, refined);
+				if (newError >= error)
+				{
+					break;
+				}
+				error = newError;
+				block = refined;
+			}
+		}
+		writeBC7Mode6(block, outBlock);
+	}
+
+	void BlockCompressor::compress(const u8* rgba, u32 width, u32 height, Format format, Quality quality, u8* outBlocks)
+	{
+		using CompressBlockFn = void(*)(const u8*, Quality, u8*);
+		CompressBlockFn compressBlock = &compressBlockBC1;
+		switch (format)
+		{
+		case Format::BC3: compressBlock = &compressBlockBC3; break;
+		case Format::BC5: compressBlock = &compressBlockBC5; break;
+		case Format::BC7: compressBlock = &compressBlockBC7; break;
+		default: break;
+		}
+
+		const u32 blocksX = glm::max((width + s_blockDim - 1) / s_blockDim, 1u);
+		const u32 blocksY = glm::max((height + s_blockDim - 1) / s_blockDim, 1u);
+		const u32 blockSize = getBlockSize(format);
+		auto compressRows = [=](u32 firstRow, u32 lastRow)
+		{
+			u8 texels[4 * s_texelsPerBlock];
+			for (u32 by = firstRow; by < lastRow; ++by)
+			{
+				for (u32 bx = 0; bx < blocksX; ++bx)
+				{
+					for (u32 y = 0; y < s_blockDim; ++y)
+					{
+						const u32 srcY = glm::min(by * s_blockDim + y, height - 1);
+						for (u32 x = 0; x < s_blockDim; ++x)
+						{
+							const u32 srcX = glm::min(bx * s_blockDim + x, width - 1);
+							memcpy(&texels[4 * (y * s_blockDim + x)], rgba + 4 * (srcY * width + srcX), 4);
+						}
+					}
+					compressBlock(texels, quality, outBlocks + (by * blocksX + bx) * blockSize);
+				}
+			}
+		};
+
+		const u32 threadCount = glm::min(glm::max(std::thread::hardware_concurrency(), 1u), glm::max((blocksX * blocksY) / s_minBlocksPerThread, 1u));
+		if (threadCount <= 1)
+		{
+			compressRows(0, blocksY);
+			return;
+		}
+		Vector<std::thread> threads;
+		threads.reserve(threadCount);
+		const u32 rowsPerThread = (blocksY + threadCount - 1) / threadCount;
+		for (u32 firstRow = 0; firstRow < blocksY; firstRow += rowsPerThread)
+		{
+			threads.emplace_back(compressRows, firstRow, glm::min(firstRow + rowsPerThread, blocksY));
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	void BlockCompressor::compress(const MipChain& mipChain, Format format, Quality quality, Vector<u8>& outData, Vector<u32>& outLevelOffsets)
+	{
+		const u32 levelCount = mipChain.getLevelCount();
+		outLevelOffsets.resize(levelCount);
+		u32 totalSize = 0;
+		for (u32 i = 0; i < levelCount; ++i)
+		{
+			outLevelOffsets[i] = totalSize;
+			totalSize += getLevelSize(format, mipChain.m_levels[i].m_width, mipChain.m_levels[i].m_height);
+		}
+		outData.resize(totalSize);
+		for (u32 i = 0; i < levelCount; ++i)
+		{
+			const MipChain::Level& level = mipChain.m_levels[i];
+			compress(mipChain.getLevelData(i), level.m_width, level.m_height, format, quality, outData.data() + outLevelOffsets[i]);
+		}
+	}
+
+}
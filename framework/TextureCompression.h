@@ -0,0 +1,50 @@
+#pragma once
+
+#include "framework/Types.h"
+#include "framework/TextureUtils.h"
+
+namespace framework
+{
+
+	// Block compression of RGBA8 images. Has no dependency on D3D
+	class BlockCompressor
+	{
+	public:
+
+		enum class Format : u32
+		{
+			BC1, // RGB, 4 bpp
+			BC3, // RGBA, 8 bpp. BC4 alpha + BC1 color
+			BC5, // RG, 8 bpp. Two BC4 channels, used for normal maps
+			BC7, // RGBA, 8 bpp. Only mode 6 (single subset) is emitted
+		};
+
+		enum class Quality : u32
+		{
+			Fast, // Endpoints from the bounding box of the block
+			High, // Endpoints from the principal axis of the block, refined with least squares
+		};
+
+		static constexpr u32 s_blockDim = 4;
+
+		// Bytes per 4x4 block
+		static u32 getBlockSize(Format format);
+
+		static u32 getLevelSize(Format format, u32 width, u32 height);
+		static u32 getRowPitch(Format format, u32 width);
+
+		// Compress a tightly packed RGBA8 image. Partial blocks at the edges replicate the last row/column.
+		// Rows of blocks are split between threads for big images
+		static void compress(const u8* rgba, u32 width, u32 height, Format format, Quality quality, u8* outBlocks);
+
+		// Compress every level of the chain. outData gets the levels one after another
+		static void compress(const MipChain& mipChain, Format format, Quality quality, Vector<u8>& outData, Vector<u32>& outLevelOffsets);
+
+		static bool hasAlpha(const u8* rgba, u32 texelCount);
+
+		static void compressBlockBC1(const u8* texels, Quality quality, u8* outBlock);
+		static void compressBlockBC3(const u8* texels, Quality quality, u8* outBlock);
+		static void compressBlockBC5(const u8* texels, Quality quality, u8* outBlock);
+		static void compressBlockBC7(const u8* texels, Quality quality, u8* outBlock);
+	};
+}
@@ -0,0 +1,76 @@
+#include "framework/Framework.h"
+#include "framework/TextureCooker.h"
+
+namespace framework
+{
+
+	// Bump when the cooked output changes, invalidates every cooked file
+	static constexpr u32 s_cookVersion = 1;
+
+	static const char* s_cookedDir = "./cooked";
+
+	String TextureCooker::getCookedPath(u64 sourceKey, Usage usage, BlockCompressor::Quality quality)
+	{
+		const u64 key[] = { sourceKey, static_cast<u64>(usage), static_cast<u64>(quality), s_cookVersion };
+		char fileName[32];
+		snprintf(fileName, sizeof(fileName), "/%016llx.dds", static_cast<unsigned long long>(Hash::compute(key, sizeof(key))));
+		return Paths::getAssetPath(s_cookedDir) + fileName;
+	}
+
+	bool TextureCooker::loadCooked(ID3D11Device* device, const String& cookedAbsPath, Texture2D& outTexture)
+	{
+		if (!FileUtils::doesFileExist(cookedAbsPath.c_str()))
+		{
+			return false;
+		}
+		// Subresources point into the mapped file, no intermediate copies
+		MappedFile file;
+		TextureLevels levels;
+		return file.open(cookedAbsPath.c_str()) && DDSFile::parse(file.getData(), file.getSize(), levels) &&
+			RenderResources::createTexture2D(device, levels, outTexture);
+	}
+
+	bool TextureCooker::cook(const u8* rgba, u32 width, u32 height, Usage usage, BlockCompressor::Quality quality, const String& cookedAbsPath)
+	{
+		const bool isColor = usage == Usage::Color;
+		MipChain mipChain;
+		MipGenerator::generate(rgba, width, height, isColor, isColor ? MipGenerator::Filter::Kaiser : MipGenerator::Filter::Box, mipChain);
+
+		BlockCompressor::Format format = BlockCompressor::Format::BC5;
+		TextureLevels levels;
+		levels.m_format = DXGI_FORMAT_BC5_UNORM;
+		if (isColor && quality == BlockCompressor::Quality::High)
+		{
+			format = BlockCompressor::Format::BC7;
+			levels.m_format = DXGI_FORMAT_BC7_UNORM_SRGB;
+		}
+		else if (isColor)
+		{
+			const bool hasAlpha = BlockCompressor::hasAlpha(rgba, width * height);
+			format = hasAlpha ? BlockCompressor::Format::BC3 : BlockCompressor::Format::BC1;
+			levels.m_format = hasAlpha ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM_SRGB;
+		}
+
+		Vector<u8> compressed;
+		Vector<u32> levelOffsets;
+		BlockCompressor::compress(mipChain, format, quality, compressed, levelOffsets);
+		levels.m_levels.resize(mipChain.getLevelCount());
+		for (u32 i = 0; i < mipChain.getLevelCount(); ++i)
+		{
+			TextureLevels::Level& level = levels.m_levels[i];
+			level.m_data = compressed.data() + levelOffsets[i];
+			level.m_width = mipChain.m_levels[i].m_width;
+			level.m_height = mipChain.m_levels[i].m_height;
+			level.m_rowPitch = BlockCompressor::getRowPitch(format, level.m_width);
+			level.m_size = BlockCompressor::getLevelSize(format, level.m_width, level.m_height);
+		}
+
+		if (!FileUtils::createDirectory(Paths::getAssetPath(s_cookedDir).c_str()) || !DDSFile::write(cookedAbsPath.c_str(), levels))
+		{
+			printf("Failed to write cooked texture %s\n", cookedAbsPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// Converts decoded images into block compressed textures with precomputed mips.
+	// Results are stored as DDS files in <workingDir>/cooked, so later runs skip decoding and encoding
+	class TextureCooker
+	{
+	public:
+
+		enum class Usage : u32
+		{
+			Color, // sRGB. BC7 on high quality, BC1/BC3 (if there is alpha) on fast
+			NormalMap, // Tangent space XY in BC5, Z is reconstructed in the shader
+		};
+
+		// Cooked file for a source image. sourceKey must change when the source does
+		static String getCookedPath(u64 sourceKey, Usage usage, BlockCompressor::Quality quality);
+
+		static bool loadCooked(ID3D11Device* device, const String& cookedAbsPath, Texture2D& outTexture);
+
+		// Generate the mips, compress and write the cooked file. Data is tightly packed RGBA8
+		static bool cook(const u8* rgba, u32 width, u32 height, Usage usage, BlockCompressor::Quality quality, const String& cookedAbsPath);
+	};
+}
@@ -0,0 +1,406 @@
+#include "framework/Framework.h"
+#include "framework/TextureFile.h"
+
+namespace framework
+{
+
+	static constexpr u32 s_ddsMagic = 0x20534444; // "DDS "
+	static constexpr u32 s_fourCCDX10 = 0x30315844; // "DX10"
+	static constexpr u32 s_fourCCDXT1 = 0x31545844; // "DXT1"
+	static constexpr u32 s_fourCCDXT5 = 0x35545844; // "DXT5"
+	static constexpr u32 s_fourCCATI1 = 0x31495441; // "ATI1"
+	static constexpr u32 s_fourCCATI2 = 0x32495441; // "ATI2"
+	static constexpr u32 s_fourCCBC4U = 0x55344342; // "BC4U"
+	static constexpr u32 s_fourCCBC5U = 0x55354342; // "BC5U"
+
+	// Flags used by the header. Values from the DDS specification
+	static constexpr u32 s_ddsdCaps = 0x1;
+	static constexpr u32 s_ddsdHeight = 0x2;
+	static constexpr u32 s_ddsdWidth = 0x4;
+	static constexpr u32 s_ddsdPixelFormat = 0x1000;
+	static constexpr u32 s_ddsdMipMapCount = 0x20000;
+	static constexpr u32 s_ddsdLinearSize = 0x80000;
+	static constexpr u32 s_ddpfFourCC = 0x4;
+	static constexpr u32 s_ddpfRGB = 0x40;
+	static constexpr u32 s_ddsCapsComplex = 0x8;
+	static constexpr u32 s_ddsCapsTexture = 0x1000;
+	static constexpr u32 s_ddsCapsMipMap = 0x400000;
+	static constexpr u32 s_resourceDimensionTexture2D = 3;
+
+	struct DDSPixelFormat
+	{
+		u32 m_size;
+		u32 m_flags;
+		u32 m_fourCC;
+		u32 m_rgbBitCount;
+		u32 m_bitMasks[4];
+	};
+
+	struct DDSHeader
+	{
+		u32 m_size;
+		u32 m_flags;
+		u32 m_height;
+		u32 m_width;
+		u32 m_pitchOrLinearSize;
+		u32 m_depth;
+		u32 m_mipMapCount;
+		u32 m_reserved1[11];
+		DDSPixelFormat m_pixelFormat;
+		u32 m_caps[4];
+		u32 m_reserved2;
+	};
+
+	struct DDSHeaderDX10
+	{
+		u32 m_dxgiFormat;
+		u32 m_resourceDimension;
+		u32 m_miscFlag;
+		u32 m_arraySize;
+		u32 m_miscFlags2;
+	};
+
+	static_assert(sizeof(DDSHeader) == 124, "DDS header size mismatch");
+	static_assert(sizeof(DDSHeaderDX10) == 20, "DDS DX10 header size mismatch");
+
+	static const u8 s_ktx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	struct KTX2Header
+	{
+		u8 m_identifier[12];
+		u32 m_vkFormat;
+		u32 m_typeSize;
+		u32 m_pixelWidth;
+		u32 m_pixelHeight;
+		u32 m_pixelDepth;
+		u32 m_layerCount;
+		u32 m_faceCount;
+		u32 m_levelCount;
+		u32 m_supercompressionScheme;
+		u32 m_dfdByteOffset;
+		u32 m_dfdByteLength;
+		u32 m_kvdByteOffset;
+		u32 m_kvdByteLength;
+		u64 m_sgdByteOffset;
+		u64 m_sgdByteLength;
+	};
+
+	struct KTX2LevelIndex
+	{
+		u64 m_byteOffset;
+		u64 m_byteLength;
+		u64 m_uncompressedByteLength;
+	};
+
+	static_assert(sizeof(KTX2Header) == 80, "KTX2 header size mismatch");
+
+	// VkFormat -> DXGI_FORMAT for the formats the loader understands
+	static DXGI_FORMAT vkFormatToDXGI(u32 vkFormat)
+	{
+		switch (vkFormat)
+		{
+		case 37: return DXGI_FORMAT_R8G8B8A8_UNORM; // VK_FORMAT_R8G8B8A8_UNORM
+		case 43: return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB; // VK_FORMAT_R8G8B8A8_SRGB
+		case 131: // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+		case 133: return DXGI_FORMAT_BC1_UNORM; // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+		case 132: // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+		case 134: return DXGI_FORMAT_BC1_UNORM_SRGB; // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+		case 137: return DXGI_FORMAT_BC3_UNORM; // VK_FORMAT_BC3_UNORM_BLOCK
+		case 138: return DXGI_FORMAT_BC3_UNORM_SRGB; // VK_FORMAT_BC3_SRGB_BLOCK
+		case 139: return DXGI_FORMAT_BC4_UNORM; // VK_FORMAT_BC4_UNORM_BLOCK
+		case 141: return DXGI_FORMAT_BC5_UNORM; // VK_FORMAT_BC5_UNORM_BLOCK
+		case 145: return DXGI_FORMAT_BC7_UNORM; // VK_FORMAT_BC7_UNORM_BLOCK
+		case 146: return DXGI_FORMAT_BC7_UNORM_SRGB; // VK_FORMAT_BC7_SRGB_BLOCK
+		default: return DXGI_FORMAT_UNKNOWN;
+		}
+	}
+
+	// Full mip chain of a texture, down to 1x1
+	static u32 getMaxLevelCount(u32 width, u32 height)
+	{
+		u32 levelCount = 1;
+		for (u32 size = glm::max(width, height); size > 1; size >>= 1)
+		{
+			levelCount++;
+		}
+		return levelCount;
+	}
+
+	// Fill the size of every level, mips go from 0 (biggest) to levelCount - 1
+	static bool setupLevels(DXGI_FORMAT format, u32 width, u32 height, u32 levelCount, TextureLevels& outLevels)
+	{
+		// Headers come from files, a bad size or level count must not size the level arrays or overflow the level sizes
+		if (width == 0 || height == 0 || width > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION || height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+		{
+			printf("Invalid texture size %ux%u\n", width, height);
+			return false;
+		}
+		if (levelCount == 0 || levelCount > getMaxLevelCount(width, height))
+		{
+			printf("Invalid mip count %u for a %ux%u texture\n", levelCount, width, height);
+			return false;
+		}
+		outLevels.m_format = format;
+		outLevels.m_levels.resize(levelCount);
+		for (u32 i = 0; i < levelCount; ++i)
+		{
+			TextureLevels::Level& level = outLevels.m_levels[i];
+			level.m_width = glm::max(width >> i, 1u);
+			level.m_height = glm::max(height >> i, 1u);
+			if (!TextureFile::getLevelLayout(format, level.m_width, level.m_height, level.m_rowPitch, level.m_size))
+			{
+				printf("Texture format %u not supported\n", static_cast<u32>(format));
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// ----------------------------------------------------------------------
+
+	bool TextureFile::isContainer(const u8* data, u64 size)
+	{
+		return DDSFile::isDDS(data, size) || KTX2File::isKTX2(data, size);
+	}
+
+	bool TextureFile::parse(const u8* data, u64 size, TextureLevels& outLevels)
+	{
+		if (DDSFile::isDDS(data, size))
+		{
+			return DDSFile::parse(data, size, outLevels);
+		}
+		if (KTX2File::isKTX2(data, size))
+		{
+			return KTX2File::parse(data, size, outLevels);
+		}
+		printf("Unknown texture container\n");
+		return false;
+	}
+
+	bool TextureFile::getLevelLayout(DXGI_FORMAT format, u32 width, u32 height, u32& outRowPitch, u32& outSize)
+	{
+		u32 blockSize = 0;
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC4_UNORM:
+			blockSize = 8;
+			break;
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			blockSize = 16;
+			break;
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+			outRowPitch = width * 4;
+			outSize = outRowPitch * height;
+			return true;
+		default:
+			return false;
+		}
+		outRowPitch = glm::max((width + 3) / 4, 1u) * blockSize;
+		outSize = outRowPitch * glm::max((height + 3) / 4, 1u);
+		return true;
+	}
+
+	DXGI_FORMAT TextureFile::toSRGB(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R8G8B8A8_UNORM: return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+		case DXGI_FORMAT_BC1_UNORM: return DXGI_FORMAT_BC1_UNORM_SRGB;
+		case DXGI_FORMAT_BC3_UNORM: return DXGI_FORMAT_BC3_UNORM_SRGB;
+		case DXGI_FORMAT_BC7_UNORM: return DXGI_FORMAT_BC7_UNORM_SRGB;
+		default: return format;
+		}
+	}
+
+	// ----------------------------------------------------------------------
+
+	bool DDSFile::isDDS(const u8* data, u64 size)
+	{
+		u32 magic = 0;
+		if (size >= sizeof(u32) + sizeof(DDSHeader))
+		{
+			memcpy(&magic, data, sizeof(u32));
+		}
+		return magic == s_ddsMagic;
+	}
+
+	bool DDSFile::parse(const u8* data, u64 size, TextureLevels& outLevels)
+	{
+		if (!isDDS(data, size))
+		{
+			printf("Not a DDS file\n");
+			return false;
+		}
+
+		DDSHeader header;
+		memcpy(&header, data + sizeof(u32), sizeof(DDSHeader));
+		u64 offset = sizeof(u32) + sizeof(DDSHeader);
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		const DDSPixelFormat& pixelFormat = header.m_pixelFormat;
+		if ((pixelFormat.m_flags & s_ddpfFourCC) != 0)
+		{
+			switch (pixelFormat.m_fourCC)
+			{
+			case s_fourCCDX10:
+			{
+				DDSHeaderDX10 headerDX10;
+				if (offset + sizeof(DDSHeaderDX10) > size)
+				{
+					printf("DDS file is truncated\n");
+					return false;
+				}
+				memcpy(&headerDX10, data + offset, sizeof(DDSHeaderDX10));
+				offset += sizeof(DDSHeaderDX10);
+				if (headerDX10.m_resourceDimension != s_resourceDimensionTexture2D || headerDX10.m_arraySize > 1)
+				{
+					printf("Only 2D DDS textures are supported\n");
+					return false;
+				}
+				format = static_cast<DXGI_FORMAT>(headerDX10.m_dxgiFormat);
+				break;
+			}
+			case s_fourCCDXT1: format = DXGI_FORMAT_BC1_UNORM; break;
+			case s_fourCCDXT5: format = DXGI_FORMAT_BC3_UNORM; break;
+			case s_fourCCATI1:
+			case s_fourCCBC4U: format = DXGI_FORMAT_BC4_UNORM; break;
+			case s_fourCCATI2:
+			case s_fourCCBC5U: format = DXGI_FORMAT_BC5_UNORM; break;
+			default: break;
+			}
+		}
+		else if ((pixelFormat.m_flags & s_ddpfRGB) != 0 && pixelFormat.m_rgbBitCount == 32 &&
+			pixelFormat.m_bitMasks[0] == 0x000000FF && pixelFormat.m_bitMasks[1] == 0x0000FF00 && pixelFormat.m_bitMasks[2] == 0x00FF0000)
+		{
+			format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		}
+
+		// The mip count is only meaningful with its flag. Writers that store more mips than the chain has are capped
+		u32 mipCount = (header.m_flags & s_ddsdMipMapCount) != 0 ? glm::max(header.m_mipMapCount, 1u) : 1;
+		mipCount = glm::min(mipCount, getMaxLevelCount(header.m_width, header.m_height));
+		if (!setupLevels(format, header.m_width, header.m_height, mipCount, outLevels))
+		{
+			return false;
+		}
+		// Levels are stored one after another
+		for (TextureLevels::Level& level : outLevels.m_levels)
+		{
+			if (offset + level.m_size > size)
+			{
+				printf("DDS file is truncated\n");
+				return false;
+			}
+			level.m_data = data + offset;
+			offset += level.m_size;
+		}
+		return true;
+	}
+
+	bool DDSFile::write(const char* fileAbsPath, const TextureLevels& levels)
+	{
+		const TextureLevels::Level& level0 = levels.m_levels[0];
+		const u32 mipCount = static_cast<u32>(levels.m_levels.size());
+
+		DDSHeader header;
+		memset(&header, 0, sizeof(DDSHeader));
+		header.m_size = sizeof(DDSHeader);
+		header.m_flags = s_ddsdCaps | s_ddsdHeight | s_ddsdWidth | s_ddsdPixelFormat | s_ddsdMipMapCount | s_ddsdLinearSize;
+		header.m_height = level0.m_height;
+		header.m_width = level0.m_width;
+		header.m_pitchOrLinearSize = level0.m_size;
+		header.m_mipMapCount = mipCount;
+		header.m_pixelFormat.m_size = sizeof(DDSPixelFormat);
+		header.m_pixelFormat.m_flags = s_ddpfFourCC;
+		header.m_pixelFormat.m_fourCC = s_fourCCDX10;
+		header.m_caps[0] = s_ddsCapsTexture | (mipCount > 1 ? (s_ddsCapsComplex | s_ddsCapsMipMap) : 0);
+
+		DDSHeaderDX10 headerDX10;
+		memset(&headerDX10, 0, sizeof(DDSHeaderDX10));
+		headerDX10.m_dxgiFormat = static_cast<u32>(levels.m_format);
+		headerDX10.m_resourceDimension = s_resourceDimensionTexture2D;
+		headerDX10.m_arraySize = 1;
+
+		HANDLE file = FileUtils::openFileForWrite(fileAbsPath);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		bool success = FileUtils::writeBytes(file, sizeof(u32), &s_ddsMagic) == sizeof(u32) &&
+			FileUtils::writeBytes(file, sizeof(DDSHeader), &header) == sizeof(DDSHeader) &&
+			FileUtils::writeBytes(file, sizeof(DDSHeaderDX10), &headerDX10) == sizeof(DDSHeaderDX10);
+		for (u32 i = 0; i < mipCount && success; ++i)
+		{
+			success = FileUtils::writeBytes(file, levels.m_levels[i].m_size, levels.m_levels[i].m_data) == levels.m_levels[i].m_size;
+		}
+		FileUtils::closeFile(file);
+		return success;
+	}
+
+	// ----------------------------------------------------------------------
+
+	bool KTX2File::isKTX2(const u8* data, u64 size)
+	{
+		return size >= sizeof(KTX2Header) && memcmp(data, s_ktx2Identifier, sizeof(s_ktx2Identifier)) == 0;
+	}
+
+	bool KTX2File::parse(const u8* data, u64 size, TextureLevels& outLevels)
+	{
+		if (!isKTX2(data, size))
+		{
+			printf("Not a KTX2 file\n");
+			return false;
+		}
+
+		KTX2Header header;
+		memcpy(&header, data, sizeof(KTX2Header));
+		if (header.m_supercompressionScheme != 0 || header.m_pixelDepth > 1 || header.m_layerCount > 1 || header.m_faceCount != 1)
+		{
+			printf("Only 2D KTX2 textures without supercompression are supported\n");
+			return false;
+		}
+
+		// A level count of 0 asks the loader to generate the mips. Levels point into the file data and
+		// there's nowhere to keep generated ones, so those files must be cooked with their mip chain
+		if (header.m_levelCount == 0)
+		{
+			printf("KTX2 files asking for generated mips (levelCount 0) aren't supported, store the mip chain\n");
+			return false;
+		}
+		const u32 levelCount = header.m_levelCount;
+		if (sizeof(KTX2Header) + static_cast<u64>(levelCount) * sizeof(KTX2LevelIndex) > size)
+		{
+			printf("KTX2 file is truncated\n");
+			return false;
+		}
+		const DXGI_FORMAT format = vkFormatToDXGI(header.m_vkFormat);
+		if (format == DXGI_FORMAT_UNKNOWN)
+		{
+			printf("KTX2 format %u not supported\n", header.m_vkFormat);
+			return false;
+		}
+		if (!setupLevels(format, header.m_pixelWidth, glm::max(header.m_pixelHeight, 1u), levelCount, outLevels))
+		{
+			return false;
+		}
+		for (u32 i = 0; i < levelCount; ++i)
+		{
+			KTX2LevelIndex index;
+			memcpy(&index, data + sizeof(KTX2Header) + i * sizeof(KTX2LevelIndex), sizeof(KTX2LevelIndex));
+			TextureLevels::Level& level = outLevels.m_levels[i];
+			if (index.m_byteLength < level.m_size || index.m_byteOffset + level.m_size > size)
+			{
+				printf("KTX2 file is truncated\n");
+				return false;
+			}
+			level.m_data = data + index.m_byteOffset;
+		}
+		return true;
+	}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// Mip levels of a texture in any format. Level data is owned elsewhere (file contents, mip chain...)
+	struct TextureLevels
+	{
+		struct Level
+		{
+			const u8* m_data = nullptr;
+			u32 m_width = 0;
+			u32 m_height = 0;
+			u32 m_rowPitch = 0; // In bytes, rows of blocks for compressed formats
+			u32 m_size = 0;
+		};
+
+		DXGI_FORMAT m_format = DXGI_FORMAT_UNKNOWN;
+		Vector<Level> m_levels;
+	};
+
+	// Pre-cooked texture containers. Parsing doesn't copy: levels point into the file data, which must outlive them
+	class TextureFile
+	{
+	public:
+
+		// True for DDS and KTX2 files
+		static bool isContainer(const u8* data, u64 size);
+
+		// Detects the container from the data
+		static bool parse(const u8* data, u64 size, TextureLevels& outLevels);
+
+		// Row pitch and size in bytes of a level. Returns false for formats that are not supported
+		static bool getLevelLayout(DXGI_FORMAT format, u32 width, u32 height, u32& outRowPitch, u32& outSize);
+
+		// sRGB variant of the format if it has one
+		static DXGI_FORMAT toSRGB(DXGI_FORMAT format);
+	};
+
+	// DDS container, 2D textures only. Reads the DX10 extended header and the legacy DXT1/DXT5/ATI1/ATI2/RGBA8 formats
+	class DDSFile
+	{
+	public:
+
+		static bool isDDS(const u8* data, u64 size);
+		static bool parse(const u8* data, u64 size, TextureLevels& outLevels);
+
+		// Always written with the DX10 header
+		static bool write(const char* fileAbsPath, const TextureLevels& levels);
+	};
+
+	// KTX2 container, 2D textures without supercompression only
+	class KTX2File
+	{
+	public:
+
+		static bool isKTX2(const u8* data, u64 size);
+		static bool parse(const u8* data, u64 size, TextureLevels& outLevels);
+	};
+}
@@ -0,0 +1,223 @@
+#include "framework/Framework.h"
+#include "framework/TextureStreamer.h"
+
+namespace framework
+{
+
+	u64 TextureStreamer::getSizeOfMips(const StreamedTexture& texture, u32 firstMip) const
+	{
+		u64 size = 0;
+		for (u32 i = firstMip; i < static_cast<u32>(texture.m_levels.m_levels.size()); ++i)
+		{
+			size += texture.m_levels.m_levels[i].m_size;
+		}
+		return size;
+	}
+
+	u32 TextureStreamer::addTexture(ID3D11Device* device, const char* fileAbsPath, Texture2D& outTexture)
+	{
+		StreamedTexture texture;
+		texture.m_file = std::make_unique<MappedFile>();
+		if (!texture.m_file->open(fileAbsPath) || !TextureFile::parse(texture.m_file->getData(), texture.m_file->getSize(), texture.m_levels))
+		{
+			printf("Failed to stream texture %s\n", fileAbsPath);
+			return s_invalidHandle;
+		}
+
+		const u32 mipCount = static_cast<u32>(texture.m_levels.m_levels.size());
+		texture.m_tailMip = mipCount - 1;
+		while (texture.m_tailMip > 0)
+		{
+			const TextureLevels::Level& level = texture.m_levels.m_levels[texture.m_tailMip - 1];
+			if (glm::max(level.m_width, level.m_height) > m_config.m_initialMaxSize)
+			{
+				break;
+			}
+			texture.m_tailMip--;
+		}
+		texture.m_residentMip = texture.m_tailMip;
+		texture.m_requestedMip = texture.m_tailMip;
+		texture.m_texture = &outTexture;
+
+		// The tail is created straight from the file
+		TextureLevels tail;
+		tail.m_format = texture.m_levels.m_format;
+		tail.m_levels.assign(texture.m_levels.m_levels.begin() + texture.m_tailMip, texture.m_levels.m_levels.end());
+		if (!RenderResources::createTexture2D(device, tail, outTexture))
+		{
+			return s_invalidHandle;
+		}
+		m_residentBytes += getSizeOfMips(texture, texture.m_tailMip);
+		m_textures.push_back(std::move(texture));
+		return static_cast<u32>(m_textures.size() - 1);
+	}
+
+	void TextureStreamer::requestMip(u32 handle, f32 uvPerPixel)
+	{
+		if (handle == s_invalidHandle)
+		{
+			return;
+		}
+		StreamedTexture& texture = m_textures[handle];
+		const TextureLevels::Level& level0 = texture.m_levels.m_levels[0];
+		const f32 texelsPerPixel = uvPerPixel * static_cast<f32>(glm::max(level0.m_width, level0.m_height));
+		const u32 mip = static_cast<u32>(glm::clamp(glm::log2(glm::max(texelsPerPixel, 1.0f)), 0.0f, static_cast<f32>(texture.m_tailMip)));
+		if (texture.m_lastUsedFrame != m_frame)
+		{
+			texture.m_lastUsedFrame = m_frame;
+			texture.m_requestedMip = mip;
+		}
+		else
+		{
+			texture.m_requestedMip = glm::min(texture.m_requestedMip, mip);
+		}
+	}
+
+	TextureStreamer::StreamedTexture* TextureStreamer::findEvictionCandidate(u32 priorityIdx)
+	{
+		const StreamedTexture& priority = m_textures[priorityIdx];
+		StreamedTexture* candidate = nullptr;
+		for (u32 i = 0; i < static_cast<u32>(m_textures.size()); ++i)
+		{
+			StreamedTexture& texture = m_textures[i];
+			if (i == priorityIdx || texture.m_residentMip >= texture.m_tailMip)
+			{
+				continue;
+			}
+			// Textures used this frame only give up the mips they don't need
+			const bool isUsed = texture.m_lastUsedFrame == m_frame;
+			if (isUsed && texture.m_residentMip >= texture.m_requestedMip)
+			{
+				continue;
+			}
+			if (!isUsed && texture.m_lastUsedFrame > priority.m_lastUsedFrame)
+			{
+				continue;
+			}
+			if (!candidate || texture.m_lastUsedFrame < candidate->m_lastUsedFrame)
+			{
+				candidate = &texture;
+			}
+		}
+		return candidate;
+	}
+
+	void TextureStreamer::update(ID3D11Device* device, ID3D11DeviceContext* ctx)
+	{
+		// Textures used this frame first, the ones missing more mips before
+		m_streamingOrder.clear();
+		for (u32 i = 0; i < static_cast<u32>(m_textures.size()); ++i)
+		{
+			const StreamedTexture& texture = m_textures[i];
+			if (texture.m_lastUsedFrame == m_frame && texture.m_requestedMip < texture.m_residentMip)
+			{
+				m_streamingOrder.push_back(i);
+			}
+		}
+		std::sort(m_streamingOrder.begin(), m_streamingOrder.end(), [this](u32 a, u32 b)
+		{
+			const StreamedTexture& texA = m_textures[a];
+			const StreamedTexture& texB = m_textures[b];
+			return (texA.m_residentMip - texA.m_requestedMip) > (texB.m_residentMip - texB.m_requestedMip);
+		});
+
+		// Stream in one mip at a time, so the upload of a frame stays small
+		u64 uploadedBytes = 0;
+		bool isStreaming = true;
+		while (isStreaming)
+		{
+			isStreaming = false;
+			for (u32 idx : m_streamingOrder)
+			{
+				StreamedTexture& texture = m_textures[idx];
+				if (texture.m_residentMip <= texture.m_requestedMip)
+				{
+					continue;
+				}
+				const u64 mipSize = texture.m_levels.m_levels[texture.m_residentMip - 1].m_size;
+				if (uploadedBytes + mipSize > m_config.m_uploadBytesPerFrame && uploadedBytes > 0)
+				{
+					break;
+				}
+				while (m_residentBytes + mipSize > m_config.m_budgetBytes)
+				{
+					StreamedTexture* victim = findEvictionCandidate(idx);
+					if (!victim || !setResidentMip(device, ctx, *victim, victim->m_residentMip + 1))
+					{
+						break;
+					}
+				}
+				if (m_residentBytes + mipSize > m_config.m_budgetBytes || !setResidentMip(device, ctx, texture, texture.m_residentMip - 1))
+				{
+					continue;
+				}
+				uploadedBytes += mipSize;
+				isStreaming = true;
+			}
+		}
+		m_frame++;
+	}
+
+	bool TextureStreamer::setResidentMip(ID3D11Device* device, ID3D11DeviceContext* ctx, StreamedTexture& texture, u32 newResidentMip)
+	{
+		const u32 mipCount = static_cast<u32>(texture.m_levels.m_levels.size());
+		const TextureLevels::Level& top = texture.m_levels.m_levels[newResidentMip];
+		D3D11_TEXTURE2D_DESC desc;
+		ZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+		desc.Width = top.m_width;
+		desc.Height = top.m_height;
+		desc.MipLevels = mipCount - newResidentMip;
+		desc.ArraySize = 1;
+		desc.Format = texture.m_levels.m_format;
+		desc.SampleDesc.Count = 1;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+
+		ID3D11Texture2D* newTexture = nullptr;
+		if (FAILED(device->CreateTexture2D(&desc, nullptr, &newTexture)))
+		{
+			printf("Failed to create streamed texture\n");
+			return false;
+		}
+
+		// Mips already on the GPU are copied, the rest come from the file. The mapped file is uploaded from directly,
+		// staging it in an upload ring would only add a copy
+		for (u32 mip = newResidentMip; mip < mipCount; ++mip)
+		{
+			const u32 dstSubresource = mip - newResidentMip;
+			if (mip >= texture.m_residentMip)
+			{
+				ctx->CopySubresourceRegion(newTexture, dstSubresource, 0, 0, 0, texture.m_texture->m_texture, mip - texture.m_residentMip, nullptr);
+			}
+			else
+			{
+				const TextureLevels::Level& level = texture.m_levels.m_levels[mip];
+				ctx->UpdateSubresource(newTexture, dstSubresource, nullptr, level.m_data, level.m_rowPitch, 0);
+			}
+		}
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC descSRV;
+		ZeroMemory(&descSRV, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+		descSRV.Format = desc.Format;
+		descSRV.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		descSRV.Texture2D.MipLevels = -1;
+		descSRV.Texture2D.MostDetailedMip = 0;
+		ID3D11ShaderResourceView* newSRV = nullptr;
+		if (FAILED(device->CreateShaderResourceView(newTexture, &descSRV, &newSRV)))
+		{
+			printf("Failed to create SRV for streamed texture\n");
+			newTexture->Release();
+			return false;
+		}
+
+		Texture2D& dst = *texture.m_texture;
+		dst.m_SRV->Release();
+		dst.m_texture->Release();
+		dst.m_SRV = newSRV;
+		dst.m_texture = newTexture;
+		m_residentBytes = m_residentBytes - getSizeOfMips(texture, texture.m_residentMip) + getSizeOfMips(texture, newResidentMip);
+		texture.m_residentMip = newResidentMip;
+		return true;
+	}
+
+}
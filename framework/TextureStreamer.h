@@ -0,0 +1,72 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+	struct Texture2D;
+
+	// Keeps the mips of cooked textures (DDS/KTX2 files) resident depending on how big they are seen on screen, under a memory budget.
+	// Textures start with their smallest mips only. Every frame, higher mips are streamed in for the textures that need them,
+	// evicting mips of the least recently used textures when the budget is exceeded.
+	// D3D11 can't change the mips of a texture, so every change creates a new texture and copies the mips that stay on the GPU.
+	class TextureStreamer
+	{
+	public:
+
+		static constexpr u32 s_invalidHandle = 0xFFFFFFFF;
+
+		struct Config
+		{
+			u64 m_budgetBytes = 256ull * 1024 * 1024;
+			u64 m_uploadBytesPerFrame = 8ull * 1024 * 1024; // Limits the hitches caused by streaming
+			u32 m_initialMaxSize = 64; // Mips up to this size are loaded on registration and never evicted
+		};
+
+		TextureStreamer() {}
+		TextureStreamer(const TextureStreamer&) = delete;
+		TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+		void setConfig(const Config& config) { m_config = config; }
+		const Config& getConfig() const { return m_config; }
+
+		// Creates outTexture with the smallest mips of the file. outTexture must outlive the streamer, its views get replaced when mips change
+		u32 addTexture(ID3D11Device* device, const char* fileAbsPath, Texture2D& outTexture);
+
+		// uvPerPixel is the size of a screen pixel in UV space where the texture is used this frame
+		void requestMip(u32 handle, f32 uvPerPixel);
+
+		// Stream mips in and out. Call once per frame, after the requests
+		void update(ID3D11Device* device, ID3D11DeviceContext* ctx);
+
+		u64 getResidentBytes() const { return m_residentBytes; }
+		u32 getTextureCount() const { return static_cast<u32>(m_textures.size()); }
+
+	private:
+
+		struct StreamedTexture
+		{
+			UniquePtr<MappedFile> m_file; // Source of the mips that are streamed in
+			TextureLevels m_levels;
+			Texture2D* m_texture = nullptr;
+			u32 m_residentMip = 0; // Most detailed mip in GPU memory
+			u32 m_tailMip = 0; // Mips from here on are always resident
+			u32 m_requestedMip = 0; // Most detailed mip needed this frame
+			u64 m_lastUsedFrame = 0;
+		};
+
+		// Recreate the texture with mips [newResidentMip, last]
+		bool setResidentMip(ID3D11Device* device, ID3D11DeviceContext* ctx, StreamedTexture& texture, u32 newResidentMip);
+
+		// Least recently used texture that can give up its most detailed mip to make room for the texture at priorityIdx
+		StreamedTexture* findEvictionCandidate(u32 priorityIdx);
+
+		u64 getSizeOfMips(const StreamedTexture& texture, u32 firstMip) const;
+
+		Config m_config;
+		Vector<StreamedTexture> m_textures;
+		Vector<u32> m_streamingOrder; // Scratch
+		u64 m_residentBytes = 0;
+		u64 m_frame = 1;
+	};
+}
@@ -0,0 +1,253 @@
+#include "framework/Types.h"
+#include "framework/TextureUtils.h"
+
+#include <cstring>
+#include <cmath>
+#include <emmintrin.h>
+
+namespace framework
+{
+
+	static constexpr u32 s_kaiserTaps = 8;
+	static constexpr u32 s_linearToSRGBTableSize = 0x10000;
+
+	static f32 srgbToLinear(f32 value)
+	{
+		return (value <= 0.04045f) ? (value / 12.92f) : powf((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	static f32 linearToSRGB(f32 value)
+	{
+		return (value <= 0.0031308f) ? (value * 12.92f) : (1.055f * powf(value, 1.0f / 2.4f) - 0.055f);
+	}
+
+	// Conversion tables, built on first use
+	struct ColorTables
+	{
+		ColorTables()
+		{
+			for (u32 i = 0; i < 256; ++i)
+			{
+				m_srgbToLinear[i] = srgbToLinear(static_cast<f32>(i) / 255.0f);
+			}
+			for (u32 i = 0; i < s_linearToSRGBTableSize; ++i)
+			{
+				const f32 srgb = linearToSRGB(static_cast<f32>(i) / static_cast<f32>(s_linearToSRGBTableSize - 1));
+				m_linearToSRGB[i] = static_cast<u8>(glm::clamp(srgb * 255.0f + 0.5f, 0.0f, 255.0f));
+			}
+		}
+
+		f32 m_srgbToLinear[256];
+		u8 m_linearToSRGB[s_linearToSRGBTableSize];
+	};
+
+	static const ColorTables& getColorTables()
+	{
+		static const ColorTables s_tables;
+		return s_tables;
+	}
+
+	// Kaiser windowed sinc weights for a 2:1 reduction. Tap i samples the source texel at offset (i - 3.5) from the destination center
+	static const f32* getKaiserWeights()
+	{
+		struct KaiserWeights
+		{
+			KaiserWeights()
+			{
+				static constexpr f64 s_alpha = 4.0;
+				static constexpr f64 s_radius = s_kaiserTaps / 2;
+				// Zeroth order modified Bessel function of the first kind
+				auto bessel0 = [](f64 x)
+				{
+					f64 sum = 1.0;
+					f64 term = 1.0;
+					for (u32 k = 1; k < 32; ++k)
+					{
+						term *= (x / (2.0 * k)) * (x / (2.0 * k));
+						sum += term;
+					}
+					return sum;
+				};
+				f64 total = 0.0;
+				f64 weights[s_kaiserTaps];
+				for (u32 i = 0; i < s_kaiserTaps; ++i)
+				{
+					const f64 x = static_cast<f64>(i) - (s_kaiserTaps - 1) * 0.5;
+					const f64 t = x / s_radius;
+					const f64 window = bessel0(s_alpha * sqrt(glm::max(0.0, 1.0 - t * t))) / bessel0(s_alpha);
+					const f64 sincArg = glm::pi<f64>() * x * 0.5;
+					const f64 sinc = sin(sincArg) / sincArg;
+					weights[i] = sinc * window;
+					total += weights[i];
+				}
+				for (u32 i = 0; i < s_kaiserTaps; ++i)
+				{
+					m_weights[i] = static_cast<f32>(weights[i] / total);
+				}
+			}
+			f32 m_weights[s_kaiserTaps];
+		};
+		static const KaiserWeights s_kaiser;
+		return s_kaiser.m_weights;
+	}
+
+	static void decodeLevel(const u8* data, u32 texelCount, bool isSRGB, f32* outTexels)
+	{
+		const f32* toLinear = getColorTables().m_srgbToLinear;
+		for (u32 i = 0; i < texelCount; ++i, data += 4, outTexels += 4)
+		{
+			outTexels[0] = isSRGB ? toLinear[data[0]] : data[0] * (1.0f / 255.0f);
+			outTexels[1] = isSRGB ? toLinear[data[1]] : data[1] * (1.0f / 255.0f);
+			outTexels[2] = isSRGB ? toLinear[data[2]] : data[2] * (1.0f / 255.0f);
+			outTexels[3] = data[3] * (1.0f / 255.0f);
+		}
+	}
+
+	static void encodeLevel(const f32* texels, u32 texelCount, bool isSRGB, u8* outData)
+	{
+		const u8* toSRGB = getColorTables().m_linearToSRGB;
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 linearScale = _mm_set1_ps(255.0f);
+		const __m128 tableScale = _mm_set1_ps(static_cast<f32>(s_linearToSRGBTableSize - 1));
+		for (u32 i = 0; i < texelCount; ++i, texels += 4, outData += 4)
+		{
+			const __m128 texel = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(texels), zero), one);
+			alignas(16) s32 linear[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(linear), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(texel, linearScale), half)));
+			if (isSRGB)
+			{
+				alignas(16) s32 tableIdx[4];
+				_mm_store_si128(reinterpret_cast<__m128i*>(tableIdx), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(texel, tableScale), half)));
+				outData[0] = toSRGB[tableIdx[0]];
+				outData[1] = toSRGB[tableIdx[1]];
+				outData[2] = toSRGB[tableIdx[2]];
+			}
+			else
+			{
+				outData[0] = static_cast<u8>(linear[0]);
+				outData[1] = static_cast<u8>(linear[1]);
+				outData[2] = static_cast<u8>(linear[2]);
+			}
+			outData[3] = static_cast<u8>(linear[3]);
+		}
+	}
+
+	// Texels are RGBA floats, one __m128 each. Coordinates are clamped to the edges
+	static void downsampleBox(const f32* src, u32 srcW, u32 srcH, f32* dst, u32 dstW, u32 dstH)
+	{
+		const __m128 quarter = _mm_set1_ps(0.25f);
+		for (u32 y = 0; y < dstH; ++y)
+		{
+			const f32* row0 = src + 4 * srcW * glm::min(2 * y, srcH - 1);
+			const f32* row1 = src + 4 * srcW * glm::min(2 * y + 1, srcH - 1);
+			for (u32 x = 0; x < dstW; ++x)
+			{
+				const u32 x0 = 4 * glm::min(2 * x, srcW - 1);
+				const u32 x1 = 4 * glm::min(2 * x + 1, srcW - 1);
+				__m128 sum = _mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1));
+				sum = _mm_add_ps(sum, _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+				_mm_storeu_ps(dst + 4 * (y * dstW + x), _mm_mul_ps(sum, quarter));
+			}
+		}
+	}
+
+	// Separable: horizontal pass into scratch (dstW x srcH), then vertical pass
+	static void downsampleKaiser(const f32* src, u32 srcW, u32 srcH, f32* dst, u32 dstW, u32 dstH, Vector<f32>& scratch)
+	{
+		const f32* weights = getKaiserWeights();
+		__m128 weights4[s_kaiserTaps];
+		for (u32 i = 0; i < s_kaiserTaps; ++i)
+		{
+			weights4[i] = _mm_set1_ps(weights[i]);
+		}
+		static constexpr s32 s_firstTap = -static_cast<s32>(s_kaiserTaps / 2) + 1;
+
+		scratch.resize(4 * dstW * srcH);
+		for (u32 y = 0; y < srcH; ++y)
+		{
+			const f32* srcRow = src + 4 * srcW * y;
+			f32* dstRow = scratch.data() + 4 * dstW * y;
+			for (u32 x = 0; x < dstW; ++x)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for (u32 i = 0; i < s_kaiserTaps; ++i)
+				{
+					const s32 srcX = glm::clamp(static_cast<s32>(2 * x) + s_firstTap + static_cast<s32>(i), 0, static_cast<s32>(srcW) - 1);
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(srcRow + 4 * srcX), weights4[i]));
+				}
+				_mm_storeu_ps(dstRow + 4 * x, sum);
+			}
+		}
+
+		for (u32 y = 0; y < dstH; ++y)
+		{
+			const f32* rows[s_kaiserTaps];
+			for (u32 i = 0; i < s_kaiserTaps; ++i)
+			{
+				const s32 srcY = glm::clamp(static_cast<s32>(2 * y) + s_firstTap + static_cast<s32>(i), 0, static_cast<s32>(srcH) - 1);
+				rows[i] = scratch.data() + 4 * dstW * srcY;
+			}
+			f32* dstRow = dst + 4 * dstW * y;
+			for (u32 x = 0; x < dstW; ++x)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for (u32 i = 0; i < s_kaiserTaps; ++i)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[i] + 4 * x), weights4[i]));
+				}
+				_mm_storeu_ps(dstRow + 4 * x, sum);
+			}
+		}
+	}
+
+	u32 MipGenerator::computeMipCount(u32 width, u32 height)
+	{
+		u32 count = 1;
+		for (u32 size = glm::max(width, height); size > 1; size >>= 1)
+		{
+			count++;
+		}
+		return count;
+	}
+
+	void MipGenerator::generate(const u8* data, u32 width, u32 height, bool isSRGB, Filter filter, MipChain& outChain)
+	{
+		const u32 mipCount = computeMipCount(width, height);
+		outChain.m_levels.resize(mipCount);
+		u32 totalSize = 0;
+		for (u32 i = 0; i < mipCount; ++i)
+		{
+			MipChain::Level& level = outChain.m_levels[i];
+			level.m_width = glm::max(width >> i, 1u);
+			level.m_height = glm::max(height >> i, 1u);
+			level.m_offset = totalSize;
+			totalSize += level.m_width * level.m_height * MipChain::s_bytesPerTexel;
+		}
+		outChain.m_data.resize(totalSize);
+		memcpy(outChain.m_data.data(), data, width * height * MipChain::s_bytesPerTexel);
+
+		Vector<f32> current(4 * width * height);
+		Vector<f32> next;
+		Vector<f32> scratch;
+		decodeLevel(data, width * height, isSRGB, current.data());
+		for (u32 i = 1; i < mipCount; ++i)
+		{
+			const MipChain::Level& src = outChain.m_levels[i - 1];
+			const MipChain::Level& dst = outChain.m_levels[i];
+			next.resize(4 * dst.m_width * dst.m_height);
+			if (filter == Filter::Kaiser)
+			{
+				downsampleKaiser(current.data(), src.m_width, src.m_height, next.data(), dst.m_width, dst.m_height, scratch);
+			}
+			else
+			{
+				downsampleBox(current.data(), src.m_width, src.m_height, next.data(), dst.m_width, dst.m_height);
+			}
+			encodeLevel(next.data(), dst.m_width * dst.m_height, isSRGB, outChain.m_data.data() + dst.m_offset);
+			current.swap(next);
+		}
+	}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// RGBA8 image with its full mip chain stored contiguously, level 0 first
+	struct MipChain
+	{
+		struct Level
+		{
+			u32 m_width = 0;
+			u32 m_height = 0;
+			u32 m_offset = 0; // In bytes, into m_data
+		};
+
+		static constexpr u32 s_bytesPerTexel = 4;
+
+		const u8* getLevelData(u32 level) const { return m_data.data() + m_levels[level].m_offset; }
+		u32 getLevelPitch(u32 level) const { return m_levels[level].m_width * s_bytesPerTexel; }
+		u32 getLevelCount() const { return static_cast<u32>(m_levels.size()); }
+
+		Vector<Level> m_levels;
+		Vector<u8> m_data;
+	};
+
+	// Generates mip chains on the CPU. Texels are filtered in linear space (sRGB data is linearized first),
+	// carrying float precision from one level to the next. Has no dependency on D3D
+	class MipGenerator
+	{
+	public:
+
+		enum class Filter : u32
+		{
+			Box, // 2x2 average
+			Kaiser, // 8 tap windowed sinc, sharper
+		};
+
+		// Levels down to 1x1
+		static u32 computeMipCount(u32 width, u32 height);
+
+		// Data is tightly packed RGBA8. Alpha is always treated as linear
+		static void generate(const u8* data, u32 width, u32 height, bool isSRGB, Filter filter, MipChain& outChain);
+	};
+}
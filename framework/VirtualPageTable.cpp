@@ -0,0 +1,258 @@
+#include "framework/Types.h"
+#include "framework/Debug.h"
+#include "framework/VirtualPageTable.h"
+
+#include <cstdio>
+
+namespace framework
+{
+
+	static constexpr u32 s_maxMipCount = 16; // 4 bits in the page id
+	static constexpr u32 s_maxSlotsPerAxis = 256; // 8 bits in the table entries
+
+	bool VirtualPageTable::init(const Config& config)
+	{
+		if (config.m_width == 0 || config.m_height == 0 || config.m_pageSize == 0 ||
+			config.m_cacheSlotsX == 0 || config.m_cacheSlotsX > s_maxSlotsPerAxis || config.m_cacheSlotsY == 0 || config.m_cacheSlotsY > s_maxSlotsPerAxis)
+		{
+			printf("Invalid virtual texture configuration\n");
+			return false;
+		}
+
+		m_config = config;
+		m_mipPages.clear();
+		for (u32 mip = 0; ; ++mip)
+		{
+			const u32 width = glm::max(config.m_width >> mip, 1u);
+			const u32 height = glm::max(config.m_height >> mip, 1u);
+			const glm::uvec2 pages((width + config.m_pageSize - 1) / config.m_pageSize, (height + config.m_pageSize - 1) / config.m_pageSize);
+			if (mip >= s_maxMipCount || pages.x > s_maxPagesPerAxis || pages.y > s_maxPagesPerAxis)
+			{
+				printf("Virtual texture too big for its page size\n");
+				return false;
+			}
+			m_mipPages.push_back(pages);
+			if (pages.x == 1 && pages.y == 1)
+			{
+				break;
+			}
+		}
+
+		// The coarsest mip has to fit, it's always resident
+		const u32 coarsestMip = getMipCount() - 1;
+		m_slots.clear();
+		m_slots.resize(config.m_cacheSlotsX * config.m_cacheSlotsY);
+		if (m_mipPages[coarsestMip].x * m_mipPages[coarsestMip].y >= m_slots.size())
+		{
+			printf("Virtual texture page cache too small\n");
+			return false;
+		}
+
+		m_residentPages.clear();
+		m_requests.clear();
+		m_table.clear();
+		m_table.resize(getMipCount());
+		for (u32 mip = 0; mip < getMipCount(); ++mip)
+		{
+			m_table[mip].resize(m_mipPages[mip].x * m_mipPages[mip].y, s_invalidPage);
+		}
+		m_isTableDirty = true;
+		m_frame = 1;
+		return true;
+	}
+
+	u32 VirtualPageTable::getParent(u32 pageId) const
+	{
+		const u32 parentMip = getPageMip(pageId) + 1;
+		if (parentMip >= getMipCount())
+		{
+			return s_invalidPage;
+		}
+		// Mips with an odd number of texels can have less than half the pages
+		const u32 x = glm::min(getPageX(pageId) / 2, m_mipPages[parentMip].x - 1);
+		const u32 y = glm::min(getPageY(pageId) / 2, m_mipPages[parentMip].y - 1);
+		return makePageId(parentMip, x, y);
+	}
+
+	void VirtualPageTable::processFeedback(const u32* entries, u32 count)
+	{
+		u32 lastEntry = s_invalidPage;
+		for (u32 i = 0; i < count; ++i)
+		{
+			const u32 entry = entries[i];
+			const u32 mip = getPageMip(entry);
+			if (entry == s_invalidPage || mip >= getMipCount() || getPageX(entry) >= m_mipPages[mip].x || getPageY(entry) >= m_mipPages[mip].y)
+			{
+				continue;
+			}
+			m_requests[entry]++;
+			if (entry == lastEntry)
+			{
+				continue; // Neighbour pixels mostly hit the same page, the residency walk is done already
+			}
+			lastEntry = entry;
+
+			// The page or the ancestor that is displayed instead is in use
+			for (u32 page = entry; page != s_invalidPage; page = getParent(page))
+			{
+				auto it = m_residentPages.find(page);
+				if (it != m_residentPages.end())
+				{
+					m_slots[it->second].m_lastUsedFrame = m_frame;
+					break;
+				}
+			}
+		}
+	}
+
+	void VirtualPageTable::processFeedbackTarget(const u8* data, u32 width, u32 height, u32 rowPitch)
+	{
+		m_feedbackRow.resize(width);
+		for (u32 y = 0; y < height; ++y)
+		{
+			const u32* row = reinterpret_cast<const u32*>(data + y * rowPitch);
+			for (u32 x = 0; x < width; ++x)
+			{
+				m_feedbackRow[x] = row[x] - 1; // The cleared value becomes s_invalidPage
+			}
+			processFeedback(m_feedbackRow.data(), width);
+		}
+	}
+
+	void VirtualPageTable::getRequests(u32 maxCount, Vector<u32>& outPages) const
+	{
+		// Missing pages with the number of pixels that need them
+		UMap<u32, u32> missing;
+		const u32 coarsestMip = getMipCount() - 1;
+		for (u32 y = 0; y < m_mipPages[coarsestMip].y; ++y)
+		{
+			for (u32 x = 0; x < m_mipPages[coarsestMip].x; ++x)
+			{
+				const u32 page = makePageId(coarsestMip, x, y);
+				if (!isResident(page))
+				{
+					missing[page] = 0xFFFFFFFF;
+				}
+			}
+		}
+		for (const auto& request : m_requests)
+		{
+			for (u32 page = request.first; page != s_invalidPage && !isResident(page); page = getParent(page))
+			{
+				u32& count = missing[page];
+				count = (count > 0xFFFFFFFF - request.second) ? 0xFFFFFFFF : count + request.second;
+			}
+		}
+
+		outPages.clear();
+		outPages.reserve(missing.size());
+		for (const auto& page : missing)
+		{
+			outPages.push_back(page.first);
+		}
+		std::sort(outPages.begin(), outPages.end(), [&missing](u32 a, u32 b)
+		{
+			if (getPageMip(a) != getPageMip(b))
+			{
+				return getPageMip(a) > getPageMip(b);
+			}
+			const u32 countA = missing.at(a);
+			const u32 countB = missing.at(b);
+			return (countA != countB) ? (countA > countB) : (a < b);
+		});
+		if (outPages.size() > maxCount)
+		{
+			outPages.resize(maxCount);
+		}
+	}
+
+	bool VirtualPageTable::mapPage(u32 pageId, u32& outSlotX, u32& outSlotY)
+	{
+		auto it = m_residentPages.find(pageId);
+		u32 slotIdx = (it != m_residentPages.end()) ? it->second : s_invalidPage;
+		if (slotIdx == s_invalidPage)
+		{
+			// Free slot first, then the least recently used one
+			for (u32 i = 0; i < static_cast<u32>(m_slots.size()); ++i)
+			{
+				const Slot& slot = m_slots[i];
+				if (slot.m_page == s_invalidPage)
+				{
+					slotIdx = i;
+					break;
+				}
+				if (!slot.m_isPinned && slot.m_lastUsedFrame < m_frame &&
+					(slotIdx == s_invalidPage || slot.m_lastUsedFrame < m_slots[slotIdx].m_lastUsedFrame))
+				{
+					slotIdx = i;
+				}
+			}
+			if (slotIdx == s_invalidPage)
+			{
+				return false;
+			}
+
+			Slot& slot = m_slots[slotIdx];
+			if (slot.m_page != s_invalidPage)
+			{
+				m_residentPages.erase(slot.m_page);
+			}
+			slot.m_page = pageId;
+			slot.m_isPinned = getPageMip(pageId) == getMipCount() - 1;
+			m_residentPages[pageId] = slotIdx;
+			m_isTableDirty = true;
+		}
+		m_slots[slotIdx].m_lastUsedFrame = m_frame;
+		outSlotX = slotIdx % m_config.m_cacheSlotsX;
+		outSlotY = slotIdx / m_config.m_cacheSlotsX;
+		return true;
+	}
+
+	void VirtualPageTable::endFrame()
+	{
+		m_requests.clear();
+		m_frame++;
+	}
+
+	const Vector<u32>& VirtualPageTable::getTableMip(u32 mip)
+	{
+		if (m_isTableDirty)
+		{
+			rebuildTable();
+		}
+		return m_table[mip];
+	}
+
+	void VirtualPageTable::rebuildTable()
+	{
+		// Coarse to fine, so missing pages can take the entry of their parent
+		for (u32 mip = getMipCount(); mip-- > 0;)
+		{
+			Vector<u32>& entries = m_table[mip];
+			for (u32 y = 0; y < m_mipPages[mip].y; ++y)
+			{
+				for (u32 x = 0; x < m_mipPages[mip].x; ++x)
+				{
+					const u32 page = makePageId(mip, x, y);
+					auto it = m_residentPages.find(page);
+					u32 entry = s_invalidPage;
+					if (it != m_residentPages.end())
+					{
+						entry = makeEntry(it->second % m_config.m_cacheSlotsX, it->second / m_config.m_cacheSlotsX, mip);
+					}
+					else
+					{
+						const u32 parent = getParent(page);
+						if (parent != s_invalidPage)
+						{
+							entry = m_table[mip + 1][getPageY(parent) * m_mipPages[mip + 1].x + getPageX(parent)];
+						}
+					}
+					entries[y * m_mipPages[mip].x + x] = entry;
+				}
+			}
+		}
+		m_isTableDirty = false;
+	}
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "framework/Types.h"
+
+namespace framework
+{
+
+	// CPU side of a software virtual texture: which pages of the virtual mip chain are resident in which slot of the physical
+	// page cache, what the feedback pass asked for and what to load next. Doesn't touch the GPU, so it can run headless
+	// with synthetic feedback.
+	class VirtualPageTable
+	{
+	public:
+
+		static constexpr u32 s_invalidPage = 0xFFFFFFFF;
+		static constexpr u32 s_maxPagesPerAxis = 1 << 14;
+
+		struct Config
+		{
+			u32 m_width = 0; // Virtual size in texels
+			u32 m_height = 0;
+			u32 m_pageSize = 128; // Texels of a page, without borders
+			u32 m_cacheSlotsX = 16; // Physical cache size in pages
+			u32 m_cacheSlotsY = 16;
+		};
+
+		// Page ids pack the mip and the page coordinates in that mip. The feedback pass writes them
+		static u32 makePageId(u32 mip, u32 x, u32 y) { return (mip << 28) | (y << 14) | x; }
+		static u32 getPageMip(u32 pageId) { return pageId >> 28; }
+		static u32 getPageX(u32 pageId) { return pageId & (s_maxPagesPerAxis - 1); }
+		static u32 getPageY(u32 pageId) { return (pageId >> 14) & (s_maxPagesPerAxis - 1); }
+
+		// Page table entries: slot x, slot y and mip of the page that is resident for the area (8 bits each), so it can be
+		// uploaded as R8G8B8A8_UINT. The page itself if resident, the closest resident ancestor otherwise
+		static u32 makeEntry(u32 slotX, u32 slotY, u32 mip) { return slotX | (slotY << 8) | (mip << 16); }
+
+		bool init(const Config& config);
+
+		const Config& getConfig() const { return m_config; }
+		u32 getMipCount() const { return static_cast<u32>(m_mipPages.size()); }
+		u32 getPagesX(u32 mip) const { return m_mipPages[mip].x; }
+		u32 getPagesY(u32 mip) const { return m_mipPages[mip].y; }
+
+		// Count the pages requested by a feedback buffer. Entries are page ids or s_invalidPage
+		void processFeedback(const u32* entries, u32 count);
+
+		// Same for the feedback target read back from the GPU: rows of width entries, rowPitch bytes apart, that hold
+		// page id + 1 (0 where nothing was rendered)
+		void processFeedbackTarget(const u8* data, u32 width, u32 height, u32 rowPitch);
+
+		// Non resident pages to load, most important first: coarser mips first (so every area gets some data soon),
+		// then the most requested. The ancestors of requested pages are requested too
+		void getRequests(u32 maxCount, Vector<u32>& outPages) const;
+
+		// Slot for a page that finished loading. Evicts the least recently used page that wasn't used this frame.
+		// Returns false if every slot is in use
+		bool mapPage(u32 pageId, u32& outSlotX, u32& outSlotY);
+
+		bool isResident(u32 pageId) const { return m_residentPages.find(pageId) != m_residentPages.end(); }
+		u32 getResidentCount() const { return static_cast<u32>(m_residentPages.size()); }
+
+		// Clears the requests. Call once per frame after loading the pages
+		void endFrame();
+
+		// Entries of a mip of the page table. Rebuilt lazily when the residency changed
+		const Vector<u32>& getTableMip(u32 mip);
+		bool isTableDirty() const { return m_isTableDirty; }
+
+	private:
+
+		struct Slot
+		{
+			u32 m_page = s_invalidPage;
+			u64 m_lastUsedFrame = 0;
+			bool m_isPinned = false; // The coarsest mip is never evicted, it's the fallback for everything
+		};
+
+		u32 getParent(u32 pageId) const;
+		void rebuildTable();
+
+		Config m_config;
+		Vector<glm::uvec2> m_mipPages; // Pages per axis of each mip
+		Vector<Slot> m_slots;
+		UMap<u32, u32> m_residentPages; // Page -> Slot
+		UMap<u32, u32> m_requests; // Page -> Times requested this frame
+		Vector<Vector<u32>> m_table;
+		Vector<u32> m_feedbackRow; // Scratch
+		bool m_isTableDirty = true;
+		u64 m_frame = 1;
+	};
+}
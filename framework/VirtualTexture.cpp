@@ -0,0 +1,236 @@
+#include "framework/Framework.h"
+#include "framework/VirtualTexture.h"
+
+namespace framework
+{
+
+	static bool isPowerOf2(u32 value)
+	{
+		return value && (value & (value - 1)) == 0;
+	}
+
+	VirtualTexture::~VirtualTexture()
+	{
+		for (ID3D11Texture2D*& readback : m_feedbackReadback)
+		{
+			if (readback)
+			{
+				readback->Release();
+				readback = nullptr;
+			}
+		}
+		if (m_feedbackRTV)
+		{
+			m_feedbackRTV->Release();
+			m_feedbackRTV = nullptr;
+		}
+		if (m_feedbackTexture)
+		{
+			m_feedbackTexture->Release();
+			m_feedbackTexture = nullptr;
+		}
+	}
+
+	bool VirtualTexture::init(ID3D11Device* device, const char* fileAbsPath, const Config& config, u32 screenWidth, u32 screenHeight)
+	{
+		m_config = config;
+		m_file = std::make_unique<MappedFile>();
+		if (!m_file->open(fileAbsPath) || !TextureFile::parse(m_file->getData(), m_file->getSize(), m_levels))
+		{
+			printf("Failed to open virtual texture %s\n", fileAbsPath);
+			return false;
+		}
+
+		// Block layout of the format: a 1x1 level takes a whole block
+		u32 rowPitch, size4x4;
+		TextureFile::getLevelLayout(m_levels.m_format, 1, 1, rowPitch, m_blockBytes);
+		TextureFile::getLevelLayout(m_levels.m_format, 4, 4, rowPitch, size4x4);
+		m_blockDim = (size4x4 == m_blockBytes) ? 4 : 1;
+
+		// Power of 2 sizes keep the page table mips aligned with the texture mips
+		const TextureLevels::Level& top = m_levels.m_levels[0];
+		if (!isPowerOf2(top.m_width) || !isPowerOf2(top.m_height) || !isPowerOf2(config.m_pageSize) || config.m_pageSize < m_blockDim ||
+			(config.m_pageBorder % m_blockDim) != 0)
+		{
+			printf("Virtual texture %s needs power of 2 sizes and block aligned pages\n", fileAbsPath);
+			return false;
+		}
+
+		VirtualPageTable::Config pageConfig;
+		pageConfig.m_width = top.m_width;
+		pageConfig.m_height = top.m_height;
+		pageConfig.m_pageSize = config.m_pageSize;
+		pageConfig.m_cacheSlotsX = config.m_cacheSlotsX;
+		pageConfig.m_cacheSlotsY = config.m_cacheSlotsY;
+		if (!m_pageTableCPU.init(pageConfig))
+		{
+			return false;
+		}
+		if (m_levels.m_levels.size() < m_pageTableCPU.getMipCount())
+		{
+			printf("Virtual texture %s doesn't have enough mips\n", fileAbsPath);
+			return false;
+		}
+
+		const u32 pageStride = config.m_pageSize + 2 * config.m_pageBorder;
+		m_pageScratch.resize((pageStride / m_blockDim) * (pageStride / m_blockDim) * m_blockBytes);
+
+		// Physical page cache
+		{
+			D3D11_TEXTURE2D_DESC desc;
+			ZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+			desc.Width = config.m_cacheSlotsX * pageStride;
+			desc.Height = config.m_cacheSlotsY * pageStride;
+			desc.MipLevels = 1;
+			desc.ArraySize = 1;
+			desc.Format = m_levels.m_format;
+			desc.SampleDesc.Count = 1;
+			desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+			desc.Usage = D3D11_USAGE_DEFAULT;
+			if (FAILED(device->CreateTexture2D(&desc, nullptr, &m_physical.m_texture)) ||
+				FAILED(device->CreateShaderResourceView(m_physical.m_texture, nullptr, &m_physical.m_SRV)))
+			{
+				printf("Failed to create the virtual texture page cache\n");
+				return false;
+			}
+			m_constants.m_physicalSize = v4(static_cast<f32>(desc.Width), static_cast<f32>(desc.Height), static_cast<f32>(pageStride), static_cast<f32>(config.m_pageBorder));
+			m_constants.m_virtualSize = v4(static_cast<f32>(top.m_width), static_cast<f32>(top.m_height), static_cast<f32>(config.m_pageSize), static_cast<f32>(m_pageTableCPU.getMipCount()));
+		}
+
+		// Page table, one texel per page with a mip per virtual mip
+		{
+			D3D11_TEXTURE2D_DESC desc;
+			ZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+			desc.Width = m_pageTableCPU.getPagesX(0);
+			desc.Height = m_pageTableCPU.getPagesY(0);
+			desc.MipLevels = m_pageTableCPU.getMipCount();
+			desc.ArraySize = 1;
+			desc.Format = DXGI_FORMAT_R8G8B8A8_UINT;
+			desc.SampleDesc.Count = 1;
+			desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+			desc.Usage = D3D11_USAGE_DEFAULT;
+			if (FAILED(device->CreateTexture2D(&desc, nullptr, &m_pageTable.m_texture)) ||
+				FAILED(device->CreateShaderResourceView(m_pageTable.m_texture, nullptr, &m_pageTable.m_SRV)))
+			{
+				printf("Failed to create the virtual texture page table\n");
+				return false;
+			}
+		}
+
+		// Feedback target and the textures it is read back through
+		{
+			m_feedbackWidth = glm::max(screenWidth / glm::max(config.m_feedbackDivisor, 1u), 1u);
+			m_feedbackHeight = glm::max(screenHeight / glm::max(config.m_feedbackDivisor, 1u), 1u);
+			D3D11_TEXTURE2D_DESC desc;
+			ZeroMemory(&desc, sizeof(D3D11_TEXTURE2D_DESC));
+			desc.Width = m_feedbackWidth;
+			desc.Height = m_feedbackHeight;
+			desc.MipLevels = 1;
+			desc.ArraySize = 1;
+			desc.Format = DXGI_FORMAT_R32_UINT;
+			desc.SampleDesc.Count = 1;
+			desc.BindFlags = D3D11_BIND_RENDER_TARGET;
+			desc.Usage = D3D11_USAGE_DEFAULT;
+			if (FAILED(device->CreateTexture2D(&desc, nullptr, &m_feedbackTexture)) ||
+				FAILED(device->CreateRenderTargetView(m_feedbackTexture, nullptr, &m_feedbackRTV)) ||
+				!RenderResources::createDepthAttachment(device, m_feedbackWidth, m_feedbackHeight, DXGI_FORMAT_D24_UNORM_S8_UINT, m_feedbackDepth))
+			{
+				printf("Failed to create the virtual texture feedback target\n");
+				return false;
+			}
+
+			desc.BindFlags = 0;
+			desc.Usage = D3D11_USAGE_STAGING;
+			desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+			for (ID3D11Texture2D*& readback : m_feedbackReadback)
+			{
+				if (FAILED(device->CreateTexture2D(&desc, nullptr, &readback)))
+				{
+					printf("Failed to create the virtual texture feedback readback\n");
+					return false;
+				}
+			}
+		}
+		m_frame = 0;
+		return true;
+	}
+
+	void VirtualTexture::copyPage(u32 pageId)
+	{
+		const u32 mip = VirtualPageTable::getPageMip(pageId);
+		const TextureLevels::Level& level = m_levels.m_levels[mip];
+		const s32 levelBlocksX = static_cast<s32>((level.m_width + m_blockDim - 1) / m_blockDim);
+		const s32 levelBlocksY = static_cast<s32>((level.m_height + m_blockDim - 1) / m_blockDim);
+		const u32 pageBlocks = (m_config.m_pageSize + 2 * m_config.m_pageBorder) / m_blockDim;
+		// First block of the page with its border, which starts before the texture for the first row and column of pages.
+		// Rounds down so those get a negative block
+		const s32 blockDim = static_cast<s32>(m_blockDim);
+		const s32 texelX = static_cast<s32>(VirtualPageTable::getPageX(pageId) * m_config.m_pageSize) - static_cast<s32>(m_config.m_pageBorder);
+		const s32 texelY = static_cast<s32>(VirtualPageTable::getPageY(pageId) * m_config.m_pageSize) - static_cast<s32>(m_config.m_pageBorder);
+		const s32 originX = (texelX >= 0 ? texelX : texelX - blockDim + 1) / blockDim;
+		const s32 originY = (texelY >= 0 ? texelY : texelY - blockDim + 1) / blockDim;
+
+		// Borders outside the texture repeat the edge blocks
+		u8* dst = m_pageScratch.data();
+		for (u32 by = 0; by < pageBlocks; ++by)
+		{
+			const s32 srcY = glm::clamp(originY + static_cast<s32>(by), 0, levelBlocksY - 1);
+			const u8* srcRow = level.m_data + srcY * level.m_rowPitch;
+			for (u32 bx = 0; bx < pageBlocks; ++bx)
+			{
+				const s32 srcX = glm::clamp(originX + static_cast<s32>(bx), 0, levelBlocksX - 1);
+				memcpy(dst, srcRow + srcX * m_blockBytes, m_blockBytes);
+				dst += m_blockBytes;
+			}
+		}
+	}
+
+	void VirtualTexture::update(ID3D11DeviceContext* ctx)
+	{
+		// Read the feedback rendered s_feedbackLatency - 1 frames ago, if the GPU is done with it
+		ctx->CopyResource(m_feedbackReadback[m_frame % s_feedbackLatency], m_feedbackTexture);
+		m_frame++;
+		if (m_frame >= s_feedbackLatency)
+		{
+			ID3D11Texture2D* readback = m_feedbackReadback[m_frame % s_feedbackLatency];
+			D3D11_MAPPED_SUBRESOURCE mapped;
+			if (SUCCEEDED(ctx->Map(readback, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped)))
+			{
+				m_pageTableCPU.processFeedbackTarget(static_cast<const u8*>(mapped.pData), m_feedbackWidth, m_feedbackHeight, mapped.RowPitch);
+				ctx->Unmap(readback, 0);
+			}
+		}
+
+		// Load the most important pages
+		m_pageTableCPU.getRequests(m_config.m_maxPagesPerFrame, m_requestScratch);
+		const u32 pageStride = m_config.m_pageSize + 2 * m_config.m_pageBorder;
+		for (u32 pageId : m_requestScratch)
+		{
+			u32 slotX, slotY;
+			if (!m_pageTableCPU.mapPage(pageId, slotX, slotY))
+			{
+				break; // Every slot is in use this frame
+			}
+			copyPage(pageId);
+			D3D11_BOX box;
+			box.left = slotX * pageStride;
+			box.right = box.left + pageStride;
+			box.top = slotY * pageStride;
+			box.bottom = box.top + pageStride;
+			box.front = 0;
+			box.back = 1;
+			ctx->UpdateSubresource(m_physical.m_texture, 0, &box, m_pageScratch.data(), (pageStride / m_blockDim) * m_blockBytes, 0);
+		}
+
+		if (m_pageTableCPU.isTableDirty())
+		{
+			for (u32 mip = 0; mip < m_pageTableCPU.getMipCount(); ++mip)
+			{
+				const Vector<u32>& entries = m_pageTableCPU.getTableMip(mip);
+				ctx->UpdateSubresource(m_pageTable.m_texture, mip, nullptr, entries.data(), m_pageTableCPU.getPagesX(mip) * sizeof(u32), 0);
+			}
+		}
+		m_pageTableCPU.endFrame();
+	}
+
+}
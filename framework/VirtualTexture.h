@@ -0,0 +1,84 @@
+#pragma once
+
+#include "framework/Types.h"
+#include "framework/VirtualPageTable.h"
+
+namespace framework
+{
+
+	// Software virtual texture backed by a cooked texture file (DDS/KTX2, see TextureFile). Only the pages that the feedback
+	// pass sees are kept in a physical page cache texture, a page table texture maps the virtual pages to it.
+	// Every frame:
+	//  - Render the feedback pass to getFeedbackRTV (page ids written by vtFeedback in assets/shaders/VirtualTexture.hlsli)
+	//  - Call update, which reads back an older feedback (so it never stalls), loads the requested pages and updates the page table
+	//  - Sample with vtSample, binding the page table, the physical texture and the shader constants
+	class VirtualTexture
+	{
+	public:
+
+		struct Config
+		{
+			u32 m_pageSize = 128; // Power of 2
+			u32 m_pageBorder = 4; // Texels copied from the neighbour pages for filtering. Multiple of 4 for BC formats
+			u32 m_cacheSlotsX = 16;
+			u32 m_cacheSlotsY = 16;
+			u32 m_maxPagesPerFrame = 8; // Pages loaded per update
+			u32 m_feedbackDivisor = 8; // The feedback pass is rendered at the screen size divided by this
+		};
+
+		// Layout of VirtualTextureCB in VirtualTexture.hlsli
+		struct ShaderConstants
+		{
+			v4 m_virtualSize; // Width, height, page size, mip count
+			v4 m_physicalSize; // Width, height, page stride, page border. In texels
+		};
+
+		VirtualTexture() {}
+		~VirtualTexture();
+		VirtualTexture(const VirtualTexture&) = delete;
+		VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+		bool init(ID3D11Device* device, const char* fileAbsPath, const Config& config, u32 screenWidth, u32 screenHeight);
+
+		void update(ID3D11DeviceContext* ctx);
+
+		ID3D11RenderTargetView* getFeedbackRTV() const { return m_feedbackRTV; }
+		ID3D11DepthStencilView* getFeedbackDSV() const { return m_feedbackDepth.m_depthStencilView; }
+		u32 getFeedbackWidth() const { return m_feedbackWidth; }
+		u32 getFeedbackHeight() const { return m_feedbackHeight; }
+
+		ID3D11ShaderResourceView* getPageTableSRV() const { return m_pageTable.m_SRV; }
+		ID3D11ShaderResourceView* getPhysicalSRV() const { return m_physical.m_SRV; }
+		const ShaderConstants& getShaderConstants() const { return m_constants; }
+
+		const VirtualPageTable& getPageTable() const { return m_pageTableCPU; }
+
+	private:
+
+		static constexpr u32 s_feedbackLatency = 3; // Frames between rendering the feedback and reading it
+
+		// Copy a page and its borders from the source file into m_pageScratch, in blocks for compressed formats
+		void copyPage(u32 pageId);
+
+		Config m_config;
+		UniquePtr<MappedFile> m_file;
+		TextureLevels m_levels;
+		u32 m_blockDim = 1;
+		u32 m_blockBytes = 4;
+		VirtualPageTable m_pageTableCPU;
+		Texture2D m_physical;
+		Texture2D m_pageTable;
+		ShaderConstants m_constants;
+
+		ID3D11Texture2D* m_feedbackTexture = nullptr;
+		ID3D11RenderTargetView* m_feedbackRTV = nullptr;
+		DepthAttachment m_feedbackDepth;
+		ID3D11Texture2D* m_feedbackReadback[s_feedbackLatency] = {};
+		u32 m_feedbackWidth = 0;
+		u32 m_feedbackHeight = 0;
+		u64 m_frame = 0;
+
+		Vector<u32> m_requestScratch;
+		Vector<u8> m_pageScratch;
+	};
+}
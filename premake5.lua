@@ -132,4 +132,46 @@ addSample("2_Texturing");
 addSample("3_Hierarchy");
 addSample("4_LoadingGLTF");
 addSample("5_Lighting");
-----------------------------------------------------------
\ No newline at end of file
+----------------------------------------------------------
+----------------------------------------------------------
+-- Tests of the framework code that doesn't need D3D. They build on any platform, e.g. on Linux:
+-- premake5 --os=linux gmake2 && make -C _vs tests && ./_bin/Win64/Debug/tests/tests
+----------------------------------------------------------
+TestedFrameworkFiles = 
+{
+	"./framework/TextureUtils.cpp",
+	"./framework/RingAllocator.cpp",
+	"./framework/VirtualPageTable.cpp",
+	"./framework/DrawCulling.cpp",
+	"./framework/RenderGraph.cpp",
+	"./framework/LightClusters.cpp",
+	"./framework/AutoExposure.cpp",
+	"./framework/OcclusionCuller.cpp",
+	"./framework/ShadowAtlas.cpp",
+	"./framework/AccessorUtils.cpp",
+}
+
+group "tests"
+project "tests"
+	kind "ConsoleApp"
+	language "C++"
+	cppdialect "C++17"
+	system(os.target())
+
+	location( config.ProjectFilesDir)
+	targetdir(config.OutPath .. "/tests")
+	objdir(config.ObjPath .. "/tests/obj/")
+	debugdir( "./assets" )
+
+	-------------------
+	-- Add include dirs
+	includedirs { "./", "./external" }
+
+	-------------------
+	-- Add files
+	files { "./tests/**.*", TestedFrameworkFiles }
+
+	filter { "system:linux" }
+		buildoptions { "-msse2" }
+		links { "pthread" }
+	filter {}
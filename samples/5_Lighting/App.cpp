@@ -1,5 +1,10 @@
 #include "samples/5_Lighting/App.h"
 
+#include <cfloat>
+#include <random>
+
+#include "external/glm/gtc/packing.hpp"
+
 #define ENABLE_DEVICE_DEBUG true
 
 // -----------------------------------------------------------------------------------------------
@@ -36,7 +41,8 @@ bool UberShader::uberize(ID3D11Device* device,
 		const String* keywords, u32 keywordCount,
 		const char* entryVS,
 		const char* entryFS,
-		D3D11_INPUT_ELEMENT_DESC* vertexAttributes, u32 vertexAttribCount) 
+		D3D11_INPUT_ELEMENT_DESC* vertexAttributes, u32 vertexAttribCount,
+		const char* srcAbsPath) 
 {
 	u32 combinationsCount = 1 << keywordCount;
 	String defines("");
@@ -58,7 +64,7 @@ bool UberShader::uberize(ID3D11Device* device,
 
 		shaderFinalSrc = defines + src;
 		UniquePtr<framework::ShaderPipeline> shader = std::make_unique<framework::ShaderPipeline>();
-		if (!shader->createGraphicsPipeline(device, shaderFinalSrc.c_str(), shaderFinalSrc.size(), entryVS, entryFS, vertexAttributes, vertexAttribCount)) 
+		if (!shader->createGraphicsPipeline(device, shaderFinalSrc.c_str(), shaderFinalSrc.size(), entryVS, entryFS, vertexAttributes, vertexAttribCount, srcAbsPath)) 
 		{
 			return false;
 		}
@@ -100,9 +106,11 @@ bool loadShader(ID3D11Device* device, const char* relPath, framework::ShaderPipe
 	return outShader.loadGraphicsPipeline(device, relPath, "mainVS", "mainFS", vertexLayout, s_vertexAttribCount);
 }
 
-bool loadSurfaceShader(ID3D11Device* device, const char* relPath, UberShader& outShader) 
+// GPU-driven variants read the draw id from a per instance vertex buffer in slot 2, and the drawcall data from a buffer.
+// hasDrawLights adds the variants that light with the lights of the draw instead of the clusters
+bool loadSurfaceShader(ID3D11Device* device, const char* relPath, UberShader& outShader, bool isGpuDriven = false, bool hasDrawLights = false) 
 {
-	static constexpr u32 s_vertexAttribCount = 4;
+	static constexpr u32 s_vertexAttribCount = 5;
 	D3D11_INPUT_ELEMENT_DESC vertexLayout[s_vertexAttribCount];
 	ZeroMemory(vertexLayout, s_vertexAttribCount * sizeof(D3D11_INPUT_ELEMENT_DESC));
 	vertexLayout[0].SemanticName = "POSITION";
@@ -129,11 +137,23 @@ bool loadSurfaceShader(ID3D11Device* device, const char* relPath, UberShader& ou
 	vertexLayout[3].AlignedByteOffset = u32(offsetof(framework::GltfScene::VertexBuffer1, m_uv));
 	vertexLayout[3].InstanceDataStepRate = D3D11_INPUT_PER_VERTEX_DATA;
 
-	static const u32 s_keywordCount = 2;
+	vertexLayout[4].SemanticName = "DRAWID";
+	vertexLayout[4].Format = DXGI_FORMAT_R32_UINT;
+	vertexLayout[4].InputSlot = 2;
+	vertexLayout[4].AlignedByteOffset = 0;
+	vertexLayout[4].InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+	vertexLayout[4].InstanceDataStepRate = 1;
+
+	// Order of GltfScene::MaterialHashFlags, then the flags of the sample
+	static const u32 s_keywordCount = 6;
 	static String s_keywords[] = 
 	{
 		"NORMAL_MAPPING",
-		"DEBUG_NORMALS"
+		"ALPHA_TEST",
+		"DOUBLE_SIDED",
+		"DEBUG_NORMALS",
+		"TEXTURE_ARRAYS",
+		"DRAW_LIGHTS"
 	};
 
 	String absPath = framework::Paths::getAssetPath(relPath);
@@ -144,7 +164,8 @@ bool loadSurfaceShader(ID3D11Device* device, const char* relPath, UberShader& ou
 		return false;
 	}
 
-	return outShader.uberize(device, hlslSrc.get(), s_keywords, s_keywordCount, "mainVS", "mainFS", vertexLayout, s_vertexAttribCount);
+	const String src = isGpuDriven ? String("#define GPU_DRIVEN 1\n") + hlslSrc.get() : String(hlslSrc.get());
+	return outShader.uberize(device, src, s_keywords, hasDrawLights ? s_keywordCount : s_keywordCount - 1, "mainVS", "mainFS", vertexLayout, isGpuDriven ? s_vertexAttribCount : s_vertexAttribCount - 1, absPath.c_str());
 }
 
 static void updateFrameCB(ID3D11DeviceContext* ctx, ID3D11Buffer* cBuffer, const FrameDataCB& frameData) 
@@ -152,10 +173,29 @@ static void updateFrameCB(ID3D11DeviceContext* ctx, ID3D11Buffer* cBuffer, const
 	framework::RenderResources::updateMappableCBData(ctx, cBuffer, &frameData, sizeof(FrameDataCB));
 }
 
-static void updateBatchCB(ID3D11DeviceContext* ctx, ID3D11Buffer* cBuffer, const m4& model) 
+static DrawcallDataCB getDrawcallData(const m4& model, const framework::GltfScene::SurfaceMaterial* material) 
 {
 	DrawcallDataCB drawcallCB;
 	drawcallCB.m_model = model;
+	drawcallCB.m_albedoSlice = material ? material->m_albedoSlot.m_slice : 0;
+	drawcallCB.m_normalSlice = material ? material->m_normalSlot.m_slice : 0;
+	drawcallCB.m_alphaCutoff = material ? material->m_record.m_alphaCutoff : 0.0f;
+	drawcallCB.m_normalScale = material ? material->m_record.m_normalScale : 1.0f;
+	drawcallCB.m_baseColorFactor = material ? material->m_record.m_baseColorFactor : v4(1.0f);
+	drawcallCB.m_lightOffset = 0;
+	drawcallCB.m_lightCount = 0;
+	return drawcallCB;
+}
+
+static void updateBatchCB(ID3D11DeviceContext* ctx, ID3D11Buffer* cBuffer, const m4& model, const framework::GltfScene::SurfaceMaterial* material = nullptr, 
+	const framework::DrawLightLists::Range* lightRange = nullptr) 
+{
+	DrawcallDataCB drawcallCB = getDrawcallData(model, material);
+	if (lightRange) 
+	{
+		drawcallCB.m_lightOffset = lightRange->m_offset;
+		drawcallCB.m_lightCount = lightRange->m_count;
+	}
 	framework::RenderResources::updateMappableCBData(ctx, cBuffer, &drawcallCB, sizeof(DrawcallDataCB));
 }
 
@@ -216,29 +256,31 @@ void App::doGui(DebugConfig& config)
 			break;
 			case 1:
 			{
-				v3 color = m_frameCBData.pointLightColor / m_pointLightIntensity;
+				framework::ClusterLight& pointLight = m_lights[s_editPointLightIdx];
+				v3 color = pointLight.m_color / m_pointLightIntensity;
 
-				ImGui::InputFloat("Point light radius", &m_frameCBData.pointLightRadius);
+				ImGui::InputFloat("Point light radius", &pointLight.m_radius);
 				ImGui::ColorEdit3("Point light color", &color[0]);
 				ImGui::InputFloat("Point Light Intensity", &m_pointLightIntensity);
-				m_frameCBData.pointLightRadius = glm::max(m_frameCBData.pointLightRadius, 0.0f);
-				m_frameCBData.pointLightColor = color * m_pointLightIntensity;
+				pointLight.m_radius = glm::max(pointLight.m_radius, 0.0f);
+				pointLight.m_color = color * m_pointLightIntensity;
 			}
 			break;
 			case 2:
 			{
-				v3 color = m_frameCBData.spotLightColor / m_spotLightIntensity;
+				framework::ClusterLight& spotLight = m_lights[s_editSpotLightIdx];
+				v3 color = spotLight.m_color / m_spotLightIntensity;
 
-				ImGui::InputFloat("Spot light inner radius", &m_frameCBData.spotLightRadius);
+				ImGui::InputFloat("Spot light inner radius", &spotLight.m_radius);
 				ImGui::ColorEdit3("Spot light color", &color[0]);
 				ImGui::InputFloat("Spot Light Intensity", &m_spotLightIntensity);
-				f32 innerAngle = glm::degrees(glm::acos(m_frameCBData.spotLightInnerCone));
-				f32 outerAngle = glm::degrees(glm::acos(m_frameCBData.spotLightOuterCone));
+				f32 innerAngle = glm::degrees(glm::acos(spotLight.m_cosInnerCone));
+				f32 outerAngle = glm::degrees(glm::acos(spotLight.m_cosOuterCone));
 				ImGui::SliderFloat("Spot inner angle", &innerAngle, 0.0f, outerAngle);
 				ImGui::SliderFloat("Spot outer angle", &outerAngle, 0.0f, 89.9f);
-				m_frameCBData.spotLightInnerCone = glm::cos(glm::radians(glm::min(innerAngle, outerAngle)));
-				m_frameCBData.spotLightOuterCone = glm::cos(glm::radians(glm::max(outerAngle, innerAngle)));
-				m_frameCBData.spotLightColor = color * m_spotLightIntensity;
+				spotLight.m_cosInnerCone = glm::cos(glm::radians(glm::min(innerAngle, outerAngle)));
+				spotLight.m_cosOuterCone = glm::cos(glm::radians(glm::max(outerAngle, innerAngle)));
+				spotLight.m_color = color * m_spotLightIntensity;
 			}
 			break;
 			default:
@@ -248,7 +290,60 @@ void App::doGui(DebugConfig& config)
 			ImGui::Separator();
 
 			ImGui::CheckboxFlags("NormalMapping enabled", &config.m_renderingFeaturesMask, 1 << framework::GltfScene::NormalMap);
+			ImGui::CheckboxFlags("Alpha test enabled", &config.m_renderingFeaturesMask, 1 << framework::GltfScene::AlphaTest);
+			ImGui::CheckboxFlags("Double sided enabled", &config.m_renderingFeaturesMask, 1 << framework::GltfScene::DoubleSided);
 			ImGui::CheckboxFlags("Debug normals", &config.m_renderingFeaturesMask, s_DebugNormalsFlag);
+			ImGui::RadioButton("Forward", &config.m_shadingPath, 0); ImGui::SameLine();
+			ImGui::RadioButton("Deferred", &config.m_shadingPath, 1);
+			ImGui::Checkbox("Depth pre-pass", &config.m_depthPrepass);
+			if (config.m_shadingPath == 0 && !config.m_gpuCulling) 
+			{
+				ImGui::RadioButton("Lights per cluster", &config.m_lightAssignment, 0); ImGui::SameLine();
+				ImGui::RadioButton("Lights per draw", &config.m_lightAssignment, 1);
+				if (config.m_lightAssignment == 1) 
+				{
+					const u32 lightIndexCount = static_cast<u32>(m_drawLightLists.getLightIndices().size());
+					ImGui::Text("Draw lights: %.1f per draw in view (%u draws), %u dropped (%.2f ms)", 
+						static_cast<f64>(lightIndexCount) / glm::max(m_drawLightsDrawCount, 1u), m_drawLightsDrawCount, m_drawLightLists.getDroppedCount(), m_drawLightsTimeMs);
+				}
+			}
+			ImGui::RadioButton("Sort by material", &config.m_sortMode, 0); ImGui::SameLine();
+			ImGui::RadioButton("Sort front to back", &config.m_sortMode, 1);
+			ImGui::Text("Pre-pass: %u draws, %u state changes", m_prepassStats.m_draws, m_prepassStats.m_stateChanges);
+			ImGui::Text("Shading: %u draws, %u shader, %u state and %u resource changes", m_shadingStats.m_draws, m_shadingStats.m_shaderChanges, m_shadingStats.m_stateChanges, m_shadingStats.m_resourceChanges);
+			const framework::RenderGraph::Report& graphReport = m_frameGraph.getReport();
+			ImGui::Text("Frame graph: %u passes (%u culled), %u targets in %u textures, %.1f MB (%.1f MB saved)", graphReport.m_passCount, graphReport.m_culledPassCount, 
+				graphReport.m_transientCount, graphReport.m_physicalCount, static_cast<f64>(graphReport.m_physicalBytes) / (1024.0 * 1024.0), static_cast<f64>(graphReport.getSavedBytes()) / (1024.0 * 1024.0));
+			ImGui::SliderFloat("Exposure compensation (EV)", &config.m_exposureCompensation, -4.0f, 4.0f);
+			if (ImGui::Button("Validate exposure against the CPU reference")) 
+			{
+				m_validateExposure = true;
+			}
+			if (m_exposureValidationError >= 0.0f) 
+			{
+				ImGui::SameLine();
+				ImGui::Text("%.4f%% max difference", m_exposureValidationError * 100.0f);
+			}
+			ImGui::Checkbox("Occlusion culling", &config.m_occlusionCulling);
+			const framework::OcclusionCuller::Stats& occlusionStats = m_occlusionCuller.getStats();
+			ImGui::Text("Occlusion: %u occluder triangles, %.1f%% of %u draws culled (%.2f ms)", occlusionStats.m_occluderTriangles, 
+				occlusionStats.getCulledPercentage(), occlusionStats.m_testedCount, m_occlusionTimeMs);
+			ImGui::Checkbox("GPU culling (indirect draws)", &config.m_gpuCulling);
+			if (config.m_gpuCulling) 
+			{
+				ImGui::Checkbox("GPU occlusion culling (two phase)", &config.m_gpuOcclusion);
+				ImGui::Text("GPU culling: %u/%u draws visible", m_gpuVisibleCount, static_cast<u32>(m_drawList.size()));
+				if (ImGui::Button("Validate against the CPU reference")) 
+				{
+					m_validateGpuCulling = true;
+				}
+				if (m_cullValidationMismatches >= 0) 
+				{
+					ImGui::SameLine();
+					ImGui::Text("%d mismatches", m_cullValidationMismatches);
+				}
+			}
+			ImGui::Text("Shadow views: %u, rendered: %u, cached tiles: %u", static_cast<u32>(m_shadowViews.size()), static_cast<u32>(m_shadowAtlas.getRenderList().size()), m_shadowAtlas.getCachedCount());
 			ImGui::End();
 		}
 
@@ -268,9 +363,9 @@ void App::doGui(DebugConfig& config)
 			break;
 			case 1:
 			{
-				m4 model = glm::translate(m4(1.0f), m_frameCBData.pointLightPos);
+				m4 model = glm::translate(m4(1.0f), m_lights[s_editPointLightIdx].m_pos);
 				framework::Gizmo3D::drawTranslationGizmo(view, projection, model);
-				m_frameCBData.pointLightPos = model[3];
+				m_lights[s_editPointLightIdx].m_pos = model[3];
 			}
 			break;
 			case 2:
@@ -283,8 +378,8 @@ void App::doGui(DebugConfig& config)
 				{
 					framework::Gizmo3D::drawRotationGizmo(view, projection, m_spotModelNoScale);
 				}
-				m_frameCBData.spotLightPos = m_spotModelNoScale[3];
-				m_frameCBData.spotLightDir = glm::normalize(m_spotModelNoScale[2]);
+				m_lights[s_editSpotLightIdx].m_pos = m_spotModelNoScale[3];
+				m_lights[s_editSpotLightIdx].m_dir = glm::normalize(m_spotModelNoScale[2]);
 			}
 			break;
 			default:
@@ -308,8 +403,9 @@ void App::drawDebugPrims(DebugConfig& config)
 			break;
 		case 1:
 		{
-			m4 model = glm::scale(m4(1.0f), v3(m_frameCBData.pointLightRadius));
-			model[3] = v4(m_frameCBData.pointLightPos, 1.0f);
+			const framework::ClusterLight& pointLight = m_lights[s_editPointLightIdx];
+			m4 model = glm::scale(m4(1.0f), v3(pointLight.m_radius));
+			model[3] = v4(pointLight.m_pos, 1.0f);
 			drawDebugPrim(m_ctx, model, m_drawcallCB, m_debugSphere);
 		}
 		break;
@@ -318,9 +414,10 @@ void App::drawDebugPrims(DebugConfig& config)
 			m4 translation = glm::translate(m4(1.0f), (v3)m_spotModelNoScale[3]);
 			m4 rot = m_spotModelNoScale;
 			rot[3] = v4(0.0f, 0.0f, 0.0f, 1.0f);
-			m4 model = translation * rot * getSpotlightScale(glm::acos(m_frameCBData.spotLightInnerCone), m_frameCBData.spotLightRadius);
+			const framework::ClusterLight& spotLight = m_lights[s_editSpotLightIdx];
+			m4 model = translation * rot * getSpotlightScale(glm::acos(spotLight.m_cosInnerCone), spotLight.m_radius);
 			drawDebugPrim(m_ctx, model, m_drawcallCB, m_debugCone);
-			model = translation * rot * getSpotlightScale(glm::acos(m_frameCBData.spotLightOuterCone), m_frameCBData.spotLightRadius);
+			model = translation * rot * getSpotlightScale(glm::acos(spotLight.m_cosOuterCone), spotLight.m_radius);
 			drawDebugPrim(m_ctx, model, m_drawcallCB, m_debugCone);
 		}
 		break;
@@ -330,6 +427,1170 @@ void App::drawDebugPrims(DebugConfig& config)
 	}
 }
 
+void App::buildDrawList() 
+{
+	const Vector<framework::GltfScene::Mesh>& meshes = m_scene->getMeshes();
+	const Vector<framework::GltfScene::Node>& nodes = m_scene->getNodes();
+	const Vector<framework::GltfScene::SurfaceMaterial>& materials = m_scene->getMaterials();
+
+	m_drawList.clear();
+	for (u32 nodeIdx = 0; nodeIdx < static_cast<u32>(nodes.size()); ++nodeIdx) 
+	{
+		const framework::GltfScene::Node& node = nodes[nodeIdx];
+		if (node.m_mesh >= static_cast<u32>(meshes.size())) 
+		{
+			continue; // Nodes without mesh
+		}
+		const Vector<framework::GltfScene::Meshlet>& meshlets = meshes[node.m_mesh].m_meshlets;
+		for (u32 meshletIdx = 0; meshletIdx < static_cast<u32>(meshlets.size()); ++meshletIdx) 
+		{
+			const framework::GltfScene::Meshlet& meshlet = meshlets[meshletIdx];
+			const framework::GltfScene::SurfaceMaterial& mat = materials[meshlet.m_material];
+			// Material sort id (shader variant, texture arrays, textures, samplers), then index format
+			DrawItem item;
+			item.m_sortKey = (static_cast<u64>(mat.m_sortId) << 8) | (meshlet.m_isIndexShort ? 1 : 0);
+			item.m_node = nodeIdx;
+			item.m_meshlet = meshletIdx;
+			m_drawList.push_back(item);
+		}
+	}
+	std::sort(m_drawList.begin(), m_drawList.end(), [](const DrawItem& a, const DrawItem& b) 
+	{
+		return a.m_sortKey < b.m_sortKey;
+	});
+	m_materialOrder.resize(m_drawList.size());
+	for (u32 i = 0; i < static_cast<u32>(m_drawList.size()); ++i) 
+	{
+		m_materialOrder[i] = i;
+	}
+}
+
+void App::sortFrontToBack() 
+{
+	const Vector<framework::GltfScene::Mesh>& meshes = m_scene->getMeshes();
+	const Vector<framework::GltfScene::Node>& nodes = m_scene->getNodes();
+	const m4 view = m_fpCam.getView();
+
+	// Distance to the closest point of the bounding sphere in the high bits (positive floats sort as integers), draw index in the low ones
+	m_depthKeys.resize(m_drawList.size());
+	for (u32 i = 0; i < static_cast<u32>(m_drawList.size()); ++i) 
+	{
+		const DrawItem& item = m_drawList[i];
+		const framework::GltfScene::Node& node = nodes[item.m_node];
+		const framework::GltfScene::Meshlet& meshlet = meshes[node.m_mesh].m_meshlets[item.m_meshlet];
+		const f32 scale = glm::max(glm::length(v3(node.m_model[0])), glm::max(glm::length(v3(node.m_model[1])), glm::length(v3(node.m_model[2]))));
+		const f32 depth = -(view * node.m_model * v4(meshlet.m_boundsCenter, 1.0f)).z - meshlet.m_boundsRadius * scale;
+		m_depthKeys[i] = (static_cast<u64>(glm::floatBitsToUint(glm::max(depth, 0.0f))) << 32) | i;
+	}
+	std::sort(m_depthKeys.begin(), m_depthKeys.end());
+	m_frontToBackOrder.resize(m_drawList.size());
+	for (u32 i = 0; i < static_cast<u32>(m_depthKeys.size()); ++i) 
+	{
+		m_frontToBackOrder[i] = static_cast<u32>(m_depthKeys[i]);
+	}
+}
+
+void App::addRandomLights(u32 count) 
+{
+	// Bounds of the scene
+	v3 boundsMin(FLT_MAX);
+	v3 boundsMax(-FLT_MAX);
+	const Vector<framework::GltfScene::Mesh>& meshes = m_scene->getMeshes();
+	for (const framework::GltfScene::Node& node : m_scene->getNodes()) 
+	{
+		if (node.m_mesh >= static_cast<u32>(meshes.size())) 
+		{
+			continue;
+		}
+		for (const framework::GltfScene::Meshlet& meshlet : meshes[node.m_mesh].m_meshlets) 
+		{
+			const v3 center = v3(node.m_model * v4(meshlet.m_boundsCenter, 1.0f));
+			boundsMin = glm::min(boundsMin, center);
+			boundsMax = glm::max(boundsMax, center);
+		}
+	}
+	if (count == 0 || boundsMin.x > boundsMax.x) 
+	{
+		return;
+	}
+
+	// Fixed seed, so runs can be compared
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+	for (u32 i = 0; i < count; ++i) 
+	{
+		framework::ClusterLight light;
+		light.m_pos = boundsMin + (boundsMax - boundsMin) * v3(unit(rng), unit(rng), unit(rng));
+		light.m_radius = 1.0f + 2.0f * unit(rng);
+		light.m_color = glm::normalize(v3(unit(rng), unit(rng), unit(rng)) + 0.1f);
+		if (unit(rng) < 0.25f) 
+		{
+			light.m_type = framework::ClusterLight::Spot;
+			light.m_dir = glm::normalize(v3(unit(rng) - 0.5f, -1.0f, unit(rng) - 0.5f));
+			light.m_cosInnerCone = glm::cos(glm::radians(20.0f));
+			light.m_cosOuterCone = glm::cos(glm::radians(35.0f));
+		}
+		m_lights.push_back(light);
+	}
+}
+
+bool App::updateLightClusters() 
+{
+	m_lightClusters.build(m_fpCam.getView(), m_fpCam.getProjection(), m_fpCam.getNearPlane(), m_fpCam.getFarPlane(), m_width, m_height, 
+		m_lights.data(), static_cast<u32>(m_lights.size()));
+	const Vector<framework::LightClusters::Range>& ranges = m_lightClusters.getRanges();
+	const Vector<u32>& indices = m_lightClusters.getLightIndices();
+	return framework::RenderResources::updateStructuredBuffer(m_device, m_ctx, m_lights.data(), static_cast<u32>(sizeof(framework::ClusterLight)), static_cast<u32>(m_lights.size()), m_lightBuffer) &&
+		framework::RenderResources::updateStructuredBuffer(m_device, m_ctx, ranges.data(), static_cast<u32>(sizeof(framework::LightClusters::Range)), static_cast<u32>(ranges.size()), m_clusterRangeBuffer) &&
+		framework::RenderResources::updateStructuredBuffer(m_device, m_ctx, indices.data(), static_cast<u32>(sizeof(u32)), static_cast<u32>(indices.size()), m_clusterLightIndexBuffer) &&
+		framework::RenderResources::updateMappableCBData(m_ctx, m_clusterCB, &m_lightClusters.getShaderConstants(), sizeof(framework::LightClusters::ShaderConstants));
+}
+
+bool App::updateDrawLights(const DebugConfig& config) 
+{
+	m_useDrawLights = config.m_lightAssignment == 1 && config.m_shadingPath == 0 && !config.m_gpuCulling;
+	if (!m_useDrawLights) 
+	{
+		return true;
+	}
+	const f64 startMs = framework::Time::getTimeStampMs();
+	const Vector<framework::GltfScene::Mesh>& meshes = m_scene->getMeshes();
+	const Vector<framework::GltfScene::Node>& nodes = m_scene->getNodes();
+	const u32 drawCount = static_cast<u32>(m_drawList.size());
+	if (m_drawBounds.size() != drawCount) 
+	{
+		m_drawBounds.resize(drawCount);
+		for (u32 i = 0; i < drawCount; ++i) 
+		{
+			const DrawItem& item = m_drawList[i];
+			const framework::GltfScene::Node& node = nodes[item.m_node];
+			const framework::GltfScene::Meshlet& meshlet = meshes[node.m_mesh].m_meshlets[item.m_meshlet];
+			const m3 absModel(glm::abs(v3(node.m_model[0])), glm::abs(v3(node.m_model[1])), glm::abs(v3(node.m_model[2])));
+			m_drawBounds[i].m_center = v3(node.m_model * v4(meshlet.m_boundsCenter, 1.0f));
+			m_drawBounds[i].m_extents = absModel * meshlet.m_boundsExtents;
+		}
+	}
+
+	// Draws out of the view get no lights, they aren't drawn
+	const framework::Frustum frustum = framework::Frustum::fromViewProj(m_fpCam.getViewProj());
+	m_drawInView.resize(drawCount);
+	m_drawLightsDrawCount = 0;
+	for (u32 i = 0; i < drawCount; ++i) 
+	{
+		m_drawInView[i] = (m_drawVisible[i] && frustum.isSphereVisible(m_drawBounds[i].m_center, glm::length(m_drawBounds[i].m_extents))) ? 1 : 0;
+		m_drawLightsDrawCount += m_drawInView[i];
+	}
+	m_drawLightLists.build(m_drawBounds.data(), m_drawInView.data(), drawCount, m_lights.data(), static_cast<u32>(m_lights.size()));
+	const Vector<u32>& indices = m_drawLightLists.getLightIndices();
+	m_drawLightsTimeMs = framework::Time::getTimeStampMs() - startMs;
+	return framework::RenderResources::updateStructuredBuffer(m_device, m_ctx, indices.data(), static_cast<u32>(sizeof(u32)), static_cast<u32>(indices.size()), m_drawLightIndexBuffer);
+}
+
+void App::addShadowView(u64 key, const m4& viewProj, f32 importance, u32 size, const v3& boundsCenter, f32 boundsRadius, f32 extent, bool isPerspective) 
+{
+	framework::ShadowAtlas::Request request;
+	request.m_key = key;
+	request.m_viewHash = framework::Hash::compute(&viewProj, sizeof(m4));
+	request.m_importance = importance;
+	request.m_size = size;
+	request.m_boundsCenter = boundsCenter;
+	request.m_boundsRadius = boundsRadius;
+	m_shadowRequests.push_back(request);
+
+	ShadowViewData view;
+	view.m_viewProj = viewProj;
+	view.m_normalOffset = extent; // Divided by the tile size once it's known
+	view.m_isPerspective = isPerspective ? 1 : 0;
+	view.m_isValid = 0;
+	m_shadowViews.push_back(view);
+}
+
+bool App::updateShadows() 
+{
+	m_shadowRequests.clear();
+	m_shadowViews.clear();
+
+	// Cascades first, they are the most important views
+	const framework::ShadowCascades::Config cascadeConfig;
+	m_shadowCascades.build(cascadeConfig, m_fpCam.getView(), m_fpCam.getProjection(), m_fpCam.getNearPlane(), m_fpCam.getFarPlane(), m_frameCBData.lightDir, s_cascadeShadowSize);
+	m_shadowCBData.m_cascadeCount = m_shadowCascades.getCascadeCount();
+	for (u32 i = 0; i < m_shadowCascades.getCascadeCount(); ++i) 
+	{
+		const framework::ShadowCascades::Cascade& cascade = m_shadowCascades.getCascade(i);
+		// Casters up to m_casterDistance towards the light are in the view too
+		const v3 boundsCenter = cascade.m_center - m_frameCBData.lightDir * (cascadeConfig.m_casterDistance * 0.5f);
+		addShadowView(i, cascade.m_viewProj, FLT_MAX, s_cascadeShadowSize, boundsCenter, cascade.m_radius + cascadeConfig.m_casterDistance * 0.5f, 2.0f * cascade.m_radius, false);
+		m_shadowCBData.m_cascadeSplits[i] = cascade.m_splitFar;
+	}
+
+	// Spot and point lights by their size on screen. Lights out of the view cast no shadows
+	const framework::Frustum frustum = framework::Frustum::fromViewProj(m_fpCam.getViewProj());
+	const v3 camPos = m_fpCam.getPos();
+	m_shadowCandidates.clear();
+	for (u32 i = 0; i < static_cast<u32>(m_lights.size()); ++i) 
+	{
+		framework::ClusterLight& light = m_lights[i];
+		light.m_shadowView = framework::ClusterLight::s_noShadow;
+		if (light.m_radius > 0.0f && frustum.isSphereVisible(light.m_pos, light.m_radius)) 
+		{
+			m_shadowCandidates.push_back({light.m_radius / glm::max(glm::length(light.m_pos - camPos), m_fpCam.getNearPlane()), i});
+		}
+	}
+	const u32 shadowedCount = glm::min(static_cast<u32>(m_shadowCandidates.size()), s_maxShadowedLights);
+	std::partial_sort(m_shadowCandidates.begin(), m_shadowCandidates.begin() + shadowedCount, m_shadowCandidates.end(), [](const std::pair<f32, u32>& a, const std::pair<f32, u32>& b) 
+	{
+		return a.first > b.first;
+	});
+
+	static const v3 s_cubeFaceDirs[] = {v3(1.0f, 0.0f, 0.0f), v3(-1.0f, 0.0f, 0.0f), v3(0.0f, 1.0f, 0.0f), v3(0.0f, -1.0f, 0.0f), v3(0.0f, 0.0f, 1.0f), v3(0.0f, 0.0f, -1.0f)};
+	static const v3 s_cubeFaceUps[] = {v3(0.0f, 1.0f, 0.0f), v3(0.0f, 1.0f, 0.0f), v3(0.0f, 0.0f, 1.0f), v3(0.0f, 0.0f, 1.0f), v3(0.0f, 1.0f, 0.0f), v3(0.0f, 1.0f, 0.0f)};
+	static constexpr f32 s_shadowNearPlane = 0.05f;
+	for (u32 i = 0; i < shadowedCount; ++i) 
+	{
+		const f32 importance = m_shadowCandidates[i].first;
+		framework::ClusterLight& light = m_lights[m_shadowCandidates[i].second];
+		const u32 size = static_cast<u32>(glm::min(importance, 1.0f) * s_maxLightShadowSize); // The atlas rounds it up to a power of 2
+		const u64 key = static_cast<u64>(m_shadowCandidates[i].second + 1) << 8;
+		light.m_shadowView = static_cast<u32>(m_shadowViews.size());
+		if (light.m_type == framework::ClusterLight::Spot) 
+		{
+			const f32 fov = glm::min(2.0f * glm::acos(glm::clamp(light.m_cosOuterCone, 0.0f, 1.0f)) + glm::radians(2.0f), glm::radians(170.0f));
+			const v3 dir = glm::normalize(light.m_dir);
+			const v3 up = (glm::abs(dir.y) > 0.99f) ? v3(1.0f, 0.0f, 0.0f) : v3(0.0f, 1.0f, 0.0f);
+			const m4 viewProj = glm::perspectiveRH_ZO(fov, 1.0f, s_shadowNearPlane, light.m_radius) * glm::lookAt(light.m_pos, light.m_pos + dir, up);
+			addShadowView(key, viewProj, importance, size, light.m_pos, light.m_radius, 2.0f * glm::tan(fov * 0.5f), true);
+		}
+		else 
+		{
+			const m4 projection = glm::perspectiveRH_ZO(glm::radians(90.0f), 1.0f, s_shadowNearPlane, light.m_radius);
+			for (u32 face = 0; face < 6; ++face) 
+			{
+				const m4 viewProj = projection * glm::lookAt(light.m_pos, light.m_pos + s_cubeFaceDirs[face], s_cubeFaceUps[face]);
+				addShadowView(key | face, viewProj, importance, size / 2, light.m_pos, light.m_radius, 2.0f, true);
+			}
+		}
+	}
+
+	// Tiles and the atlas UVs of the views
+	m_shadowAtlas.update(m_shadowRequests.data(), static_cast<u32>(m_shadowRequests.size()));
+	const Vector<framework::ShadowAtlas::Result>& results = m_shadowAtlas.getResults();
+	const f32 invAtlasSize = 1.0f / s_shadowAtlasSize;
+	for (u32 i = 0; i < static_cast<u32>(m_shadowViews.size()); ++i) 
+	{
+		ShadowViewData& view = m_shadowViews[i];
+		const framework::ShadowAtlasAllocator::Tile& tile = results[i].m_tile;
+		if (!results[i].m_hasTile) 
+		{
+			continue;
+		}
+		const f32 halfSize = 0.5f * tile.m_size * invAtlasSize;
+		view.m_atlasScaleBias = v4(halfSize, -halfSize, (tile.m_x + 0.5f * tile.m_size) * invAtlasSize, (tile.m_y + 0.5f * tile.m_size) * invAtlasSize);
+		view.m_atlasBounds = v4(tile.m_x + 0.5f, tile.m_y + 0.5f, tile.m_x + tile.m_size - 0.5f, tile.m_y + tile.m_size - 0.5f) * invAtlasSize;
+		view.m_normalOffset = 1.5f * view.m_normalOffset / tile.m_size;
+		view.m_isValid = results[i].m_isValid ? 1 : 0;
+	}
+
+	if (m_shadowViews.empty()) 
+	{
+		return framework::RenderResources::updateMappableCBData(m_ctx, m_shadowCB, &m_shadowCBData, sizeof(ShadowDataCB));
+	}
+	return framework::RenderResources::updateStructuredBuffer(m_device, m_ctx, m_shadowViews.data(), static_cast<u32>(sizeof(ShadowViewData)), static_cast<u32>(m_shadowViews.size()), m_shadowViewBuffer) &&
+		framework::RenderResources::updateMappableCBData(m_ctx, m_shadowCB, &m_shadowCBData, sizeof(ShadowDataCB));
+}
+
+void App::renderShadows() 
+{
+	const Vector<u32>& renderList = m_shadowAtlas.getRenderList();
+	if (renderList.empty()) 
+	{
+		return;
+	}
+
+	// The atlas is read by the lighting of the last frame
+	ID3D11ShaderResourceView* nullView = nullptr;
+	m_ctx->PSSetShaderResources(11, 1, &nullView);
+	m_ctx->OMSetRenderTargets(0, nullptr, m_shadowAtlasDepth.m_depthStencilView);
+	m_ctx->RSSetState(m_shadowRasterState);
+	m_ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_ctx->VSSetConstantBuffers(0, 1, &m_shadowPassCB);
+	m_ctx->VSSetConstantBuffers(1, 1, &m_drawcallCB);
+
+	// Only positions
+	u32 vertexBufferOffset = 0;
+	u32 vertexBufferStride = static_cast<u32>(sizeof(framework::GltfScene::VertexBuffer0));
+	ID3D11Buffer* vertexBuffer = m_scene->getPackedVertexBuffer();
+	m_ctx->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexBufferStride, &vertexBufferOffset);
+
+	const Vector<framework::GltfScene::Mesh>& meshes = m_scene->getMeshes();
+	const Vector<framework::GltfScene::Node>& nodes = m_scene->getNodes();
+	const Vector<framework::ShadowAtlas::Result>& results = m_shadowAtlas.getResults();
+	DXGI_FORMAT currIndexFormat = DXGI_FORMAT_UNKNOWN;
+	for (u32 viewIdx : renderList) 
+	{
+		const framework::ShadowAtlasAllocator::Tile& tile = results[viewIdx].m_tile;
+		const m4& viewProj = m_shadowViews[viewIdx].m_viewProj;
+		D3D11_VIEWPORT viewport;
+		viewport.TopLeftX = static_cast<f32>(tile.m_x);
+		viewport.TopLeftY = static_cast<f32>(tile.m_y);
+		viewport.Width = static_cast<f32>(tile.m_size);
+		viewport.Height = static_cast<f32>(tile.m_size);
+		viewport.MinDepth = 0.0f;
+		viewport.MaxDepth = 1.0f;
+		m_ctx->RSSetViewports(1, &viewport);
+		framework::RenderResources::updateMappableCBData(m_ctx, m_shadowPassCB, &viewProj, sizeof(m4));
+
+		// Clear the tile only, the rest of the atlas is cached
+		m_shadowClearShader.bind(m_ctx);
+		m_ctx->OMSetDepthStencilState(m_shadowClearDepthState, 0);
+		m_ctx->Draw(3, 0);
+
+		m_shadowShader.bind(m_ctx);
+		m_ctx->OMSetDepthStencilState(m_depthStencilState, 0);
+		const framework::Frustum frustum = framework::Frustum::fromViewProj(viewProj);
+		for (const DrawItem& item : m_drawList) 
+		{
+			const framework::GltfScene::Node& node = nodes[item.m_node];
+			const framework::GltfScene::Meshlet& meshlet = meshes[node.m_mesh].m_meshlets[item.m_meshlet];
+			const f32 scale = glm::max(glm::length(v3(node.m_model[0])), glm::max(glm::length(v3(node.m_model[1])), glm::length(v3(node.m_model[2]))));
+			if (!frustum.isSphereVisible(v3(node.m_model * v4(meshlet.m_boundsCenter, 1.0f)), meshlet.m_boundsRadius * scale)) 
+			{
+				continue;
+			}
+
+			const DXGI_FORMAT indexFormat = meshlet.m_isIndexShort ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+			if (indexFormat != currIndexFormat) 
+			{
+				currIndexFormat = indexFormat;
+				m_ctx->IASetIndexBuffer(m_scene->getPackedIndexBuffer(), indexFormat, 0);
+			}
+			updateBatchCB(m_ctx, m_drawcallCB, node.m_model);
+			const u32 indexSize = meshlet.m_isIndexShort ? 2 : 4;
+			m_ctx->DrawIndexed(meshlet.m_indexCount, meshlet.m_indexBytesOffset / indexSize, static_cast<s32>(meshlet.m_vertexOffset));
+		}
+	}
+}
+
+void App::updateOcclusionCulling(const DebugConfig& config) 
+{
+	m_drawVisible.assign(m_drawList.size(), 1);
+	if (!config.m_occlusionCulling || config.m_gpuCulling) 
+	{
+		m_occlusionCuller.beginFrame(m_fpCam.getViewProj());
+		return;
+	}
+	const f64 startMs = framework::Time::getTimeStampMs();
+	const Vector<framework::GltfScene::Mesh>& meshes = m_scene->getMeshes();
+	const Vector<framework::GltfScene::Node>& nodes = m_scene->getNodes();
+	const Vector<framework::GltfScene::SurfaceMaterial>& materials = m_scene->getMaterials();
+	const Vector<v3>& positions = m_scene->getCpuPositions();
+	const Vector<u8>& indexData = m_scene->getCpuIndexData();
+
+	// Occluders: opaque meshlets in view, the largest on screen first. Alpha tested ones have holes
+	const framework::Frustum frustum = framework::Frustum::fromViewProj(m_fpCam.getViewProj());
+	const v3 camPos = m_fpCam.getPos();
+	m_occluderCandidates.clear();
+	for (u32 i = 0; i < static_cast<u32>(m_drawList.size()); ++i) 
+	{
+		const DrawItem& item = m_drawList[i];
+		const framework::GltfScene::Node& node = nodes[item.m_node];
+		const framework::GltfScene::Meshlet& meshlet = meshes[node.m_mesh].m_meshlets[item.m_meshlet];
+		if ((materials[meshlet.m_material].m_hash & (1 << framework::GltfScene::AlphaTest)) != 0 || meshlet.m_indexCount / 3 > s_occluderTriangleBudget) 
+		{
+			continue;
+		}
+		const f32 scale = glm::max(glm::length(v3(node.m_model[0])), glm::max(glm::length(v3(node.m_model[1])), glm::length(v3(node.m_model[2]))));
+		const v3 center = v3(node.m_model * v4(meshlet.m_boundsCenter, 1.0f));
+		const f32 radius = meshlet.m_boundsRadius * scale;
+		if (frustum.isSphereVisible(center, radius)) 
+		{
+			m_occluderCandidates.push_back({radius / glm::max(glm::length(center - camPos), m_fpCam.getNearPlane()), i});
+		}
+	}
+	std::sort(m_occluderCandidates.begin(), m_occluderCandidates.end(), [](const std::pair<f32, u32>& a, const std::pair<f32, u32>& b) 
+	{
+		return a.first > b.first;
+	});
+
+	m_occlusionCuller.beginFrame(m_fpCam.getViewProj());
+	u32 triangleCount = 0;
+	for (const std::pair<f32, u32>& candidate : m_occluderCandidates) 
+	{
+		const DrawItem& item = m_drawList[candidate.second];
+		const framework::GltfScene::Node& node = nodes[item.m_node];
+		const framework::GltfScene::Meshlet& meshlet = meshes[node.m_mesh].m_meshlets[item.m_meshlet];
+		if (triangleCount + meshlet.m_indexCount / 3 > s_occluderTriangleBudget) 
+		{
+			continue;
+		}
+		triangleCount += meshlet.m_indexCount / 3;
+		m_occlusionCuller.addOccluder(positions.data() + meshlet.m_vertexOffset, indexData.data() + meshlet.m_indexBytesOffset, 
+			meshlet.m_indexCount, meshlet.m_isIndexShort, node.m_model);
+	}
+	m_occlusionCuller.rasterize();
+
+	for (u32 i = 0; i < static_cast<u32>(m_drawList.size()); ++i) 
+	{
+		const DrawItem& item = m_drawList[i];
+		const framework::GltfScene::Node& node = nodes[item.m_node];
+		const framework::GltfScene::Meshlet& meshlet = meshes[node.m_mesh].m_meshlets[item.m_meshlet];
+		m_drawVisible[i] = m_occlusionCuller.isVisible(meshlet.m_boundsCenter, meshlet.m_boundsExtents, node.m_model) ? 1 : 0;
+	}
+	m_occlusionTimeMs = framework::Time::getTimeStampMs() - startMs;
+}
+
+bool App::initGpuCulling() 
+{
+	if (m_isGpuCullingReady) 
+	{
+		return true;
+	}
+	if (!loadSurfaceShader(m_device, "./shaders/5_ForwardLights.hlsl", m_gpuDrivenSurfaceShader, true) ||
+		!loadSurfaceShader(m_device, "./shaders/5_GBuffer.hlsl", m_gpuDrivenGBufferShader, true) ||
+		!m_hizCopyShader.loadComputePipeline(m_device, "./shaders/HiZ.hlsl", "copyDepthCS") ||
+		!m_hizDownsampleShader.loadComputePipeline(m_device, "./shaders/HiZ.hlsl", "downsampleCS") ||
+		!m_cullClearShader.loadComputePipeline(m_device, "./shaders/DrawCulling.hlsl", "clearCS") ||
+		!m_cullShader.loadComputePipeline(m_device, "./shaders/DrawCulling.hlsl", "cullCS")) 
+	{
+		printf("Failed to load the GPU culling shaders");
+		return false;
+	}
+	if (!framework::RenderResources::createRWTexture2D(m_device, m_width, m_height, framework::DrawCulling::getLevelCount(m_width, m_height), DXGI_FORMAT_R32_FLOAT, m_hiz)) 
+	{
+		printf("Failed to create the depth hierarchy");
+		return false;
+	}
+
+	// Draws in world space, batches are the runs of the draw list that share their render state
+	const Vector<framework::GltfScene::Mesh>& meshes = m_scene->getMeshes();
+	const Vector<framework::GltfScene::Node>& nodes = m_scene->getNodes();
+	const Vector<framework::GltfScene::SurfaceMaterial>& materials = m_scene->getMaterials();
+	const u32 drawCount = static_cast<u32>(m_drawList.size());
+	m_cullDraws.resize(drawCount);
+	m_cullBatches.clear();
+	Vector<DrawcallDataCB> drawcallData(drawCount);
+	Vector<u32> drawIds(drawCount);
+	for (u32 i = 0; i < drawCount; ++i) 
+	{
+		const DrawItem& item = m_drawList[i];
+		const framework::GltfScene::Node& node = nodes[item.m_node];
+		const framework::GltfScene::Meshlet& meshlet = meshes[node.m_mesh].m_meshlets[item.m_meshlet];
+		if (i == 0 || item.m_sortKey != m_drawList[i - 1].m_sortKey) 
+		{
+			m_cullBatches.push_back({i, 0});
+		}
+		m_cullBatches.back().m_drawCount++;
+
+		const m3 absModel(glm::abs(v3(node.m_model[0])), glm::abs(v3(node.m_model[1])), glm::abs(v3(node.m_model[2])));
+		const f32 scale = glm::max(glm::length(v3(node.m_model[0])), glm::max(glm::length(v3(node.m_model[1])), glm::length(v3(node.m_model[2]))));
+		framework::DrawCulling::Draw& draw = m_cullDraws[i];
+		draw.m_boundsCenter = v3(node.m_model * v4(meshlet.m_boundsCenter, 1.0f));
+		draw.m_batch = static_cast<u32>(m_cullBatches.size()) - 1;
+		draw.m_boundsExtents = absModel * meshlet.m_boundsExtents;
+		draw.m_boundsRadius = meshlet.m_boundsRadius * scale;
+		draw.m_indexCount = meshlet.m_indexCount;
+		draw.m_firstIndex = meshlet.m_indexBytesOffset / (meshlet.m_isIndexShort ? 2 : 4);
+		draw.m_baseVertex = static_cast<s32>(meshlet.m_vertexOffset);
+		draw.m_drawId = i;
+		drawcallData[i] = getDrawcallData(node.m_model, &materials[meshlet.m_material]);
+		drawIds[i] = i;
+	}
+	const u32 batchCount = static_cast<u32>(m_cullBatches.size());
+	const u32 argsSize = glm::max(drawCount, 1u) * static_cast<u32>(sizeof(framework::DrawCulling::IndirectArgs));
+	const u32 countsSize = glm::max(batchCount, 1u) * static_cast<u32>(sizeof(u32));
+	if (!framework::RenderResources::updateStructuredBuffer(m_device, m_ctx, m_cullDraws.data(), static_cast<u32>(sizeof(framework::DrawCulling::Draw)), drawCount, m_cullDrawBuffer) ||
+		!framework::RenderResources::updateStructuredBuffer(m_device, m_ctx, m_cullBatches.data(), static_cast<u32>(sizeof(framework::DrawCulling::Batch)), batchCount, m_cullBatchBuffer) ||
+		!framework::RenderResources::updateStructuredBuffer(m_device, m_ctx, drawcallData.data(), static_cast<u32>(sizeof(DrawcallDataCB)), drawCount, m_drawcallDataBuffer) ||
+		!framework::RenderResources::createRawBuffer(m_device, argsSize, true, m_indirectArgs) ||
+		!framework::RenderResources::createRawBuffer(m_device, countsSize, false, m_batchCounts) ||
+		!framework::RenderResources::createRawBuffer(m_device, glm::max(drawCount, 1u) * static_cast<u32>(sizeof(u32)), false, m_visibility)) 
+	{
+		printf("Failed to create the GPU culling buffers");
+		return false;
+	}
+	// Nothing was visible before the first frame, its late phase tests every draw
+	const UINT zeros[] = {0, 0, 0, 0};
+	m_ctx->ClearUnorderedAccessViewUint(m_visibility.m_UAV, zeros);
+	m_drawIdBuffer = framework::RenderResources::createVertexBuffer(m_device, glm::max(drawCount, 1u) * static_cast<u32>(sizeof(u32)), drawIds.data());
+	m_cullCB = framework::RenderResources::createConstantBuffer<framework::DrawCulling::Constants>(m_device, framework::DrawCulling::Constants());
+	m_hizCB = framework::RenderResources::createConstantBuffer<HiZDataCB>(m_device, HiZDataCB());
+	if (!m_drawIdBuffer || !m_cullCB || !m_hizCB) 
+	{
+		printf("Failed to create the GPU culling buffers");
+		return false;
+	}
+	for (u32 i = 0; i < s_cullReadbackCount * 2; ++i) 
+	{
+		m_cullReadback[i] = framework::RenderResources::createReadbackBuffer(m_device, countsSize);
+		if (!m_cullReadback[i]) 
+		{
+			return false;
+		}
+	}
+	m_isGpuCullingReady = true;
+	return true;
+}
+
+void App::buildHiZ() 
+{
+	// The depth can't be bound as an attachment while it is read
+	m_ctx->OMSetRenderTargets(0, nullptr, nullptr);
+	ID3D11ShaderResourceView* nullView = nullptr;
+	ID3D11UnorderedAccessView* nullUAV = nullptr;
+	m_ctx->CSSetConstantBuffers(0, 1, &m_hizCB);
+
+	const u32 levelCount = static_cast<u32>(m_hiz.m_mipUAVs.size());
+	for (u32 level = 0; level < levelCount; ++level) 
+	{
+		HiZDataCB hizCB;
+		hizCB.m_srcWidth = level ? glm::max(m_hiz.m_width >> (level - 1), 1u) : m_hiz.m_width;
+		hizCB.m_srcHeight = level ? glm::max(m_hiz.m_height >> (level - 1), 1u) : m_hiz.m_height;
+		hizCB.m_dstWidth = glm::max(m_hiz.m_width >> level, 1u);
+		hizCB.m_dstHeight = glm::max(m_hiz.m_height >> level, 1u);
+		framework::RenderResources::updateMappableCBData(m_ctx, m_hizCB, &hizCB, sizeof(HiZDataCB));
+
+		// Unbind the destination of the last dispatch before it is read
+		m_ctx->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+		ID3D11ShaderResourceView* srcView = level ? m_hiz.m_mipSRVs[level - 1] : m_depthAttachment->m_SRV;
+		m_ctx->CSSetShaderResources(0, 1, &srcView);
+		m_ctx->CSSetUnorderedAccessViews(0, 1, &m_hiz.m_mipUAVs[level], nullptr);
+		if (level) 
+		{
+			m_hizDownsampleShader.bind(m_ctx);
+		}
+		else 
+		{
+			m_hizCopyShader.bind(m_ctx);
+		}
+		m_ctx->Dispatch((hizCB.m_dstWidth + 7) / 8, (hizCB.m_dstHeight + 7) / 8, 1);
+	}
+	m_ctx->CSSetShaderResources(0, 1, &nullView);
+	m_ctx->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+}
+
+void App::cullDrawsGpu(const DebugConfig& config, framework::DrawCulling::Phase phase) 
+{
+	// The early phase reprojects the depth hierarchy of the last frame with the camera's previous view projection, the late
+	// one tests against the depth the early phase just rendered
+	const bool isLatePhase = phase == framework::DrawCulling::LatePhase;
+	if (isLatePhase) 
+	{
+		buildHiZ();
+	}
+	const bool isOcclusionEnabled = config.m_gpuOcclusion && (isLatePhase || (phase == framework::DrawCulling::EarlyPhase && m_hasPrevHiZ));
+	const m4 hizViewProj = isLatePhase ? m_fpCam.getViewProj() : m_fpCam.getPrevViewProj();
+	m_cullConstants = framework::DrawCulling::makeConstants(m_fpCam.getViewProj(), hizViewProj, isOcclusionEnabled ? m_hiz.m_width : 0, m_hiz.m_height, 
+		static_cast<u32>(m_cullDraws.size()), m_cullBatches.data(), static_cast<u32>(m_cullBatches.size()), phase);
+	framework::RenderResources::updateMappableCBData(m_ctx, m_cullCB, &m_cullConstants, sizeof(framework::DrawCulling::Constants));
+
+	// Only the last culling of the frame is validated, with the flags it starts from
+	const bool isValidating = m_validateGpuCulling && phase != framework::DrawCulling::EarlyPhase;
+	Vector<u32> visibility;
+	if (isValidating && isLatePhase) 
+	{
+		visibility.resize(m_cullDraws.size());
+		framework::RenderResources::readbackBuffer(m_device, m_ctx, m_visibility.m_buffer, static_cast<u32>(visibility.size() * sizeof(u32)), visibility.data());
+	}
+
+	m_ctx->CSSetConstantBuffers(0, 1, &m_cullCB);
+	ID3D11ShaderResourceView* views[] = {m_cullDrawBuffer.m_SRV, m_cullBatchBuffer.m_SRV, m_hiz.m_SRV};
+	m_ctx->CSSetShaderResources(0, 3, views);
+	ID3D11UnorderedAccessView* uavs[] = {m_indirectArgs.m_UAV, m_batchCounts.m_UAV, m_visibility.m_UAV};
+	m_ctx->CSSetUnorderedAccessViews(0, 3, uavs, nullptr);
+	const u32 groupSize = framework::DrawCulling::s_threadGroupSize;
+	m_cullClearShader.bind(m_ctx);
+	m_ctx->Dispatch((glm::max(m_cullConstants.m_argsCount, m_cullConstants.m_batchCount) + groupSize - 1) / groupSize, 1, 1);
+	m_cullShader.bind(m_ctx);
+	m_ctx->Dispatch((m_cullConstants.m_drawCount + groupSize - 1) / groupSize, 1, 1);
+
+	ID3D11ShaderResourceView* nullViews[] = {nullptr, nullptr, nullptr};
+	ID3D11UnorderedAccessView* nullUAVs[] = {nullptr, nullptr, nullptr};
+	m_ctx->CSSetShaderResources(0, 3, nullViews);
+	m_ctx->CSSetUnorderedAccessViews(0, 3, nullUAVs, nullptr);
+	m_ctx->CSSetShader(nullptr, nullptr, 0);
+
+	// The counts are overwritten by the next phase, keep them for endGpuCullingFrame
+	m_ctx->CopyResource(m_cullReadback[(m_cullFrame % s_cullReadbackCount) * 2 + (isLatePhase ? 1 : 0)], m_batchCounts.m_buffer);
+	if (isLatePhase) 
+	{
+		m_hasPrevHiZ = true;
+	}
+
+	if (isValidating) 
+	{
+		validateGpuCulling(visibility);
+	}
+}
+
+void App::endGpuCullingFrame(bool hasLatePhase) 
+{
+	// Visible count for the UI, from a few frames ago so the CPU doesn't wait for the GPU
+	m_cullReadbackHasLate[m_cullFrame % s_cullReadbackCount] = hasLatePhase;
+	m_cullFrame++;
+	if (!hasLatePhase) 
+	{
+		m_hasPrevHiZ = false;
+	}
+	if (m_cullFrame < s_cullReadbackCount) 
+	{
+		return;
+	}
+	const u32 frameIdx = m_cullFrame % s_cullReadbackCount;
+	const u32 phaseCount = m_cullReadbackHasLate[frameIdx] ? 2 : 1;
+	u32 visibleCount = 0;
+	for (u32 phaseIdx = 0; phaseIdx < phaseCount; ++phaseIdx) 
+	{
+		ID3D11Buffer* readback = m_cullReadback[frameIdx * 2 + phaseIdx];
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (FAILED(m_ctx->Map(readback, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped))) 
+		{
+			return;
+		}
+		const u32* counts = static_cast<const u32*>(mapped.pData);
+		for (u32 i = 0; i < static_cast<u32>(m_cullBatches.size()); ++i) 
+		{
+			visibleCount += counts[i];
+		}
+		m_ctx->Unmap(readback, 0);
+	}
+	m_gpuVisibleCount = visibleCount;
+}
+
+void App::validateGpuCulling(Vector<u32>& visibility) 
+{
+	m_validateGpuCulling = false;
+	const bool isOcclusionEnabled = m_cullConstants.m_hizLevelCount > 0;
+	framework::DrawCulling::HiZ hiz;
+	if (isOcclusionEnabled) 
+	{
+		Vector<u8> depth;
+		if (!framework::RenderResources::readbackTexture2D(m_device, m_ctx, m_hiz.m_texture, 0, static_cast<u32>(sizeof(f32)), depth)) 
+		{
+			return;
+		}
+		framework::DrawCulling::buildHiZ(reinterpret_cast<const f32*>(depth.data()), m_hiz.m_width, m_hiz.m_height, hiz);
+	}
+
+	Vector<framework::DrawCulling::IndirectArgs> gpuArgs(glm::max(m_cullConstants.m_argsCount, 1u));
+	Vector<u32> gpuCounts(glm::max(m_cullConstants.m_batchCount, 1u));
+	if (!framework::RenderResources::readbackBuffer(m_device, m_ctx, m_indirectArgs.m_buffer, static_cast<u32>(gpuArgs.size() * sizeof(framework::DrawCulling::IndirectArgs)), gpuArgs.data()) ||
+		!framework::RenderResources::readbackBuffer(m_device, m_ctx, m_batchCounts.m_buffer, static_cast<u32>(gpuCounts.size() * sizeof(u32)), gpuCounts.data())) 
+	{
+		return;
+	}
+
+	Vector<framework::DrawCulling::IndirectArgs> cpuArgs;
+	Vector<u32> cpuCounts;
+	framework::DrawCulling::cull(m_cullConstants, m_cullDraws.data(), m_cullBatches.data(), isOcclusionEnabled ? &hiz : nullptr, visibility.empty() ? nullptr : visibility.data(), 
+		cpuArgs, cpuCounts);
+	m_cullValidationMismatches = static_cast<s32>(framework::DrawCulling::compareResults(m_cullBatches.data(), m_cullConstants.m_batchCount, 
+		gpuArgs.data(), gpuCounts.data(), cpuArgs.data(), cpuCounts.data()));
+	printf("GPU culling validation: %d mismatches out of %u draws\n", m_cullValidationMismatches, m_cullConstants.m_drawCount);
+}
+
+void App::drawDepthPrepass(const DebugConfig& config) 
+{
+	m_prepassStats = PassStats();
+	const Vector<framework::GltfScene::Mesh>& meshes = m_scene->getMeshes();
+	const Vector<framework::GltfScene::Node>& nodes = m_scene->getNodes();
+	const Vector<framework::GltfScene::SurfaceMaterial>& materials = m_scene->getMaterials();
+
+	m_prepassShader.bind(m_ctx);
+	m_prepassStats.m_shaderChanges++;
+	m_ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_ctx->OMSetDepthStencilState(m_depthStencilState, 0);
+
+	// Only positions
+	u32 vertexBufferOffset = 0;
+	u32 vertexBufferStride = static_cast<u32>(sizeof(framework::GltfScene::VertexBuffer0));
+	ID3D11Buffer* vertexBuffer = m_scene->getPackedVertexBuffer();
+	m_ctx->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexBufferStride, &vertexBufferOffset);
+
+	DXGI_FORMAT currIndexFormat = DXGI_FORMAT_UNKNOWN;
+	ID3D11RasterizerState* currRasterState = m_rasterState;
+	for (u32 drawIdx : m_frontToBackOrder) 
+	{
+		const DrawItem& item = m_drawList[drawIdx];
+		const framework::GltfScene::Node& node = nodes[item.m_node];
+		const framework::GltfScene::Meshlet& meshlet = meshes[node.m_mesh].m_meshlets[item.m_meshlet];
+		const u32 hash = config.m_renderingFeaturesMask & materials[meshlet.m_material].m_hash;
+		if ((hash & (1 << framework::GltfScene::AlphaTest)) != 0 || !m_drawVisible[drawIdx]) 
+		{
+			continue;
+		}
+
+		const DXGI_FORMAT indexFormat = meshlet.m_isIndexShort ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		if (indexFormat != currIndexFormat) 
+		{
+			currIndexFormat = indexFormat;
+			m_ctx->IASetIndexBuffer(m_scene->getPackedIndexBuffer(), indexFormat, 0);
+			m_prepassStats.m_stateChanges++;
+		}
+
+		ID3D11RasterizerState* rasterState = ((hash & (1 << framework::GltfScene::DoubleSided)) != 0) ? m_doubleSidedRasterState : m_rasterState;
+		if (rasterState != currRasterState) 
+		{
+			currRasterState = rasterState;
+			m_ctx->RSSetState(rasterState);
+			m_prepassStats.m_stateChanges++;
+		}
+
+		updateBatchCB(m_ctx, m_drawcallCB, node.m_model);
+		const u32 indexSize = meshlet.m_isIndexShort ? 2 : 4;
+		m_ctx->DrawIndexed(meshlet.m_indexCount, meshlet.m_indexBytesOffset / indexSize, static_cast<s32>(meshlet.m_vertexOffset));
+		m_prepassStats.m_draws++;
+	}
+	if (currRasterState != m_rasterState) 
+	{
+		m_ctx->RSSetState(m_rasterState);
+	}
+}
+
+void App::drawScene(UberShader& surfaceShader, const DebugConfig& config, const Vector<u32>& order) 
+{
+	const Vector<framework::GltfScene::Mesh>& meshes = m_scene->getMeshes();
+	const Vector<framework::GltfScene::Node>& nodes = m_scene->getNodes();
+	const Vector<framework::GltfScene::SurfaceMaterial>& materials = m_scene->getMaterials();
+
+	framework::ShaderPipeline* currShader = nullptr;
+	m_ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// Draw GLTF. All meshlets share the packed buffers, so they are bound once and meshlets are selected with the base vertex and first index
+	u32 vertexBubberOffsets[] = {0, m_scene->getVertexBuff1BaseOffsetBytes()};
+	u32 vertexBubberStrides[] = {static_cast<u32>(sizeof(framework::GltfScene::VertexBuffer0)), static_cast<u32>(sizeof(framework::GltfScene::VertexBuffer1))};
+	ID3D11Buffer* vertexBuffers[] = {m_scene->getPackedVertexBuffer(), m_scene->getPackedVertexBuffer()};
+	m_ctx->IASetVertexBuffers(0, 2, vertexBuffers, vertexBubberStrides, vertexBubberOffsets);
+	const Vector<ID3D11SamplerState*>& samplers = m_scene->getSamplers();
+	if (config.m_gpuCulling) 
+	{
+		u32 drawIdStride = static_cast<u32>(sizeof(u32));
+		u32 drawIdOffset = 0;
+		m_ctx->IASetVertexBuffers(2, 1, &m_drawIdBuffer, &drawIdStride, &drawIdOffset);
+		m_ctx->VSSetShaderResources(12, 1, &m_drawcallDataBuffer.m_SRV);
+		m_ctx->PSSetShaderResources(12, 1, &m_drawcallDataBuffer.m_SRV);
+	}
+
+	const framework::TextureArrayPacker& textureArrays = m_scene->getTextureArrays();
+	DXGI_FORMAT currIndexFormat = DXGI_FORMAT_UNKNOWN;
+	ID3D11ShaderResourceView* currViews[] = {nullptr, nullptr};
+	bool areViewsBound = false;
+	ID3D11SamplerState* currSamplers[] = {nullptr, nullptr};
+	ID3D11RasterizerState* currRasterState = m_rasterState;
+	ID3D11DepthStencilState* currDepthState = nullptr;
+	for (u32 drawIdx : order) 
+	{
+		if (!m_drawVisible[drawIdx]) 
+		{
+			continue;
+		}
+		// With GPU culling the first draw of a batch sets the state and draws the whole batch
+		const framework::DrawCulling::Batch* batch = config.m_gpuCulling ? &m_cullBatches[m_cullDraws[drawIdx].m_batch] : nullptr;
+		if (batch && batch->m_firstArgs != drawIdx) 
+		{
+			continue;
+		}
+		const DrawItem& item = m_drawList[drawIdx];
+		const framework::GltfScene::Node& node = nodes[item.m_node];
+		const framework::GltfScene::Meshlet& meshlet = meshes[node.m_mesh].m_meshlets[item.m_meshlet];
+		const framework::GltfScene::SurfaceMaterial& mat = materials[meshlet.m_material];
+
+		const DXGI_FORMAT indexFormat = meshlet.m_isIndexShort ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		if (indexFormat != currIndexFormat) 
+		{
+			currIndexFormat = indexFormat;
+			m_ctx->IASetIndexBuffer(m_scene->getPackedIndexBuffer(), indexFormat, 0);
+			m_shadingStats.m_stateChanges++;
+		}
+
+		u32 hash = config.m_renderingFeaturesMask & mat.m_hash;
+		if ((config.m_renderingFeaturesMask & s_DebugNormalsFlag) != 0) 
+		{
+			hash |= s_DebugNormalsFlag;
+		}
+		if (m_useTextureArrays) 
+		{
+			hash |= s_TextureArraysFlag;
+		}
+		if (m_useDrawLights) 
+		{
+			hash |= s_DrawLightsFlag;
+		}
+
+		framework::ShaderPipeline* shader = surfaceShader.getShader(hash); // See how the hash is generated and how we uberize the shader
+		VERIFY(shader, "Trying to access null shader");
+		if (shader != currShader) 
+		{
+			currShader = shader;
+			currShader->bind(m_ctx);
+			m_shadingStats.m_shaderChanges++;
+		}
+
+		ID3D11RasterizerState* rasterState = ((hash & (1 << framework::GltfScene::DoubleSided)) != 0) ? m_doubleSidedRasterState : m_rasterState;
+		if (rasterState != currRasterState) 
+		{
+			currRasterState = rasterState;
+			m_ctx->RSSetState(rasterState);
+			m_shadingStats.m_stateChanges++;
+		}
+
+		// After the pre-pass only the pixels that won the depth test are shaded. Alpha tested surfaces aren't in it
+		const bool isInPrepass = config.m_depthPrepass && (hash & (1 << framework::GltfScene::AlphaTest)) == 0;
+		ID3D11DepthStencilState* depthState = isInPrepass ? m_depthEqualState : m_depthStencilState;
+		if (depthState != currDepthState) 
+		{
+			currDepthState = depthState;
+			m_ctx->OMSetDepthStencilState(depthState, 0);
+			m_shadingStats.m_stateChanges++;
+		}
+
+		ID3D11SamplerState* materialSamplers[] = {samplers[mat.m_record.m_albedoSampler], samplers[mat.m_record.m_normalSampler]};
+		if (materialSamplers[0] != currSamplers[0] || materialSamplers[1] != currSamplers[1]) 
+		{
+			currSamplers[0] = materialSamplers[0];
+			currSamplers[1] = materialSamplers[1];
+			m_ctx->PSSetSamplers(0, 2, materialSamplers);
+			m_shadingStats.m_resourceChanges++;
+		}
+
+		// With texture arrays, draws of the same batch only change the slices in the drawcall CB
+		ID3D11ShaderResourceView* views[] = {nullptr, nullptr};
+		if (m_useTextureArrays) 
+		{
+			views[0] = (mat.m_albedoSlot.m_array != framework::TextureArrayPacker::s_invalidArray) ? textureArrays.getArray(mat.m_albedoSlot.m_array).m_SRV : nullptr;
+			views[1] = (mat.m_normalSlot.m_array != framework::TextureArrayPacker::s_invalidArray) ? textureArrays.getArray(mat.m_normalSlot.m_array).m_SRV : nullptr;
+		}
+		else 
+		{
+			views[0] = mat.m_albedo ? mat.m_albedo->m_SRV : nullptr;
+			views[1] = mat.m_normal ? mat.m_normal->m_SRV : nullptr;
+		}
+		if (!areViewsBound || views[0] != currViews[0] || views[1] != currViews[1]) 
+		{
+			areViewsBound = true;
+			currViews[0] = views[0];
+			currViews[1] = views[1];
+			m_ctx->PSSetShaderResources(0, 2, views);
+			m_shadingStats.m_resourceChanges++;
+		}
+
+		if (batch) 
+		{
+			// D3D11 has no multi draw indirect, every slot of the batch is a call. The culled ones draw no instances
+			for (u32 i = 0; i < batch->m_drawCount; ++i) 
+			{
+				m_ctx->DrawIndexedInstancedIndirect(m_indirectArgs.m_buffer, (batch->m_firstArgs + i) * static_cast<u32>(sizeof(framework::DrawCulling::IndirectArgs)));
+			}
+			m_shadingStats.m_draws += batch->m_drawCount;
+			continue;
+		}
+
+		updateBatchCB(m_ctx, m_drawcallCB, node.m_model, &mat, m_useDrawLights ? &m_drawLightLists.getRanges()[drawIdx] : nullptr);
+		const u32 indexSize = meshlet.m_isIndexShort ? 2 : 4;
+		m_ctx->DrawIndexed(meshlet.m_indexCount, meshlet.m_indexBytesOffset / indexSize, static_cast<s32>(meshlet.m_vertexOffset));
+		m_shadingStats.m_draws++;
+	}
+	if (config.m_gpuCulling) 
+	{
+		ID3D11ShaderResourceView* nullView = nullptr;
+		m_ctx->VSSetShaderResources(12, 1, &nullView);
+		m_ctx->PSSetShaderResources(12, 1, &nullView);
+	}
+	if (currRasterState != m_rasterState) 
+	{
+		m_ctx->RSSetState(m_rasterState);
+	}
+	if (currDepthState != m_depthStencilState) 
+	{
+		m_ctx->OMSetDepthStencilState(m_depthStencilState, 0);
+	}
+}
+
+void App::resolveDeferred(ID3D11RenderTargetView* sceneColor) 
+{
+	// The depth is read, so it can't stay bound as the attachment
+	m_ctx->OMSetRenderTargets(1, &sceneColor, nullptr);
+	m_ctx->RSSetState(m_doubleSidedRasterState); // The full screen triangle is clockwise
+	m_ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_resolveShader.bind(m_ctx);
+	ID3D11ShaderResourceView* gbufferViews[] = {m_gbufferAlbedo->m_SRV, m_gbufferNormal->m_SRV, m_depthAttachment->m_SRV};
+	m_ctx->PSSetShaderResources(5, 3, gbufferViews);
+	m_ctx->Draw(3, 0);
+
+	// Unbind the G-buffer before it's written again
+	ID3D11ShaderResourceView* nullViews[] = {nullptr, nullptr, nullptr};
+	m_ctx->PSSetShaderResources(5, 3, nullViews);
+	m_ctx->OMSetRenderTargets(1, &sceneColor, m_depthAttachment->m_depthStencilView);
+	m_ctx->RSSetState(m_rasterState);
+}
+
+void App::renderScene(DebugConfig& config, ID3D11RenderTargetView* sceneColor) 
+{
+	if (config.m_gpuCulling && !initGpuCulling()) 
+	{
+		config.m_gpuCulling = false;
+	}
+	updateOcclusionCulling(config);
+	if (!updateDrawLights(config)) 
+	{
+		m_useDrawLights = false;
+	}
+	const bool isTwoPhaseCulling = config.m_gpuCulling && config.m_gpuOcclusion;
+	if (config.m_gpuCulling) 
+	{
+		// Batches are drawn in material order, without a pre-pass
+		config.m_depthPrepass = false;
+		config.m_sortMode = 0;
+		cullDrawsGpu(config, isTwoPhaseCulling ? framework::DrawCulling::EarlyPhase : framework::DrawCulling::SinglePhase);
+	}
+
+	const bool isDeferred = config.m_shadingPath == 1;
+	ID3D11RenderTargetView* gbuffer[] = {nullptr, nullptr};
+	if (isDeferred) 
+	{
+		gbuffer[0] = m_gbufferAlbedo->m_RTV;
+		gbuffer[1] = m_gbufferNormal->m_RTV;
+	}
+	// Set the scene color (or the G-buffer) as our RenderTarget
+	auto bindSceneTargets = [&]() 
+	{
+		if (isDeferred) 
+		{
+			m_ctx->OMSetRenderTargets(2, gbuffer, m_depthAttachment->m_depthStencilView);
+		}
+		else 
+		{
+			m_ctx->OMSetRenderTargets(1, &sceneColor, m_depthAttachment->m_depthStencilView);
+		}
+	};
+	bindSceneTargets();
+
+	// Set the viewport. This configures the area to render
+	D3D11_VIEWPORT viewport;
+	viewport.TopLeftX = 0.0f;
+	viewport.TopLeftY = 0.0f;
+	viewport.Width = static_cast<f32>(m_width);
+	viewport.Height = static_cast<f32>(m_height);
+	viewport.MinDepth = 0.0f;
+	viewport.MaxDepth = 1.0f;
+	m_ctx->RSSetViewports(1, &viewport);
+
+	// Tell the context how we want to rasterize the following drawcalls
+	m_ctx->RSSetState(m_rasterState);
+
+	// Clear the RenderTarget to the desired color. The deferred resolve writes every pixel of the scene color
+	FLOAT clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	if (isDeferred) 
+	{
+		m_ctx->ClearRenderTargetView(gbuffer[0], clearColor);
+		m_ctx->ClearRenderTargetView(gbuffer[1], clearColor);
+	}
+	else 
+	{
+		m_ctx->ClearRenderTargetView(sceneColor, clearColor);
+	}
+
+	m_ctx->OMSetDepthStencilState(m_depthStencilState, 0);
+	m_ctx->ClearDepthStencilView(m_depthAttachment->m_depthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+	// Update per-frame ConstantBuffer
+	updateFrameCB(m_ctx, m_frameCB, m_frameCBData);
+
+	m_ctx->VSSetConstantBuffers(0, 1, &m_frameCB);
+	m_ctx->PSSetConstantBuffers(0, 1, &m_frameCB);
+	m_ctx->VSSetConstantBuffers(1, 1, &m_drawcallCB);
+	m_ctx->PSSetConstantBuffers(1, 1, &m_drawcallCB);
+	m_ctx->PSSetConstantBuffers(2, 1, &m_clusterCB);
+	ID3D11ShaderResourceView* lightViews[] = {m_lightBuffer.m_SRV, m_clusterRangeBuffer.m_SRV, 
+		m_useDrawLights ? m_drawLightIndexBuffer.m_SRV : m_clusterLightIndexBuffer.m_SRV};
+	m_ctx->PSSetShaderResources(2, 3, lightViews);
+	m_ctx->PSSetConstantBuffers(4, 1, &m_shadowCB);
+	ID3D11ShaderResourceView* shadowViews[] = {m_shadowViewBuffer.m_SRV, m_shadowAtlasDepth.m_SRV};
+	m_ctx->PSSetShaderResources(10, 2, shadowViews);
+	m_ctx->PSSetSamplers(2, 1, &m_shadowSampler);
+
+	const bool isFrontToBack = config.m_sortMode == 1;
+	if (config.m_depthPrepass || isFrontToBack) 
+	{
+		sortFrontToBack();
+	}
+	if (config.m_depthPrepass) 
+	{
+		drawDepthPrepass(config);
+	}
+	else 
+	{
+		m_prepassStats = PassStats();
+	}
+	const Vector<u32>& drawOrder = isFrontToBack ? m_frontToBackOrder : m_materialOrder;
+	UberShader& sceneShader = isDeferred ? (config.m_gpuCulling ? m_gpuDrivenGBufferShader : m_gbufferShader) : 
+		(config.m_gpuCulling ? m_gpuDrivenSurfaceShader : m_surfaceShader);
+	m_shadingStats = PassStats();
+	drawScene(sceneShader, config, drawOrder);
+	if (isTwoPhaseCulling) 
+	{
+		// What the early phase missed, tested against the depth it rendered
+		cullDrawsGpu(config, framework::DrawCulling::LatePhase);
+		bindSceneTargets();
+		drawScene(sceneShader, config, drawOrder);
+	}
+	if (config.m_gpuCulling) 
+	{
+		endGpuCullingFrame(isTwoPhaseCulling);
+	}
+	else 
+	{
+		m_hasPrevHiZ = false;
+	}
+}
+
+void App::updateExposure(const DebugConfig& config) 
+{
+	const framework::AutoExposure::Constants constants = framework::AutoExposure::makeConstants(m_exposureConfig, m_width, m_height, m_deltaTime, config.m_exposureCompensation);
+	framework::RenderResources::updateMappableCBData(m_ctx, m_exposureCB, &constants, sizeof(framework::AutoExposure::Constants));
+
+	// The state before the dispatch is the starting point of the CPU reference
+	Vector<u32> prevState;
+	Vector<u8> sceneColorData;
+	if (m_validateExposure) 
+	{
+		prevState.resize(framework::AutoExposure::s_stateWordCount);
+		framework::RenderResources::readbackBuffer(m_device, m_ctx, m_exposureState.m_buffer, m_exposureState.m_size, prevState.data());
+		framework::RenderResources::readbackTexture2D(m_device, m_ctx, m_sceneColor->m_texture, 0, 8, sceneColorData);
+	}
+
+	// The scene color can't be bound as a target while it is read
+	m_ctx->OMSetRenderTargets(0, nullptr, nullptr);
+	ID3D11ShaderResourceView* nullView = nullptr;
+	ID3D11UnorderedAccessView* nullUAV = nullptr;
+	m_exposureShader.bind(m_ctx);
+	m_ctx->CSSetConstantBuffers(0, 1, &m_exposureCB);
+	m_ctx->CSSetShaderResources(0, 1, &m_sceneColor->m_SRV);
+	m_ctx->CSSetUnorderedAccessViews(0, 1, &m_exposureState.m_UAV, nullptr);
+	m_ctx->Dispatch(framework::AutoExposure::getGroupCountX(m_width), framework::AutoExposure::getGroupCountY(m_height), 1);
+	m_ctx->CSSetShaderResources(0, 1, &nullView);
+	m_ctx->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+
+	if (m_validateExposure) 
+	{
+		m_validateExposure = false;
+		validateExposure(constants, prevState, sceneColorData);
+	}
+}
+
+void App::validateExposure(const framework::AutoExposure::Constants& constants, Vector<u32>& state, const Vector<u8>& sceneColorData) 
+{
+	const u32 pixelCount = m_width * m_height;
+	Vector<u32> gpuState(framework::AutoExposure::s_stateWordCount);
+	if (sceneColorData.size() != pixelCount * 8 || 
+		!framework::RenderResources::readbackBuffer(m_device, m_ctx, m_exposureState.m_buffer, m_exposureState.m_size, gpuState.data())) 
+	{
+		printf("Failed to read back the exposure\n");
+		return;
+	}
+	// RGBA16F texels
+	Vector<v4> pixels(pixelCount);
+	const u64* texels = reinterpret_cast<const u64*>(sceneColorData.data());
+	for (u32 i = 0; i < pixelCount; ++i) 
+	{
+		pixels[i] = glm::unpackHalf4x16(texels[i]);
+	}
+	framework::AutoExposure::update(constants, pixels.data(), state.data());
+	m_exposureValidationError = framework::AutoExposure::compareStates(state.data(), gpuState.data());
+	printf("Exposure validation: %.4f%% max difference with the CPU reference\n", m_exposureValidationError * 100.0f);
+}
+
+void App::tonemap(ID3D11RenderTargetView* backBuffer) 
+{
+	m_ctx->OMSetRenderTargets(1, &backBuffer, nullptr);
+	m_ctx->RSSetState(m_doubleSidedRasterState); // The full screen triangle is clockwise
+	m_ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	m_tonemapShader.bind(m_ctx);
+	ID3D11ShaderResourceView* views[] = {m_sceneColor->m_SRV, m_exposureState.m_SRV};
+	m_ctx->PSSetShaderResources(0, 2, views);
+	m_ctx->Draw(3, 0);
+
+	ID3D11ShaderResourceView* nullViews[] = {nullptr, nullptr};
+	m_ctx->PSSetShaderResources(0, 2, nullViews);
+	// Debug primitives are depth tested on top
+	m_ctx->OMSetRenderTargets(1, &backBuffer, m_depthAttachment->m_depthStencilView);
+	m_ctx->RSSetState(m_rasterState);
+}
+
+bool App::buildFrameGraph(DebugConfig& config, ID3D11RenderTargetView* backBuffer) 
+{
+	using RenderGraph = framework::RenderGraph;
+	RenderGraph::TextureDesc backBufferDesc = {m_width, m_height, DXGI_FORMAT_R8G8B8A8_UNORM, 4, RenderGraph::ColorTarget};
+	RenderGraph::TextureDesc shadowAtlasDesc = {s_shadowAtlasSize, s_shadowAtlasSize, DXGI_FORMAT_D32_FLOAT, 4, RenderGraph::DepthTarget};
+	RenderGraph::TextureDesc depthDesc = {m_width, m_height, DXGI_FORMAT_D24_UNORM_S8_UINT, 4, RenderGraph::DepthTarget};
+	RenderGraph::TextureDesc albedoDesc = {m_width, m_height, DXGI_FORMAT_R8G8B8A8_UNORM, 4, RenderGraph::ColorTarget};
+	RenderGraph::TextureDesc normalDesc = {m_width, m_height, DXGI_FORMAT_R10G10B10A2_UNORM, 4, RenderGraph::ColorTarget};
+	RenderGraph::TextureDesc sceneColorDesc = {m_width, m_height, DXGI_FORMAT_R16G16B16A16_FLOAT, 8, RenderGraph::ColorTarget};
+	// The exposure state is a buffer kept between frames, the graph only tracks textures
+	RenderGraph::TextureDesc exposureDesc = {framework::AutoExposure::s_stateWordCount, 1, DXGI_FORMAT_R32_TYPELESS, 4, RenderGraph::ColorTarget};
+
+	m_frameGraph.reset();
+	RenderGraph::ResourceHandle backBufferTarget = m_frameGraph.importTexture("BackBuffer", backBufferDesc);
+	RenderGraph::ResourceHandle shadowAtlas = m_frameGraph.importTexture("ShadowAtlas", shadowAtlasDesc);
+	RenderGraph::ResourceHandle exposure = m_frameGraph.importTexture("ExposureState", exposureDesc);
+	RenderGraph::ResourceHandle depth = m_frameGraph.createTexture("SceneDepth", depthDesc);
+	RenderGraph::ResourceHandle sceneColor = m_frameGraph.createTexture("SceneColor", sceneColorDesc);
+	RenderGraph::ResourceHandle albedo = RenderGraph::s_invalidHandle;
+	RenderGraph::ResourceHandle normal = RenderGraph::s_invalidHandle;
+	const bool isDeferred = config.m_shadingPath == 1;
+
+	const u32 shadowPass = m_frameGraph.addPass("Shadows", [this]() { renderShadows(); });
+	shadowAtlas = m_frameGraph.write(shadowPass, shadowAtlas);
+
+	// Lighting is HDR, the tonemap writes the back buffer
+	const u32 scenePass = m_frameGraph.addPass(isDeferred ? "GBuffer" : "ForwardShading", [this, &config]() { renderScene(config, m_sceneColor->m_RTV); });
+	m_frameGraph.read(scenePass, shadowAtlas);
+	depth = m_frameGraph.write(scenePass, depth);
+	if (isDeferred) 
+	{
+		// G-buffer: albedo and world space normals, the position comes from the depth
+		albedo = m_frameGraph.write(scenePass, m_frameGraph.createTexture("GBufferAlbedo", albedoDesc));
+		normal = m_frameGraph.write(scenePass, m_frameGraph.createTexture("GBufferNormal", normalDesc));
+		const u32 resolvePass = m_frameGraph.addPass("DeferredResolve", [this]() { resolveDeferred(m_sceneColor->m_RTV); });
+		m_frameGraph.read(resolvePass, albedo);
+		m_frameGraph.read(resolvePass, normal);
+		m_frameGraph.read(resolvePass, depth);
+		sceneColor = m_frameGraph.write(resolvePass, sceneColor);
+	}
+	else 
+	{
+		sceneColor = m_frameGraph.write(scenePass, sceneColor);
+	}
+
+	// Histogram and adaptation in one dispatch, then the tonemap with the adapted exposure
+	const u32 exposurePass = m_frameGraph.addPass("Exposure", [this, &config]() { updateExposure(config); });
+	m_frameGraph.read(exposurePass, sceneColor);
+	exposure = m_frameGraph.write(exposurePass, exposure);
+	const u32 tonemapPass = m_frameGraph.addPass("Tonemap", [this, backBuffer]() { tonemap(backBuffer); });
+	m_frameGraph.read(tonemapPass, sceneColor);
+	m_frameGraph.read(tonemapPass, exposure);
+	backBufferTarget = m_frameGraph.write(tonemapPass, backBufferTarget);
+
+	// Depth tested
+	const u32 debugPass = m_frameGraph.addPass("DebugPrims", [this, &config]() { drawDebugPrims(config); });
+	m_frameGraph.read(debugPass, depth);
+	m_frameGraph.write(debugPass, backBufferTarget);
+
+	if (!m_frameGraph.compile() || !m_frameTargets.update(m_device, m_frameGraph)) 
+	{
+		printf("Failed to build the frame graph");
+		return false;
+	}
+	m_depthAttachment = m_frameTargets.getDepthAttachment(m_frameGraph, depth);
+	m_gbufferAlbedo = isDeferred ? m_frameTargets.getRenderTarget(m_frameGraph, albedo) : nullptr;
+	m_gbufferNormal = isDeferred ? m_frameTargets.getRenderTarget(m_frameGraph, normal) : nullptr;
+	m_sceneColor = m_frameTargets.getRenderTarget(m_frameGraph, sceneColor);
+	if (m_reportedShadingPath != config.m_shadingPath) 
+	{
+		m_frameGraph.printReport();
+		m_reportedShadingPath = config.m_shadingPath;
+	}
+	return true;
+}
+
 s32 App::init() 
 {
 	const u32 width = 1280;
@@ -337,7 +1598,46 @@ s32 App::init()
 	Window::init("5_Lighting", width, height, true, false, ENABLE_DEVICE_DEBUG);
 
 	// Init shaders
-	if (!loadSurfaceShader(m_device, "./shaders/5_ForwardLights.hlsl", m_surfaceShader)) 
+	if (!loadSurfaceShader(m_device, "./shaders/5_ForwardLights.hlsl", m_surfaceShader, false, true)) 
+	{
+		printf("Failed to load and create shader");
+		return 1;
+	}
+
+	if (!loadSurfaceShader(m_device, "./shaders/5_GBuffer.hlsl", m_gbufferShader) ||
+		!m_resolveShader.loadGraphicsPipeline(m_device, "./shaders/5_DeferredResolve.hlsl", "mainVS", "mainFS", nullptr, 0)) 
+	{
+		printf("Failed to load and create shader");
+		return 1;
+	}
+
+	// HDR scene color to the back buffer
+	if (!m_exposureShader.loadComputePipeline(m_device, "./shaders/Exposure.hlsl", "exposureCS") ||
+		!m_tonemapShader.loadGraphicsPipeline(m_device, "./shaders/Tonemap.hlsl", "mainVS", "mainFS", nullptr, 0)) 
+	{
+		printf("Failed to load and create shader");
+		return 1;
+	}
+	m_exposureCB = framework::RenderResources::createConstantBuffer<framework::AutoExposure::Constants>(m_device, framework::AutoExposure::Constants());
+	if (!m_exposureCB || !framework::RenderResources::createRawBuffer(m_device, framework::AutoExposure::s_stateWordCount * 4, false, m_exposureState)) 
+	{
+		printf("Failed to create the exposure resources");
+		return 1;
+	}
+	// Empty histogram and no adapted luminance yet
+	const UINT zeros[] = {0, 0, 0, 0};
+	m_ctx->ClearUnorderedAccessViewUint(m_exposureState.m_UAV, zeros);
+
+	// Depth only passes read the positions only
+	D3D11_INPUT_ELEMENT_DESC shadowVertexLayout;
+	ZeroMemory(&shadowVertexLayout, sizeof(D3D11_INPUT_ELEMENT_DESC));
+	shadowVertexLayout.SemanticName = "POSITION";
+	shadowVertexLayout.Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	shadowVertexLayout.AlignedByteOffset = u32(offsetof(framework::GltfScene::VertexBuffer0, m_pos));
+	shadowVertexLayout.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	if (!m_prepassShader.loadGraphicsPipeline(m_device, "./shaders/5_DepthPrepass.hlsl", "prepassVS", nullptr, &shadowVertexLayout, 1) ||
+		!m_shadowShader.loadGraphicsPipeline(m_device, "./shaders/5_Shadow.hlsl", "mainVS", nullptr, &shadowVertexLayout, 1) ||
+		!m_shadowClearShader.loadGraphicsPipeline(m_device, "./shaders/5_Shadow.hlsl", "clearVS", nullptr, nullptr, 0)) 
 	{
 		printf("Failed to load and create shader");
 		return 1;
@@ -374,18 +1674,24 @@ s32 App::init()
 		m_frameCBData.lightDir = glm::normalize((m3)lightModel * v3(0.0f, -1.0f, 0.0f));
 		m_frameCBData.mainLightColor = m_mainLightIntensity * m_mainLightColor;
 	}
-	m_frameCBData.pointLightPos = v3(0.0f, 1.0f, 0.0f);
-	m_frameCBData.pointLightRadius = 3.0f;
-	m_frameCBData.pointLightColor = v3(m_pointLightIntensity);
-
-	m_frameCBData.spotLightColor = v3(m_spotLightIntensity);
-	m_frameCBData.spotLightInnerCone = glm::cos(glm::radians(15.0f));
-	m_frameCBData.spotLightOuterCone = glm::cos(glm::radians(30.0f));
-	m_frameCBData.spotLightRadius = 3.0f;
-	m_frameCBData.spotLightPos = v3(4.0f, 1.5f, 0.0f);
-	m_frameCBData.spotLightDir = v3(0.0f, -1.0f, 0.0f);
+	m_lights.resize(2);
+	framework::ClusterLight& pointLight = m_lights[s_editPointLightIdx];
+	pointLight.m_type = framework::ClusterLight::Point;
+	pointLight.m_pos = v3(0.0f, 1.0f, 0.0f);
+	pointLight.m_radius = 3.0f;
+	pointLight.m_color = v3(m_pointLightIntensity);
+
+	framework::ClusterLight& spotLight = m_lights[s_editSpotLightIdx];
+	spotLight.m_type = framework::ClusterLight::Spot;
+	spotLight.m_color = v3(m_spotLightIntensity);
+	spotLight.m_cosInnerCone = glm::cos(glm::radians(15.0f));
+	spotLight.m_cosOuterCone = glm::cos(glm::radians(30.0f));
+	spotLight.m_radius = 3.0f;
+	spotLight.m_pos = v3(4.0f, 1.5f, 0.0f);
+	spotLight.m_dir = v3(0.0f, -1.0f, 0.0f);
 	m_spotModelNoScale = glm::rotate(m4(1.0f), glm::radians(90.0f), v3(1.0f, 0.0f, 0.0f));
-	m_spotModelNoScale[3] = v4(m_frameCBData.spotLightPos, 1.0f);
+	m_spotModelNoScale[3] = v4(spotLight.m_pos, 1.0f);
+
 
 	m_lightModel = glm::yawPitchRoll(glm::radians(45.0f), 0.0f, glm::radians(45.0f)) * glm::translate(m4(1.0f), v3(0.0f, 3.0f, -3.0f));
 
@@ -404,14 +1710,6 @@ s32 App::init()
 		return 1;
 	}
 
-	m_samplers = framework::RenderResources::createSamplerState(m_device, D3D11_FILTER_MIN_MAG_MIP_LINEAR, D3D11_TEXTURE_ADDRESS_WRAP);
-	if (!m_samplers) 
-	{
-		printf("Failed to create sampler state");
-		return 1;
-	}
-
-	
 	// Configure rasterization with a RasterState
 	D3D11_RASTERIZER_DESC rasterStateDesc;
 	ZeroMemory(&rasterStateDesc, sizeof(D3D11_RASTERIZER_DESC));
@@ -423,7 +1721,24 @@ s32 App::init()
 		printf("Failed to create Raster State");
 		return 1;
 	}
+
+	rasterStateDesc.CullMode = D3D11_CULL_NONE; // Double sided materials
+	if (FAILED(m_device->CreateRasterizerState(&rasterStateDesc, &m_doubleSidedRasterState))) 
+	{
+		printf("Failed to create Raster State");
+		return 1;
+	}
 		
+	// Shadows: both faces cast, slope scaled bias against acne, and casters in front of the near plane are clamped to it
+	rasterStateDesc.DepthBias = 100;
+	rasterStateDesc.SlopeScaledDepthBias = 2.0f;
+	rasterStateDesc.DepthClipEnable = false;
+	if (FAILED(m_device->CreateRasterizerState(&rasterStateDesc, &m_shadowRasterState))) 
+	{
+		printf("Failed to create Raster State");
+		return 1;
+	}
+
 	ZeroMemory(&rasterStateDesc, sizeof(D3D11_RASTERIZER_DESC));
 	rasterStateDesc.FillMode = D3D11_FILL_WIREFRAME; // Solid geometry
 	rasterStateDesc.CullMode = D3D11_CULL_BACK;
@@ -434,16 +1749,98 @@ s32 App::init()
 		return 1;
 	}
 
+	// Compare the image decoders on a directory of textures, e.g. --benchmarkDecoders models/Sponza/glTF
+	static const String s_benchmarkDecodersArg = "--benchmarkDecoders";
+	const String benchmarkDir = framework::CommandLine::getArg(framework::Hash::compute(s_benchmarkDecodersArg));
+	if (!benchmarkDir.empty())
+	{
+		framework::ImageDecoders::benchmark(framework::Paths::getAssetPath(benchmarkDir).c_str());
+	}
+
+	// Textures are packed in arrays to batch draws unless streaming them is requested (--textures stream)
+	static const String s_texturesArg = "--textures";
+	const bool streamTextures = framework::CommandLine::getArg(framework::Hash::compute(s_texturesArg)) == "stream";
+	u32 loadFlags = framework::GltfScene::SplitLargePrimitives | framework::GltfScene::WeldVertices | framework::GltfScene::CookTextures | framework::GltfScene::KeepCpuGeometry;
+	loadFlags |= streamTextures ? framework::GltfScene::StreamTextures : framework::GltfScene::PackTextures;
+	m_useTextureArrays = !streamTextures;
+
+	// Quick loads with low detail textures that skip cooking, e.g. --textureDownscale 2 decodes them at a quarter of their size
+	static const String s_textureDownscaleArg = "--textureDownscale";
+	const String textureDownscaleArg = framework::CommandLine::getArg(framework::Hash::compute(s_textureDownscaleArg));
+	const u32 textureDownscaleLog2 = textureDownscaleArg.empty() ? 0 : static_cast<u32>(strtoul(textureDownscaleArg.c_str(), nullptr, 10));
+	if (textureDownscaleLog2 > 0)
+	{
+		loadFlags &= ~framework::GltfScene::CookTextures;
+	}
+
 	m_scene = std::make_unique<framework::GltfScene>();
-	if (!m_scene->loadGLTF(m_device, m_ctx, "./models/Sponza/glTF/Sponza.gltf")) 
+	m_scene->setTextureDownscale(textureDownscaleLog2);
+	if (!m_scene->loadGLTF(m_device, m_ctx, "./models/Sponza/glTF/Sponza.gltf", loadFlags)) 
 	{
 		printf("Failed to load gltf");
 		return 1;
 	}
+	buildDrawList();
+	if (!m_occlusionCuller.init(framework::OcclusionCuller::Config())) 
+	{
+		return 1;
+	}
+
+	// Extra lights to stress the clustered lighting, e.g. --lights 512
+	static const String s_lightsArg = "--lights";
+	const String lightCountArg = framework::CommandLine::getArg(framework::Hash::compute(s_lightsArg));
+	addRandomLights(lightCountArg.empty() ? 0 : static_cast<u32>(strtoul(lightCountArg.c_str(), nullptr, 10)));
+	m_lightClusters.init(framework::LightClusters::Config());
+	m_drawLightLists.init(framework::DrawLightLists::Config());
+	m_clusterCB = framework::RenderResources::createConstantBuffer<framework::LightClusters::ShaderConstants>(m_device, m_lightClusters.getShaderConstants());
+	if (!m_clusterCB) 
+	{
+		printf("Failed to create the light cluster constant buffer");
+		return 1;
+	}
 
 	m_depthStencilState = framework::RenderResources::createDepthStencilState(m_device, D3D11_COMPARISON_LESS);
-	if (!framework::RenderResources::createDepthAttachment(m_device, width, height, DXGI_FORMAT_D24_UNORM_S8_UINT, m_depthAttachment) || !m_depthStencilState) 
+	m_shadowClearDepthState = framework::RenderResources::createDepthStencilState(m_device, D3D11_COMPARISON_ALWAYS);
+	m_depthEqualState = framework::RenderResources::createDepthStencilState(m_device, D3D11_COMPARISON_EQUAL, false);
+	if (!m_depthStencilState || !m_depthEqualState) 
+	{
+		return 1;
+	}
+
+	// Shadow atlas, cleared once. Tiles are cleared when they are rendered
+	framework::ShadowAtlas::Config shadowConfig;
+	shadowConfig.m_size = s_shadowAtlasSize;
+	shadowConfig.m_maxRendersPerFrame = 12; // All cascades and a point light
+	if (!m_shadowAtlas.init(shadowConfig) ||
+		!framework::RenderResources::createDepthAttachment(m_device, s_shadowAtlasSize, s_shadowAtlasSize, DXGI_FORMAT_D32_FLOAT, m_shadowAtlasDepth, true) || 
+		!m_shadowClearDepthState) 
+	{
+		printf("Failed to create the shadow atlas");
+		return 1;
+	}
+	m_ctx->ClearDepthStencilView(m_shadowAtlasDepth.m_depthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0);
+	m_shadowCBData.m_cascadeSplits = v4(0.0f);
+	m_shadowCBData.m_cascadeCount = 0;
+	m_shadowCB = framework::RenderResources::createConstantBuffer<ShadowDataCB>(m_device, m_shadowCBData);
+	m_shadowPassCB = framework::RenderResources::createConstantBuffer<m4>(m_device, m4(1.0f));
+	if (!m_shadowCB || !m_shadowPassCB) 
+	{
+		printf("Failed to create the shadow constant buffers");
+		return 1;
+	}
+
+	// Bilinear depth comparison (2x2 PCF per tap)
+	D3D11_SAMPLER_DESC shadowSamplerDesc;
+	ZeroMemory(&shadowSamplerDesc, sizeof(D3D11_SAMPLER_DESC));
+	shadowSamplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	shadowSamplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	shadowSamplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	shadowSamplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	shadowSamplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+	shadowSamplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	if (FAILED(m_device->CreateSamplerState(&shadowSamplerDesc, &m_shadowSampler))) 
 	{
+		printf("Failed to create the shadow sampler");
 		return 1;
 	}
 
@@ -461,11 +1858,22 @@ s32 App::run()
 	f64 framerate = 0.0f;
 	f64 elapsedTime = 0.0f;
 
-	const Vector<framework::GltfScene::Mesh>& meshes = m_scene->getMeshes();
-	const Vector<framework::GltfScene::Node>& nodes = m_scene->getNodes();
-	const Vector<framework::GltfScene::SurfaceMaterial>& materials = m_scene->getMaterials();
-
 	DebugConfig debugConfig;
+	// Shading path at startup, e.g. --shading deferred
+	static const String s_shadingArg = "--shading";
+	debugConfig.m_shadingPath = (framework::CommandLine::getArg(framework::Hash::compute(s_shadingArg)) == "deferred") ? 1 : 0;
+	// Depth pre-pass at startup, e.g. --prepass on
+	static const String s_prepassArg = "--prepass";
+	debugConfig.m_depthPrepass = framework::CommandLine::getArg(framework::Hash::compute(s_prepassArg)) == "on";
+	// Software occlusion culling at startup, e.g. --occlusion on
+	static const String s_occlusionArg = "--occlusion";
+	debugConfig.m_occlusionCulling = framework::CommandLine::getArg(framework::Hash::compute(s_occlusionArg)) == "on";
+	// GPU culling with indirect draws at startup, e.g. --gpuculling on
+	static const String s_gpuCullingArg = "--gpuculling";
+	debugConfig.m_gpuCulling = framework::CommandLine::getArg(framework::Hash::compute(s_gpuCullingArg)) == "on";
+	// Forward lights per draw instead of per cluster at startup, e.g. --lightculling draw
+	static const String s_lightCullingArg = "--lightculling";
+	debugConfig.m_lightAssignment = (framework::CommandLine::getArg(framework::Hash::compute(s_lightCullingArg)) == "draw") ? 1 : 0;
 
 	// Start frames
 	while (update())
@@ -485,99 +1893,18 @@ s32 App::run()
 		m_frameCBData.viewProj = m_fpCam.getViewProj();;
 		m_frameCBData.invViewProj = m_fpCam.getInvViewProj();
 		m_frameCBData.camPosWS = m_fpCam.getPos();
-		
-		// --------------------------------
-
-		ID3D11RenderTargetView* backBuffer = getBackBuffer();
-		// Set the back buffer as our RenderTarget
-		m_ctx->OMSetRenderTargets(1, &backBuffer, m_depthAttachment.m_depthStencilView);
-
-		// Set the viewport. This configures the area to render
-		D3D11_VIEWPORT viewport;
-		viewport.TopLeftX = 0.0f;
-		viewport.TopLeftY = 0.0f;
-		viewport.Width = static_cast<f32>(m_width);
-		viewport.Height = static_cast<f32>(m_height);
-		viewport.MinDepth = 0.0f;
-		viewport.MaxDepth = 1.0f;
-		m_ctx->RSSetViewports(1, &viewport);
-
-		// Tell the context how we want to rasterize the following drawcalls
-		m_ctx->RSSetState(m_rasterState);
-
-		// Clear the RenderTarget to the desired color
-		FLOAT clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-		m_ctx->ClearRenderTargetView(backBuffer, clearColor);
-
-		m_ctx->OMSetDepthStencilState(m_depthStencilState, 0);
-		m_ctx->ClearDepthStencilView(m_depthAttachment.m_depthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0);
-
-		// Update per-frame ConstantBuffer
-		updateFrameCB(m_ctx, m_frameCB, m_frameCBData);
 
-		// Bind shaders and draw batches
-		framework::ShaderPipeline* currShader = nullptr;
-		m_ctx->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		m_ctx->VSSetConstantBuffers(0, 1, &m_frameCB);
-		m_ctx->PSSetConstantBuffers(0, 1, &m_frameCB);
-		m_ctx->VSSetConstantBuffers(1, 1, &m_drawcallCB);
+		m_scene->updateTextureStreaming(m_device, m_ctx, m_fpCam.getView(), m_fpCam.getProjection(), m_height);
+		updateShadows();
+		updateLightClusters();
+		m_deltaTime = static_cast<f32>(elapsedTime);
 
-		// Draw GLTF
-		for (const framework::GltfScene::Node& node : nodes) 
+		ID3D11RenderTargetView* backBuffer = getBackBuffer();
+		if (!buildFrameGraph(debugConfig, backBuffer)) 
 		{
-			if (node.m_mesh >= 0) 
-			{
-				updateBatchCB(m_ctx, m_drawcallCB, node.m_model);
-				const framework::GltfScene::Mesh& mesh = meshes[node.m_mesh];
-				for (const framework::GltfScene::Meshlet& meshlet : mesh.m_meshlets) 
-				{
-					u32 vertexBubberOffsets[] = {m_scene->getVertexBuff0OffsetBytes(meshlet), m_scene->getVertexBuff1OffsetBytes(meshlet)};
-					u32 vertexBubberStrides[] = {static_cast<u32>(sizeof(framework::GltfScene::VertexBuffer0)), static_cast<u32>(sizeof(framework::GltfScene::VertexBuffer1))};
-					ID3D11Buffer* vertexBuffers[] = {m_scene->getPackedVertexBuffer(), m_scene->getPackedVertexBuffer()};
-					m_ctx->IASetVertexBuffers(0, 2, vertexBuffers, vertexBubberStrides, vertexBubberOffsets);
-					m_ctx->IASetIndexBuffer(m_scene->getPackedIndexBuffer(),
-						meshlet.m_isIndexShort ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT,
-						meshlet.m_indexBytesOffset);
-
-					const framework::GltfScene::SurfaceMaterial& mat = materials[meshlet.m_material];
-
-					u32 hash = debugConfig.m_renderingFeaturesMask & mat.m_hash;
-					if ((debugConfig.m_renderingFeaturesMask & s_DebugNormalsFlag) != 0) 
-					{
-						hash |= s_DebugNormalsFlag;
-					}
-
-					framework::ShaderPipeline* shader = m_surfaceShader.getShader(hash); // See how the hash is generated and how we uberize the shader
-					VERIFY(shader, "Trying to access null shader");
-					if (shader != currShader) 
-					{
-						currShader = shader;
-						currShader->bind(m_ctx);
-					}
-
-					ID3D11ShaderResourceView* views[] =	{nullptr, nullptr};
-					u32 texToBind = 0;
-
-					if (mat.m_albedo.m_SRV) 
-					{						
-						views[texToBind++] = mat.m_albedo.m_SRV;
-					}
-					if (mat.m_normal.m_SRV) 
-					{
-						views[texToBind++] = mat.m_normal.m_SRV;
-					}
-
-					m_ctx->PSSetSamplers(0, 1, &m_samplers);
-					m_ctx->PSSetShaderResources(0, texToBind, views);
-
-					m_ctx->DrawIndexed(meshlet.m_indexCount, 0, 0);
-				}
-
-			}
+			return 1;
 		}
-
-		// Draw debug primitives
-		drawDebugPrims(debugConfig);
+		m_frameGraph.execute();
 
 		// Present swapchain
 		present();
@@ -13,36 +13,96 @@ struct FrameDataCB
 	v3 lightDir;
 	f32 pad0;
 	v3 mainLightColor;
-	
-	// Point
-	f32 pointLightRadius;
-	v3 pointLightPos;
 	f32 pad1;
-	v3 pointLightColor;
-
-	// Spot
-	f32 spotLightInnerCone; // cos of angle
-	v3 spotLightPos;
-	f32 spotLightOuterCone; // cos of angle
-	v3 spotLightDir;
-	f32 spotLightRadius;
-	v3 spotLightColor;
-	f32 pad2;
 };
 
+// The point and spot lights edited from the UI are the first ones of the light list
+static constexpr u32 s_editPointLightIdx = 0;
+static constexpr u32 s_editSpotLightIdx = 1;
+
+// Layout of ShadowView in assets/shaders/Shadows.hlsli
+struct ShadowViewData
+{
+	m4 m_viewProj;
+	v4 m_atlasScaleBias;
+	v4 m_atlasBounds;
+	f32 m_normalOffset;
+	u32 m_isPerspective;
+	u32 m_isValid;
+	f32 pad;
+};
+
+struct ShadowDataCB
+{
+	v4 m_cascadeSplits;
+	u32 m_cascadeCount;
+	f32 pad[3];
+};
+
+// Layout of HiZCB in assets/shaders/HiZ.hlsl
+struct HiZDataCB
+{
+	u32 m_srcWidth;
+	u32 m_srcHeight;
+	u32 m_dstWidth;
+	u32 m_dstHeight;
+};
+
+static constexpr u32 s_shadowAtlasSize = 4096;
+static constexpr u32 s_cascadeShadowSize = 1024;
+static constexpr u32 s_maxLightShadowSize = 1024; // Spot lights filling the screen. Cube faces get half
+static constexpr u32 s_maxShadowedLights = 16; // Spot and point lights, by screen size
+static constexpr u32 s_occluderTriangleBudget = 40000; // Software rasterized per frame, largest meshlets on screen first
+static constexpr u32 s_cullReadbackCount = 3; // Frames the GPU culling stats are read back late, so reading them doesn't wait
+
 struct DrawcallDataCB 
 {
 	m4 m_model;
+	u32 m_albedoSlice; // Only used with texture arrays
+	u32 m_normalSlice;
+	f32 m_alphaCutoff;
+	f32 m_normalScale;
+	v4 m_baseColorFactor;
+	u32 m_lightOffset; // Only used with per draw lights, range of the draw in the light indices
+	u32 m_lightCount;
+	u32 pad[2];
 };
 
 static constexpr u32 s_DebugNormalsFlag = 1 << framework::GltfScene::COUNT;
+static constexpr u32 s_TextureArraysFlag = 1 << (framework::GltfScene::COUNT + 1);
+static constexpr u32 s_DrawLightsFlag = 1 << (framework::GltfScene::COUNT + 2); // Forward shader only
+
+// Meshlet of a node. The draw list is sorted so consecutive draws share as much state as possible
+struct DrawItem
+{
+	u64 m_sortKey;
+	u32 m_node;
+	u32 m_meshlet;
+};
 
 struct DebugConfig 
 {
 	bool m_editLights = true;
 	s32 m_editLightIdx = 1; // Pointlight by default
 	s32 m_editTransformationIdx = 0; // 0: Translation, 1: Rotation
-	u32 m_renderingFeaturesMask = (1<<framework::GltfScene::NormalMap); // Default: Normal mapping enabled
+	u32 m_renderingFeaturesMask = (1<<framework::GltfScene::NormalMap) | (1<<framework::GltfScene::AlphaTest) | (1<<framework::GltfScene::DoubleSided); // Default: All material features enabled
+	s32 m_shadingPath = 0; // 0: Forward, 1: Deferred
+	bool m_depthPrepass = false; // Opaque depth first, then shading with an EQUAL test
+	s32 m_sortMode = 0; // Shading pass order. 0: By material (fewest state changes), 1: Front to back (early-Z)
+	bool m_occlusionCulling = false; // Skip meshlets hidden behind the largest ones, rasterized on the CPU
+	bool m_gpuCulling = false; // Draws culled by a compute pass and submitted with indirect arguments, in material order
+	bool m_gpuOcclusion = true; // Two phase GPU culling: last frame's visible draws against last frame's depth, then the rest
+	s32 m_lightAssignment = 0; // Point and spot lights of the forward path without GPU culling. 0: Per cluster, 1: Per draw
+	f32 m_exposureCompensation = 0.0f; // EV, on top of the automatic exposure
+};
+
+// Draws and state changes of a pass, shown in the UI
+struct PassStats
+{
+	u32 m_draws = 0;
+	u32 m_shaderChanges = 0;
+	u32 m_stateChanges = 0; // Raster, depth and index buffer
+	u32 m_resourceChanges = 0; // Textures and samplers
 };
 
 class UberShader 
@@ -57,7 +117,8 @@ public:
 		const String* keywords, u32 keywordCount,
 		const char* entryVS,
 		const char* entryFS,
-		D3D11_INPUT_ELEMENT_DESC* vertexAttributes, u32 vertexAttribCount);
+		D3D11_INPUT_ELEMENT_DESC* vertexAttributes, u32 vertexAttribCount,
+		const char* srcAbsPath = nullptr);
 
 	framework::ShaderPipeline* getShader(u32 hash);
 
@@ -79,11 +140,83 @@ public:
 
 	void drawDebugPrims(DebugConfig& config);
 
+	void buildDrawList();
+
+	// Orders the draw list by the distance of the meshlets to the camera, closest first
+	void sortFrontToBack();
+
+	void addRandomLights(u32 count);
+
+	bool updateLightClusters();
+
+	// Assigns the point and spot lights to the visible draws when the forward path uses per draw lights. After the occlusion
+	// culling
+	bool updateDrawLights(const DebugConfig& config);
+
+	// Picks the shadow views of the frame and their atlas tiles. Before updateLightClusters, it sets the shadow views of the lights
+	bool updateShadows();
+
+	// Renders the views of the atlas that changed
+	void renderShadows();
+
+	// Rasterizes the largest meshlets on screen on the CPU and flags the draws they hide
+	void updateOcclusionCulling(const DebugConfig& config);
+
+	// GPU-driven path. Resources and shaders are created the first time it is used
+	bool initGpuCulling();
+
+	// Culls the draw list on the GPU into the indirect arguments of m_cullBatches. The late phase builds the depth hierarchy
+	// from the depth of the early one first, the render targets have to be bound again after it
+	void cullDrawsGpu(const DebugConfig& config, framework::DrawCulling::Phase phase);
+
+	// Once per frame after the GPU culling, reads back the visible counts of an older frame
+	void endGpuCullingFrame(bool hasLatePhase);
+
+	// Depth of the opaque meshlets, front to back. Alpha tested ones are left to the shading pass
+	void drawDepthPrepass(const DebugConfig& config);
+
+	// Draws the draw list in the given order (indices into m_drawList) with the variants of surfaceShader. Render targets,
+	// viewport and frame constants are set by the caller. With GPU culling, surfaceShader has to be a GPU-driven one and
+	// every batch is drawn from its indirect arguments
+	void drawScene(UberShader& surfaceShader, const DebugConfig& config, const Vector<u32>& order);
+
+	// Lights the G-buffer into the scene color
+	void resolveDeferred(ID3D11RenderTargetView* sceneColor);
+
+	// Luminance histogram of the scene color and the adapted exposure, in one dispatch
+	void updateExposure(const DebugConfig& config);
+
+	// Scene color to the back buffer with the adapted exposure
+	void tonemap(ID3D11RenderTargetView* backBuffer);
+
+	// Passes of the frame and their targets. Transient targets are created (or kept) for the compiled graph
+	bool buildFrameGraph(DebugConfig& config, ID3D11RenderTargetView* backBuffer);
+
+	// Culling, pre-pass and shading of the draw list, into the scene color or the G-buffer
+	void renderScene(DebugConfig& config, ID3D11RenderTargetView* sceneColor);
+
 	s32 run();
 
 private:
 
+	// World units per texel at distance 1 (perspective) or per texel (orthographic) come from extent / tile size
+	void addShadowView(u64 key, const m4& viewProj, f32 importance, u32 size, const v3& boundsCenter, f32 boundsRadius, f32 extent, bool isPerspective);
+
+	// Current depth to the depth hierarchy
+	void buildHiZ();
+
+	// Reads back the results of the last GPU culling and compares them with the CPU reference. visibility has the flags
+	// the culling started with
+	void validateGpuCulling(Vector<u32>& visibility);
+
+	// Runs the exposure of the read back scene color on the CPU from state, the exposure state before the dispatch, and
+	// compares it with the GPU one
+	void validateExposure(const framework::AutoExposure::Constants& constants, Vector<u32>& state, const Vector<u8>& sceneColorData);
+
 	UberShader m_surfaceShader;
+	UberShader m_gbufferShader;
+	framework::ShaderPipeline m_prepassShader;
+	framework::ShaderPipeline m_resolveShader;
 	framework::ShaderPipeline m_debugPrimShader;
 
 	framework::DebugMesh m_debugSphere;
@@ -101,12 +234,107 @@ private:
 
 	ID3D11Buffer* m_frameCB;
 	ID3D11Buffer* m_drawcallCB;
-	ID3D11SamplerState* m_samplers;
+	ID3D11Buffer* m_clusterCB = nullptr;
+
+	// Point and spot lights, binned in clusters every frame
+	Vector<framework::ClusterLight> m_lights;
+	framework::LightClusters m_lightClusters;
+	framework::StructuredBuffer m_lightBuffer;
+	framework::StructuredBuffer m_clusterRangeBuffer;
+	framework::StructuredBuffer m_clusterLightIndexBuffer;
+
+	// Per draw lights, an alternative to the clusters for the forward path. Bound instead of the cluster light indices
+	framework::DrawLightLists m_drawLightLists;
+	framework::StructuredBuffer m_drawLightIndexBuffer;
+	Vector<framework::DrawLightLists::DrawBounds> m_drawBounds; // Per draw of m_drawList, the scene is static
+	Vector<u8> m_drawInView; // Visible and in the frustum
+	bool m_useDrawLights = false; // This frame
+	u32 m_drawLightsDrawCount = 0; // Draws that got lights
+	f64 m_drawLightsTimeMs = 0.0;
+
+	// Shadows of the directional light (cascades) and of the most important spot and point lights share an atlas. Its tiles
+	// are cached and only rendered again when their view changes
+	framework::ShadowAtlas m_shadowAtlas;
+	framework::ShadowCascades m_shadowCascades;
+	framework::DepthAttachment m_shadowAtlasDepth;
+	framework::ShaderPipeline m_shadowShader;
+	framework::ShaderPipeline m_shadowClearShader;
+	ShadowDataCB m_shadowCBData;
+	ID3D11Buffer* m_shadowCB = nullptr;
+	ID3D11Buffer* m_shadowPassCB = nullptr;
+	ID3D11RasterizerState* m_shadowRasterState = nullptr;
+	ID3D11DepthStencilState* m_shadowClearDepthState = nullptr;
+	ID3D11SamplerState* m_shadowSampler = nullptr;
+	framework::StructuredBuffer m_shadowViewBuffer;
+	Vector<framework::ShadowAtlas::Request> m_shadowRequests;
+	Vector<ShadowViewData> m_shadowViews;
+	Vector<std::pair<f32, u32>> m_shadowCandidates; // Importance, light
 
 	ID3D11RasterizerState* m_rasterState = nullptr;
+	ID3D11RasterizerState* m_doubleSidedRasterState = nullptr;
 	ID3D11RasterizerState* m_wireRasterState = nullptr;
 	UniquePtr<framework::GltfScene> m_scene;
+	Vector<DrawItem> m_drawList;
+	Vector<u32> m_materialOrder; // m_drawList as sorted
+	Vector<u32> m_frontToBackOrder; // Updated every frame when used
+	Vector<u64> m_depthKeys;
+	Vector<u8> m_drawVisible; // Per draw of m_drawList, 0 when occluded
+	PassStats m_prepassStats;
+	PassStats m_shadingStats;
+	bool m_useTextureArrays = false;
+
+	framework::OcclusionCuller m_occlusionCuller;
+	Vector<std::pair<f32, u32>> m_occluderCandidates; // Size on screen, draw
+	f64 m_occlusionTimeMs = 0.0;
 
-	framework::DepthAttachment m_depthAttachment;
+	// GPU-driven path. Draws of a batch share their state, they are compacted in the arguments of the batch (see DrawCulling).
+	// The scene is static, the culling data is built once
+	bool m_isGpuCullingReady = false;
+	UberShader m_gpuDrivenSurfaceShader;
+	UberShader m_gpuDrivenGBufferShader;
+	framework::ComputePipeline m_hizCopyShader;
+	framework::ComputePipeline m_hizDownsampleShader;
+	framework::ComputePipeline m_cullClearShader;
+	framework::ComputePipeline m_cullShader;
+	framework::RWTexture2D m_hiz;
+	Vector<framework::DrawCulling::Draw> m_cullDraws; // Per draw of m_drawList
+	Vector<framework::DrawCulling::Batch> m_cullBatches; // Runs of m_drawList with the same sort key, their arguments start at their first draw
+	framework::DrawCulling::Constants m_cullConstants; // Of the last culling
+	framework::StructuredBuffer m_cullDrawBuffer;
+	framework::StructuredBuffer m_cullBatchBuffer;
+	framework::StructuredBuffer m_drawcallDataBuffer; // DrawcallDataCB per draw
+	framework::RawBuffer m_indirectArgs;
+	framework::RawBuffer m_batchCounts;
+	ID3D11Buffer* m_drawIdBuffer = nullptr; // Instance vertex buffer, the draw id at every index
+	ID3D11Buffer* m_cullCB = nullptr;
+	ID3D11Buffer* m_hizCB = nullptr;
+	framework::RawBuffer m_visibility; // DrawCulling visibility flags per draw
+	ID3D11Buffer* m_cullReadback[s_cullReadbackCount * 2] = {}; // Early (or single) and late phase counts per frame
+	bool m_cullReadbackHasLate[s_cullReadbackCount] = {};
+	u32 m_cullFrame = 0;
+	u32 m_gpuVisibleCount = 0;
+	bool m_hasPrevHiZ = false; // Built by the last frame, from its early phase depth and with the camera's previous viewProj
+	bool m_validateGpuCulling = false;
+	s32 m_cullValidationMismatches = -1; // -1 until validated
+
+	// Frame graph, described every frame. Its targets are set before it executes
+	framework::RenderGraph m_frameGraph;
+	framework::RenderGraphTargets m_frameTargets;
+	s32 m_reportedShadingPath = -1; // The report is printed when the shading path changes
+	framework::RenderTarget* m_gbufferAlbedo = nullptr; // Deferred path
+	framework::RenderTarget* m_gbufferNormal = nullptr;
+	framework::RenderTarget* m_sceneColor = nullptr; // HDR, lit by the forward or the deferred path
+	framework::DepthAttachment* m_depthAttachment = nullptr; // Read by the resolve and the depth hierarchy
 	ID3D11DepthStencilState* m_depthStencilState;
+	ID3D11DepthStencilState* m_depthEqualState = nullptr; // Shading after the pre-pass, no writes
+
+	// Automatic exposure and tonemapping of the scene color
+	framework::AutoExposure::Config m_exposureConfig;
+	framework::ComputePipeline m_exposureShader;
+	framework::ShaderPipeline m_tonemapShader;
+	framework::RawBuffer m_exposureState; // Histogram and adapted luminance, see AutoExposure
+	ID3D11Buffer* m_exposureCB = nullptr;
+	f32 m_deltaTime = 0.0f; // Of the frame, for the adaptation
+	bool m_validateExposure = false;
+	f32 m_exposureValidationError = -1.0f; // -1 until validated
 };
@@ -0,0 +1,195 @@
+#include "tests/Test.h"
+#include "framework/AccessorUtils.h"
+
+#include <cstring>
+#include <limits>
+
+using namespace framework;
+
+namespace
+{
+	// Same layout as GltfScene::VertexBuffer1, the interleaved buffer setupGeometry converts into
+	struct Vertex
+	{
+		v3 m_normal;
+		v4 m_tangent;
+		v2 m_uv;
+	};
+
+	const v4 s_untouched(-42.0f);
+
+	template<typename T>
+	f32 getReference(T value, bool normalized)
+	{
+		return normalized ? glm::max(static_cast<f32>(value) / static_cast<f32>(std::numeric_limits<T>::max()), -1.0f) : static_cast<f32>(value);
+	}
+
+	// count elements of componentCount components, stride bytes apart, with every value of T showing up
+	template<typename T>
+	Vector<u8> makeSource(u32 count, u32 componentCount, u32 stride)
+	{
+		Vector<u8> data(count * stride, 0xCD);
+		for (u32 i = 0; i < count; ++i)
+		{
+			for (u32 c = 0; c < componentCount; ++c)
+			{
+				const T value = static_cast<T>((i * 37 + c * 11) * 0x0101 + std::numeric_limits<T>::min());
+				memcpy(&data[i * stride + c * sizeof(T)], &value, sizeof(T));
+			}
+		}
+		return data;
+	}
+
+	template<typename T>
+	T readSource(const Vector<u8>& data, u32 stride, u32 element, u32 component)
+	{
+		T value;
+		memcpy(&value, &data[element * stride + component * sizeof(T)], sizeof(T));
+		return value;
+	}
+
+	// Converts an attribute into the normals or uvs of interleaved vertices, as setupGeometry does, and checks every value and
+	// that nothing else in the vertices was written
+	template<typename T>
+	void checkInterleaved(u32 componentType, bool normalized, u32 srcComponentCount, u32 srcStride, bool isUv, bool isRemapped)
+	{
+		const u32 count = 37;
+		const Vector<u8> data = makeSource<T>(count, srcComponentCount, srcStride);
+		Vector<u32> elementIndices(count);
+		for (u32 i = 0; i < count; ++i)
+		{
+			elementIndices[i] = isRemapped ? (i * 7) % count : i;
+		}
+
+		AccessorUtils::Stream stream;
+		stream.m_data = data.data();
+		stream.m_stride = srcStride;
+		stream.m_componentType = componentType;
+		stream.m_componentCount = srcComponentCount;
+		stream.m_normalized = normalized;
+		Vector<Vertex> vertices(count, {v3(s_untouched), s_untouched, v2(s_untouched)});
+		const u32 dstComponentCount = isUv ? 2 : 3;
+		f32* dst = isUv ? &vertices[0].m_uv[0] : &vertices[0].m_normal[0];
+		CHECK(AccessorUtils::convertToFloat(stream, count, dst, dstComponentCount, sizeof(Vertex), isRemapped ? elementIndices.data() : nullptr));
+
+		const u32 components = glm::min(srcComponentCount, dstComponentCount);
+		for (u32 i = 0; i < count; ++i)
+		{
+			const Vertex& vertex = vertices[i];
+			CHECK(vertex.m_tangent == s_untouched);
+			CHECK(isUv ? vertex.m_normal == v3(s_untouched) : vertex.m_uv == v2(s_untouched));
+			const f32* written = isUv ? &vertex.m_uv[0] : &vertex.m_normal[0];
+			for (u32 c = 0; c < dstComponentCount; ++c)
+			{
+				if (c >= components)
+				{
+					CHECK(written[c] == s_untouched.x);
+					continue;
+				}
+				const T value = readSource<T>(data, srcStride, elementIndices[i], c);
+				CHECK_NEAR(written[c], getReference(value, normalized), 1e-6f);
+			}
+		}
+	}
+}
+
+TEST_CASE(AccessorUtils_InterleavedIntegers)
+{
+	// 8 bit attributes are padded to 4 byte strides by glTF
+	checkInterleaved<u8>(AccessorUtils::UnsignedByte, true, 2, 4, true, false);
+	checkInterleaved<u8>(AccessorUtils::UnsignedByte, true, 2, 4, true, true);
+	checkInterleaved<u16>(AccessorUtils::UnsignedShort, true, 2, 4, true, true);
+	checkInterleaved<u16>(AccessorUtils::UnsignedShort, false, 2, 8, true, false);
+	checkInterleaved<s8>(AccessorUtils::Byte, true, 3, 4, false, false);
+	checkInterleaved<s8>(AccessorUtils::Byte, true, 3, 4, false, true);
+	checkInterleaved<s16>(AccessorUtils::Short, true, 3, 8, false, true);
+	checkInterleaved<s16>(AccessorUtils::Short, false, 3, 8, false, false);
+	// Fewer components than the destination, and more
+	checkInterleaved<u8>(AccessorUtils::UnsignedByte, true, 1, 4, true, false);
+	checkInterleaved<s16>(AccessorUtils::Short, true, 4, 8, false, true);
+}
+
+TEST_CASE(AccessorUtils_InterleavedFloats)
+{
+	// Positions, normals and uvs interleaved in the source too
+	struct SrcVertex
+	{
+		v3 m_pos;
+		v3 m_normal;
+		v2 m_uv;
+	};
+	const u32 count = 23;
+	Vector<SrcVertex> src(count);
+	Vector<u32> elementIndices(count);
+	for (u32 i = 0; i < count; ++i)
+	{
+		src[i] = {v3(i * 1.0f, i * 2.0f, i * 3.0f), v3(-1.0f * i, 0.5f * i, 0.25f * i), v2(i * 0.125f, -0.5f * i)};
+		elementIndices[i] = (i * 5) % count;
+	}
+	for (bool isRemapped : {false, true})
+	{
+		Vector<Vertex> vertices(count, {v3(s_untouched), s_untouched, v2(s_untouched)});
+		AccessorUtils::Stream stream;
+		stream.m_data = reinterpret_cast<const u8*>(&src[0].m_normal);
+		stream.m_stride = sizeof(SrcVertex);
+		stream.m_componentCount = 3;
+		CHECK(AccessorUtils::convertToFloat(stream, count, &vertices[0].m_normal[0], 3, sizeof(Vertex), isRemapped ? elementIndices.data() : nullptr));
+		stream.m_data = reinterpret_cast<const u8*>(&src[0].m_uv);
+		stream.m_componentCount = 2;
+		CHECK(AccessorUtils::convertToFloat(stream, count, &vertices[0].m_uv[0], 2, sizeof(Vertex), isRemapped ? elementIndices.data() : nullptr));
+		for (u32 i = 0; i < count; ++i)
+		{
+			const SrcVertex& expected = src[isRemapped ? elementIndices[i] : i];
+			CHECK(vertices[i].m_normal == expected.m_normal);
+			CHECK(vertices[i].m_uv == expected.m_uv);
+			CHECK(vertices[i].m_tangent == s_untouched);
+		}
+	}
+}
+
+TEST_CASE(AccessorUtils_PackedIntegers)
+{
+	// 5 elements of 4 components: two 8 component steps and a scalar tail
+	const u32 count = 5;
+	const Vector<u8> bytes = makeSource<u8>(count, 4, 4);
+	const Vector<u8> shorts = makeSource<s16>(count, 4, 8);
+	AccessorUtils::Stream stream;
+	stream.m_componentCount = 4;
+	stream.m_normalized = true;
+	Vector<v4> dst(count + 1, s_untouched);
+
+	stream.m_data = bytes.data();
+	stream.m_stride = 4;
+	stream.m_componentType = AccessorUtils::UnsignedByte;
+	CHECK(AccessorUtils::convertToFloat(stream, count, &dst[0][0], 4, sizeof(v4)));
+	for (u32 i = 0; i < count * 4; ++i)
+	{
+		CHECK_NEAR(dst[i / 4][i % 4], getReference(bytes[i], true), 1e-6f);
+	}
+	CHECK(dst[count] == s_untouched);
+
+	stream.m_data = shorts.data();
+	stream.m_stride = 8;
+	stream.m_componentType = AccessorUtils::Short;
+	CHECK(AccessorUtils::convertToFloat(stream, count, &dst[0][0], 4, sizeof(v4)));
+	for (u32 i = 0; i < count * 4; ++i)
+	{
+		CHECK_NEAR(dst[i / 4][i % 4], getReference(readSource<s16>(shorts, 8, i / 4, i % 4), true), 1e-6f);
+	}
+	CHECK(dst[count] == s_untouched);
+}
+
+TEST_CASE(AccessorUtils_ConvertToUint)
+{
+	const u16 shorts[] = {1, 65535, 7, 0};
+	u32 dst[4] = {};
+	AccessorUtils::Stream stream;
+	stream.m_data = reinterpret_cast<const u8*>(shorts);
+	stream.m_stride = 2;
+	stream.m_componentType = AccessorUtils::UnsignedShort;
+	stream.m_componentCount = 1;
+	CHECK(AccessorUtils::convertToUint(stream, 4, dst));
+	CHECK(dst[0] == 1 && dst[1] == 65535 && dst[2] == 7 && dst[3] == 0);
+	stream.m_componentType = AccessorUtils::Float;
+	CHECK(!AccessorUtils::convertToUint(stream, 4, dst));
+}
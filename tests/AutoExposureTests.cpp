@@ -0,0 +1,150 @@
+#include "tests/Test.h"
+#include "framework/AutoExposure.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace framework;
+
+namespace
+{
+	f32 getStateFloat(const Vector<u32>& state, u32 word)
+	{
+		f32 value;
+		memcpy(&value, &state[word], sizeof(f32));
+		return value;
+	}
+
+	// Grey image with the given luminance
+	Vector<v4> makeUniformImage(u32 width, u32 height, f32 luminance)
+	{
+		return Vector<v4>(width * height, v4(v3(luminance), 1.0f));
+	}
+}
+
+TEST_CASE(AutoExposure_GetBin)
+{
+	const AutoExposure::Config config;
+	const AutoExposure::Constants constants = AutoExposure::makeConstants(config, 64, 32, 1.0f / 60.0f, 0.0f);
+	const u32 lastBin = AutoExposure::s_binCount - 1;
+
+	// Too dark to count, black and invalid values
+	CHECK(AutoExposure::getBin(constants, 0.0f) == 0);
+	CHECK(AutoExposure::getBin(constants, -1.0f) == 0);
+	CHECK(AutoExposure::getBin(constants, 1e-6f) == 0);
+	CHECK(AutoExposure::getBin(constants, std::nanf("")) == 0);
+
+	// The ends of the range, values outside it are clamped
+	CHECK(AutoExposure::getBin(constants, exp2f(config.m_minLogLuminance)) == 1);
+	CHECK(AutoExposure::getBin(constants, exp2f(config.m_minLogLuminance - 2.0f)) == 1);
+	CHECK(AutoExposure::getBin(constants, exp2f(config.m_maxLogLuminance)) == lastBin);
+	CHECK(AutoExposure::getBin(constants, 1e6f) == lastBin);
+
+	// Log2 steps of the same size take the same number of bins
+	const u32 middle = AutoExposure::getBin(constants, exp2f(0.5f * (config.m_minLogLuminance + config.m_maxLogLuminance)));
+	CHECK(middle == 1 + (AutoExposure::s_binCount - 2) / 2);
+	u32 prevBin = 0;
+	for (f32 logLuminance = config.m_minLogLuminance; logLuminance <= config.m_maxLogLuminance; logLuminance += 0.25f)
+	{
+		const u32 bin = AutoExposure::getBin(constants, exp2f(logLuminance));
+		CHECK(bin > prevBin || logLuminance == config.m_minLogLuminance);
+		prevBin = bin;
+	}
+}
+
+TEST_CASE(AutoExposure_GetAverageLuminance)
+{
+	const AutoExposure::Config config;
+	const AutoExposure::Constants constants = AutoExposure::makeConstants(config, 64, 32, 1.0f / 60.0f, 0.0f);
+
+	// Only pixels in bin 0: the darkest luminance of the range
+	Vector<u32> bins(AutoExposure::s_binCount, 0);
+	bins[0] = 64 * 32;
+	CHECK(AutoExposure::getAverageLuminance(constants, bins.data()) == exp2f(config.m_minLogLuminance));
+
+	// A uniform image averages to its luminance, within a bin. Black pixels don't pull the average down
+	const f32 binWidth = (config.m_maxLogLuminance - config.m_minLogLuminance) / (AutoExposure::s_binCount - 2);
+	for (f32 luminance : {0.01f, 0.18f, 1.0f, 5.0f})
+	{
+		const Vector<v4> image = makeUniformImage(64, 32, luminance);
+		bins.assign(AutoExposure::s_binCount, 0);
+		AutoExposure::addToHistogram(constants, image.data(), bins.data());
+		CHECK(bins[AutoExposure::getBin(constants, luminance)] == 64 * 32);
+		CHECK_NEAR(log2f(AutoExposure::getAverageLuminance(constants, bins.data())), log2f(luminance), binWidth);
+		bins[0] += 1000;
+		CHECK_NEAR(log2f(AutoExposure::getAverageLuminance(constants, bins.data())), log2f(luminance), binWidth);
+	}
+}
+
+TEST_CASE(AutoExposure_Adapt)
+{
+	AutoExposure::Config config;
+	config.m_adaptationSpeed = 2.0f;
+	const AutoExposure::Constants constants = AutoExposure::makeConstants(config, 64, 32, 0.1f, 0.0f);
+	CHECK_NEAR(constants.m_adaptationRate, 1.0f - expf(-0.2f), 1e-6f);
+
+	// The first frame takes the average as is
+	CHECK(AutoExposure::adapt(constants, 0.0f, 0.5f) == 0.5f);
+
+	// Then moves the rate of the way towards it, in both directions
+	CHECK_NEAR(AutoExposure::adapt(constants, 1.0f, 2.0f), 1.0f + constants.m_adaptationRate, 1e-6f);
+	CHECK_NEAR(AutoExposure::adapt(constants, 2.0f, 1.0f), 2.0f - constants.m_adaptationRate, 1e-6f);
+
+	// No time, no adaptation. A long frame gets there
+	CHECK(AutoExposure::adapt(AutoExposure::makeConstants(config, 64, 32, 0.0f, 0.0f), 1.0f, 2.0f) == 1.0f);
+	CHECK_NEAR(AutoExposure::adapt(AutoExposure::makeConstants(config, 64, 32, 100.0f, 0.0f), 1.0f, 2.0f), 2.0f, 1e-6f);
+}
+
+TEST_CASE(AutoExposure_UpdateClearsTheHistogram)
+{
+	const AutoExposure::Config config;
+	const AutoExposure::Constants constants = AutoExposure::makeConstants(config, 40, 24, 1.0f / 60.0f, 1.0f);
+	Vector<u32> state(AutoExposure::s_stateWordCount, 0);
+	state[AutoExposure::s_groupCounterWord] = constants.m_groupCount;
+
+	const Vector<v4> image = makeUniformImage(40, 24, 0.5f);
+	AutoExposure::update(constants, image.data(), state.data());
+	for (u32 i = 0; i < AutoExposure::s_binCount; ++i)
+	{
+		CHECK(state[i] == 0);
+	}
+	CHECK(state[AutoExposure::s_groupCounterWord] == 0);
+
+	// First frame: adapted to the average, exposed to the key value with 1 EV of compensation
+	const f32 average = getStateFloat(state, AutoExposure::s_averageWord);
+	CHECK_NEAR(log2f(average), log2f(0.5f), 0.1f);
+	CHECK(getStateFloat(state, AutoExposure::s_adaptedWord) == average);
+	CHECK_NEAR(getStateFloat(state, AutoExposure::s_exposureWord), 2.0f * config.m_keyValue / average, 1e-5f);
+
+	// A brighter frame only adapts part of the way
+	const Vector<u32> firstState = state;
+	const Vector<v4> brighter = makeUniformImage(40, 24, 2.0f);
+	AutoExposure::update(constants, brighter.data(), state.data());
+	const f32 adapted = getStateFloat(state, AutoExposure::s_adaptedWord);
+	CHECK(adapted > average && adapted < getStateFloat(state, AutoExposure::s_averageWord));
+	CHECK(AutoExposure::compareStates(state.data(), state.data()) == 0.0f);
+	CHECK(AutoExposure::compareStates(state.data(), firstState.data()) > 0.1f);
+	state[3] = 1;
+	CHECK(AutoExposure::compareStates(state.data(), firstState.data()) == 1.0f);
+}
+
+TEST_CASE(AutoExposure_Tonemap)
+{
+	// Black stays black, bright colors saturate to 1 and the curve never goes down
+	CHECK(AutoExposure::tonemap(v3(0.0f), 1.0f) == v3(0.0f));
+	CHECK(AutoExposure::tonemap(v3(-1.0f), 1.0f) == v3(0.0f));
+	CHECK_NEAR(AutoExposure::tonemap(v3(1000.0f), 1.0f).x, 1.0f, 1e-5f);
+	f32 prev = 0.0f;
+	for (f32 value = 0.0f; value < 64.0f; value = value * 1.1f + 0.001f)
+	{
+		const v3 mapped = AutoExposure::tonemap(v3(value, 0.5f * value, 2.0f * value), 1.0f);
+		CHECK(mapped.x >= prev);
+		CHECK(mapped.x >= 0.0f && mapped.x <= 1.0f && mapped.y >= 0.0f && mapped.y <= 1.0f && mapped.z >= 0.0f && mapped.z <= 1.0f);
+		CHECK(mapped.y <= mapped.x && mapped.x <= mapped.z);
+		prev = mapped.x;
+	}
+
+	// The exposure scales the color before the curve
+	CHECK(AutoExposure::tonemap(v3(0.1f), 4.0f) == AutoExposure::tonemap(v3(0.4f), 1.0f));
+	CHECK(AutoExposure::tonemap(v3(0.1f), 4.0f).x > AutoExposure::tonemap(v3(0.1f), 1.0f).x);
+}
@@ -0,0 +1,157 @@
+#include "tests/Test.h"
+#include "framework/DrawCulling.h"
+
+using namespace framework;
+
+namespace
+{
+	// Camera at z = 5 looking at a wall at z = 0 that fills the depth buffer. The depth buffer has odd sizes and a hole
+	// in its last column
+	struct Scene
+	{
+		static constexpr u32 s_width = 67;
+		static constexpr u32 s_height = 37;
+
+		m4 m_viewProj;
+		DrawCulling::HiZ m_hiz;
+		Vector<DrawCulling::Draw> m_draws;
+		DrawCulling::Batch m_batches[2] = { { 0, 2 }, { 2, 3 } };
+
+		Scene()
+		{
+			const m4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+			const m4 view = glm::lookAt(v3(0.0f, 0.0f, 5.0f), v3(0.0f), v3(0.0f, 1.0f, 0.0f));
+			m_viewProj = proj * view;
+			const v4 wall = m_viewProj * v4(0.0f, 0.0f, 0.0f, 1.0f);
+			Vector<f32> depth(s_width * s_height, wall.z / wall.w);
+			depth[5 * s_width + s_width - 1] = 1.0f;
+			DrawCulling::buildHiZ(depth.data(), s_width, s_height, m_hiz);
+
+			addDraw(v3(0.0f, 0.0f, -3.0f), v3(0.5f), 0); // Behind the wall
+			addDraw(v3(0.0f, 0.0f, 2.0f), v3(0.5f), 0); // In front of the wall
+			addDraw(v3(0.0f, 0.0f, -3.0f), v3(0.5f), 1); // Behind the wall
+			addDraw(v3(0.0f, 0.0f, 20.0f), v3(0.5f), 1); // Behind the camera
+			addDraw(v3(0.0f, 0.0f, -0.01f), v3(1.0f, 1.0f, 0.02f), 1); // Through the wall
+		}
+
+		void addDraw(const v3& center, const v3& extents, u32 batch)
+		{
+			DrawCulling::Draw draw;
+			draw.m_boundsCenter = center;
+			draw.m_boundsExtents = extents;
+			draw.m_boundsRadius = glm::length(extents);
+			draw.m_batch = batch;
+			draw.m_indexCount = 3 * (static_cast<u32>(m_draws.size()) + 1);
+			draw.m_firstIndex = 100 * static_cast<u32>(m_draws.size());
+			draw.m_drawId = static_cast<u32>(m_draws.size());
+			m_draws.push_back(draw);
+		}
+
+		DrawCulling::Constants makeConstants(bool useHiZ, DrawCulling::Phase phase = DrawCulling::SinglePhase) const
+		{
+			return DrawCulling::makeConstants(m_viewProj, m_viewProj, useHiZ ? s_width : 0, useHiZ ? s_height : 0, 
+				static_cast<u32>(m_draws.size()), m_batches, 2, phase);
+		}
+	};
+}
+
+TEST_CASE(DrawCulling_BuildHiZ)
+{
+	CHECK(DrawCulling::getLevelCount(1, 1) == 1);
+	CHECK(DrawCulling::getLevelCount(67, 37) == 7);
+	CHECK(DrawCulling::getLevelCount(64, 1) == 7);
+
+	// Farthest depth of each 2x2 footprint
+	const f32 depth[16] = 
+	{
+		0.1f, 0.2f, 0.3f, 0.3f,
+		0.4f, 0.1f, 0.3f, 0.9f,
+		0.5f, 0.5f, 0.2f, 0.2f,
+		0.5f, 0.6f, 0.2f, 0.1f,
+	};
+	DrawCulling::HiZ hiz;
+	DrawCulling::buildHiZ(depth, 4, 4, hiz);
+	CHECK(hiz.m_levels.size() == 3);
+	CHECK(hiz.m_widths[1] == 2 && hiz.m_heights[1] == 2);
+	CHECK(hiz.m_levels[1][0] == 0.4f && hiz.m_levels[1][1] == 0.9f && hiz.m_levels[1][2] == 0.6f && hiz.m_levels[1][3] == 0.2f);
+	CHECK(hiz.m_levels[2][0] == 0.9f);
+
+	// The texel left over by an odd size is covered by the last texel of the row
+	const Scene scene;
+	CHECK(scene.m_hiz.m_widths[1] == 33 && scene.m_hiz.m_heights[1] == 18);
+	CHECK(scene.m_hiz.m_levels[1][2 * 33 + 32] == 1.0f);
+	CHECK(scene.m_hiz.m_levels[1][2 * 33 + 31] < 1.0f);
+	CHECK(scene.m_hiz.m_levels.back()[0] == 1.0f);
+}
+
+TEST_CASE(DrawCulling_IsVisible)
+{
+	const Scene scene;
+	const DrawCulling::Constants occlusion = scene.makeConstants(true);
+	const DrawCulling::Constants frustumOnly = scene.makeConstants(false);
+	const bool expectedOcclusion[] = { false, true, false, false, true };
+	const bool expectedFrustum[] = { true, true, true, false, true };
+	for (u32 i = 0; i < 5; ++i)
+	{
+		CHECK(DrawCulling::isVisible(occlusion, scene.m_draws[i], &scene.m_hiz) == expectedOcclusion[i]);
+		CHECK(DrawCulling::isVisible(frustumOnly, scene.m_draws[i], nullptr) == expectedFrustum[i]);
+	}
+}
+
+TEST_CASE(DrawCulling_CullCompactsBatches)
+{
+	const Scene scene;
+	Vector<DrawCulling::IndirectArgs> args;
+	Vector<u32> counts;
+	DrawCulling::cull(scene.makeConstants(true), scene.m_draws.data(), scene.m_batches, &scene.m_hiz, nullptr, args, counts);
+	CHECK(counts.size() == 2 && counts[0] == 1 && counts[1] == 1);
+	CHECK(args.size() == 5);
+
+	// The visible draws are at the front of their batch, the other arguments draw nothing
+	CHECK(args[0].m_instanceCount == 1 && args[0].m_startInstanceLocation == 1);
+	CHECK(args[0].m_indexCountPerInstance == scene.m_draws[1].m_indexCount && args[0].m_startIndexLocation == scene.m_draws[1].m_firstIndex);
+	CHECK(args[1].m_instanceCount == 0);
+	CHECK(args[2].m_instanceCount == 1 && args[2].m_startInstanceLocation == 4);
+	CHECK(args[3].m_instanceCount == 0 && args[4].m_instanceCount == 0);
+	CHECK(DrawCulling::compareResults(scene.m_batches, 2, args.data(), counts.data(), args.data(), counts.data()) == 0);
+
+	// Without the depth hierarchy the draws behind the wall come back, in any order
+	Vector<DrawCulling::IndirectArgs> frustumArgs;
+	Vector<u32> frustumCounts;
+	DrawCulling::cull(scene.makeConstants(false), scene.m_draws.data(), scene.m_batches, nullptr, nullptr, frustumArgs, frustumCounts);
+	CHECK(frustumCounts[0] == 2 && frustumCounts[1] == 2);
+	CHECK(DrawCulling::compareResults(scene.m_batches, 2, args.data(), counts.data(), frustumArgs.data(), frustumCounts.data()) == 2);
+	Vector<DrawCulling::IndirectArgs> reordered = frustumArgs;
+	std::swap(reordered[0], reordered[1]);
+	std::swap(reordered[2], reordered[3]);
+	CHECK(DrawCulling::compareResults(scene.m_batches, 2, frustumArgs.data(), frustumCounts.data(), reordered.data(), frustumCounts.data()) == 0);
+}
+
+TEST_CASE(DrawCulling_TwoPhaseFlags)
+{
+	const Scene scene;
+	const u32 drawCount = static_cast<u32>(scene.m_draws.size());
+
+	// Draws 0 and 1 were visible last frame. Last frame's depth isn't available, so the early phase only frustum tests
+	Vector<u32> visibility(drawCount, 0);
+	visibility[0] = DrawCulling::s_visibleFlag;
+	visibility[1] = DrawCulling::s_visibleFlag;
+	Vector<DrawCulling::IndirectArgs> args;
+	Vector<u32> counts;
+	DrawCulling::cull(scene.makeConstants(false, DrawCulling::EarlyPhase), scene.m_draws.data(), scene.m_batches, nullptr, visibility.data(), args, counts);
+	CHECK(counts[0] == 2 && counts[1] == 0);
+	const u32 drawnEarly = DrawCulling::s_visibleFlag | DrawCulling::s_drawnEarlyFlag;
+	CHECK(visibility[0] == drawnEarly && visibility[1] == drawnEarly);
+	CHECK(visibility[2] == 0 && visibility[3] == 0 && visibility[4] == 0);
+
+	// The late phase tests everything against the new depth, only draws what the early phase missed and
+	// keeps what is visible for the next frame
+	DrawCulling::cull(scene.makeConstants(true, DrawCulling::LatePhase), scene.m_draws.data(), scene.m_batches, &scene.m_hiz, visibility.data(), args, counts);
+	CHECK(counts[0] == 0 && counts[1] == 1);
+	CHECK(args[2].m_startInstanceLocation == 4);
+	const u32 expected[] = { 0, DrawCulling::s_visibleFlag, 0, 0, DrawCulling::s_visibleFlag };
+	for (u32 i = 0; i < drawCount; ++i)
+	{
+		CHECK(visibility[i] == expected[i]);
+	}
+}
@@ -0,0 +1,274 @@
+#include "tests/Test.h"
+#include "framework/LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace framework;
+
+namespace
+{
+	const f32 s_near = 0.1f;
+	const f32 s_far = 100.0f;
+
+	struct Camera
+	{
+		m4 m_view = glm::lookAt(v3(0.0f, 2.0f, 10.0f), v3(0.0f), v3(0.0f, 1.0f, 0.0f));
+		m4 m_projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, s_near, s_far);
+	};
+
+	// Frustum cell of a cluster: ndc rectangle and view depth range
+	struct Cell
+	{
+		f32 m_left, m_right, m_bottom, m_top;
+		f32 m_near, m_far;
+	};
+
+	Cell getCell(const LightClusters::Config& config, u32 x, u32 y, u32 slice)
+	{
+		Cell cell;
+		cell.m_left = -1.0f + 2.0f * x / config.m_tilesX;
+		cell.m_right = -1.0f + 2.0f * (x + 1) / config.m_tilesX;
+		cell.m_top = 1.0f - 2.0f * y / config.m_tilesY;
+		cell.m_bottom = 1.0f - 2.0f * (y + 1) / config.m_tilesY;
+		cell.m_near = s_near * powf(s_far / s_near, static_cast<f32>(slice) / config.m_slices);
+		cell.m_far = s_near * powf(s_far / s_near, static_cast<f32>(slice + 1) / config.m_slices);
+		return cell;
+	}
+
+	// Brute force reference: sphere against the view space AABB of the cell
+	bool isInClusterAABB(const Camera& camera, const Cell& cell, const v3& centerVS, f32 radius)
+	{
+		const f32 invScaleX = 1.0f / camera.m_projection[0][0];
+		const f32 invScaleY = 1.0f / camera.m_projection[1][1];
+		const v3 boxMin(glm::min(cell.m_left * cell.m_near, cell.m_left * cell.m_far) * invScaleX,
+			glm::min(cell.m_bottom * cell.m_near, cell.m_bottom * cell.m_far) * invScaleY, -cell.m_far);
+		const v3 boxMax(glm::max(cell.m_right * cell.m_near, cell.m_right * cell.m_far) * invScaleX,
+			glm::max(cell.m_top * cell.m_near, cell.m_top * cell.m_far) * invScaleY, -cell.m_near);
+		const v3 delta = glm::max(glm::max(boxMin - centerVS, centerVS - boxMax), v3(0.0f));
+		return glm::dot(delta, delta) <= radius * radius;
+	}
+
+	// The AABB of a cell sticks out of the cell, build may skip clusters the sphere only touches there.
+	// Samples the cell to check the sphere really misses it
+	bool isInCell(const Camera& camera, const Cell& cell, const v3& centerVS, f32 radius)
+	{
+		static constexpr u32 s_steps = 8;
+		for (u32 k = 0; k <= s_steps; ++k)
+		{
+			const f32 depth = cell.m_near + (cell.m_far - cell.m_near) * k / s_steps;
+			for (u32 j = 0; j <= s_steps; ++j)
+			{
+				const f32 ndcY = cell.m_bottom + (cell.m_top - cell.m_bottom) * j / s_steps;
+				for (u32 i = 0; i <= s_steps; ++i)
+				{
+					const f32 ndcX = cell.m_left + (cell.m_right - cell.m_left) * i / s_steps;
+					const v3 point(ndcX * depth / camera.m_projection[0][0], ndcY * depth / camera.m_projection[1][1], -depth);
+					if (glm::distance(point, centerVS) <= radius)
+					{
+						return true;
+					}
+				}
+			}
+		}
+		return false;
+	}
+
+	Vector<u32> getClusterLights(const LightClusters& clusters, u32 x, u32 y, u32 slice)
+	{
+		const LightClusters::Range& range = clusters.getRanges()[clusters.getClusterIdx(x, y, slice)];
+		Vector<u32> lights(clusters.getLightIndices().begin() + range.m_offset, clusters.getLightIndices().begin() + range.m_offset + range.m_count);
+		std::sort(lights.begin(), lights.end());
+		return lights;
+	}
+
+	// Every light binned to a cluster touches its AABB, every light missing from a cluster misses the cell.
+	// Returns how many (cluster, light) pairs were checked against the brute force
+	u32 checkAgainstBruteForce(const LightClusters& clusters, const Camera& camera, const Vector<ClusterLight>& lights)
+	{
+		const LightClusters::Config& config = clusters.getConfig();
+		Vector<v3> centers(lights.size());
+		Vector<f32> radii(lights.size());
+		for (size_t i = 0; i < lights.size(); ++i)
+		{
+			LightClusters::getLightSphere(lights[i], centers[i], radii[i]);
+			centers[i] = v3(camera.m_view * v4(centers[i], 1.0f));
+		}
+
+		u32 pairCount = 0;
+		for (u32 slice = 0; slice < config.m_slices; ++slice)
+		{
+			for (u32 y = 0; y < config.m_tilesY; ++y)
+			{
+				for (u32 x = 0; x < config.m_tilesX; ++x)
+				{
+					const Cell cell = getCell(config, x, y, slice);
+					const Vector<u32> binned = getClusterLights(clusters, x, y, slice);
+					CHECK(std::adjacent_find(binned.begin(), binned.end()) == binned.end());
+					for (u32 i = 0; i < static_cast<u32>(lights.size()); ++i)
+					{
+						const bool isBinned = std::binary_search(binned.begin(), binned.end(), i);
+						if (isInClusterAABB(camera, cell, centers[i], radii[i]))
+						{
+							CHECK(isBinned || !isInCell(camera, cell, centers[i], radii[i]));
+							pairCount += isBinned ? 1 : 0;
+						}
+						else
+						{
+							CHECK(!isBinned);
+						}
+					}
+				}
+			}
+		}
+		return pairCount;
+	}
+
+	// Points and spots around the origin, some behind the camera or crossing its near plane
+	Vector<ClusterLight> makeRandomLights(u32 count)
+	{
+		u32 seed = 1;
+		auto random = [&seed]()
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return static_cast<f32>(seed >> 8) / 16777216.0f;
+		};
+		Vector<ClusterLight> lights(count);
+		for (ClusterLight& light : lights)
+		{
+			light.m_pos = v3(random() * 40.0f - 20.0f, random() * 10.0f - 3.0f, random() * 44.0f - 30.0f);
+			light.m_radius = 0.5f + random() * 5.0f;
+			if (random() < 0.4f)
+			{
+				light.m_type = ClusterLight::Spot;
+				light.m_dir = glm::normalize(v3(random() - 0.5f, random() - 0.5f, random() - 0.5f));
+				light.m_cosOuterCone = random();
+			}
+		}
+		return lights;
+	}
+}
+
+TEST_CASE(LightClusters_MatchesBruteForce)
+{
+	const Camera camera;
+	const Vector<ClusterLight> lights = makeRandomLights(40);
+	LightClusters clusters;
+	clusters.init(LightClusters::Config());
+	clusters.build(camera.m_view, camera.m_projection, s_near, s_far, 1280, 720, lights.data(), static_cast<u32>(lights.size()));
+	CHECK(clusters.getDroppedCount() == 0);
+	CHECK(checkAgainstBruteForce(clusters, camera, lights) == clusters.getLightIndices().size());
+	CHECK(clusters.getLightIndices().size() > 1000);
+	CHECK(clusters.getShaderConstants().m_grid.w == 40.0f);
+}
+
+TEST_CASE(LightClusters_ThreadedMatchesBruteForce)
+{
+	// Enough lights for several threads, and room for all of them in every cluster
+	const Camera camera;
+	const Vector<ClusterLight> lights = makeRandomLights(800);
+	LightClusters::Config config;
+	config.m_maxLightsPerCluster = 1024;
+	config.m_maxThreadCount = 4;
+	LightClusters clusters;
+	clusters.init(config);
+	clusters.build(camera.m_view, camera.m_projection, s_near, s_far, 1280, 720, lights.data(), static_cast<u32>(lights.size()));
+	CHECK(clusters.getDroppedCount() == 0);
+	CHECK(checkAgainstBruteForce(clusters, camera, lights) == clusters.getLightIndices().size());
+
+	// Same result on one thread
+	config.m_maxThreadCount = 1;
+	LightClusters singleThreaded;
+	singleThreaded.init(config);
+	singleThreaded.build(camera.m_view, camera.m_projection, s_near, s_far, 1280, 720, lights.data(), static_cast<u32>(lights.size()));
+	CHECK(singleThreaded.getLightIndices() == clusters.getLightIndices());
+}
+
+TEST_CASE(LightClusters_LightCrossingTheNearPlane)
+{
+	// Around the camera: every tile of the first slice needs it, even though its center is behind the near plane
+	const Camera camera;
+	ClusterLight light;
+	light.m_pos = v3(0.0f, 2.0f, 10.2f);
+	light.m_radius = 1.0f;
+	LightClusters clusters;
+	clusters.init(LightClusters::Config());
+	clusters.build(camera.m_view, camera.m_projection, s_near, s_far, 1280, 720, &light, 1);
+	const LightClusters::Config& config = clusters.getConfig();
+	for (u32 y = 0; y < config.m_tilesY; ++y)
+	{
+		for (u32 x = 0; x < config.m_tilesX; ++x)
+		{
+			CHECK(getClusterLights(clusters, x, y, 0) == Vector<u32>(1, 0));
+		}
+	}
+	CHECK(getClusterLights(clusters, 0, 0, config.m_slices - 1).empty());
+	checkAgainstBruteForce(clusters, camera, Vector<ClusterLight>(1, light));
+}
+
+TEST_CASE(LightClusters_SpotConesAreTighterThanTheirRange)
+{
+	// A narrow spot along the view direction only reaches the center tiles, a point light with its range reaches the corners
+	const Camera camera;
+	const v3 forward = glm::normalize(v3(0.0f, -2.0f, -10.0f));
+	ClusterLight lights[2];
+	lights[0].m_type = ClusterLight::Spot;
+	lights[0].m_pos = v3(0.0f, 2.0f, 10.0f) + forward;
+	lights[0].m_dir = forward;
+	lights[0].m_radius = 8.0f;
+	lights[0].m_cosInnerCone = 0.99f;
+	lights[0].m_cosOuterCone = 0.97f;
+	lights[1].m_pos = lights[0].m_pos;
+	lights[1].m_radius = 8.0f;
+
+	v3 center;
+	f32 radius;
+	LightClusters::getLightSphere(lights[0], center, radius);
+	CHECK(radius < lights[0].m_radius);
+
+	LightClusters clusters;
+	clusters.init(LightClusters::Config());
+	clusters.build(camera.m_view, camera.m_projection, s_near, s_far, 1280, 720, lights, 2);
+	const LightClusters::Config& config = clusters.getConfig();
+	u32 spotClusterCount = 0;
+	u32 pointClusterCount = 0;
+	for (u32 slice = 0; slice < config.m_slices; ++slice)
+	{
+		for (u32 y = 0; y < config.m_tilesY; ++y)
+		{
+			for (u32 x = 0; x < config.m_tilesX; ++x)
+			{
+				const Vector<u32> binned = getClusterLights(clusters, x, y, slice);
+				spotClusterCount += std::count(binned.begin(), binned.end(), 0u);
+				pointClusterCount += std::count(binned.begin(), binned.end(), 1u);
+			}
+		}
+	}
+	CHECK(spotClusterCount > 0 && spotClusterCount < pointClusterCount);
+	checkAgainstBruteForce(clusters, camera, Vector<ClusterLight>(lights, lights + 2));
+}
+
+TEST_CASE(LightClusters_DropsLightsOfFullClusters)
+{
+	const Camera camera;
+	const Vector<ClusterLight> lights = makeRandomLights(40);
+	LightClusters::Config config;
+	LightClusters unlimited;
+	unlimited.init(config);
+	unlimited.build(camera.m_view, camera.m_projection, s_near, s_far, 1280, 720, lights.data(), static_cast<u32>(lights.size()));
+	CHECK(unlimited.getDroppedCount() == 0);
+
+	config.m_maxLightsPerCluster = 2;
+	LightClusters limited;
+	limited.init(config);
+	limited.build(camera.m_view, camera.m_projection, s_near, s_far, 1280, 720, lights.data(), static_cast<u32>(lights.size()));
+	u32 expectedDropped = 0;
+	for (u32 i = 0; i < limited.getClusterCount(); ++i)
+	{
+		const u32 count = unlimited.getRanges()[i].m_count;
+		CHECK(limited.getRanges()[i].m_count == glm::min(count, 2u));
+		expectedDropped += count > 2 ? count - 2 : 0;
+	}
+	CHECK(expectedDropped > 0);
+	CHECK(limited.getDroppedCount() == expectedDropped);
+}
@@ -0,0 +1,194 @@
+#include "tests/Test.h"
+#include "framework/OcclusionCuller.h"
+
+using namespace framework;
+
+namespace
+{
+	// Camera at z = 5 looking down -Z
+	m4 makeViewProj()
+	{
+		const m4 proj = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+		const m4 view = glm::lookAt(v3(0.0f, 0.0f, 5.0f), v3(0.0f), v3(0.0f, 1.0f, 0.0f));
+		return proj * view;
+	}
+
+	// Grid of cellsPerSide^2 quads (2 triangles each) from minCorner along axisU and axisV
+	struct Mesh
+	{
+		Vector<v3> m_positions;
+		Vector<u32> m_indices;
+
+		Mesh(const v3& minCorner, const v3& axisU, const v3& axisV, u32 cellsPerSide)
+		{
+			for (u32 j = 0; j <= cellsPerSide; ++j)
+			{
+				for (u32 i = 0; i <= cellsPerSide; ++i)
+				{
+					m_positions.push_back(minCorner + axisU * (static_cast<f32>(i) / cellsPerSide) + axisV * (static_cast<f32>(j) / cellsPerSide));
+				}
+			}
+			for (u32 j = 0; j < cellsPerSide; ++j)
+			{
+				for (u32 i = 0; i < cellsPerSide; ++i)
+				{
+					const u32 v0 = j * (cellsPerSide + 1) + i;
+					const u32 v1 = v0 + cellsPerSide + 1;
+					m_indices.insert(m_indices.end(), {v0, v0 + 1, v1 + 1, v0, v1 + 1, v1});
+				}
+			}
+		}
+	};
+
+	// Wall at z = 0, much bigger than the view
+	Mesh makeWall(u32 cellsPerSide = 1)
+	{
+		return Mesh(v3(-100.0f, -100.0f, 0.0f), v3(200.0f, 0.0f, 0.0f), v3(0.0f, 200.0f, 0.0f), cellsPerSide);
+	}
+
+	void rasterize(OcclusionCuller& culler, const Mesh& mesh)
+	{
+		culler.beginFrame(makeViewProj());
+		culler.addOccluder(mesh.m_positions.data(), mesh.m_indices.data(), static_cast<u32>(mesh.m_indices.size()), false, m4(1.0f));
+		culler.rasterize();
+	}
+}
+
+TEST_CASE(OcclusionCuller_FullScreenOccluder)
+{
+	OcclusionCuller culler;
+	CHECK(culler.init(OcclusionCuller::Config()));
+	const Mesh wall = makeWall();
+	rasterize(culler, wall);
+
+	// The wall is 5 units away everywhere on screen: 1/w = 0.2
+	for (f32 depth : culler.getDepth())
+	{
+		CHECK_NEAR(depth, 0.2f, 1e-4f);
+	}
+	CHECK(culler.getStats().m_occluderTriangles == 2);
+
+	const m4 identity(1.0f);
+	CHECK(!culler.isVisible(v3(0.0f, 0.0f, -3.0f), v3(0.5f), identity));
+	CHECK(!culler.isVisible(v3(0.0f), v3(0.5f), glm::translate(identity, v3(1.0f, 1.0f, -10.0f))));
+	CHECK(culler.isVisible(v3(0.0f, 0.0f, 2.0f), v3(0.5f), identity));
+	// Crossing the wall, and around the camera
+	CHECK(culler.isVisible(v3(0.0f, 0.0f, -0.1f), v3(0.5f), identity));
+	CHECK(culler.isVisible(v3(0.0f, 0.0f, 5.0f), v3(0.5f), identity));
+	// Off screen is left to the frustum culling
+	CHECK(culler.isVisible(v3(50.0f, 0.0f, -3.0f), v3(0.5f), identity));
+	CHECK(culler.getStats().m_testedCount == 6 && culler.getStats().m_culledCount == 2);
+}
+
+TEST_CASE(OcclusionCuller_ClipsOccludersAtTheNearPlane)
+{
+	// Floor at y = -1 going from far in front of the camera to behind it: clipped, it covers the bottom half of the screen
+	OcclusionCuller culler;
+	CHECK(culler.init(OcclusionCuller::Config()));
+	const Mesh floor(v3(-50.0f, -1.0f, 50.0f), v3(100.0f, 0.0f, 0.0f), v3(0.0f, 0.0f, -100.0f), 1);
+	rasterize(culler, floor);
+	CHECK(culler.getStats().m_occluderTriangles > 2);
+
+	const u32 width = culler.getWidth();
+	const u32 height = culler.getHeight();
+	const Vector<f32>& depth = culler.getDepth();
+	const m4 proj = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+	for (u32 y = 0; y < height; ++y)
+	{
+		// The floor seen through the pixel center is 1 / tan(angle below the horizon) away: 1/w = ndcY * tan(fov / 2)
+		const f32 ndcY = 1.0f - 2.0f * (y + 0.5f) / height;
+		const f32 expected = ndcY < 0.0f ? -ndcY / proj[1][1] : 0.0f;
+		if (expected > 0.0f && expected < 0.03f)
+		{
+			continue; // Past the far end of the floor
+		}
+		for (u32 x : {0u, width / 2, width - 1})
+		{
+			CHECK_NEAR(depth[y * width + x], expected, 1e-3f);
+		}
+	}
+
+	// The triangles sharing the clipped edge leave no cracks
+	for (u32 y = height / 2 + 4; y < height; ++y)
+	{
+		for (u32 x = 0; x < width; ++x)
+		{
+			CHECK(depth[y * width + x] > 0.0f);
+		}
+	}
+
+	const m4 identity(1.0f);
+	CHECK(!culler.isVisible(v3(0.0f, -3.0f, -10.0f), v3(0.5f), identity));
+	CHECK(culler.isVisible(v3(0.0f, 0.0f, -10.0f), v3(0.5f), identity));
+}
+
+TEST_CASE(OcclusionCuller_HierarchyKeepsTheFarthestDepth)
+{
+	// 96x48 pixels: levels of 6x3 and 3x2 texels have a row or column left over
+	OcclusionCuller::Config config;
+	config.m_width = 96;
+	config.m_height = 48;
+	OcclusionCuller culler;
+	CHECK(culler.init(config));
+	CHECK(culler.getLevelCount() == 8);
+	CHECK(culler.getLevelWidth(4) == 6 && culler.getLevelHeight(4) == 3);
+	CHECK(culler.getLevelWidth(5) == 3 && culler.getLevelHeight(5) == 2);
+
+	// A tilted quad that covers part of the screen, so the depth varies and has empty texels
+	const Mesh quad(v3(-2.0f, -1.5f, -1.0f), v3(4.5f, 0.0f, 3.0f), v3(0.0f, 3.0f, 0.0f), 2);
+	rasterize(culler, quad);
+	u32 coveredCount = 0;
+	for (f32 depth : culler.getDepth())
+	{
+		coveredCount += depth > 0.0f ? 1 : 0;
+	}
+	CHECK(coveredCount > 0 && coveredCount < culler.getDepth().size());
+
+	for (u32 level = 1; level < culler.getLevelCount(); ++level)
+	{
+		const Vector<f32>& src = culler.getLevel(level - 1);
+		const u32 srcWidth = culler.getLevelWidth(level - 1);
+		const u32 srcHeight = culler.getLevelHeight(level - 1);
+		CHECK(culler.getLevelWidth(level) == (srcWidth + 1) / 2 && culler.getLevelHeight(level) == (srcHeight + 1) / 2);
+		for (u32 y = 0; y < culler.getLevelHeight(level); ++y)
+		{
+			for (u32 x = 0; x < culler.getLevelWidth(level); ++x)
+			{
+				f32 expected = 1e30f;
+				for (u32 srcY = 2 * y; srcY < glm::min(2 * y + 2, srcHeight); ++srcY)
+				{
+					for (u32 srcX = 2 * x; srcX < glm::min(2 * x + 2, srcWidth); ++srcX)
+					{
+						expected = glm::min(expected, src[srcY * srcWidth + srcX]);
+					}
+				}
+				CHECK(culler.getLevel(level)[y * culler.getLevelWidth(level) + x] == expected);
+			}
+		}
+	}
+	CHECK(culler.getLevel(culler.getLevelCount() - 1)[0] == 0.0f);
+}
+
+TEST_CASE(OcclusionCuller_ThreadedMatchesSingleThreaded)
+{
+	// Enough triangles for 4 threads
+	const Mesh wall = makeWall(48);
+	OcclusionCuller::Config config;
+	config.m_maxThreadCount = 4;
+	OcclusionCuller threaded;
+	CHECK(threaded.init(config));
+	rasterize(threaded, wall);
+	config.m_maxThreadCount = 1;
+	OcclusionCuller singleThreaded;
+	CHECK(singleThreaded.init(config));
+	rasterize(singleThreaded, wall);
+
+	CHECK(threaded.getStats().m_occluderTriangles == singleThreaded.getStats().m_occluderTriangles);
+	CHECK(threaded.getStats().m_occluderTriangles > 0);
+	CHECK(threaded.getDepth() == singleThreaded.getDepth());
+	for (f32 depth : threaded.getDepth())
+	{
+		CHECK_NEAR(depth, 0.2f, 1e-4f);
+	}
+	CHECK(!threaded.isVisible(v3(0.0f, 0.0f, -3.0f), v3(0.5f), m4(1.0f)));
+}
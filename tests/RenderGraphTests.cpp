@@ -0,0 +1,174 @@
+#include "tests/Test.h"
+#include "framework/RenderGraph.h"
+
+using namespace framework;
+
+namespace
+{
+	const RenderGraph::TextureDesc s_hdrDesc = { 1280, 720, 10, 8, RenderGraph::ColorTarget }; // R16G16B16A16_FLOAT
+	const RenderGraph::TextureDesc s_ldrDesc = { 1280, 720, 28, 4, RenderGraph::ColorTarget }; // R8G8B8A8_UNORM
+	const RenderGraph::TextureDesc s_depthDesc = { 1280, 720, 45, 4, RenderGraph::DepthTarget }; // D24_UNORM_S8_UINT
+
+	// Appends the name of the pass to the log when it runs
+	RenderGraph::Execute logPass(String& log, const char* name)
+	{
+		return [&log, name]() { log += name; };
+	}
+}
+
+TEST_CASE(RenderGraph_CullsAndOrdersPasses)
+{
+	RenderGraph graph;
+	String log;
+	RenderGraph::ResourceHandle backBuffer = graph.importTexture("BackBuffer", s_ldrDesc);
+	RenderGraph::ResourceHandle depth = graph.createTexture("Depth", s_depthDesc);
+	RenderGraph::ResourceHandle scene = graph.createTexture("Scene", s_hdrDesc);
+	RenderGraph::ResourceHandle bloomA = graph.createTexture("BloomA", s_hdrDesc);
+	RenderGraph::ResourceHandle bloomB = graph.createTexture("BloomB", s_hdrDesc);
+	RenderGraph::ResourceHandle unused = graph.createTexture("Unused", s_hdrDesc);
+
+	// Declared out of order, and a pass whose output nothing reads
+	const u32 tonemapPass = graph.addPass("Tonemap", logPass(log, "T"));
+	const u32 scenePass = graph.addPass("Scene", logPass(log, "S"));
+	const u32 bloomPass = graph.addPass("Bloom", logPass(log, "B"));
+	const u32 debugPass = graph.addPass("Debug", logPass(log, "X"));
+	const u32 blurPass = graph.addPass("Blur", logPass(log, "2"));
+	const RenderGraph::ResourceHandle depth1 = graph.write(scenePass, depth);
+	scene = graph.write(scenePass, scene);
+	graph.read(bloomPass, scene);
+	bloomA = graph.write(bloomPass, bloomA);
+	graph.read(blurPass, bloomA);
+	bloomB = graph.write(blurPass, bloomB);
+	graph.read(tonemapPass, scene);
+	graph.read(tonemapPass, bloomB);
+	graph.write(tonemapPass, backBuffer);
+	graph.read(debugPass, depth1);
+	unused = graph.write(debugPass, unused);
+
+	// Only the latest version can be written
+	CHECK(graph.write(debugPass, depth) == RenderGraph::s_invalidHandle);
+
+	CHECK(graph.compile());
+	graph.execute();
+	CHECK(log == "SB2T");
+	CHECK(graph.isPassCulled(debugPass));
+	CHECK(!graph.isPassCulled(scenePass) && !graph.isPassCulled(tonemapPass));
+	CHECK(graph.getPassOrder().size() == 4);
+	CHECK(graph.getPhysicalIndex(unused) == RenderGraph::s_invalidIndex);
+	CHECK(graph.getPhysicalIndex(backBuffer) == RenderGraph::s_invalidIndex);
+
+	const RenderGraph::Report& report = graph.getReport();
+	CHECK(report.m_passCount == 5 && report.m_culledPassCount == 1);
+	CHECK(report.m_transientCount == 4);
+}
+
+TEST_CASE(RenderGraph_ReadsRunBeforeTheNextWrite)
+{
+	// R0 reads the first version of A, so it has to run before W1 modifies it even though it's declared later
+	RenderGraph graph;
+	String log;
+	RenderGraph::ResourceHandle backBuffer = graph.importTexture("BackBuffer", s_ldrDesc);
+	RenderGraph::ResourceHandle a = graph.createTexture("A", s_hdrDesc);
+	const u32 write0 = graph.addPass("W0", logPass(log, "a"));
+	const u32 write1 = graph.addPass("W1", logPass(log, "b"));
+	const u32 read0 = graph.addPass("R0", logPass(log, "r"));
+	const u32 read1 = graph.addPass("R1", logPass(log, "s"));
+	const RenderGraph::ResourceHandle a1 = graph.write(write0, a);
+	const RenderGraph::ResourceHandle a2 = graph.write(write1, a1);
+	graph.read(read0, a1);
+	backBuffer = graph.write(read0, backBuffer);
+	graph.read(read1, a2);
+	graph.write(read1, backBuffer);
+
+	CHECK(graph.compile());
+	graph.execute();
+	CHECK(log == "arbs");
+}
+
+TEST_CASE(RenderGraph_DetectsCycles)
+{
+	RenderGraph graph;
+	const RenderGraph::ResourceHandle backBuffer = graph.importTexture("BackBuffer", s_ldrDesc);
+	const RenderGraph::ResourceHandle a = graph.createTexture("A", s_hdrDesc);
+	const RenderGraph::ResourceHandle b = graph.createTexture("B", s_hdrDesc);
+	const u32 pass0 = graph.addPass("P0", nullptr);
+	const u32 pass1 = graph.addPass("P1", nullptr);
+	const RenderGraph::ResourceHandle a1 = graph.write(pass0, a);
+	const RenderGraph::ResourceHandle b1 = graph.write(pass1, b);
+	graph.read(pass0, b1);
+	graph.read(pass1, a1);
+	graph.write(pass0, backBuffer);
+	CHECK(!graph.compile());
+	CHECK(graph.getPassOrder().empty());
+
+	// Resetting gives a usable graph again
+	graph.reset();
+	const RenderGraph::ResourceHandle backBuffer2 = graph.importTexture("BackBuffer", s_ldrDesc);
+	graph.write(graph.addPass("P0", nullptr), backBuffer2);
+	CHECK(graph.compile());
+	CHECK(graph.getPassOrder().size() == 1);
+}
+
+TEST_CASE(RenderGraph_AliasesTexturesThatDontOverlap)
+{
+	// A chain of post passes: A is dead by the time C is written, so they share a texture. B overlaps both.
+	// D has another description and L isn't used by a pass that runs
+	RenderGraph graph;
+	RenderGraph::ResourceHandle backBuffer = graph.importTexture("BackBuffer", s_ldrDesc);
+	const RenderGraph::ResourceHandle a = graph.createTexture("A", s_hdrDesc);
+	const RenderGraph::ResourceHandle b = graph.createTexture("B", s_hdrDesc);
+	const RenderGraph::ResourceHandle c = graph.createTexture("C", s_hdrDesc);
+	const RenderGraph::ResourceHandle d = graph.createTexture("D", s_ldrDesc);
+	const RenderGraph::ResourceHandle l = graph.createTexture("L", s_hdrDesc);
+	const u32 pass0 = graph.addPass("P0", nullptr);
+	const u32 pass1 = graph.addPass("P1", nullptr);
+	const u32 pass2 = graph.addPass("P2", nullptr);
+	const u32 pass3 = graph.addPass("P3", nullptr);
+	const u32 pass4 = graph.addPass("P4", nullptr);
+	const u32 culledPass = graph.addPass("Culled", nullptr);
+	const RenderGraph::ResourceHandle a1 = graph.write(pass0, a);
+	graph.read(pass1, a1);
+	const RenderGraph::ResourceHandle b1 = graph.write(pass1, b);
+	graph.read(pass2, b1);
+	const RenderGraph::ResourceHandle c1 = graph.write(pass2, c);
+	graph.read(pass3, c1);
+	const RenderGraph::ResourceHandle d1 = graph.write(pass3, d);
+	graph.read(pass4, d1);
+	graph.write(pass4, backBuffer);
+	const RenderGraph::ResourceHandle l1 = graph.write(culledPass, l);
+
+	CHECK(graph.compile());
+	CHECK(graph.getPhysicalIndex(a1) == graph.getPhysicalIndex(c1));
+	CHECK(graph.getPhysicalIndex(b1) != graph.getPhysicalIndex(a1));
+	CHECK(graph.getPhysicalIndex(d1) != graph.getPhysicalIndex(a1) && graph.getPhysicalIndex(d1) != graph.getPhysicalIndex(b1));
+	CHECK(graph.getPhysicalIndex(l1) == RenderGraph::s_invalidIndex);
+	CHECK(graph.getPhysicalCount() == 3);
+	CHECK(graph.getPhysicalDesc(graph.getPhysicalIndex(d1)) == s_ldrDesc);
+
+	const RenderGraph::Report& report = graph.getReport();
+	CHECK(report.m_transientCount == 4 && report.m_physicalCount == 3);
+	CHECK(report.m_transientBytes == 3 * s_hdrDesc.getSize() + s_ldrDesc.getSize());
+	CHECK(report.m_physicalBytes == 2 * s_hdrDesc.getSize() + s_ldrDesc.getSize());
+	CHECK(report.getSavedBytes() == s_hdrDesc.getSize());
+}
+
+TEST_CASE(RenderGraph_DoesntAliasWithinAPass)
+{
+	// A texture last read by a pass can't be reused by a texture first written by the same pass
+	RenderGraph graph;
+	RenderGraph::ResourceHandle backBuffer = graph.importTexture("BackBuffer", s_ldrDesc);
+	const RenderGraph::ResourceHandle a = graph.createTexture("A", s_hdrDesc);
+	const RenderGraph::ResourceHandle b = graph.createTexture("B", s_hdrDesc);
+	const u32 pass0 = graph.addPass("P0", nullptr);
+	const u32 pass1 = graph.addPass("P1", nullptr);
+	const u32 pass2 = graph.addPass("P2", nullptr);
+	const RenderGraph::ResourceHandle a1 = graph.write(pass0, a);
+	graph.read(pass1, a1);
+	const RenderGraph::ResourceHandle b1 = graph.write(pass1, b);
+	graph.read(pass2, b1);
+	graph.write(pass2, backBuffer);
+
+	CHECK(graph.compile());
+	CHECK(graph.getPhysicalIndex(a1) != graph.getPhysicalIndex(b1));
+	CHECK(graph.getReport().getSavedBytes() == 0);
+}
@@ -0,0 +1,89 @@
+#include "tests/Test.h"
+#include "framework/RingAllocator.h"
+
+using namespace framework;
+
+TEST_CASE(RingAllocator_AllocatesInOrderAndAligns)
+{
+	RingAllocator ring(256);
+	u64 a, b, c;
+	CHECK(ring.allocate(10, 1, a) && a == 0);
+	CHECK(ring.allocate(10, 16, b) && b == 16);
+	CHECK(ring.allocate(32, 64, c) && c == 64);
+	CHECK(ring.getHead() == 96);
+	CHECK(ring.getUsedBytes() == 96);
+}
+
+TEST_CASE(RingAllocator_RejectsInvalidSizes)
+{
+	RingAllocator ring(256);
+	u64 position = 123;
+	CHECK(!ring.allocate(0, 1, position));
+	CHECK(!ring.allocate(257, 1, position));
+	CHECK(position == 123);
+	CHECK(ring.getUsedBytes() == 0);
+}
+
+TEST_CASE(RingAllocator_FailsWhenFullUntilReleased)
+{
+	RingAllocator ring(256);
+	u64 a, b, c;
+	CHECK(ring.allocate(128, 1, a));
+	CHECK(ring.allocate(128, 1, b));
+	CHECK(!ring.allocate(1, 1, c));
+
+	ring.release(b);
+	CHECK(ring.getUsedBytes() == 128);
+	CHECK(ring.allocate(100, 1, c) && c == 256 && ring.getOffset(c) == 0);
+}
+
+TEST_CASE(RingAllocator_SkipsTheEndInsteadOfWrapping)
+{
+	RingAllocator ring(256);
+	u64 a, b, c;
+	CHECK(ring.allocate(200, 1, a));
+	ring.release(ring.getHead());
+	CHECK(ring.getUsedBytes() == 0);
+
+	// 56 bytes are left before the end, the allocation moves to the start of the ring and the gap counts as used
+	CHECK(ring.allocate(100, 1, b) && b == 256 && ring.getOffset(b) == 0);
+	CHECK(ring.getUsedBytes() == 156);
+
+	// The skipped gap is only free once the tail moves past it
+	CHECK(!ring.allocate(120, 1, c));
+	CHECK(ring.allocate(100, 1, c) && c == 356 && ring.getOffset(c) == 100);
+}
+
+TEST_CASE(RingAllocator_ReuseDoesNotOverlapLiveAllocations)
+{
+	// Allocate and free in FIFO order for many laps of the ring, keeping a few allocations alive
+	RingAllocator ring(1024);
+	Vector<std::pair<u64, u64>> live; // Position, size
+	u32 failures = 0;
+	for (u32 i = 0; i < 2000; ++i)
+	{
+		const u64 size = 1 + (i * 37) % 300;
+		u64 position;
+		while (!ring.allocate(size, 16, position))
+		{
+			CHECK(!live.empty());
+			if (live.empty())
+			{
+				return;
+			}
+			live.erase(live.begin());
+			ring.release(live.empty() ? ring.getHead() : live.front().first);
+			failures++;
+		}
+		CHECK(position % 16 == 0);
+		CHECK(ring.getOffset(position) + size <= ring.getCapacity());
+		for (const std::pair<u64, u64>& other : live)
+		{
+			CHECK(position >= other.first + other.second);
+			CHECK(position + size - other.first <= ring.getCapacity());
+		}
+		live.push_back({position, size});
+	}
+	CHECK(ring.getHead() > 10 * ring.getCapacity());
+	CHECK(failures > 0);
+}
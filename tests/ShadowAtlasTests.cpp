@@ -0,0 +1,234 @@
+#include "tests/Test.h"
+#include "framework/ShadowAtlas.h"
+
+using namespace framework;
+
+namespace
+{
+	bool areOverlapping(const ShadowAtlasAllocator::Tile& a, const ShadowAtlasAllocator::Tile& b)
+	{
+		return a.m_x < b.m_x + b.m_size && b.m_x < a.m_x + a.m_size && a.m_y < b.m_y + b.m_size && b.m_y < a.m_y + a.m_size;
+	}
+
+	ShadowAtlas::Request makeRequest(u64 key, f32 importance, u32 size)
+	{
+		ShadowAtlas::Request request;
+		request.m_key = key;
+		request.m_viewHash = key * 100;
+		request.m_importance = importance;
+		request.m_size = size;
+		return request;
+	}
+}
+
+TEST_CASE(ShadowAtlasAllocator_Split)
+{
+	ShadowAtlasAllocator allocator;
+	CHECK(!allocator.init(1000, 128));
+	CHECK(!allocator.init(128, 1024));
+	CHECK(allocator.init(1024, 128));
+	CHECK(allocator.getFreeArea() == 1024 * 1024);
+
+	// Sizes round up to a power of 2 and are clamped to the atlas
+	ShadowAtlasAllocator::Tile big;
+	CHECK(allocator.allocate(300, big));
+	CHECK(big.m_size == 512 && big.m_x % 512 == 0 && big.m_y % 512 == 0);
+	CHECK(allocator.getFreeArea() == 1024 * 1024 - 512 * 512);
+	ShadowAtlasAllocator::Tile tile;
+	CHECK(!allocator.allocate(4096, tile));
+	CHECK(allocator.allocate(1, tile));
+	CHECK(tile.m_size == 128);
+
+	// Fill the rest with the smallest tiles: none overlap and nothing is left
+	Vector<ShadowAtlasAllocator::Tile> tiles = {tile};
+	while (allocator.allocate(128, tile))
+	{
+		tiles.push_back(tile);
+	}
+	CHECK(tiles.size() == 48);
+	CHECK(allocator.getFreeArea() == 0);
+	tiles.push_back(big);
+	for (size_t i = 0; i < tiles.size(); ++i)
+	{
+		CHECK(tiles[i].m_x + tiles[i].m_size <= 1024 && tiles[i].m_y + tiles[i].m_size <= 1024);
+		for (size_t j = i + 1; j < tiles.size(); ++j)
+		{
+			CHECK(!areOverlapping(tiles[i], tiles[j]));
+		}
+	}
+}
+
+TEST_CASE(ShadowAtlasAllocator_MergesReleasedSiblings)
+{
+	ShadowAtlasAllocator allocator;
+	CHECK(allocator.init(1024, 128));
+	Vector<ShadowAtlasAllocator::Tile> tiles(64);
+	for (ShadowAtlasAllocator::Tile& tile : tiles)
+	{
+		CHECK(allocator.allocate(128, tile));
+	}
+
+	// One tile left keeps its 512 quadrant and the 256 block around it split
+	ShadowAtlasAllocator::Tile kept = tiles[0];
+	for (size_t i = 1; i < tiles.size(); ++i)
+	{
+		allocator.release(tiles[i]);
+	}
+	CHECK(allocator.getFreeArea() == 1024 * 1024 - 128 * 128);
+	ShadowAtlasAllocator::Tile tile;
+	CHECK(!allocator.allocate(1024, tile));
+	Vector<ShadowAtlasAllocator::Tile> quadrants;
+	while (allocator.allocate(512, tile))
+	{
+		CHECK(!areOverlapping(tile, kept));
+		quadrants.push_back(tile);
+	}
+	CHECK(quadrants.size() == 3);
+
+	// Releasing twice does nothing
+	allocator.release(kept);
+	allocator.release(kept);
+	for (const ShadowAtlasAllocator::Tile& quadrant : quadrants)
+	{
+		allocator.release(quadrant);
+	}
+	CHECK(allocator.getFreeArea() == 1024 * 1024);
+	CHECK(allocator.allocate(1024, tile));
+	CHECK(tile.m_x == 0 && tile.m_y == 0 && tile.m_size == 1024);
+}
+
+TEST_CASE(ShadowAtlas_KeepsCachedTiles)
+{
+	ShadowAtlas atlas;
+	CHECK(atlas.init(ShadowAtlas::Config()));
+	ShadowAtlas::Request request = makeRequest(1, 1.0f, 512);
+
+	atlas.update(&request, 1);
+	CHECK(atlas.getRenderList().size() == 1 && atlas.getRenderList()[0] == 0);
+	const ShadowAtlas::Result first = atlas.getResults()[0];
+	CHECK(first.m_hasTile && first.m_isValid && first.m_tile.m_size == 512);
+
+	// Same view: the tile is reused without rendering
+	atlas.update(&request, 1);
+	CHECK(atlas.getRenderList().empty());
+	CHECK(atlas.getResults()[0].m_isValid && atlas.getResults()[0].m_tile.m_node == first.m_tile.m_node);
+
+	// The view moved: same tile, rendered again
+	request.m_viewHash++;
+	atlas.update(&request, 1);
+	CHECK(atlas.getRenderList().size() == 1);
+	CHECK(atlas.getResults()[0].m_isValid && atlas.getResults()[0].m_tile.m_node == first.m_tile.m_node);
+
+	// Another size gets a new tile
+	request.m_size = 256;
+	atlas.update(&request, 1);
+	CHECK(atlas.getRenderList().size() == 1);
+	CHECK(atlas.getResults()[0].m_tile.m_size == 256);
+	CHECK(atlas.getCachedCount() == 1);
+	CHECK(atlas.getAllocator().getFreeArea() == 4096 * 4096 - 256 * 256);
+}
+
+TEST_CASE(ShadowAtlas_CapsRendersPerFrame)
+{
+	ShadowAtlas::Config config;
+	config.m_maxRendersPerFrame = 2;
+	ShadowAtlas atlas;
+	CHECK(atlas.init(config));
+	Vector<ShadowAtlas::Request> requests;
+	for (u32 i = 0; i < 5; ++i)
+	{
+		requests.push_back(makeRequest(i, static_cast<f32>(i), 256));
+	}
+
+	// The most important views first, the others have a tile but nothing valid in it yet
+	atlas.update(requests.data(), 5);
+	CHECK(atlas.getRenderList() == Vector<u32>({4, 3}));
+	for (u32 i = 0; i < 5; ++i)
+	{
+		CHECK(atlas.getResults()[i].m_hasTile);
+		CHECK(atlas.getResults()[i].m_isValid == (i >= 3));
+	}
+	atlas.update(requests.data(), 5);
+	CHECK(atlas.getRenderList() == Vector<u32>({2, 1}));
+	atlas.update(requests.data(), 5);
+	CHECK(atlas.getRenderList() == Vector<u32>({0}));
+	for (const ShadowAtlas::Result& result : atlas.getResults())
+	{
+		CHECK(result.m_isValid);
+	}
+	atlas.update(requests.data(), 5);
+	CHECK(atlas.getRenderList().empty());
+}
+
+TEST_CASE(ShadowAtlas_EvictionOrder)
+{
+	// Room for 4 views of 512
+	ShadowAtlas::Config config;
+	config.m_size = 1024;
+	ShadowAtlas atlas;
+	CHECK(atlas.init(config));
+	Vector<ShadowAtlas::Request> requests = {makeRequest(1, 5.0f, 512), makeRequest(2, 1.0f, 512), makeRequest(3, 3.0f, 512), makeRequest(4, 2.0f, 512)};
+	atlas.update(requests.data(), 4);
+	CHECK(atlas.getCachedCount() == 4 && atlas.getAllocator().getFreeArea() == 0);
+
+	// View 1 isn't requested any more: it goes before any requested view, even though it was the most important
+	requests[0] = makeRequest(5, 4.0f, 512);
+	atlas.update(requests.data(), 4);
+	CHECK(atlas.getCachedCount() == 4);
+	CHECK(atlas.getRenderList() == Vector<u32>({0}));
+	for (const ShadowAtlas::Result& result : atlas.getResults())
+	{
+		CHECK(result.m_hasTile && result.m_isValid);
+	}
+
+	// All requested: the new view 6 takes the tile of the least important one, which is left without a tile
+	requests.push_back(makeRequest(6, 2.5f, 512));
+	atlas.update(requests.data(), 5);
+	CHECK(atlas.getCachedCount() == 4);
+	CHECK(atlas.getRenderList() == Vector<u32>({4}));
+	CHECK(!atlas.getResults()[1].m_hasTile && !atlas.getResults()[1].m_isValid);
+	for (u32 i : {0u, 2u, 3u, 4u})
+	{
+		CHECK(atlas.getResults()[i].m_hasTile && atlas.getResults()[i].m_isValid);
+	}
+}
+
+TEST_CASE(ShadowAtlas_FallsBackToSmallerTiles)
+{
+	ShadowAtlas::Config config;
+	config.m_size = 1024;
+	ShadowAtlas atlas;
+	CHECK(atlas.init(config));
+	Vector<ShadowAtlas::Request> requests = {makeRequest(1, 3.0f, 512), makeRequest(2, 2.0f, 512), makeRequest(3, 1.0f, 1024)};
+	atlas.update(requests.data(), 3);
+	CHECK(atlas.getResults()[0].m_tile.m_size == 512);
+	CHECK(atlas.getResults()[1].m_tile.m_size == 512);
+	CHECK(atlas.getResults()[2].m_hasTile && atlas.getResults()[2].m_tile.m_size == 512);
+}
+
+TEST_CASE(ShadowAtlas_InvalidateBySphere)
+{
+	ShadowAtlas atlas;
+	CHECK(atlas.init(ShadowAtlas::Config()));
+	Vector<ShadowAtlas::Request> requests = {makeRequest(1, 1.0f, 256), makeRequest(2, 1.0f, 256)};
+	requests[0].m_boundsRadius = 1.0f;
+	requests[1].m_boundsCenter = v3(10.0f, 0.0f, 0.0f);
+	requests[1].m_boundsRadius = 1.0f;
+	atlas.update(requests.data(), 2);
+	CHECK(atlas.getRenderList().size() == 2);
+
+	// A caster touching the first view only
+	atlas.invalidate(v3(1.5f, 0.0f, 0.0f), 0.6f);
+	atlas.update(requests.data(), 2);
+	CHECK(atlas.getRenderList() == Vector<u32>({0}));
+	CHECK(atlas.getResults()[0].m_isValid && atlas.getResults()[1].m_isValid);
+
+	// Between them, touching neither
+	atlas.invalidate(v3(5.0f, 0.0f, 0.0f), 1.0f);
+	atlas.update(requests.data(), 2);
+	CHECK(atlas.getRenderList().empty());
+
+	atlas.invalidateAll();
+	atlas.update(requests.data(), 2);
+	CHECK(atlas.getRenderList().size() == 2);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "framework/Types.h"
+
+#include <cmath>
+
+// Minimal test runner for the D3D-free framework code. TEST_CASE registers a function, CHECK records a failure and the
+// test carries on. Build the tests project and run it, optionally with part of a test name to run only those
+namespace tests
+{
+	using TestFunction = void (*)();
+
+	struct TestCase
+	{
+		const char* m_name;
+		TestFunction m_function;
+	};
+
+	Vector<TestCase>& getTestCases();
+
+	void reportFailure(const char* file, int line, const char* expression);
+
+	struct TestRegistrar
+	{
+		TestRegistrar(const char* name, TestFunction function) { getTestCases().push_back({name, function}); }
+	};
+}
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static tests::TestRegistrar s_##name##Registrar(#name, name); \
+	static void name()
+
+#define CHECK(expression) \
+	do \
+	{ \
+		if (!(expression)) \
+		{ \
+			tests::reportFailure(__FILE__, __LINE__, #expression); \
+		} \
+	} while (false)
+
+#define CHECK_NEAR(a, b, tolerance) CHECK(std::fabs(static_cast<double>(a) - static_cast<double>(b)) <= static_cast<double>(tolerance))
@@ -0,0 +1,47 @@
+#include "tests/Test.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace tests
+{
+
+	static u32 s_failureCount = 0;
+
+	Vector<TestCase>& getTestCases()
+	{
+		static Vector<TestCase> s_testCases;
+		return s_testCases;
+	}
+
+	void reportFailure(const char* file, int line, const char* expression)
+	{
+		printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+		s_failureCount++;
+	}
+
+}
+
+int main(int argCount, char** args)
+{
+	const char* filter = argCount > 1 ? args[1] : nullptr;
+	u32 runCount = 0;
+	u32 failedCount = 0;
+	for (const tests::TestCase& testCase : tests::getTestCases())
+	{
+		if (filter && !strstr(testCase.m_name, filter))
+		{
+			continue;
+		}
+		const u32 prevFailureCount = tests::s_failureCount;
+		testCase.m_function();
+		runCount++;
+		if (tests::s_failureCount != prevFailureCount)
+		{
+			printf("FAILED %s\n", testCase.m_name);
+			failedCount++;
+		}
+	}
+	printf("%u tests, %u failed\n", runCount, failedCount);
+	return failedCount == 0 ? 0 : 1;
+}
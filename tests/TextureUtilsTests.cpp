@@ -0,0 +1,110 @@
+#include "tests/Test.h"
+#include "framework/TextureUtils.h"
+
+#include <cstring>
+
+using namespace framework;
+
+// 8x8 sRGB test image: red and green ramps, a blue checker and a linear alpha ramp
+static Vector<u8> makeTestImage()
+{
+	Vector<u8> image(8 * 8 * MipChain::s_bytesPerTexel);
+	for (u32 y = 0; y < 8; ++y)
+	{
+		for (u32 x = 0; x < 8; ++x)
+		{
+			u8* texel = &image[(y * 8 + x) * MipChain::s_bytesPerTexel];
+			texel[0] = static_cast<u8>(x * 32);
+			texel[1] = static_cast<u8>(y * 32);
+			texel[2] = static_cast<u8>(((x + y) & 1) * 255);
+			texel[3] = static_cast<u8>(255 - x * 16);
+		}
+	}
+	return image;
+}
+
+static bool isLevelEqual(const MipChain& chain, u32 level, const u8* expected, u32 expectedSize)
+{
+	const u32 size = chain.m_levels[level].m_width * chain.m_levels[level].m_height * MipChain::s_bytesPerTexel;
+	return size == expectedSize && memcmp(chain.getLevelData(level), expected, size) == 0;
+}
+
+TEST_CASE(MipGenerator_MipCount)
+{
+	CHECK(MipGenerator::computeMipCount(1, 1) == 1);
+	CHECK(MipGenerator::computeMipCount(256, 128) == 9);
+	CHECK(MipGenerator::computeMipCount(5, 3) == 3);
+}
+
+TEST_CASE(MipGenerator_BoxIsGammaCorrect)
+{
+	// Black and white average to linear 0.5, 188 in sRGB. Alpha is linear
+	const u8 checker[] = {0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0};
+	MipChain chain;
+	MipGenerator::generate(checker, 2, 2, true, MipGenerator::Filter::Box, chain);
+	CHECK(chain.getLevelCount() == 2);
+	const u8 expectedSRGB[] = {188, 188, 188, 128};
+	CHECK(isLevelEqual(chain, 1, expectedSRGB, sizeof(expectedSRGB)));
+
+	MipGenerator::generate(checker, 2, 2, false, MipGenerator::Filter::Box, chain);
+	const u8 expectedLinear[] = {128, 128, 128, 128};
+	CHECK(isLevelEqual(chain, 1, expectedLinear, sizeof(expectedLinear)));
+}
+
+TEST_CASE(MipGenerator_KaiserKeepsConstantImages)
+{
+	Vector<u8> image(16 * 16 * MipChain::s_bytesPerTexel);
+	for (u32 i = 0; i < static_cast<u32>(image.size()); i += MipChain::s_bytesPerTexel)
+	{
+		image[i + 0] = 200;
+		image[i + 1] = 100;
+		image[i + 2] = 10;
+		image[i + 3] = 77;
+	}
+	MipChain chain;
+	MipGenerator::generate(image.data(), 16, 16, true, MipGenerator::Filter::Kaiser, chain);
+	CHECK(chain.getLevelCount() == 5);
+	for (u32 level = 1; level < chain.getLevelCount(); ++level)
+	{
+		CHECK(memcmp(chain.getLevelData(level), image.data(), chain.m_levels[level].m_width * chain.m_levels[level].m_height * MipChain::s_bytesPerTexel) == 0);
+	}
+}
+
+// Reference outputs of makeTestImage, level 1 to 3
+TEST_CASE(MipGenerator_BoxReference)
+{
+	static const u8 s_level1[] = 
+	{
+		20, 20, 188, 247, 82, 20, 188, 215, 145, 20, 188, 183, 209, 20, 188, 151, 20, 82, 188, 247, 82, 82, 188, 215, 145, 82, 188, 183, 209, 82, 188, 151, 
+		20, 145, 188, 247, 82, 145, 188, 215, 145, 145, 188, 183, 209, 145, 188, 151, 20, 209, 188, 247, 82, 209, 188, 215, 145, 209, 188, 183, 209, 209, 188, 151
+	};
+	static const u8 s_level2[] = {60, 60, 188, 231, 181, 60, 188, 167, 60, 181, 188, 231, 181, 181, 188, 167};
+	static const u8 s_level3[] = {138, 138, 188, 199};
+	const Vector<u8> image = makeTestImage();
+	MipChain chain;
+	MipGenerator::generate(image.data(), 8, 8, true, MipGenerator::Filter::Box, chain);
+	CHECK(chain.getLevelCount() == 4);
+	CHECK(chain.m_data.size() == 340);
+	CHECK(isLevelEqual(chain, 0, image.data(), static_cast<u32>(image.size())));
+	CHECK(isLevelEqual(chain, 1, s_level1, sizeof(s_level1)));
+	CHECK(isLevelEqual(chain, 2, s_level2, sizeof(s_level2)));
+	CHECK(isLevelEqual(chain, 3, s_level3, sizeof(s_level3)));
+}
+
+TEST_CASE(MipGenerator_KaiserReference)
+{
+	static const u8 s_level1[] = 
+	{
+		15, 15, 184, 247, 79, 15, 188, 215, 144, 15, 187, 183, 209, 15, 191, 151, 15, 79, 188, 247, 79, 79, 187, 215, 144, 79, 188, 183, 209, 79, 187, 151, 
+		15, 144, 187, 247, 79, 144, 188, 215, 144, 144, 187, 183, 209, 144, 188, 151, 15, 209, 191, 247, 79, 209, 187, 215, 144, 209, 188, 183, 209, 209, 184, 151
+	};
+	static const u8 s_level2[] = {52, 52, 187, 231, 179, 52, 188, 167, 52, 179, 188, 231, 179, 179, 187, 167};
+	static const u8 s_level3[] = {135, 135, 188, 199};
+	const Vector<u8> image = makeTestImage();
+	MipChain chain;
+	MipGenerator::generate(image.data(), 8, 8, true, MipGenerator::Filter::Kaiser, chain);
+	CHECK(chain.getLevelCount() == 4);
+	CHECK(isLevelEqual(chain, 1, s_level1, sizeof(s_level1)));
+	CHECK(isLevelEqual(chain, 2, s_level2, sizeof(s_level2)));
+	CHECK(isLevelEqual(chain, 3, s_level3, sizeof(s_level3)));
+}
@@ -0,0 +1,157 @@
+#include "tests/Test.h"
+#include "framework/VirtualPageTable.h"
+
+using namespace framework;
+
+// 1024x512 texels in 128 texel pages: 8x4, 4x2, 2x1 and 1x1 pages
+static VirtualPageTable::Config makeConfig(u32 slotsX, u32 slotsY)
+{
+	VirtualPageTable::Config config;
+	config.m_width = 1024;
+	config.m_height = 512;
+	config.m_pageSize = 128;
+	config.m_cacheSlotsX = slotsX;
+	config.m_cacheSlotsY = slotsY;
+	return config;
+}
+
+static u32 getTableEntry(VirtualPageTable& table, u32 pageId)
+{
+	const u32 mip = VirtualPageTable::getPageMip(pageId);
+	return table.getTableMip(mip)[VirtualPageTable::getPageY(pageId) * table.getPagesX(mip) + VirtualPageTable::getPageX(pageId)];
+}
+
+TEST_CASE(VirtualPageTable_MipPages)
+{
+	VirtualPageTable table;
+	CHECK(table.init(makeConfig(4, 4)));
+	CHECK(table.getMipCount() == 4);
+	CHECK(table.getPagesX(0) == 8 && table.getPagesY(0) == 4);
+	CHECK(table.getPagesX(1) == 4 && table.getPagesY(1) == 2);
+	CHECK(table.getPagesX(2) == 2 && table.getPagesY(2) == 1);
+	CHECK(table.getPagesX(3) == 1 && table.getPagesY(3) == 1);
+
+	// The coarsest mip needs a slot and there must be room for something else
+	CHECK(!table.init(makeConfig(1, 1)));
+	CHECK(!table.init(makeConfig(0, 4)));
+}
+
+TEST_CASE(VirtualPageTable_RequestsCoarseMipsFirst)
+{
+	VirtualPageTable table;
+	CHECK(table.init(makeConfig(4, 4)));
+
+	// Without feedback only the coarsest mip is missing
+	Vector<u32> requests;
+	table.getRequests(16, requests);
+	CHECK(requests.size() == 1 && requests[0] == VirtualPageTable::makePageId(3, 0, 0));
+	u32 slotX, slotY;
+	CHECK(table.mapPage(VirtualPageTable::makePageId(3, 0, 0), slotX, slotY));
+
+	// Feedback asks for two mip 0 pages, the first one by more pixels. Their missing ancestors are requested too
+	const u32 invalid = VirtualPageTable::s_invalidPage;
+	const u32 pageA = VirtualPageTable::makePageId(0, 3, 1);
+	const u32 pageB = VirtualPageTable::makePageId(0, 5, 2);
+	const u32 outOfRange = VirtualPageTable::makePageId(1, 4, 0);
+	const u32 feedback[] = { invalid, pageA, pageA, pageB, outOfRange, pageA };
+	table.processFeedback(feedback, 6);
+	table.getRequests(16, requests);
+	const u32 expected[] = 
+	{
+		VirtualPageTable::makePageId(2, 0, 0), VirtualPageTable::makePageId(2, 1, 0),
+		VirtualPageTable::makePageId(1, 1, 0), VirtualPageTable::makePageId(1, 2, 1),
+		pageA, pageB,
+	};
+	CHECK(requests.size() == 6);
+	for (u32 i = 0; i < 6 && i < requests.size(); ++i)
+	{
+		CHECK(requests[i] == expected[i]);
+	}
+
+	table.getRequests(2, requests);
+	CHECK(requests.size() == 2);
+
+	// Requests only last a frame
+	table.endFrame();
+	table.getRequests(16, requests);
+	CHECK(requests.empty());
+}
+
+TEST_CASE(VirtualPageTable_TableFallsBackToResidentAncestors)
+{
+	VirtualPageTable table;
+	CHECK(table.init(makeConfig(4, 4)));
+	u32 slotX, slotY;
+	CHECK(table.mapPage(VirtualPageTable::makePageId(3, 0, 0), slotX, slotY) && slotX == 0 && slotY == 0);
+	CHECK(table.mapPage(VirtualPageTable::makePageId(2, 1, 0), slotX, slotY) && slotX == 1 && slotY == 0);
+	CHECK(table.mapPage(VirtualPageTable::makePageId(0, 5, 2), slotX, slotY) && slotX == 2 && slotY == 0);
+	CHECK(table.isTableDirty());
+
+	const u32 coarsest = VirtualPageTable::makeEntry(0, 0, 3);
+	const u32 mip2 = VirtualPageTable::makeEntry(1, 0, 2);
+	CHECK(getTableEntry(table, VirtualPageTable::makePageId(2, 0, 0)) == coarsest);
+	CHECK(getTableEntry(table, VirtualPageTable::makePageId(2, 1, 0)) == mip2);
+	CHECK(getTableEntry(table, VirtualPageTable::makePageId(1, 0, 0)) == coarsest);
+	CHECK(getTableEntry(table, VirtualPageTable::makePageId(1, 2, 1)) == mip2);
+	CHECK(getTableEntry(table, VirtualPageTable::makePageId(0, 0, 0)) == coarsest);
+	CHECK(getTableEntry(table, VirtualPageTable::makePageId(0, 4, 3)) == mip2);
+	CHECK(getTableEntry(table, VirtualPageTable::makePageId(0, 5, 2)) == VirtualPageTable::makeEntry(2, 0, 0));
+	CHECK(!table.isTableDirty());
+
+	// Mapping a resident page again keeps its slot and the table
+	CHECK(table.mapPage(VirtualPageTable::makePageId(2, 1, 0), slotX, slotY) && slotX == 1 && slotY == 0);
+	CHECK(!table.isTableDirty());
+}
+
+TEST_CASE(VirtualPageTable_EvictsLeastRecentlyUsed)
+{
+	// 4 slots: the pinned coarsest page and 3 others
+	VirtualPageTable table;
+	CHECK(table.init(makeConfig(2, 2)));
+	const u32 coarsest = VirtualPageTable::makePageId(3, 0, 0);
+	const u32 pageA = VirtualPageTable::makePageId(2, 0, 0);
+	const u32 pageB = VirtualPageTable::makePageId(2, 1, 0);
+	const u32 pageC = VirtualPageTable::makePageId(1, 0, 0);
+	const u32 pageD = VirtualPageTable::makePageId(1, 1, 0);
+	const u32 pageE = VirtualPageTable::makePageId(1, 2, 0);
+	u32 slotX, slotY;
+	CHECK(table.mapPage(coarsest, slotX, slotY));
+	CHECK(table.mapPage(pageA, slotX, slotY));
+	table.endFrame();
+	CHECK(table.mapPage(pageB, slotX, slotY));
+	CHECK(table.mapPage(pageC, slotX, slotY));
+	table.endFrame();
+
+	// A was used longer ago than B and C, unless the feedback shows it's still in use (through a child that isn't resident)
+	const u32 feedback[] = { VirtualPageTable::makePageId(1, 1, 0) };
+	table.processFeedback(feedback, 1);
+	CHECK(table.mapPage(pageD, slotX, slotY));
+	CHECK(table.isResident(pageA) && !table.isResident(pageB) && table.isResident(pageD));
+	CHECK(table.mapPage(pageE, slotX, slotY));
+	CHECK(!table.isResident(pageC) && table.isResident(pageE));
+
+	// Everything else was used this frame and the coarsest page is pinned
+	CHECK(!table.mapPage(VirtualPageTable::makePageId(0, 0, 0), slotX, slotY));
+	CHECK(table.isResident(coarsest) && table.getResidentCount() == 4);
+}
+
+TEST_CASE(VirtualPageTable_FeedbackTarget)
+{
+	VirtualPageTable table;
+	CHECK(table.init(makeConfig(4, 4)));
+	u32 slotX, slotY;
+	CHECK(table.mapPage(VirtualPageTable::makePageId(3, 0, 0), slotX, slotY));
+
+	// 3x2 target with padded rows, written with page id + 1. 0 is where nothing was rendered
+	const u32 page = VirtualPageTable::makePageId(2, 1, 0);
+	const u32 rowPitch = 4 * sizeof(u32);
+	const u32 target[] = 
+	{
+		0, page + 1, 0, 0xDEADBEEF,
+		page + 1, 0, 0, 0xDEADBEEF,
+	};
+	table.processFeedbackTarget(reinterpret_cast<const u8*>(target), 3, 2, rowPitch);
+	Vector<u32> requests;
+	table.getRequests(16, requests);
+	CHECK(requests.size() == 1 && requests[0] == page);
+}